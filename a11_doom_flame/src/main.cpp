@@ -1,5 +1,7 @@
 // Pinout configuration for the PicoDriver v.5.0
 #include "common/pico_driver_v5_pinout.h"
+#include "common/frame_writer.h"
+#include "common/lut.h"
 
 #include <Arduino.h>
 #include <SmartMatrix.h>
@@ -24,14 +26,15 @@ uint8_t pixel_data[TOTAL_WIDTH * TOTAL_HEIGHT];
 
 uint16_t num_pixels = TOTAL_WIDTH * TOTAL_HEIGHT;
 
-rgb24 palette[] = {
-	rgb24(0, 0, 0),
-	rgb24(42, 7, 7),      // Dark red
-	rgb24(128, 0, 0),     // Bright red
-	rgb24(180, 32, 0),    // Red-orange
-	rgb24(220, 64, 0),    // Orange
-	rgb24(255, 128, 0),   // Yellow-orange
-	rgb24(255, 255, 128), // Bright yellow/white
+// A constant table in flash, no constructor calls at boot (common/lut.h)
+constexpr LutRgb palette[] = {
+	{0, 0, 0},
+	{42, 7, 7},      // Dark red
+	{128, 0, 0},     // Bright red
+	{180, 32, 0},    // Red-orange
+	{220, 64, 0},    // Orange
+	{255, 128, 0},   // Yellow-orange
+	{255, 255, 128}, // Bright yellow/white
 };
 
 uint8_t palette_size = sizeof(palette) / sizeof(palette[0]);
@@ -73,12 +76,14 @@ void loop() {
 		}
 	}
 
-	// Draw the pixels
-	for (int i = 0; i < num_pixels; i++) {
-		uint8_t x = i % TOTAL_WIDTH;
-		uint8_t y = i / TOTAL_WIDTH;
-		bg.drawPixel(x, y, palette[pixel_data[i]]);
-	}
+	// Draw the pixels, a row at a time straight into the back buffer
+	renderRows<TOTAL_WIDTH, TOTAL_HEIGHT>(bg, [](rgb24 *row, int y) {
+		const uint8_t *indices = &pixel_data[y * TOTAL_WIDTH];
+		for (int x = 0; x < TOTAL_WIDTH; x++) {
+			const LutRgb &c = palette[indices[x]];
+			row[x] = rgb24(c.red, c.green, c.blue);
+		}
+	});
 	bg.swapBuffers();
 
 	delay(40);
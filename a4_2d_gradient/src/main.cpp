@@ -12,6 +12,7 @@
 
 // Pinout configuration for the PicoDriver v.5.0
 #include "common/pico_driver_v5_pinout.h"
+#include "common/frame_writer.h"
 
 #include <Arduino.h>
 #include <SmartMatrix.h>
@@ -49,14 +50,13 @@ void setup() {
 
 void loop() {
 
-	for (int j=0; j<TOTAL_HEIGHT; j++) {
-		for(int i=0; i<TOTAL_WIDTH; i++ ) {
-			int r = 255 - i * 8;
-			int g = 255 - j * 8;
-			int b = 0;
-			bg.drawPixel(i, j, {r, g, b});	
-		}
-	}
+	// Straight into the back buffer, see common/frame_writer.h
+	shadeFrame<TOTAL_WIDTH, TOTAL_HEIGHT>(bg, [](int i, int j) {
+		int r = 255 - i * 8;
+		int g = 255 - j * 8;
+		int b = 0;
+		return rgb24(r, g, b);
+	});
 
 	bg.swapBuffers();
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+/**
+ * Bulk writes into a SmartMatrix background layer's back buffer.
+ *
+ * drawPixel() checks the bounds, maps the coordinates through the layer
+ * rotation and looks up the draw buffer for every single pixel. Renderers
+ * that fill the whole frame anyway can skip all of that: with the default
+ * rotation (rotation0) the back buffer is WIDTH × HEIGHT pixels, row-major,
+ * and a row is a plain array of the layer's colour type (rgb24 at
+ * COLOR_DEPTH 24).
+ *
+ *   shadeFrame<TOTAL_WIDTH, TOTAL_HEIGHT>(bg, [](int x, int y) { return rgb24(x * 8, y * 8, 0); });
+ *   bg.swapBuffers();
+ *
+ * renderRows() hands out one row pointer at a time for renderers that keep
+ * state along a row; writeSpan() and fillSpan() copy or fill part of a row,
+ * clipped like drawPixel(). backBuffer() moves to the other buffer on every
+ * swap, so none of these keep a pointer across frames.
+ *
+ * Layers set to another rotation need drawPixel().
+ */
+
+#ifndef FRAME_WRITER_H
+#define FRAME_WRITER_H
+
+#include <stdint.h>
+
+// Calls renderRow(row, y) for every row of the back buffer, top to bottom;
+// row points to WIDTH pixels
+template <int WIDTH, int HEIGHT, typename Layer, typename RenderRow>
+inline void renderRows(Layer &layer, RenderRow renderRow) {
+	auto *row = layer.backBuffer();
+	for (int y = 0; y < HEIGHT; y++, row += WIDTH) renderRow(row, y);
+}
+
+// Sets every pixel to shade(x, y), row by row
+template <int WIDTH, int HEIGHT, typename Layer, typename Shade>
+inline void shadeFrame(Layer &layer, Shade shade) {
+	renderRows<WIDTH, HEIGHT>(layer, [&shade](decltype(layer.backBuffer()) row, int y) {
+		for (int x = 0; x < WIDTH; x++) row[x] = shade(x, y);
+	});
+}
+
+// Copies count pixels to (x, y) and the pixels right of it. The part
+// outside the buffer is dropped.
+template <int WIDTH, int HEIGHT, typename Layer, typename RGB>
+inline void writeSpan(Layer &layer, int x, int y, const RGB *pixels, int count) {
+	if (y < 0 || y >= HEIGHT) return;
+	if (x < 0) {
+		pixels -= x;
+		count += x;
+		x = 0;
+	}
+	if (count > WIDTH - x) count = WIDTH - x;
+	auto *out = layer.backBuffer() + y * WIDTH + x;
+	for (int i = 0; i < count; i++) out[i] = pixels[i];
+}
+
+// Sets count pixels from (x, y) to the right to color, clipped the same way
+template <int WIDTH, int HEIGHT, typename Layer, typename RGB>
+inline void fillSpan(Layer &layer, int x, int y, int count, const RGB &color) {
+	if (y < 0 || y >= HEIGHT) return;
+	if (x < 0) {
+		count += x;
+		x = 0;
+	}
+	if (count > WIDTH - x) count = WIDTH - x;
+	auto *out = layer.backBuffer() + y * WIDTH + x;
+	for (int i = 0; i < count; i++) out[i] = color;
+}
+
+#endif
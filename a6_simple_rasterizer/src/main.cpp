@@ -12,6 +12,8 @@
 
 // Pinout configuration for the PicoDriver v.5.0
 #include "common/pico_driver_v5_pinout.h"
+#include "common/frame_writer.h"
+#include "common/pixel_geometry.h"
 
 #include <Arduino.h>
 #include <SmartMatrix.h>
@@ -45,32 +47,26 @@ void setup() {
 	matrix.begin();
 }
 
+// Distance of every pixel from the centre, in the -1 to 1 coordinates,
+// built by the compiler (see common/pixel_geometry.h)
+constexpr PixelPolar<TOTAL_WIDTH, TOTAL_HEIGHT> polar = pixelPolar<TOTAL_WIDTH, TOTAL_HEIGHT>(
+	(TOTAL_WIDTH - 1) / 2.0, (TOTAL_HEIGHT - 1) / 2.0, 2.0 / (TOTAL_WIDTH - 1), 2.0 / (TOTAL_HEIGHT - 1));
+
 uint frame = 0;
 
 void loop() {
 
-	int cx = 0.0;
-	int cy = 0.0;
-	float r = 0.75;
-
 	float  t = frame * 0.1;
 
-	for (int j=0; j<TOTAL_HEIGHT; j++) {
-		for (int i=0; i<TOTAL_WIDTH; i++) {
-
-			float u = (float)i / (TOTAL_WIDTH - 1) * 2 - 1.0;
-			float v = (float)j / (TOTAL_HEIGHT - 1) * 2 - 1.0;
-
-			float dx = cx - u;
-			float dy = cy - v;
+	// Straight into the back buffer, see common/frame_writer.h
+	shadeFrame<TOTAL_WIDTH, TOTAL_HEIGHT>(bg, [=](int i, int j) {
 
-			float d = sqrt( dx * dx + dy * dy);
-			float s = sin(d*8.0 - t) * 0.5 + 0.5;
-			float gray = s * 255;
+		float d = polar.dist[j * TOTAL_WIDTH + i];
+		float s = sin(d*8.0 - t) * 0.5 + 0.5;
+		uint8_t gray = s * 255;
 
-			bg.drawPixel(i, j, {gray, gray, gray});
-		}
-	}
+		return rgb24(gray, gray, gray);
+	});
 
 	bg.swapBuffers();
 
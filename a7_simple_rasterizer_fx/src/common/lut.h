@@ -0,0 +1,252 @@
+/**
+ * Lookup tables generated by the compiler and stored in flash.
+ *
+ * makeLut<T, N>(generator) evaluates generator(i) for i = 0 .. N - 1 at
+ * compile time. Assigned to a constexpr variable, the result is a constant
+ * in .rodata: it sits in flash (read through the cache on the ESP32), takes
+ * no RAM and no time in setup().
+ *
+ *   static constexpr Lut<int16_t, 256> sine = makeLut<int16_t, 256>(LutSine(256, 32767));
+ *   int16_t s = sine[angle & 255];
+ *
+ * A generator is any literal type with a constexpr operator()(int). These
+ * come with the header:
+ *
+ *   LutSine(period, amplitude, offset)   offset + amplitude * sin(2π i / period)
+ *   LutGamma(size, gamma, max)           max * (i / (size - 1))^gamma
+ *   LutExpand(bits)                      an n-bit channel to 0..255, e.g. RGB565's 5 and 6 bits
+ *   LutRadius(width, cx, cy, sx, sy)     distance of pixel i (row-major) from (cx, cy)
+ *   LutAngle(width, cx, cy, sx, sy)      atan2(dy, dx) of pixel i from (cx, cy)
+ *   LutRamp(stops, count, size)          colours blended evenly between count stops
+ *
+ * Results in double are rounded for integer tables and converted for float
+ * tables. The math (lutSin(), lutSqrt(), lutAtan2(), lutPow()) is written
+ * for C++11 constexpr, i.e. as recursions, and is exact to about 1e-15;
+ * j2_6dof/bench/lut_report.cpp checks it against libm and reports the
+ * tables' sizes. Large tables cost compile time: a 32 × 32 distance map
+ * takes the compiler a fraction of a second.
+ */
+
+#ifndef LUT_H
+#define LUT_H
+
+#include <stdint.h>
+#include <type_traits>
+
+template <typename T, int N>
+struct Lut {
+	T values[N];
+
+	constexpr const T &operator[](int i) const { return values[i]; }
+	constexpr int size() const { return N; }
+};
+
+// A colour that can be constexpr, unlike SmartMatrix's rgb24:
+// rgb24(c.red, c.green, c.blue) at the point of use
+struct LutRgb {
+	uint8_t red, green, blue;
+};
+
+// ============================================================
+// Table generation
+// ============================================================
+
+// 0 .. N - 1 as a parameter pack (C++11 has no std::index_sequence),
+// built by halves so the template depth stays at log2(N)
+template <int... I>
+struct LutIndices {};
+
+template <typename A, typename B>
+struct LutConcat;
+
+template <int... A, int... B>
+struct LutConcat<LutIndices<A...>, LutIndices<B...>> {
+	typedef LutIndices<A..., (int)sizeof...(A) + B...> type;
+};
+
+template <int N>
+struct LutMakeIndices {
+	typedef typename LutConcat<typename LutMakeIndices<N / 2>::type, typename LutMakeIndices<N - N / 2>::type>::type type;
+};
+
+template <>
+struct LutMakeIndices<0> {
+	typedef LutIndices<> type;
+};
+
+template <>
+struct LutMakeIndices<1> {
+	typedef LutIndices<0> type;
+};
+
+constexpr long long lutRound(double v) { return v < 0 ? (long long)(v - 0.5) : (long long)(v + 0.5); }
+
+template <typename T, typename V>
+constexpr T lutConvert(V v, std::true_type) { return (T)lutRound(v); }
+
+template <typename T, typename V>
+constexpr T lutConvert(V v, std::false_type) { return (T)v; }
+
+// Rounds when a floating-point value goes into an integer table
+template <typename T, typename V>
+constexpr T lutConvert(V v) {
+	return lutConvert<T>(v, std::integral_constant<bool, std::is_integral<T>::value && std::is_floating_point<V>::value>());
+}
+
+template <typename T, typename Generator, int... I>
+constexpr Lut<T, sizeof...(I)> lutFill(const Generator &generator, LutIndices<I...>) {
+	return {{lutConvert<T>(generator(I))...}};
+}
+
+template <typename T, int N, typename Generator>
+constexpr Lut<T, N> makeLut(const Generator &generator) {
+	return lutFill<T>(generator, typename LutMakeIndices<N>::type());
+}
+
+// ============================================================
+// constexpr math
+// ============================================================
+
+#define LUT_PI 3.14159265358979323846
+#define LUT_LN2 0.69314718055994530942
+
+constexpr double lutAbs(double v) { return v < 0 ? -v : v; }
+constexpr double lutTrunc(double v) { return (double)(long long)v; }
+constexpr double lutFloor(double v) { return lutTrunc(v) > v ? lutTrunc(v) - 1 : lutTrunc(v); }
+constexpr double lutSquare(double v) { return v * v; }
+
+// x - x³/3! + x⁵/5! - ..., for |x| <= π/2
+constexpr double lutSinSeries(double x2, double term, double sum, int k) {
+	return k > 12 ? sum : lutSinSeries(x2, -term * x2 / ((2 * k) * (2 * k + 1)), sum + term, k + 1);
+}
+
+constexpr double lutSinHalf(double x) { return lutSinSeries(x * x, x, 0, 1); }
+
+// x in [-π, π], mirrored into [-π/2, π/2]
+constexpr double lutSinTurn(double x) {
+	return x > LUT_PI / 2 ? lutSinHalf(LUT_PI - x) : x < -LUT_PI / 2 ? lutSinHalf(-LUT_PI - x) : lutSinHalf(x);
+}
+
+constexpr double lutSin(double x) { return lutSinTurn(x - 2 * LUT_PI * lutFloor(x / (2 * LUT_PI) + 0.5)); }
+constexpr double lutCos(double x) { return lutSin(x + LUT_PI / 2); }
+
+// Newton's method from above, which only ever moves down
+constexpr double lutSqrtStep(double x, double g, int n) {
+	return n == 0 || lutAbs(g * g - x) <= x * 1e-15 ? g : lutSqrtStep(x, 0.5 * (g + x / g), n - 1);
+}
+
+constexpr double lutSqrt(double x) { return x <= 0 ? 0 : lutSqrtStep(x, x > 1 ? x : 1, 64); }
+
+// x - x³/3 + x⁵/5 - ..., for |x| <= 0.25
+constexpr double lutAtanSeries(double x2, double power, double sum, int k) {
+	return k > 20 ? sum : lutAtanSeries(x2, -power * x2, sum + power / (2 * k + 1), k + 1);
+}
+
+// x in [0, 1], halving the angle until the series converges fast
+constexpr double lutAtanUnit(double x) {
+	return x > 0.25 ? 2 * lutAtanUnit(x / (1 + lutSqrt(1 + x * x))) : lutAtanSeries(x * x, x, 0, 0);
+}
+
+constexpr double lutAtan(double x) {
+	return x < 0 ? -lutAtan(-x) : x > 1 ? LUT_PI / 2 - lutAtanUnit(1 / x) : lutAtanUnit(x);
+}
+
+// As atan2(): -π to π, π for (0, x < 0), 0 for (0, 0)
+constexpr double lutAtan2(double y, double x) {
+	return x > 0 ? lutAtan(y / x)
+	     : x < 0 ? (y < 0 ? lutAtan(y / x) - LUT_PI : lutAtan(y / x) + LUT_PI)
+	     : y > 0 ? LUT_PI / 2 : y < 0 ? -LUT_PI / 2 : 0;
+}
+
+// 2 (z + z³/3 + z⁵/5 + ...) = ln((1 + z) / (1 - z))
+constexpr double lutLnSeries(double z2, double power, double sum, int k) {
+	return k > 30 ? sum : lutLnSeries(z2, power * z2, sum + power / (2 * k + 1), k + 1);
+}
+
+// x > 0, scaled into [0.5, 1] by powers of two
+constexpr double lutLn(double x) {
+	return x < 0.5 ? lutLn(x * 2) - LUT_LN2
+	     : x > 1 ? lutLn(x / 2) + LUT_LN2
+	     : 2 * lutLnSeries(lutSquare((x - 1) / (x + 1)), (x - 1) / (x + 1), 0, 0);
+}
+
+constexpr double lutExpSeries(double y, double term, double sum, int k) {
+	return k > 20 ? sum : lutExpSeries(y, term * y / k, sum + term * y / k, k + 1);
+}
+
+// e^y = (e^(y/2))², until |y| <= 0.5
+constexpr double lutExp(double y) { return lutAbs(y) > 0.5 ? lutSquare(lutExp(y / 2)) : lutExpSeries(y, 1, 1, 1); }
+
+// x^p for x >= 0
+constexpr double lutPow(double x, double p) { return x <= 0 ? 0 : lutExp(p * lutLn(x)); }
+
+// ============================================================
+// Generators
+// ============================================================
+
+struct LutSine {
+	int period;
+	double amplitude, offset;
+
+	constexpr LutSine(int period, double amplitude = 1, double offset = 0) : period(period), amplitude(amplitude), offset(offset) {}
+	constexpr double operator()(int i) const { return offset + amplitude * lutSin(2 * LUT_PI * i / period); }
+};
+
+struct LutGamma {
+	int size;
+	double gamma, max;
+
+	constexpr LutGamma(int size, double gamma, double max = 255) : size(size), gamma(gamma), max(max) {}
+	constexpr double operator()(int i) const { return max * lutPow((double)i / (size - 1), gamma); }
+};
+
+// Spreads 0 .. 2^bits - 1 evenly over 0..255, so the largest value is full
+// brightness (a plain shift stops short: 31 << 3 = 248)
+struct LutExpand {
+	int bits;
+
+	constexpr explicit LutExpand(int bits) : bits(bits) {}
+	constexpr double operator()(int i) const { return i * 255.0 / ((1 << bits) - 1); }
+};
+
+// Pixel i of a width-wide frame, row-major, is at
+// ((i % width - cx) * sx, (i / width - cy) * sy)
+struct LutRadius {
+	int width;
+	double cx, cy, sx, sy;
+
+	constexpr LutRadius(int width, double cx, double cy, double sx = 1, double sy = 1) : width(width), cx(cx), cy(cy), sx(sx), sy(sy) {}
+	constexpr double operator()(int i) const {
+		return lutSqrt(lutSquare((i % width - cx) * sx) + lutSquare((i / width - cy) * sy));
+	}
+};
+
+struct LutAngle {
+	int width;
+	double cx, cy, sx, sy;
+
+	constexpr LutAngle(int width, double cx, double cy, double sx = 1, double sy = 1) : width(width), cx(cx), cy(cy), sx(sx), sy(sy) {}
+	constexpr double operator()(int i) const { return lutAtan2((i / width - cy) * sy, (i % width - cx) * sx); }
+};
+
+// size colours from stops[0] to stops[count - 1], each pair of neighbouring
+// stops blended linearly; stops must be a constexpr array
+struct LutRamp {
+	const LutRgb *stops;
+	int count, size;
+
+	constexpr LutRamp(const LutRgb *stops, int count, int size) : stops(stops), count(count), size(size) {}
+
+	static constexpr uint8_t blend(uint8_t a, uint8_t b, double t) { return (uint8_t)lutRound(a + (b - a) * t); }
+
+	constexpr LutRgb between(int k, double t) const {
+		return k >= count - 1 ? stops[count - 1]
+		     : LutRgb{blend(stops[k].red, stops[k + 1].red, t), blend(stops[k].green, stops[k + 1].green, t),
+		              blend(stops[k].blue, stops[k + 1].blue, t)};
+	}
+
+	constexpr LutRgb at(double position) const { return between((int)position, position - (int)position); }
+	constexpr LutRgb operator()(int i) const { return at(size > 1 ? (double)i * (count - 1) / (size - 1) : 0); }
+};
+
+#endif
@@ -12,6 +12,7 @@
 
 // Pinout configuration for the PicoDriver v.5.0
 #include "common/pico_driver_v5_pinout.h"
+#include "common/frame_writer.h"
 
 #include <Arduino.h>
 #include <SmartMatrix.h>
@@ -24,6 +25,13 @@
 #define kPanelType SM_PANELTYPE_HUB75_32ROW_32COL_MOD8SCAN // custom
 #define kMatrixOptions (SM_HUB75_OPTIONS_NONE)
 #define kbgOptions (SM_BACKGROUND_OPTIONS_NONE)
+#define FIXED_POINT 1    // 1: fixed-point math (common/fixed_math.h), 0: the original float code
+#define RENDER_STATS_INTERVAL 0 // ms between fixed vs float reports on Serial, 0 = off (e.g. 2000 while measuring)
+#define PARALLEL_RENDER 1 // 1: render on both cores (common/parallel_render.h), 0: on loop()'s core only
+
+#include "common/parallel_render.h"
+#include "common/render_compare.h"
+#include "ripples.h"
 
 // SmartMatrix setup & buffer alloction
 SMARTMATRIX_ALLOCATE_BUFFERS(matrix, TOTAL_WIDTH, TOTAL_HEIGHT, kRefreshDepth, kDmaBufferRows, kPanelType, kMatrixOptions);
@@ -33,6 +41,8 @@ SMARTMATRIX_ALLOCATE_BACKGROUND_LAYER(bg, TOTAL_WIDTH, TOTAL_HEIGHT, COLOR_DEPTH
 
 void setup() {
 
+	if (RENDER_STATS_INTERVAL) Serial.begin(115200);
+
 	// On board LED (useful for debugging)
 	pinMode(PICO_LED_PIN, OUTPUT);
 
@@ -51,48 +61,26 @@ void setup() {
 
 int frame = 0;
 
-void loop() {
-
-
-	// calculate an offset (-1 to 1), based on "time" (frame)
-	float cx = sin((float) frame * 0.014);
-	float cy = cos((float) frame * 0.018);
-
-	for (int j=0; j<TOTAL_HEIGHT; j++) {
-		for (int i=0; i<TOTAL_WIDTH; i++) {
-
-			// normalized coordinates of the pixels: 
-			// instead of 0 to 31 we have -1.0 to 1.0			
-			float x = (float) i / (TOTAL_WIDTH - 1) * 2.0 - 1.0;
-			float y = (float) j / (TOTAL_HEIGHT - 1) * 2.0 - 1.0;
-			
-			// add some offset 
-			x += cx;
-			y += cy;
-
-			float rx = x; 
-			float ry = y;
-
-			float gx = x + 0.1;
-			float gy = y + 0.1;
-
-			float bx = x - 0.1;
-			float by = y + 0.05;
+// Once per RENDER_STATS_INTERVAL both versions render the current frame off
+// screen, for their times and how far apart they are
+void reportRenderers() {
+	static uint32_t lastReport = 0;
+	if (RENDER_STATS_INTERVAL == 0 || millis() - lastReport < RENDER_STATS_INTERVAL) return;
+	lastReport = millis();
+	compareRenderers<TOTAL_WIDTH, TOTAL_HEIGHT>(RipplesFixed<TOTAL_WIDTH, TOTAL_HEIGHT>(frame),
+	                                            RipplesFloat<TOTAL_WIDTH, TOTAL_HEIGHT>(frame));
+}
 
-			
-			float rd = sqrt( rx * rx + ry * ry);
-			float gd = sqrt( gx * gx + gy * gy);
-			float bd = sqrt( bx * bx + by * by);
-			
-			// ...or obtain a "gray" value from the distance plugged into a periodic funtion
-			int red   = (sin(rd * 12.0 - frame * 0.42) * 0.5 + 0.5) * 255.0;
-			int green = (sin(gd * 12.0 - frame * 0.45) * 0.5 + 0.5) * 255.0;
-			int blue  = (sin(bd * 12.0 - frame * 0.47) * 0.5 + 0.5) * 255.0;
+void loop() {
 
-			bg.drawPixel(i, j, {red, green, blue});
-		}
-	}
+	// Straight into the back buffer on both cores, see common/parallel_render.h
+#if FIXED_POINT
+	shadeFrameParallel<TOTAL_WIDTH, TOTAL_HEIGHT>(bg, RipplesFixed<TOTAL_WIDTH, TOTAL_HEIGHT>(frame));
+#else
+	shadeFrameParallel<TOTAL_WIDTH, TOTAL_HEIGHT>(bg, RipplesFloat<TOTAL_WIDTH, TOTAL_HEIGHT>(frame));
+#endif
 
 	bg.swapBuffers();
+	reportRenderers();
 	frame++;
 }
\ No newline at end of file
@@ -0,0 +1,98 @@
+/**
+ * Three offset rings of ripples, one per colour channel.
+ *
+ * RipplesFloat is the original float code, RipplesFixed the same effect
+ * with common/fixed_math.h: the per-frame terms (the moving centre and
+ * the phase of each channel, taken modulo 2π) are worked out once in
+ * float, every pixel is integer math. The normalised coordinates come
+ * from common/pixel_geometry.h. Both are shade(x, y) callbacks for
+ * shadeFrame() and give the same image within a step or two per channel
+ * (see j1_shader/bench/fixed_compare.cpp).
+ *
+ * Needs rgb24 (SmartMatrix.h) declared before it is included.
+ */
+
+#ifndef RIPPLES_H
+#define RIPPLES_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include "common/fixed_math.h"
+#include "common/pixel_geometry.h"
+
+template <int WIDTH, int HEIGHT>
+struct RipplesFloat {
+	const PixelAxes<WIDTH, HEIGHT> &axes = pixelAxes<WIDTH, HEIGHT>();
+	int frame;
+	float cx, cy;
+
+	explicit RipplesFloat(int frame) : frame(frame) {
+		// calculate an offset (-1 to 1), based on "time" (frame)
+		cx = sin((float) frame * 0.014);
+		cy = cos((float) frame * 0.018);
+	}
+
+	rgb24 operator()(int i, int j) const {
+
+		// normalized coordinates of the pixels:
+		// instead of 0 to 31 we have -1.0 to 1.0
+		float x = axes.x[i];
+		float y = axes.y[j];
+
+		// add some offset
+		x += cx;
+		y += cy;
+
+		float rx = x;
+		float ry = y;
+
+		float gx = x + 0.1;
+		float gy = y + 0.1;
+
+		float bx = x - 0.1;
+		float by = y + 0.05;
+
+
+		float rd = sqrt( rx * rx + ry * ry);
+		float gd = sqrt( gx * gx + gy * gy);
+		float bd = sqrt( bx * bx + by * by);
+
+		// ...or obtain a "gray" value from the distance plugged into a periodic funtion
+		int red   = (sin(rd * 12.0 - frame * 0.42) * 0.5 + 0.5) * 255.0;
+		int green = (sin(gd * 12.0 - frame * 0.45) * 0.5 + 0.5) * 255.0;
+		int blue  = (sin(bd * 12.0 - frame * 0.47) * 0.5 + 0.5) * 255.0;
+
+		return rgb24(red, green, blue);
+	}
+};
+
+template <int WIDTH, int HEIGHT>
+struct RipplesFixed {
+	const PixelAxes<WIDTH, HEIGHT> &axes = pixelAxes<WIDTH, HEIGHT>();
+	fix16 cx, cy;
+	fix16 phaseR, phaseG, phaseB;
+
+	explicit RipplesFixed(int frame) {
+		cx = fx(sinf(frame * 0.014f));
+		cy = fx(cosf(frame * 0.018f));
+		phaseR = fx(fmodf(frame * 0.42f, 2 * (float)M_PI));
+		phaseG = fx(fmodf(frame * 0.45f, 2 * (float)M_PI));
+		phaseB = fx(fmodf(frame * 0.47f, 2 * (float)M_PI));
+	}
+
+	rgb24 operator()(int i, int j) const {
+		fix16 x = axes.fixedX[i] + cx;
+		fix16 y = axes.fixedY[j] + cy;
+
+		fix16 rd = fxLength({x, y});
+		fix16 gd = fxLength({x + fx(0.1f), y + fx(0.1f)});
+		fix16 bd = fxLength({x - fx(0.1f), y + fx(0.05f)});
+
+		return rgb24(q15ToByte(q15Unit(q15Sin(rd * 12 - phaseR))),
+		             q15ToByte(q15Unit(q15Sin(gd * 12 - phaseG))),
+		             q15ToByte(q15Unit(q15Sin(bd * 12 - phaseB))));
+	}
+};
+
+#endif
@@ -0,0 +1,102 @@
+/**
+ * Two circles melting into each other (a smooth union of their distance
+ * fields), drawn as red contour lines.
+ *
+ * BlobsFloat is the original float code, BlobsFixed the same effect with
+ * common/fixed_math.h: the circle centres and the phase (modulo 2π) are
+ * worked out once per frame in float, every pixel is integer math. The
+ * normalised coordinates come from common/pixel_geometry.h. Both are
+ * shade(x, y) callbacks for shadeFrame() and give the same image
+ * within a step or two (see j1_shader/bench/fixed_compare.cpp).
+ *
+ * Needs rgb24 (SmartMatrix.h) declared before it is included.
+ */
+
+#ifndef BLOBS_H
+#define BLOBS_H
+
+#include <math.h>
+#include <stdint.h>
+
+#include "common/fixed_math.h"
+#include "common/pixel_geometry.h"
+
+template <int WIDTH, int HEIGHT>
+struct BlobsFloat {
+	const PixelAxes<WIDTH, HEIGHT> &axes = pixelAxes<WIDTH, HEIGHT>();
+	int frame;
+	float cx1, cy1, cx2, cy2;
+
+	explicit BlobsFloat(int frame) : frame(frame) {
+		// calculate an offset (-1 to 1), based on "time" (frame)
+		cx1 = sin((float) frame * 0.034);
+		cy1 = cos((float) frame * 0.048);
+
+		cx2 = sin((float) frame * 0.059 + M_PI);
+		cy2 = cos((float) frame * 0.063 + M_PI) ;
+	}
+
+	static float clamp(float v, float min, float max) {
+		if (v < min) return min;
+		if (v > max) return max;
+		return v;
+	}
+
+	static float mix(float x, float y, float a) {
+		return x * (1.0 - a) + y * a;
+	}
+
+	// https://iquilezles.org/articles/distfunctions/
+	static float opSmoothUnion( float d1, float d2, float k ) {
+		float h = clamp( 0.5 + 0.5*(d2-d1)/k, 0.0, 1.0 );
+		return mix( d2, d1, h ) - k*h*(1.0-h);
+	}
+
+	rgb24 operator()(int i, int j) const {
+
+		// normalized coordinates of the pixels:
+		// instead of 0 to 31 we have -1.0 to 1.0
+		float x = axes.x[i];
+		float y = axes.y[j];
+
+		// add some offset
+		float x1 = x + cx1;
+		float y1 = y + cy1;
+
+		float x2 = x + cx2;
+		float y2 = y + cy2;
+
+		float d1 = sqrt( x1 * x1 + y1 * y1) - 0.2;
+		float d2 = sqrt( x2 * x2 + y2 * y2) - 0.4;
+
+		float d = opSmoothUnion(d1, d2, 0.8);
+
+		int gray = (sin(d * 20.0 - frame * 0.5) * 0.5 + 0.5) * 255.0;
+		return rgb24(gray, 0, 0);
+	}
+};
+
+template <int WIDTH, int HEIGHT>
+struct BlobsFixed {
+	const PixelAxes<WIDTH, HEIGHT> &axes = pixelAxes<WIDTH, HEIGHT>();
+	fxvec2 c1, c2;
+	fix16 phase;
+
+	explicit BlobsFixed(int frame) {
+		c1 = {fx(sinf(frame * 0.034f)), fx(cosf(frame * 0.048f))};
+		c2 = {fx(sinf(frame * 0.059f + (float)M_PI)), fx(cosf(frame * 0.063f + (float)M_PI))};
+		phase = fx(fmodf(frame * 0.5f, 2 * (float)M_PI));
+	}
+
+	rgb24 operator()(int i, int j) const {
+		fxvec2 p = {axes.fixedX[i], axes.fixedY[j]};
+
+		fix16 d1 = fxLength(p + c1) - fx(0.2f);
+		fix16 d2 = fxLength(p + c2) - fx(0.4f);
+		fix16 d = fxSmoothUnion(d1, d2, fx(0.8f));
+
+		return rgb24(q15ToByte(q15Unit(q15Sin(d * 20 - phase))), 0, 0);
+	}
+};
+
+#endif
@@ -0,0 +1,197 @@
+/**
+ * Fixed-point math for per-pixel effects.
+ *
+ * fix16 is Q16.16: a signed 32-bit count of 1/65536ths, from -32768 to
+ * 32767.99998. Adding and comparing are single integer instructions and a
+ * product takes one 32×32→64 bit multiply, where the shaders' float code
+ * calls into the software double routines for every literal like 0.5 or
+ * 255.0 and into sinf() / sqrtf() for every pixel.
+ *
+ * q15 is Q1.15 in an int16_t, for values in [-1, 1): sines, blend factors
+ * and colour channels on their way to a byte.
+ *
+ * The functions are the GLSL ones the effects use (mix, clamp, smoothstep,
+ * step, fract, length, sin, cos) plus opSmoothUnion(), prefixed with fx.
+ * Results are within a few 1/65536 of the float versions; sin and cos
+ * within 0.0002 (a 7th order polynomial), which no 8-bit channel shows.
+ * Multiplications do not saturate: keep intermediate values below 32768,
+ * e.g. by taking time terms modulo their period before converting them.
+ *
+ * The file has no Arduino dependencies so it can be compiled on the host.
+ */
+
+#ifndef FIXED_MATH_H
+#define FIXED_MATH_H
+
+#include <stdint.h>
+
+#define FIX16_ONE 65536
+
+struct fix16 {
+	int32_t raw;
+};
+
+// From a constant or a per-frame value; per pixel, stay in fix16
+constexpr fix16 fx(float v) { return {(int32_t)(v * FIX16_ONE + (v < 0 ? -0.5f : 0.5f))}; }
+constexpr fix16 fxInt(int32_t v) { return {v * FIX16_ONE}; }
+inline float fxToFloat(fix16 a) { return a.raw * (1.0f / FIX16_ONE); }
+
+inline fix16 operator+(fix16 a, fix16 b) { return {a.raw + b.raw}; }
+inline fix16 operator-(fix16 a, fix16 b) { return {a.raw - b.raw}; }
+inline fix16 operator-(fix16 a) { return {-a.raw}; }
+inline fix16 operator*(fix16 a, fix16 b) { return {(int32_t)(((int64_t)a.raw * b.raw) >> 16)}; }
+inline fix16 operator*(fix16 a, int32_t b) { return {a.raw * b}; }
+inline fix16 &operator+=(fix16 &a, fix16 b) { a.raw += b.raw; return a; }
+inline fix16 &operator-=(fix16 &a, fix16 b) { a.raw -= b.raw; return a; }
+inline fix16 &operator*=(fix16 &a, fix16 b) { return a = a * b; }
+inline bool operator<(fix16 a, fix16 b) { return a.raw < b.raw; }
+inline bool operator>(fix16 a, fix16 b) { return a.raw > b.raw; }
+inline bool operator<=(fix16 a, fix16 b) { return a.raw <= b.raw; }
+inline bool operator>=(fix16 a, fix16 b) { return a.raw >= b.raw; }
+
+// Division saturates instead of trapping on a zero or tiny divisor
+inline fix16 operator/(fix16 a, fix16 b) {
+	if (b.raw == 0) return {a.raw < 0 ? INT32_MIN : INT32_MAX};
+	int64_t q = ((int64_t)a.raw << 16) / b.raw;
+	if (q > INT32_MAX) return {INT32_MAX};
+	if (q < INT32_MIN) return {INT32_MIN};
+	return {(int32_t)q};
+}
+
+inline fix16 fxAbs(fix16 a) { return {a.raw < 0 ? -a.raw : a.raw}; }
+inline fix16 fxMin(fix16 a, fix16 b) { return a.raw < b.raw ? a : b; }
+inline fix16 fxMax(fix16 a, fix16 b) { return a.raw > b.raw ? a : b; }
+inline fix16 fxClamp(fix16 x, fix16 lo, fix16 hi) { return x.raw < lo.raw ? lo : (x.raw > hi.raw ? hi : x); }
+inline fix16 fxMix(fix16 a, fix16 b, fix16 t) { return a + (b - a) * t; }
+inline fix16 fxStep(fix16 edge, fix16 x) { return {x.raw < edge.raw ? 0 : FIX16_ONE}; }
+inline fix16 fxFloor(fix16 a) { return {(int32_t)((uint32_t)a.raw & 0xFFFF0000u)}; }
+inline fix16 fxFract(fix16 a) { return {a.raw & 0xFFFF}; }
+
+inline fix16 fxSmoothstep(fix16 edge0, fix16 edge1, fix16 x) {
+	int32_t n = x.raw - edge0.raw, d = edge1.raw - edge0.raw;
+	if (d < 0) {
+		n = -n;
+		d = -d;
+	}
+	if (n <= 0) return {0};
+	if (n >= d) return fxInt(1);
+	// n < d, so the 32-bit division does whenever n << 16 fits
+	fix16 t = {n < 0x8000 ? (n << 16) / d : (int32_t)(((int64_t)n << 16) / d)};
+	return t * t * (fxInt(3) - t * 2);
+}
+
+// floor(sqrt(v)), bit by bit: 16 rounds of 32-bit adds and shifts
+inline uint32_t isqrt32(uint32_t v) {
+	uint32_t root = 0, bit = 1u << 30;
+	while (bit > v) bit >>= 2;
+	while (bit) {
+		if (v >= root + bit) {
+			v -= root + bit;
+			root = (root >> 1) + bit;
+		} else {
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+// The square root of a Q32.32 value as a fix16. Values of 1 and more drop
+// low bits in pairs to fit isqrt32(), which keeps 16 significant bits.
+inline fix16 fxSqrtQ32(uint64_t v) {
+	int shift = 0;
+	while (v >> 32) {
+		v >>= 2;
+		shift++;
+	}
+	return {(int32_t)(isqrt32((uint32_t)v) << shift)};
+}
+
+// Negative arguments give 0
+inline fix16 fxSqrt(fix16 a) { return a.raw <= 0 ? fix16{0} : fxSqrtQ32((uint64_t)a.raw << 16); }
+
+#define FIX16_PI 205887     // π
+#define FIX16_HALF_PI 102944
+#define FIX16_TWO_PI 411775
+
+// Any angle in radians
+inline fix16 fxSin(fix16 a) {
+	int32_t x = a.raw % FIX16_TWO_PI; // (-2π, 2π)
+	if (x > FIX16_PI) x -= FIX16_TWO_PI;
+	if (x < -FIX16_PI) x += FIX16_TWO_PI;
+	if (x > FIX16_HALF_PI) x = FIX16_PI - x; // Mirror into [-π/2, π/2]
+	if (x < -FIX16_HALF_PI) x = -FIX16_PI - x;
+
+	// x - x³/3! + x⁵/5! - x⁷/7!, Horner on x² with Q30 coefficients
+	int64_t x2 = ((int64_t)x * x) >> 16;
+	int64_t p = (1LL << 30) / 5040;
+	p = (1LL << 30) / 120 - ((p * x2) >> 16);
+	p = (1LL << 30) / 6 - ((p * x2) >> 16);
+	p = (1LL << 30) - ((p * x2) >> 16);
+	return {(int32_t)((p * x) >> 30)};
+}
+
+inline fix16 fxCos(fix16 a) { return fxSin({a.raw + FIX16_HALF_PI}); }
+
+struct fxvec2 {
+	fix16 x, y;
+};
+
+inline fxvec2 operator+(fxvec2 a, fxvec2 b) { return {a.x + b.x, a.y + b.y}; }
+inline fxvec2 operator-(fxvec2 a, fxvec2 b) { return {a.x - b.x, a.y - b.y}; }
+inline fxvec2 operator*(fxvec2 a, fix16 s) { return {a.x * s, a.y * s}; }
+inline fix16 fxDot(fxvec2 a, fxvec2 b) { return a.x * b.x + a.y * b.y; }
+// From the exact sum of the squares: squaring in fix16 would round away
+// lengths below 0.004 (1/256), and with them the outlines of distance fields
+inline fix16 fxLength(fxvec2 v) {
+	return fxSqrtQ32((uint64_t)((int64_t)v.x.raw * v.x.raw) + (uint64_t)((int64_t)v.y.raw * v.y.raw));
+}
+inline fxvec2 fxAbs(fxvec2 v) { return {fxAbs(v.x), fxAbs(v.y)}; }
+inline fxvec2 fxMin(fxvec2 a, fxvec2 b) { return {fxMin(a.x, b.x), fxMin(a.y, b.y)}; }
+inline fxvec2 fxMax(fxvec2 a, fxvec2 b) { return {fxMax(a.x, b.x), fxMax(a.y, b.y)}; }
+inline fxvec2 fxFract(fxvec2 v) { return {fxFract(v.x), fxFract(v.y)}; }
+
+struct fxvec3 {
+	fix16 r, g, b;
+};
+
+inline fxvec3 fxVec3(fix16 v) { return {v, v, v}; }
+inline fxvec3 operator+(fxvec3 a, fxvec3 b) { return {a.r + b.r, a.g + b.g, a.b + b.b}; }
+inline fxvec3 operator*(fxvec3 a, fix16 s) { return {a.r * s, a.g * s, a.b * s}; }
+inline fxvec3 fxMix(fxvec3 a, fxvec3 b, fix16 t) { return {fxMix(a.r, b.r, t), fxMix(a.g, b.g, t), fxMix(a.b, b.b, t)}; }
+
+// https://iquilezles.org/articles/distfunctions/
+inline fix16 fxSmoothUnion(fix16 d1, fix16 d2, fix16 k) {
+	fix16 h = fxClamp(fx(0.5f) + fx(0.5f) * (d2 - d1) / k, fxInt(0), fxInt(1));
+	return fxMix(d2, d1, h) - k * h * (fxInt(1) - h);
+}
+
+typedef int16_t q15;
+
+#define Q15_ONE 32767 // Closest to 1
+
+// Saturates to [-1, 1)
+inline q15 fxToQ15(fix16 a) {
+	int32_t v = a.raw >> 1;
+	return (q15)(v > Q15_ONE ? Q15_ONE : (v < -32768 ? -32768 : v));
+}
+
+inline q15 q15Mul(q15 a, q15 b) { return (q15)(((int32_t)a * b) >> 15); }
+
+// sin() as a q15
+inline q15 q15Sin(fix16 a) { return fxToQ15(fxSin(a)); }
+
+// Maps [-1, 1) onto [0, 1), i.e. v * 0.5 + 0.5
+inline q15 q15Unit(q15 v) { return (q15)((v >> 1) + 16384); }
+
+// A [0, 1) channel as 0..255, negative values as 0
+inline uint8_t q15ToByte(q15 v) { return v <= 0 ? 0 : (uint8_t)(((int32_t)v * 255) >> 15); }
+
+// A fix16 channel clamped to [0, 1] as 0..255
+inline uint8_t fxToByte(fix16 a) {
+	if (a.raw <= 0) return 0;
+	if (a.raw >= FIX16_ONE) return 255;
+	return (uint8_t)(((int64_t)a.raw * 255) >> 16);
+}
+
+#endif
@@ -0,0 +1,79 @@
+/**
+ * Per-pixel geometry that never changes, worked out once instead of in
+ * every frame.
+ *
+ * PixelAxes has the normalised coordinates the effects start from. They
+ * are separable, one table per column and one per row:
+ *
+ *   x, y       -1 at the first column (row), 1 at the last, as
+ *              (float)i / (WIDTH - 1) * 2 - 1 in the a6 to a8 effects
+ *   uvX, uvY   Shadertoy's uv: pixel centres, origin in the middle, y up,
+ *              1 is half the height (j1_shader)
+ *
+ * each as float and as fix16 (fixed_math.h). pixelAxes<WIDTH, HEIGHT>()
+ * builds them on the first call and hands out the same copy after that.
+ *
+ * PixelPolar has the distance and angle of every pixel centre from a fixed
+ * point, for radial effects whose centre does not move. At 32 × 32 that is
+ * 8 KB, so the compiler builds it (lut.h) and it stays in flash:
+ *
+ *   constexpr PixelPolar<TOTAL_WIDTH, TOTAL_HEIGHT> polar =
+ *     pixelPolar<TOTAL_WIDTH, TOTAL_HEIGHT>(TOTAL_WIDTH / 2.0, TOTAL_HEIGHT / 2.0);
+ *   float dist = polar.dist[y * TOTAL_WIDTH + x];
+ *
+ * Both are exact to the float, so they match what the effects computed per
+ * pixel.
+ */
+
+#ifndef PIXEL_GEOMETRY_H
+#define PIXEL_GEOMETRY_H
+
+#include <math.h>
+
+#include "fixed_math.h"
+#include "lut.h"
+
+template <int WIDTH, int HEIGHT>
+struct PixelAxes {
+	float x[WIDTH], y[HEIGHT];
+	fix16 fixedX[WIDTH], fixedY[HEIGHT];
+	float uvX[WIDTH], uvY[HEIGHT];
+	fix16 fixedUvX[WIDTH], fixedUvY[HEIGHT];
+
+	PixelAxes() {
+		for (int i = 0; i < WIDTH; i++) {
+			x[i] = (float)i / (WIDTH - 1) * 2.0 - 1.0;
+			uvX[i] = (2.0f * ((float)i + 0.5f) - WIDTH) / HEIGHT;
+			fixedX[i] = fx(x[i]);
+			fixedUvX[i] = fx(uvX[i]);
+		}
+		for (int j = 0; j < HEIGHT; j++) {
+			y[j] = (float)j / (HEIGHT - 1) * 2.0 - 1.0;
+			uvY[j] = (2.0f * ((float)(HEIGHT - 1 - j) + 0.5f) - HEIGHT) / HEIGHT;
+			fixedY[j] = fx(y[j]);
+			fixedUvY[j] = fx(uvY[j]);
+		}
+	}
+};
+
+template <int WIDTH, int HEIGHT>
+const PixelAxes<WIDTH, HEIGHT> &pixelAxes() {
+	static const PixelAxes<WIDTH, HEIGHT> axes;
+	return axes;
+}
+
+// Row-major, indexed y * WIDTH + x
+template <int WIDTH, int HEIGHT>
+struct PixelPolar {
+	Lut<float, WIDTH * HEIGHT> dist;
+	Lut<float, WIDTH * HEIGHT> angle; // atan2(dy, dx), -π to π
+};
+
+// Pixel (x, y) is at ((x - centerX) * scaleX, (y - centerY) * scaleY)
+template <int WIDTH, int HEIGHT>
+constexpr PixelPolar<WIDTH, HEIGHT> pixelPolar(double centerX, double centerY, double scaleX = 1, double scaleY = 1) {
+	return {makeLut<float, WIDTH * HEIGHT>(LutRadius(WIDTH, centerX, centerY, scaleX, scaleY)),
+	        makeLut<float, WIDTH * HEIGHT>(LutAngle(WIDTH, centerX, centerY, scaleX, scaleY))};
+}
+
+#endif
@@ -12,6 +12,7 @@
 
 // Pinout configuration for the PicoDriver v.5.0
 #include "common/pico_driver_v5_pinout.h"
+#include "common/frame_writer.h"
 
 #include <Arduino.h>
 #include <SmartMatrix.h>
@@ -24,6 +25,13 @@
 #define kPanelType SM_PANELTYPE_HUB75_32ROW_32COL_MOD8SCAN // custom
 #define kMatrixOptions (SM_HUB75_OPTIONS_NONE)
 #define kbgOptions (SM_BACKGROUND_OPTIONS_NONE)
+#define FIXED_POINT 1    // 1: fixed-point math (common/fixed_math.h), 0: the original float code
+#define RENDER_STATS_INTERVAL 0 // ms between fixed vs float reports on Serial, 0 = off (e.g. 2000 while measuring)
+#define PARALLEL_RENDER 1 // 1: render on both cores (common/parallel_render.h), 0: on loop()'s core only
+
+#include "common/parallel_render.h"
+#include "common/render_compare.h"
+#include "blobs.h"
 
 // SmartMatrix setup & buffer alloction
 SMARTMATRIX_ALLOCATE_BUFFERS(matrix, TOTAL_WIDTH, TOTAL_HEIGHT, kRefreshDepth, kDmaBufferRows, kPanelType, kMatrixOptions);
@@ -33,6 +41,8 @@ SMARTMATRIX_ALLOCATE_BACKGROUND_LAYER(bg, TOTAL_WIDTH, TOTAL_HEIGHT, COLOR_DEPTH
 
 void setup() {
 
+	if (RENDER_STATS_INTERVAL) Serial.begin(115200);
+
 	// On board LED (useful for debugging)
 	pinMode(PICO_LED_PIN, OUTPUT);
 
@@ -48,60 +58,28 @@ void setup() {
 
 }
 
-float clamp(float v, float min, float max) {
-	if (v < min) return min;
-	if (v > max) return max;
-	return v;
-}
-
-float mix(float x, float y, float a) {
-	return x * (1.0 - a) + y * a;
-}
+int frame = 0;
 
-// https://iquilezles.org/articles/distfunctions/
-float opSmoothUnion( float d1, float d2, float k ) {
-    float h = clamp( 0.5 + 0.5*(d2-d1)/k, 0.0, 1.0 );
-    return mix( d2, d1, h ) - k*h*(1.0-h);
+// Once per RENDER_STATS_INTERVAL both versions render the current frame off
+// screen, for their times and how far apart they are
+void reportRenderers() {
+	static uint32_t lastReport = 0;
+	if (RENDER_STATS_INTERVAL == 0 || millis() - lastReport < RENDER_STATS_INTERVAL) return;
+	lastReport = millis();
+	compareRenderers<TOTAL_WIDTH, TOTAL_HEIGHT>(BlobsFixed<TOTAL_WIDTH, TOTAL_HEIGHT>(frame),
+	                                            BlobsFloat<TOTAL_WIDTH, TOTAL_HEIGHT>(frame));
 }
 
-
-int frame = 0;
-
 void loop() {
 
-
-	// calculate an offset (-1 to 1), based on "time" (frame)
-	float cx1 = sin((float) frame * 0.034);
-	float cy1 = cos((float) frame * 0.048);
-
-	float cx2 = sin((float) frame * 0.059 + PI);
-	float cy2 = cos((float) frame * 0.063 + PI) ;
-
-	for (int j=0; j<TOTAL_HEIGHT; j++) {
-		for (int i=0; i<TOTAL_WIDTH; i++) {
-
-			// normalized coordinates of the pixels: 
-			// instead of 0 to 31 we have -1.0 to 1.0			
-			float x = (float) i / (TOTAL_WIDTH - 1) * 2.0 - 1.0;
-			float y = (float) j / (TOTAL_HEIGHT - 1) * 2.0 - 1.0;
-			
-			// add some offset 
-			float x1 = x + cx1;
-			float y1 = y + cy1;
-
-			float x2 = x + cx2;
-			float y2 = y + cy2;
-						
-			float d1 = sqrt( x1 * x1 + y1 * y1) - 0.2;
-			float d2 = sqrt( x2 * x2 + y2 * y2) - 0.4;
-			
-			float d = opSmoothUnion(d1, d2, 0.8);
-
-			int gray = (sin(d * 20.0 - frame * 0.5) * 0.5 + 0.5) * 255.0;
-			bg.drawPixel(i, j, {gray, 0, 0});
-		}
-	}
+	// Straight into the back buffer on both cores, see common/parallel_render.h
+#if FIXED_POINT
+	shadeFrameParallel<TOTAL_WIDTH, TOTAL_HEIGHT>(bg, BlobsFixed<TOTAL_WIDTH, TOTAL_HEIGHT>(frame));
+#else
+	shadeFrameParallel<TOTAL_WIDTH, TOTAL_HEIGHT>(bg, BlobsFloat<TOTAL_WIDTH, TOTAL_HEIGHT>(frame));
+#endif
 
 	bg.swapBuffers();
+	reportRenderers();
 	frame++;
 }
\ No newline at end of file
@@ -1,3 +1,5 @@
+import { HEADER_SIZE, FORMAT_RGB565, FORMAT_RGB888, createFrameBuffer, finishFrame } from './protocol.js'
+
 const TOTAL_WIDTH = 32
 const TOTAL_HEIGHT = 32
 
@@ -5,7 +7,7 @@ const TOTAL_HEIGHT = 32
 const BAUD_RATE = 921600
 const COLOR_DEPTH = 16 // 16 or 24 bits
 
-const PIXEL_DATA = new Uint8Array(1 + TOTAL_WIDTH * TOTAL_HEIGHT * (COLOR_DEPTH / 8))
+const PIXEL_DATA = createFrameBuffer(TOTAL_WIDTH * TOTAL_HEIGHT * (COLOR_DEPTH / 8))
 
 
 // Serial port writer
@@ -38,9 +40,8 @@ export async function serialPortWriterLoop(ctx) {
 
 	try {
 		// Send pixel data
-		// The first byte is a magic number to identify the data format
-		PIXEL_DATA[0] = 42
-		let idx = 1 // Start at the second byte
+		// The payload starts after the frame header (see protocol.js)
+		let idx = HEADER_SIZE
 
 		if (COLOR_DEPTH == 24) {
 			for (let i = 0; i < pixels.length; i += 4) {
@@ -63,7 +64,8 @@ export async function serialPortWriterLoop(ctx) {
 			}
 		}
 
-		await writer.write(PIXEL_DATA)
+		const format = COLOR_DEPTH == 24 ? FORMAT_RGB888 : FORMAT_RGB565
+		await writer.write(finishFrame(PIXEL_DATA, format, idx - HEADER_SIZE))
 
 	} catch (err) {
 		const error = 'Error in draw loop: ' + err
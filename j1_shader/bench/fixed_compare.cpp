@@ -0,0 +1,163 @@
+/**
+ * Compares the fixed-point renderers with the float code they replace:
+ * synthwave (this project), ripples (a7_simple_rasterizer_fx) and blobs
+ * (a8_simple_rasterizer).
+ *
+ * Every effect renders FRAMES frames both ways. Per effect it prints the
+ * time per frame of each version, the largest and the mean difference of
+ * any channel and the share of pixels off by more than DIFF_VISIBLE, and
+ * writes the frame with the largest difference to out/<effect>.ppm: float,
+ * fixed and the difference (×16) side by side, scaled up.
+ *
+ * The times are the host's, which has a floating-point unit: they show
+ * whether a change made the fixed version slower, not the ESP32's gain.
+ * The ESP32 numbers come from the sketches' own "fixed ... float ..." line
+ * on Serial (render_compare.h).
+ *
+ * Exits with 1 if an effect goes over MAX_DIFF anywhere or over
+ * MAX_VISIBLE_PERCENT of visibly different pixels, so it can guard changes
+ * to fixed_math.h. Hard edges, like the 0.0001 wide cloud outlines of
+ * synthwave, flip a pixel now and then; that is the max diff of a few
+ * dozen steps, a wrong formula shows up in the share.
+ *
+ * Build and run (from this folder):
+ *   g++ -O2 -I../include -o fixed_compare fixed_compare.cpp
+ *   ./fixed_compare
+ */
+
+#include <chrono>
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+
+#define FRAMES 600     // Frames per effect; the sketches' frame counter or 30 fps of iTime
+#define DIFF_VISIBLE 4 // Steps of a channel that count as a visible difference
+#define MAX_DIFF 64    // Largest difference accepted in any channel of any pixel
+#define MAX_VISIBLE_PERCENT 0.01 // Largest share of pixels off by more than DIFF_VISIBLE
+#define PPM_SCALE 8    // Output pixels per matrix pixel
+
+// SmartMatrix's colour type, as far as the renderers use it
+struct rgb24 {
+  uint8_t red, green, blue;
+  rgb24() : red(0), green(0), blue(0) {}
+  rgb24(int r, int g, int b) : red((uint8_t)r), green((uint8_t)g), blue((uint8_t)b) {}
+};
+
+// Shared by all three; each effect gets its own namespace for its helpers
+#include "fixed_math.h"
+#include "pixel_geometry.h"
+
+namespace synthwave {
+#include "synthwave_fixed.h"
+}
+namespace ripples {
+#include "../../a7_simple_rasterizer_fx/src/ripples.h"
+}
+namespace blobs {
+#include "../../a8_simple_rasterizer/src/blobs.h"
+}
+
+#define WIDTH 32
+#define HEIGHT 32
+
+typedef std::chrono::steady_clock Clock;
+
+struct Frame {
+  rgb24 pixels[WIDTH * HEIGHT];
+};
+
+template <typename Shade>
+double render(Frame &frame, const Shade &shade) {
+  Clock::time_point t0 = Clock::now();
+  for (int y = 0; y < HEIGHT; y++)
+    for (int x = 0; x < WIDTH; x++) frame.pixels[y * WIDTH + x] = shade(x, y);
+  return std::chrono::duration<double, std::micro>(Clock::now() - t0).count();
+}
+
+static int channelDiff(const rgb24 &a, const rgb24 &b) {
+  int d = abs(a.red - b.red);
+  if (abs(a.green - b.green) > d) d = abs(a.green - b.green);
+  if (abs(a.blue - b.blue) > d) d = abs(a.blue - b.blue);
+  return d;
+}
+
+static void writePpm(const char *name, const Frame &floatFrame, const Frame &fixedFrame) {
+  char path[64];
+  snprintf(path, sizeof(path), "out/%s.ppm", name);
+  FILE *f = fopen(path, "wb");
+  if (!f) {
+    perror(path);
+    return;
+  }
+  fprintf(f, "P6\n%d %d\n255\n", WIDTH * 3 * PPM_SCALE, HEIGHT * PPM_SCALE);
+  for (int y = 0; y < HEIGHT * PPM_SCALE; y++) {
+    for (int x = 0; x < WIDTH * 3 * PPM_SCALE; x++) {
+      int panel = x / (WIDTH * PPM_SCALE);
+      int i = y / PPM_SCALE * WIDTH + x % (WIDTH * PPM_SCALE) / PPM_SCALE;
+      const rgb24 &a = floatFrame.pixels[i], &b = fixedFrame.pixels[i];
+      rgb24 p = panel == 0 ? a : panel == 1 ? b : rgb24(
+        abs(a.red - b.red) * 16 > 255 ? 255 : abs(a.red - b.red) * 16,
+        abs(a.green - b.green) * 16 > 255 ? 255 : abs(a.green - b.green) * 16,
+        abs(a.blue - b.blue) * 16 > 255 ? 255 : abs(a.blue - b.blue) * 16);
+      fputc(p.red, f);
+      fputc(p.green, f);
+      fputc(p.blue, f);
+    }
+  }
+  fclose(f);
+}
+
+// Renders FRAMES frames with makeFloat(frame) and makeFixed(frame), returns
+// false if they are further apart than MAX_DIFF or MAX_VISIBLE_PERCENT
+template <typename MakeFloat, typename MakeFixed>
+bool compare(const char *name, MakeFloat makeFloat, MakeFixed makeFixed) {
+  static Frame floatFrame, fixedFrame, worstFloat, worstFixed;
+  double floatUs = 0, fixedUs = 0, diffSum = 0;
+  long visible = 0;
+  int maxDiff = -1;
+
+  for (int frame = 0; frame < FRAMES; frame++) {
+    floatUs += render(floatFrame, makeFloat(frame));
+    fixedUs += render(fixedFrame, makeFixed(frame));
+
+    int frameMax = 0;
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+      int d = channelDiff(floatFrame.pixels[i], fixedFrame.pixels[i]);
+      diffSum += d;
+      if (d > DIFF_VISIBLE) visible++;
+      if (d > frameMax) frameMax = d;
+    }
+    if (frameMax > maxDiff) {
+      maxDiff = frameMax;
+      worstFloat = floatFrame;
+      worstFixed = fixedFrame;
+    }
+  }
+
+  long pixels = (long)FRAMES * WIDTH * HEIGHT;
+  bool ok = maxDiff <= MAX_DIFF && 100.0 * visible / pixels <= MAX_VISIBLE_PERCENT;
+  printf("%-10s float %7.2f us  fixed %7.2f us  max diff %3d  mean %.3f  > %d: %.4f%%%s\n", name,
+         floatUs / FRAMES, fixedUs / FRAMES, maxDiff, diffSum / pixels, DIFF_VISIBLE,
+         100.0 * visible / pixels, ok ? "" : "  FAIL");
+  writePpm(name, worstFloat, worstFixed);
+  return ok;
+}
+
+int main() {
+  mkdir("out", 0755);
+  bool ok = true;
+
+  ok &= compare("synthwave",
+    [](int frame) { return synthwave::SynthwaveFloat<WIDTH, HEIGHT>(frame / 30.0f); },
+    [](int frame) { return synthwave::SynthwaveFixed<WIDTH, HEIGHT>(frame / 30.0f); });
+  ok &= compare("ripples",
+    [](int frame) { return ripples::RipplesFloat<WIDTH, HEIGHT>(frame); },
+    [](int frame) { return ripples::RipplesFixed<WIDTH, HEIGHT>(frame); });
+  ok &= compare("blobs",
+    [](int frame) { return blobs::BlobsFloat<WIDTH, HEIGHT>(frame); },
+    [](int frame) { return blobs::BlobsFixed<WIDTH, HEIGHT>(frame); });
+
+  return ok ? 0 : 1;
+}
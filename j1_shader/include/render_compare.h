@@ -0,0 +1,59 @@
+/**
+ * Side-by-side timing of two renderers of the same effect, e.g. its
+ * fixed-point and its float version.
+ *
+ * Both render the same frame off screen, then one line on Serial gives
+ * the time each took and the largest difference of any channel between
+ * the two images:
+ *
+ *   compareRenderers<TOTAL_WIDTH, TOTAL_HEIGHT>(RipplesFixed<TOTAL_WIDTH, TOTAL_HEIGHT>(frame),
+ *                                               RipplesFloat<TOTAL_WIDTH, TOTAL_HEIGHT>(frame));
+ *   fixed <us> us (<fps> fps), float <us> us (<fps> fps), max diff <n>
+ *
+ * The fps count the shading only; swapBuffers() and the refresh come on
+ * top. Takes two WIDTH × HEIGHT frames of RAM, allocated on first use.
+ */
+
+#ifndef RENDER_COMPARE_H
+#define RENDER_COMPARE_H
+
+#include <Arduino.h>
+
+#include "frame_writer.h"
+
+// A frame in plain memory, with the backBuffer() frame_writer.h draws into
+template <typename RGB, int WIDTH, int HEIGHT>
+struct ScratchFrame {
+	RGB pixels[WIDTH * HEIGHT];
+	RGB *backBuffer() { return pixels; }
+};
+
+template <int WIDTH, int HEIGHT, typename Fixed, typename Float>
+void compareRenderers(const Fixed &fixedShade, const Float &floatShade) {
+	typedef decltype(fixedShade(0, 0)) RGB;
+	static ScratchFrame<RGB, WIDTH, HEIGHT> *frames = new ScratchFrame<RGB, WIDTH, HEIGHT>[2];
+
+	// By reference: a renderer may carry per-row tables
+	uint32_t t0 = micros();
+	shadeFrame<WIDTH, HEIGHT>(frames[0], [&fixedShade](int x, int y) { return fixedShade(x, y); });
+	uint32_t t1 = micros();
+	shadeFrame<WIDTH, HEIGHT>(frames[1], [&floatShade](int x, int y) { return floatShade(x, y); });
+	uint32_t t2 = micros();
+
+	int maxDiff = 0;
+	for (int i = 0; i < WIDTH * HEIGHT; i++) {
+		const RGB &a = frames[0].pixels[i];
+		const RGB &b = frames[1].pixels[i];
+		maxDiff = max(maxDiff, abs((int)a.red - (int)b.red));
+		maxDiff = max(maxDiff, abs((int)a.green - (int)b.green));
+		maxDiff = max(maxDiff, abs((int)a.blue - (int)b.blue));
+	}
+
+	uint32_t fixedUs = max(t1 - t0, (uint32_t)1);
+	uint32_t floatUs = max(t2 - t1, (uint32_t)1);
+	Serial.printf("fixed %lu us (%lu fps), float %lu us (%lu fps), max diff %d\n",
+	              (unsigned long)fixedUs, (unsigned long)(1000000 / fixedUs),
+	              (unsigned long)floatUs, (unsigned long)(1000000 / floatUs), maxDiff);
+}
+
+#endif
@@ -0,0 +1,207 @@
+/**
+ * Synthwave shader in fixed-point math (fixed_math.h), the same image as
+ * SynthwaveFloat in synthwave.h within a step or two per channel (see
+ * bench/fixed_compare.cpp).
+ *
+ * Besides the number format, the port moves work out of the pixel loop:
+ * everything that depends on the row only (fog, the grid's horizontal
+ * lines, the sun's stripes, the sky and mountain colours, the powf() of
+ * the mountain's width) is worked out once per row in float when the
+ * frame is set up, and everything that depends on the time only (the
+ * cloud shapes, the phases of the waves, taken modulo their period) once
+ * per frame. The pixel loop is left with integer math.
+ *
+ * Needs rgb24 (SmartMatrix.h) declared before it is included.
+ */
+
+#ifndef SYNTHWAVE_FIXED_H
+#define SYNTHWAVE_FIXED_H
+
+#include "synthwave.h"
+#include "fixed_math.h"
+#include "pixel_geometry.h"
+
+inline fxvec3 fxColor(const vec3 &c) { return {fx(c.r), fx(c.g), fx(c.b)}; }
+
+// A line segment from a to b, for sdLine() with the division done up front
+struct FxSegment {
+  fxvec2 a, ba;
+  fix16 invLength2; // 1 / dot(ba, ba)
+};
+
+inline FxSegment fxSegment(vec2 a, vec2 b) {
+  vec2 ba = b - a;
+  return {{fx(a.x), fx(a.y)}, {fx(ba.x), fx(ba.y)}, fx(1.0f / dotv(ba, ba))};
+}
+
+inline fix16 fxSdLine(fxvec2 p, const FxSegment &s) {
+  fxvec2 pa = p - s.a;
+  fix16 h = fxClamp(fxDot(pa, s.ba) * s.invLength2, fxInt(0), fxInt(1));
+  return fxLength(pa - s.ba * h);
+}
+
+inline fix16 fxSdBox(fxvec2 p, fxvec2 b) {
+  fxvec2 d = fxAbs(p) - b;
+  return fxLength(fxMax(d, {fxInt(0), fxInt(0)})) + fxMin(fxMax(d.x, d.y), fxInt(0));
+}
+
+inline fix16 fxSdTrapezoid(fxvec2 p, fix16 r1, fix16 r2, fix16 he) {
+  fxvec2 k1 = {r2, he};
+  fxvec2 k2 = {r2 - r1, he * 2};
+  p.x = fxAbs(p.x);
+  fxvec2 ca = {p.x - fxMin(p.x, p.y < fxInt(0) ? r1 : r2), fxAbs(p.y) - he};
+  fix16 t = fxClamp(fxDot(k1 - p, k2) / fxDot(k2, k2), fxInt(0), fxInt(1));
+  fxvec2 cb = p - k1 + k2 * t;
+  fix16 d = fxMin(fxLength(ca), fxLength(cb)); // Not fxSqrt(fxDot()), see fxLength()
+  return cb.x < fxInt(0) && ca.y < fxInt(0) ? -d : d;
+}
+
+// sdCloud() of synthwave.h with the parts that only depend on the time
+// (the box between the two lines) done up front
+struct FxCloud {
+  FxSegment line1, line2;
+  fxvec2 boxCenter, boxSize;
+  fix16 w;
+};
+
+inline FxCloud fxCloud(vec2 a1, vec2 b1, vec2 a2, vec2 b2, float w) {
+  vec2 ww = {w * 1.5f, 0.0f};
+  vec2 left = maxv2(a1 + ww, a2 + ww);
+  vec2 right = minv2(b1 - ww, b2 - ww);
+  vec2 center = (left + right) * 0.5f;
+  float boxH = fabsf(a2.y - a1.y) * 0.5f;
+  return {fxSegment(a1, b1), fxSegment(a2, b2), {fx(center.x), fx(center.y)}, {fx(0.04f), fx(boxH)}, fx(w)};
+}
+
+inline fix16 fxSdCloud(fxvec2 p, const FxCloud &c) {
+  fix16 boxVal = fxSdBox(p - c.boxCenter, c.boxSize) + c.w;
+  fix16 uniVal1 = fxSmoothUnion(fxSdLine(p, c.line1), boxVal, fx(0.05f));
+  fix16 uniVal2 = fxSmoothUnion(fxSdLine(p, c.line2), boxVal, fx(0.05f));
+  return fxMin(uniVal1, uniVal2);
+}
+
+template <int WIDTH, int HEIGHT>
+struct SynthwaveFixed {
+  // Per row, see the constructor
+  struct Row {
+    bool ground;    // Below the horizon: the grid
+    fix16 fog;      // fog³, added to every channel
+    fix16 gridY;    // Ground: distance, scales uv.x
+    fix16 gridSize; // Ground: half width of the vertical lines
+    fix16 linesY;   // Ground: the horizontal lines
+    fix16 uvY;      // Sky: uv.y of the mountain and clouds
+    fix16 sunCut;   // Sky: the sun's stripes
+    fix16 trapR1;   // Sky: width of the mountain's foot
+    fxvec3 sky, fuji, horizon;
+  };
+
+  const PixelAxes<WIDTH, HEIGHT> &axes = pixelAxes<WIDTH, HEIGHT>();
+  Row rows[HEIGHT];
+  fix16 wavePhase;  // Snow line
+  fix16 cloudShift; // Cloud drift, in [0, 4)
+  FxCloud cloud1, cloud2;
+
+  explicit SynthwaveFixed(float iTime) {
+    const float battery = 1.0f;
+
+    for (int py = 0; py < HEIGHT; py++) {
+      Row &row = rows[py];
+      float uvY = axes.uvY[py];
+      float fog = smoothstep(0.1f, -0.02f, fabsf(uvY + 0.2f));
+      row.fog = fx(fog * fog * fog);
+      row.ground = uvY < -0.2f;
+
+      if (row.ground) {
+        float y = 3.0f / (fabsf(uvY + 0.2f) + 0.05f);
+        row.gridY = fx(y);
+        row.gridSize = fx(y * 0.01f);
+        float sizeY = y * y * 0.2f * 0.01f;
+        float lineY = fabsf(fractf(y + iTime * 4.0f * (battery + 0.05f)) - 0.5f);
+        row.linesY = fx(smoothstep(sizeY, 0.0f, lineY) + smoothstep(sizeY * 5.0f, 0.0f, lineY) * 0.4f * battery);
+      } else {
+        float fujiD = fminf(uvY * 4.5f - 0.5f, 1.0f);
+        uvY -= battery * 1.1f - 0.51f;
+        float sunY = uvY + 0.2f;
+        float cut = 3.0f * sinf((sunY + iTime * 0.2f * (battery + 0.02f)) * 100.0f)
+                    + clampf(sunY * 14.0f + 1.0f, -6.0f, 6.0f);
+        row.uvY = fx(uvY);
+        row.sunCut = fx(clampf(cut, 0.0f, 1.0f));
+        row.trapR1 = fx(1.75f + powf(uvY * uvY, 2.1f));
+        row.sky = fxColor(mix3(vec3(1.0f, 0.2f, 1.0f), vec3(1.0f, 0.4f, 0.1f), sunY * 2.0f + 0.2f));
+        row.fuji = fxColor(mix3(vec3(0.0f, 0.0f, 0.25f), vec3(1.0f, 0.0f, 0.5f), fujiD));
+        row.horizon = fxColor(mix3(vec3(1.0f, 0.12f, 0.8f), vec3(0.0f, 0.0f, 0.2f), clampf(uvY * 3.5f + 3.0f, 0.0f, 1.0f)));
+      }
+    }
+
+    wavePhase = fx(fmodf(iTime * 2.0f, 2.0f * (float)M_PI));
+    cloudShift = fx(fmodf(iTime * 0.1f, 4.0f));
+
+    float cloudTime = iTime * 0.5f;
+    float cloudY = -0.5f;
+    cloud1 = fxCloud(
+      vec2(0.1f + sinf(cloudTime + 140.5f) * 0.1f, cloudY),
+      vec2(1.05f + cosf(cloudTime * 0.9f - 36.56f) * 0.1f, cloudY),
+      vec2(0.2f + cosf(cloudTime * 0.867f + 387.165f) * 0.1f, 0.25f + cloudY),
+      vec2(0.5f + cosf(cloudTime * 0.9675f - 15.162f) * 0.09f, 0.25f + cloudY),
+      0.075f);
+    cloudY = -0.6f;
+    cloud2 = fxCloud(
+      vec2(-0.9f + cosf(cloudTime * 1.02f + 541.75f) * 0.1f, cloudY),
+      vec2(-0.5f + sinf(cloudTime * 0.9f - 316.56f) * 0.1f, cloudY),
+      vec2(-1.5f + cosf(cloudTime * 0.867f + 37.165f) * 0.1f, 0.25f + cloudY),
+      vec2(-0.6f + sinf(cloudTime * 0.9675f + 665.162f) * 0.09f, 0.25f + cloudY),
+      0.075f);
+  }
+
+  rgb24 operator()(int px, int py) const {
+    const Row &row = rows[py];
+    const fxvec3 pink = {fxInt(1), fx(0.5f), fxInt(1)};
+
+    fix16 uvX = axes.fixedUvX[px];
+    fxvec3 col;
+
+    if (row.ground) {
+      fix16 lineX = fxAbs(fxFract(uvX * row.gridY) - fx(0.5f));
+      fix16 linesX = fxSmoothstep(row.gridSize, fxInt(0), lineX)
+                     + fxSmoothstep(row.gridSize * 5, fxInt(0), lineX) * fx(0.4f);
+      fix16 gridVal = fxClamp(linesX + row.linesY, fxInt(0), fxInt(3));
+      col = fxMix(fxvec3{fxInt(0), fx(0.1f), fx(0.2f)}, pink, gridVal);
+    } else {
+      fix16 uvY = row.uvY;
+
+      // Sun
+      fix16 sunLength = fxLength({uvX + fx(0.75f), uvY + fx(0.2f)});
+      fix16 val = fxSmoothstep(fx(0.3f), fx(0.29f), sunLength);
+      fix16 bloom = fxSmoothstep(fx(0.7f), fxInt(0), sunLength);
+      fix16 sunVal = fxClamp(val * row.sunCut, fxInt(0), fxInt(1)) + bloom * fx(0.6f);
+      col = row.sky * sunVal;
+
+      // Fuji mountain
+      fix16 fujiVal = fxSdTrapezoid({uvX - fx(0.75f), uvY + fx(0.5f)}, row.trapR1, fx(0.2f), fx(0.5f));
+      fix16 waveVal = uvY + fxSin(uvX * 20 + wavePhase) * fx(0.05f) + fx(0.2f);
+      fix16 waveWidth = fxSmoothstep(fxInt(0), fx(0.01f), waveVal);
+      fix16 inside = fxStep(fujiVal, fxInt(0));
+      col = fxMix(col, row.fuji, inside);
+      col = fxMix(col, pink, waveWidth * inside);
+      col = fxMix(col, pink, fxInt(1) - fxSmoothstep(fxInt(0), fx(0.01f), fxAbs(fujiVal)));
+
+      // Horizon color
+      col = col + fxMix(col, row.horizon, fxStep(fxInt(0), fujiVal));
+
+      // Clouds, wrapped to [-2, 2)
+      fix16 cloudX = uvX + cloudShift;
+      while (cloudX >= fxInt(4)) cloudX -= fxInt(4);
+      while (cloudX < fxInt(0)) cloudX += fxInt(4);
+      fxvec2 cloudUV = {cloudX - fxInt(2), uvY};
+      fix16 cloudVal = fxMin(fxSdCloud(cloudUV, cloud1), fxSdCloud(cloudUV, cloud2));
+      col = fxMix(col, fxvec3{fxInt(0), fxInt(0), fx(0.2f)}, fxInt(1) - fxSmoothstep(fx(0.075f - 0.0001f), fx(0.075f), cloudVal));
+      col = col + fxVec3(fxInt(1) - fxSmoothstep(fxInt(0), fx(0.01f), fxAbs(cloudVal - fx(0.075f))));
+    }
+
+    col = col + fxVec3(row.fog);
+    col = fxMix(fxVec3(col.r * fx(0.5f)), col, fx(0.7f));
+    return rgb24(fxToByte(col.r), fxToByte(col.g), fxToByte(col.b));
+  }
+};
+
+#endif
@@ -0,0 +1,100 @@
+/**
+ * Accuracy and speed of fast_math.h against libm, on the host.
+ *
+ * For each kernel it prints the largest error over a sweep of the inputs
+ * the effects use (absolute for sin, cos and atan2, relative for the
+ * square roots) and the time per call of the fast version and of libm's
+ * float function. The errors hold on the ESP32 too, both use IEEE floats;
+ * the host's times only compare the kernels with each other, its FPU has
+ * the square root and divide the ESP32's lacks.
+ *
+ * Build and run (from this folder), once per precision level:
+ *   g++ -O2 -I../include -DFAST_MATH_PRECISION=1 -o fast_math_bench fast_math_bench.cpp
+ *   ./fast_math_bench
+ */
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fast_math.h"
+
+#define SAMPLES 1000000 // Inputs per accuracy sweep
+#define BATCH 4096      // Inputs per timing pass
+#define PASSES 2000     // Timing passes
+
+typedef std::chrono::steady_clock Clock;
+
+static float xs[BATCH], ys[BATCH];
+static volatile float sink;
+
+// ns per call of f over xs (and ys)
+template <typename F>
+double timeCalls(F f) {
+  float sum = 0;
+  Clock::time_point t0 = Clock::now();
+  for (int pass = 0; pass < PASSES; pass++)
+    for (int i = 0; i < BATCH; i++) sum += f(xs[i], ys[i]);
+  double ns = std::chrono::duration<double, std::nano>(Clock::now() - t0).count();
+  sink = sum;
+  return ns / ((double)PASSES * BATCH);
+}
+
+static float uniform(float lo, float hi) { return lo + (hi - lo) * (rand() / (float)RAND_MAX); }
+
+static void fillInputs(float lo, float hi) {
+  for (int i = 0; i < BATCH; i++) {
+    xs[i] = uniform(lo, hi);
+    ys[i] = uniform(lo, hi);
+  }
+}
+
+static void report(const char *name, double maxErr, double fastNs, double libmNs) {
+  printf("%-12s max error %.2e   fast %6.2f ns   libm %6.2f ns\n", name, maxErr, fastNs, libmNs);
+}
+
+int main() {
+  printf("FAST_MATH_PRECISION %d: sine table %d floats (%d bytes of flash)\n", FAST_MATH_PRECISION,
+         FAST_SIN_SIZE + 1, (int)sizeof(fastSinTable));
+  srand(1);
+  double err;
+
+  // sin, cos: the effects' phases, a few hundred radians at most
+  err = 0;
+  for (int i = 0; i < SAMPLES; i++) {
+    float x = -300.0f + 600.0f * i / SAMPLES;
+    err = fmax(err, fabs(fastSin(x) - sin((double)x)));
+    err = fmax(err, fabs(fastCos(x) - cos((double)x)));
+  }
+  fillInputs(-300.0f, 300.0f);
+  report("sin, cos", err, timeCalls([](float x, float) { return fastSin(x); }),
+         timeCalls([](float x, float) { return sinf(x); }));
+
+  // sqrt, 1/sqrt: from 1e-4 to 1e4, squared distances and lengths
+  err = 0;
+  double invErr = 0;
+  for (int i = 0; i < SAMPLES; i++) {
+    float x = powf(10.0f, -4.0f + 8.0f * i / SAMPLES);
+    err = fmax(err, fabs(fastSqrt(x) / sqrt((double)x) - 1.0));
+    invErr = fmax(invErr, fabs(fastInvSqrt(x) * sqrt((double)x) - 1.0));
+  }
+  fillInputs(0.0f, 2048.0f);
+  report("sqrt", err, timeCalls([](float x, float) { return fastSqrt(x); }),
+         timeCalls([](float x, float) { return sqrtf(x); }));
+  report("1/sqrt", invErr, timeCalls([](float x, float) { return fastInvSqrt(x); }),
+         timeCalls([](float x, float) { return 1.0f / sqrtf(x); }));
+
+  // atan2: pixel offsets from the centre of a matrix, and finer
+  err = 0;
+  for (int i = 0; i < SAMPLES; i++) {
+    float y = uniform(-20.0f, 20.0f), x = uniform(-20.0f, 20.0f);
+    double d = fabs(fastAtan2(y, x) - atan2((double)y, (double)x));
+    err = fmax(err, fmin(d, 2 * M_PI - d)); // -π and π are the same angle
+  }
+  fillInputs(-20.0f, 20.0f);
+  report("atan2", err, timeCalls([](float x, float y) { return fastAtan2(y, x); }),
+         timeCalls([](float x, float y) { return atan2f(y, x); }));
+
+  return 0;
+}
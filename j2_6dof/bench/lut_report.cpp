@@ -0,0 +1,116 @@
+/**
+ * Report on the lookup tables the sketches build at compile time (lut.h).
+ *
+ * For each table: its entries, its size in flash, the largest difference
+ * from the same table built with libm, and how long building it at boot
+ * took on this machine, i.e. the startup time the table saves. The boot
+ * times are the host's; on the ESP32, without hardware divide or square
+ * root, they come out one to two orders of magnitude longer.
+ *
+ * The tables are declared here with the same generators and parameters
+ * the sketches use, since the sketches themselves only build for the
+ * ESP32.
+ *
+ * Build and run (from this folder):
+ *   g++ -std=gnu++11 -O2 -I../include -o lut_report lut_report.cpp
+ *   ./lut_report
+ */
+
+#include <chrono>
+#include <math.h>
+#include <stdio.h>
+
+#include "fast_math.h"
+#include "fixed_math.h"
+#include "pixel_geometry.h"
+#include "lut.h"
+
+#define WIDTH 32
+#define HEIGHT 32
+#define REPEAT 100 // Boot-time builds to average
+
+typedef std::chrono::steady_clock Clock;
+
+// a6_simple_rasterizer: ring distance in the -1 to 1 coordinates
+static constexpr PixelPolar<WIDTH, HEIGHT> ringPolar = pixelPolar<WIDTH, HEIGHT>(
+  (WIDTH - 1) / 2.0, (HEIGHT - 1) / 2.0, 2.0 / (WIDTH - 1), 2.0 / (HEIGHT - 1));
+
+// j2_6dof: pixel offsets from the centre
+static constexpr PixelPolar<WIDTH, HEIGHT> imuPolar = pixelPolar<WIDTH, HEIGHT>(WIDTH / 2.0, HEIGHT / 2.0);
+
+// a11_doom_flame's palette, and the other kinds of table lut.h makes
+static constexpr LutRgb flamePalette[] = {
+  {0, 0, 0}, {42, 7, 7}, {128, 0, 0}, {180, 32, 0}, {220, 64, 0}, {255, 128, 0}, {255, 255, 128},
+};
+static constexpr Lut<LutRgb, 64> flameRamp = makeLut<LutRgb, 64>(LutRamp(flamePalette, 7, 64));
+static constexpr Lut<uint8_t, 256> gamma22 = makeLut<uint8_t, 256>(LutGamma(256, 2.2));
+static constexpr Lut<uint8_t, 32> expand5 = makeLut<uint8_t, 32>(LutExpand(5));
+static constexpr Lut<uint8_t, 64> expand6 = makeLut<uint8_t, 64>(LutExpand(6));
+static constexpr Lut<int16_t, 256> sineQ15 = makeLut<int16_t, 256>(LutSine(256, 32767));
+
+static volatile float sink;
+static double totalBytes = 0, totalUs = 0;
+
+// Runs build() REPEAT times, returns µs per run
+template <typename Build>
+double timeBuild(Build build) {
+  Clock::time_point t0 = Clock::now();
+  for (int i = 0; i < REPEAT; i++) build();
+  return std::chrono::duration<double, std::micro>(Clock::now() - t0).count() / REPEAT;
+}
+
+static void report(const char *name, int entries, size_t bytes, double maxDiff, double bootUs) {
+  printf("%-26s %6d %8zu B   %9.2e   %8.2f us\n", name, entries, bytes, maxDiff, bootUs);
+  totalBytes += bytes;
+  totalUs += bootUs;
+}
+
+template <typename Polar>
+static void reportPolar(const char *name, const Polar &polar, double cx, double cy, double sx, double sy) {
+  static float dist[WIDTH * HEIGHT], angle[WIDTH * HEIGHT];
+  double us = timeBuild([&] {
+    for (int i = 0; i < WIDTH * HEIGHT; i++) {
+      float dx = (float)((i % WIDTH - cx) * sx), dy = (float)((i / WIDTH - cy) * sy);
+      dist[i] = sqrtf(dx * dx + dy * dy);
+      angle[i] = atan2f(dy, dx);
+    }
+    sink = dist[WIDTH * HEIGHT - 1];
+  });
+  double diff = 0;
+  for (int i = 0; i < WIDTH * HEIGHT; i++) {
+    diff = fmax(diff, fabs(polar.dist[i] - dist[i]));
+    diff = fmax(diff, fabs(polar.angle[i] - angle[i]));
+  }
+  report(name, 2 * WIDTH * HEIGHT, sizeof(polar), diff, us);
+}
+
+template <typename Table, typename Reference>
+static void reportTable(const char *name, const Table &table, Reference reference) {
+  static double values[4096];
+  double us = timeBuild([&] {
+    for (int i = 0; i < table.size(); i++) values[i] = reference(i);
+    sink = (float)values[table.size() - 1];
+  });
+  double diff = 0;
+  for (int i = 0; i < table.size(); i++) diff = fmax(diff, fabs(table[i] - values[i]));
+  report(name, table.size(), sizeof(table), diff, us);
+}
+
+int main() {
+  printf("%-26s %6s %10s   %9s   %11s\n", "table", "values", "flash", "max diff", "boot (host)");
+
+  reportTable("fast_math.h sine", fastSinTable,
+              [](int i) { return (double)sinf(i * (2.0f * (float)M_PI / FAST_SIN_SIZE)); });
+  reportPolar("a6 ring distance + angle", ringPolar, (WIDTH - 1) / 2.0, (HEIGHT - 1) / 2.0, 2.0 / (WIDTH - 1),
+              2.0 / (HEIGHT - 1));
+  reportPolar("j2 distance + angle", imuPolar, WIDTH / 2.0, HEIGHT / 2.0, 1, 1);
+  reportTable("sine Q15", sineQ15, [](int i) { return (double)lround(32767 * sin(2 * M_PI * i / 256)); });
+  reportTable("gamma 2.2", gamma22, [](int i) { return (double)lround(255 * pow(i / 255.0, 2.2)); });
+  reportTable("expand 5 bit", expand5, [](int i) { return (double)lround(i * 255.0 / 31); });
+  reportTable("expand 6 bit", expand6, [](int i) { return (double)lround(i * 255.0 / 63); });
+  report("a11 palette", 7, sizeof(flamePalette), 0, 0);
+  report("flame ramp, 64 steps", 64, sizeof(flameRamp), 0, 0);
+
+  printf("%-26s %6s %8.0f B   %9s   %8.2f us\n", "total", "", totalBytes, "", totalUs);
+  return 0;
+}
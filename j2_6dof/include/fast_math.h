@@ -0,0 +1,112 @@
+/**
+ * Fast float sin, cos, square root, inverse square root and atan2 for
+ * per-pixel effects.
+ *
+ * The ESP32's FPU adds and multiplies in a cycle but has no divide or
+ * square root instruction, so sqrtf() and atan2f() are software routines,
+ * and sinf() reduces its argument exactly before a long polynomial. Called
+ * for every pixel they take most of a frame. These give up accuracy no
+ * 8-bit channel shows:
+ *
+ *   fastSin(), fastCos()  table of one turn, linear interpolation
+ *   fastInvSqrt()         first guess from the float's bits, Newton steps
+ *   fastSqrt()            x * fastInvSqrt(x)
+ *   fastAtan2()           reduced to atan() on [0, 1], odd polynomial
+ *
+ * FAST_MATH_PRECISION, defined before the include, picks the trade-off.
+ * Largest errors, measured with j2_6dof/bench/fast_math_bench.cpp (sin and
+ * cos over ±300 radians, where rounding the argument adds its share):
+ *
+ *   level  sine table        sin, cos  sqrt (relative)  atan2 (radians)
+ *   0      65 floats, 260 B  1.2e-3    1.8e-3           1.5e-3
+ *   1      257 floats, 1 KB  7.9e-5    4.8e-6           1.2e-5    (default)
+ *   2      1025 floats, 4 KB 2.6e-5    4.8e-6           2.0e-6
+ *
+ * The compiler builds the table (lut.h) and it stays in flash: at 1 KB
+ * it lives in the cache after the first frame, and setup() has nothing to
+ * fill.
+ *
+ * Arguments of fastSin() and fastCos() are reduced to one turn in float:
+ * keep them below about 10^5, e.g. take time terms modulo their period.
+ * fastSqrt(0) is 0, fastInvSqrt(0) a large finite number.
+ */
+
+#ifndef FAST_MATH_H
+#define FAST_MATH_H
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+
+#include "lut.h"
+
+#ifndef FAST_MATH_PRECISION
+#define FAST_MATH_PRECISION 1
+#endif
+
+#if FAST_MATH_PRECISION <= 0
+#define FAST_SIN_BITS 6
+#define FAST_SQRT_STEPS 1
+#elif FAST_MATH_PRECISION == 1
+#define FAST_SIN_BITS 8
+#define FAST_SQRT_STEPS 2
+#else
+#define FAST_SIN_BITS 10
+#define FAST_SQRT_STEPS 2
+#endif
+
+#define FAST_SIN_SIZE (1 << FAST_SIN_BITS) // Table entries per turn
+
+// sin() over one turn, one entry more so the interpolation needs no wrap
+static constexpr Lut<float, FAST_SIN_SIZE + 1> fastSinTable = makeLut<float, FAST_SIN_SIZE + 1>(LutSine(FAST_SIN_SIZE));
+
+// Sine of t table entries, i.e. t / FAST_SIN_SIZE turns
+inline float fastSinSteps(float t) {
+	int32_t i = (int32_t)t;
+	if (t < i) i--; // Toward -infinity, as floor()
+	float f = t - i;
+	i &= FAST_SIN_SIZE - 1;
+	return fastSinTable[i] + (fastSinTable[i + 1] - fastSinTable[i]) * f;
+}
+
+inline float fastSin(float x) { return fastSinSteps(x * (FAST_SIN_SIZE / (2.0f * (float)M_PI))); }
+inline float fastCos(float x) { return fastSinSteps(x * (FAST_SIN_SIZE / (2.0f * (float)M_PI)) + FAST_SIN_SIZE / 4); }
+
+// 1 / sqrt(x) for x > 0
+inline float fastInvSqrt(float x) {
+	uint32_t bits;
+	memcpy(&bits, &x, sizeof(bits));
+	bits = 0x5F375A86 - (bits >> 1); // Halves and negates the exponent, roughly
+	float y;
+	memcpy(&y, &bits, sizeof(y));
+	for (int i = 0; i < FAST_SQRT_STEPS; i++) y *= 1.5f - 0.5f * x * y * y;
+	return y;
+}
+
+inline float fastSqrt(float x) { return x <= 0.0f ? 0.0f : x * fastInvSqrt(x); }
+
+// atan(a) for a in [0, 1]
+inline float fastAtanUnit(float a) {
+#if FAST_MATH_PRECISION <= 0
+	return a * ((float)M_PI / 4) + a * (1.0f - a) * (0.2447f + 0.0663f * a);
+#elif FAST_MATH_PRECISION == 1
+	float a2 = a * a; // Abramowitz & Stegun 4.4.49
+	return a * (0.9998660f + a2 * (-0.3302995f + a2 * (0.1801410f + a2 * (-0.0851330f + a2 * 0.0208351f))));
+#else
+	float a2 = a * a;
+	return a * (0.99997726f + a2 * (-0.33262347f + a2 * (0.19354346f + a2 * (-0.11643287f + a2 * (0.05265332f + a2 * -0.01172120f)))));
+#endif
+}
+
+// atan2(y, x) in [-π, π]; 0 for (0, 0)
+inline float fastAtan2(float y, float x) {
+	float ax = fabsf(x), ay = fabsf(y);
+	float hi = ax > ay ? ax : ay;
+	if (hi == 0.0f) return 0.0f;
+	float r = fastAtanUnit((ax > ay ? ay : ax) / hi);
+	if (ay > ax) r = (float)M_PI / 2 - r;
+	if (x < 0.0f) r = (float)M_PI - r;
+	return y < 0.0f ? -r : r;
+}
+
+#endif
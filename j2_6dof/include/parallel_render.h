@@ -0,0 +1,108 @@
+/**
+ * Renders a frame on both ESP32 cores.
+ *
+ * loop() runs on core 1 and core 0 mostly idles in the drawing sketches.
+ * renderRowsParallel() and shadeFrameParallel() work like renderRows() and
+ * shadeFrame() of frame_writer.h, but a worker task pinned to core 0 helps:
+ * both cores take the next band of PARALLEL_BAND_ROWS rows until the frame
+ * is done, so an expensive part of the picture (the synthwave sky) does not
+ * leave one core waiting on the other. They return once every row is
+ * written, so swapBuffers() can follow straight away.
+ *
+ *   shadeFrameParallel<TOTAL_WIDTH, TOTAL_HEIGHT>(bg, RipplesFixed<TOTAL_WIDTH, TOTAL_HEIGHT>(frame));
+ *   bg.swapBuffers();
+ *
+ * The callback runs on both cores at once: it may read anything set up for
+ * the frame, but must not write shared state, print or draw elsewhere.
+ * Rows come in no particular order, so renderers that carry state from one
+ * row to the next need renderRows().
+ *
+ * The worker is created on the first call. The calling task waits for it
+ * on its task notification, so don't call these from a task that gets
+ * notified for other reasons. With PARALLEL_RENDER 0, defined before the
+ * include, they render on the calling core only.
+ */
+
+#ifndef PARALLEL_RENDER_H
+#define PARALLEL_RENDER_H
+
+#include <Arduino.h>
+#include <atomic>
+
+#include "frame_writer.h"
+
+#ifndef PARALLEL_RENDER
+#define PARALLEL_RENDER 1
+#endif
+
+#define PARALLEL_BAND_ROWS 2 // Rows taken at a time, fewer balance better but meet more often
+#define PARALLEL_CORE 0      // Core of the worker; loop() runs on the other one
+#define PARALLEL_PRIORITY 1  // Same as loop(), below the Wi-Fi and timer tasks
+#define PARALLEL_STACK 4096
+
+// A frame being rendered: renderBand(context, y0, y1) renders rows y0 to y1 - 1
+struct ParallelJob {
+	void (*renderBand)(void *context, int y0, int y1);
+	void *context;
+	int height;
+	std::atomic<int> nextRow{0};
+	TaskHandle_t caller;
+};
+
+static ParallelJob *parallelJob = NULL;
+static TaskHandle_t parallelWorker = NULL;
+
+// Renders bands until none is left, on whichever core calls it
+inline void parallelRunBands(ParallelJob &job) {
+	for (;;) {
+		int y0 = job.nextRow.fetch_add(PARALLEL_BAND_ROWS);
+		if (y0 >= job.height) return;
+		int y1 = y0 + PARALLEL_BAND_ROWS < job.height ? y0 + PARALLEL_BAND_ROWS : job.height;
+		job.renderBand(job.context, y0, y1);
+	}
+}
+
+static void parallelWorkerLoop(void *) {
+	for (;;) {
+		ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+		parallelRunBands(*parallelJob);
+		xTaskNotifyGive(parallelJob->caller);
+	}
+}
+
+// Calls renderRow(row, y) for every row of the back buffer, on both cores
+template <int WIDTH, int HEIGHT, typename Layer, typename RenderRow>
+inline void renderRowsParallel(Layer &layer, RenderRow renderRow) {
+#if PARALLEL_RENDER
+	auto *buffer = layer.backBuffer();
+	auto band = [&](int y0, int y1) {
+		for (int y = y0; y < y1; y++) renderRow(buffer + y * WIDTH, y);
+	};
+
+	ParallelJob job;
+	job.renderBand = [](void *context, int y0, int y1) { (*(decltype(band) *)context)(y0, y1); };
+	job.context = &band;
+	job.height = HEIGHT;
+	job.caller = xTaskGetCurrentTaskHandle();
+
+	if (!parallelWorker) {
+		xTaskCreatePinnedToCore(parallelWorkerLoop, "render", PARALLEL_STACK, NULL, PARALLEL_PRIORITY, &parallelWorker, PARALLEL_CORE);
+	}
+	parallelJob = &job;
+	xTaskNotifyGive(parallelWorker);
+	parallelRunBands(job);
+	ulTaskNotifyTake(pdTRUE, portMAX_DELAY); // The worker's last band
+#else
+	renderRows<WIDTH, HEIGHT>(layer, renderRow);
+#endif
+}
+
+// Sets every pixel to shade(x, y), on both cores
+template <int WIDTH, int HEIGHT, typename Layer, typename Shade>
+inline void shadeFrameParallel(Layer &layer, const Shade &shade) {
+	renderRowsParallel<WIDTH, HEIGHT>(layer, [&shade](decltype(layer.backBuffer()) row, int y) {
+		for (int x = 0; x < WIDTH; x++) row[x] = shade(x, y);
+	});
+}
+
+#endif
@@ -28,6 +28,10 @@
 
 // Pinout configuration for the PicoDriver v.5.0
 #include "pico_driver_v5_pinout.h"
+#include "frame_writer.h"
+#include "fast_math.h"
+#include "parallel_render.h"
+#include "pixel_geometry.h"
 #define USE_ADAFRUIT_GFX_LAYERS
 
 #include <Arduino.h>
@@ -72,6 +76,10 @@ const float ALPHA = 0.15f;
 // Integrated gyro angles for rotation effect
 float angleX = 0, angleY = 0, angleZ = 0;
 
+// Distance and angle of every pixel from the centre, built by the compiler
+// and kept in flash (pixel_geometry.h)
+constexpr PixelPolar<TOTAL_WIDTH, TOTAL_HEIGHT> polar = pixelPolar<TOTAL_WIDTH, TOTAL_HEIGHT>(TOTAL_WIDTH / 2.0, TOTAL_HEIGHT / 2.0);
+
 // ============================================================
 // Helper math
 // ============================================================
@@ -166,13 +174,21 @@ void renderFrame(float iTime) {
   // Integrated angle Z drives a rotation
   float rotRad = angleZ * (M_PI / 180.0f);
 
-  for (int py = 0; py < TOTAL_HEIGHT; py++) {
+  // Per-frame terms, time phases wrapped to one turn for fastSin()
+  const float TWO_PI_F = 2.0f * (float)M_PI;
+  float phaseR = fmodf(iTime * 3.0f, TWO_PI_F) - fabsf(gxNorm) * 8.0f;
+  float phaseG = fmodf(iTime * 2.5f, TWO_PI_F) - fabsf(gyNorm) * 6.0f;
+  float pulse = 0.7f + 0.3f * sinf(iTime * 4.0f);
+
+  // A row at a time straight into the back buffer, rows split between
+  // both cores (parallel_render.h)
+  renderRowsParallel<TOTAL_WIDTH, TOTAL_HEIGHT>(backgroundLayer, [&](rgb24 *row, int py) {
     for (int px = 0; px < TOTAL_WIDTH; px++) {
       // Pixel position relative to center
       float dx = (float)px - cx;
       float dy = (float)py - cy;
-      float dist = sqrtf(dx * dx + dy * dy);
-      float angle = atan2f(dy, dx);
+      float dist = polar.dist[py * TOTAL_WIDTH + px];
+      float angle = polar.angle[py * TOTAL_WIDTH + px];
 
       // ---- Layer 1: Background gradient driven by accelZ ----
       float bgVal = zIntensity * 0.12f;
@@ -185,19 +201,19 @@ void renderFrame(float iTime) {
       // The wave frequency increases with rotation speed
 
       // GyroX → red wave radiating from center
-      float waveR = sinf(dist * 0.6f - iTime * 3.0f + fabsf(gxNorm) * 8.0f) * 0.5f + 0.5f;
+      float waveR = fastSin(dist * 0.6f - phaseR) * 0.5f + 0.5f;
       waveR *= fabsf(gxNorm); // intensity proportional to rotation speed
       // Fade with distance
       waveR *= clampf(1.0f - dist / 22.0f, 0.0f, 1.0f);
 
       // GyroY → green wave
-      float waveG = sinf(dist * 0.5f - iTime * 2.5f + fabsf(gyNorm) * 6.0f) * 0.5f + 0.5f;
+      float waveG = fastSin(dist * 0.5f - phaseG) * 0.5f + 0.5f;
       waveG *= fabsf(gyNorm);
       waveG *= clampf(1.0f - dist / 22.0f, 0.0f, 1.0f);
 
       // GyroZ → blue rotating ring
       float ringAngle = angle - rotRad;
-      float ring = sinf(ringAngle * 3.0f) * 0.5f + 0.5f;
+      float ring = fastSin(ringAngle * 3.0f) * 0.5f + 0.5f;
       float ringMask = (1.0f - fabsf(dist - 10.0f) / 4.0f);
       ringMask = clampf(ringMask, 0.0f, 1.0f);
       float waveB = ring * ringMask * clampf(fabsf(gzNorm) + 0.3f, 0.0f, 1.0f);
@@ -205,12 +221,12 @@ void renderFrame(float iTime) {
       // ---- Layer 3: Accelerometer cursor glow ----
       float cdx = (float)px - cursorX;
       float cdy = (float)py - cursorY;
-      float cdist = sqrtf(cdx * cdx + cdy * cdy);
+      float cdist2 = cdx * cdx + cdy * cdy;
 
       // Soft glow falloff
-      float glow = 1.0f / (1.0f + cdist * cdist * 0.15f);
+      float glow = 1.0f / (1.0f + cdist2 * 0.15f);
       // Pulse with time
-      glow *= 0.7f + 0.3f * sinf(iTime * 4.0f);
+      glow *= pulse;
 
       // Cursor color: warm white/yellow
       float glowR = glow * 1.0f;
@@ -241,9 +257,9 @@ void renderFrame(float iTime) {
       uint8_t pg = (uint8_t)(clampf(g, 0.0f, 1.0f) * 255.0f);
       uint8_t pb = (uint8_t)(clampf(b, 0.0f, 1.0f) * 255.0f);
 
-      backgroundLayer.drawPixel(px, py, (rgb24){pr, pg, pb});
+      row[px] = rgb24(pr, pg, pb);
     }
-  }
+  });
 }
 
 // ============================================================
@@ -253,15 +269,17 @@ void loop() {
   readIMU();
 
   float iTime = millis() / 1000.0f;
+  uint32_t t0 = micros();
   renderFrame(iTime);
+  uint32_t renderUs = micros() - t0;
   backgroundLayer.swapBuffers();
 
   // Debug output every 500ms
   static unsigned long lastPrint = 0;
   if (millis() - lastPrint > 500) {
     lastPrint = millis();
-    Serial.printf("Accel X:%.2f Y:%.2f Z:%.2f | Gyro X:%.1f Y:%.1f Z:%.1f | Angle Z:%.1f\n",
-      accelX, accelY, accelZ, gyroX, gyroY, gyroZ, angleZ);
+    Serial.printf("Accel X:%.2f Y:%.2f Z:%.2f | Gyro X:%.1f Y:%.1f Z:%.1f | Angle Z:%.1f | render %lu us\n",
+      accelX, accelY, accelZ, gyroX, gyroY, gyroZ, angleZ, (unsigned long)renderUs);
   }
 
   delay(20); // ~50 Hz
@@ -0,0 +1,608 @@
+/**
+ * Binary frame protocol shared with the firmware (common/frame_protocol.h).
+ *
+ *   Offset  Size  Field
+ *   0       2     Sync word 'P' 'X' (0x50 0x58)
+ *   2       1     Protocol version
+ *   3       1     Payload format (FORMAT_*)
+ *   4       2     Frame id, little-endian
+ *   6       2     Payload length, little-endian
+ *   8       n     Payload
+ *   8+n     4     CRC32 (zlib) of header + payload, little-endian
+ *
+ * Senders write the payload at HEADER_SIZE in a buffer obtained from
+ * createFrameBuffer() and call finishFrame() before writing it out.
+ *
+ * FORMAT_RECTS_RGB565 payload (delta against the frame with id baseId):
+ *   baseId u16 LE, count u8,
+ *   count × { x u8, y u8, w u8, h u8, w*h RGB565 pixels big-endian }
+ *
+ * FORMAT_XOR_RLE_RGB565 payload (run-length coded, optionally XORed with
+ * the frame with id baseId):
+ *   baseId u16 LE, flags u8 (XOR_RLE_DELTA),
+ *   tokens covering every pixel:
+ *     c < 0x80   c + 1 literal RGB565 values (big-endian) follow
+ *     c ≥ 0x80   (c & 0x7f) + 1 repeats of the one value that follows
+ *
+ * createFrameEncoder() picks the smallest of these for each frame.
+ *
+ * FORMAT_WINDOW_RGB565 / FORMAT_WINDOW_RGB888 payload (absolute pixels of
+ * one rectangle, the rest of the image stays as it is):
+ *   x u16 LE, y u16 LE, w u16 LE, h u16 LE, w*h pixels row-major
+ * Used to update one panel of a chained display, or to split a frame that
+ * is too large to send at once.
+ *
+ * An empty FORMAT_QUERY frame asks the device what it accepts; it answers
+ * with a FORMAT_CAPS frame (see parseCapabilities()), which
+ * createFrameReader() picks out of whatever else the device writes.
+ * FORMAT_BAUD and FORMAT_TEST frames move the link to a faster baud rate
+ * and verify it (see writeBaudPayload(), device.js). FORMAT_CREDIT frames
+ * from the device pace the sender (see parseCreditPayload()), FORMAT_TIMING
+ * frames tell when each frame shown arrived and reached the panel (see
+ * parseTimingPayload()).
+ *
+ * FORMAT_PALETTE payload: n × { R, G, B } (1 ≤ n ≤ 256). The device keeps
+ * it for the FORMAT_INDEXEDx frames that follow, whose payload is one
+ * palette index per pixel, 1/2/4/8 bits each, packed MSB first.
+ */
+
+export const SYNC_0 = 0x50 // 'P'
+export const SYNC_1 = 0x58 // 'X'
+export const VERSION = 1
+
+export const HEADER_SIZE = 8
+export const CRC_SIZE = 4
+
+export const FORMAT_RGB565 = 0x01
+export const FORMAT_RGB888 = 0x02
+export const FORMAT_RECTS_RGB565 = 0x03
+export const FORMAT_XOR_RLE_RGB565 = 0x04
+export const FORMAT_PALETTE = 0x05
+export const FORMAT_WINDOW_RGB565 = 0x06
+export const FORMAT_WINDOW_RGB888 = 0x07
+export const FORMAT_INDEXED1 = 0x11
+export const FORMAT_INDEXED2 = 0x12
+export const FORMAT_INDEXED4 = 0x14
+export const FORMAT_INDEXED8 = 0x18
+export const FORMAT_QUERY = 0x20
+export const FORMAT_CAPS = 0x21
+export const FORMAT_BAUD = 0x22
+export const FORMAT_TEST = 0x23
+export const FORMAT_CREDIT = 0x24
+export const FORMAT_TIMING = 0x25
+
+export const RECTS_HEADER_SIZE = 3
+export const XOR_RLE_HEADER_SIZE = 3
+export const XOR_RLE_DELTA = 0x01 // Flag: values are XORed with the base frame
+export const WINDOW_HEADER_SIZE = 8
+export const CAPS_HEADER_SIZE = 17
+export const CAPS_VERSION = 1
+export const BAUD_SIZE = 15
+export const BAUD_REFUSED = 0 // Device: rate not supported
+export const BAUD_SWITCH = 1  // Host: switch now, the device reverts unless committed. Device: switching
+export const BAUD_REPORT = 2  // Host: send the counters. Device: the counters
+export const BAUD_COMMIT = 3  // Host: keep the rate. Device: kept
+export const CREDIT_SIZE = 3
+export const TIMING_SIZE = 18
+const RECTS_TILE = 8 // Dirty pixels are grouped per 8×8 tile
+
+const CRC_TABLE = new Uint32Array(256)
+for (let n = 0; n < 256; n++) {
+	let c = n
+	for (let k = 0; k < 8; k++) c = c & 1 ? 0xedb88320 ^ (c >>> 1) : c >>> 1
+	CRC_TABLE[n] = c >>> 0
+}
+
+/**
+ * CRC32 (IEEE 802.3 / zlib) of bytes[start, end).
+ * @param {Uint8Array} bytes
+ * @param {number} start
+ * @param {number} end
+ * @returns {number} unsigned 32-bit checksum
+ */
+export function crc32(bytes, start = 0, end = bytes.length) {
+	let crc = 0xffffffff
+	for (let i = start; i < end; i++) {
+		crc = CRC_TABLE[(crc ^ bytes[i]) & 0xff] ^ (crc >>> 8)
+	}
+	return (crc ^ 0xffffffff) >>> 0
+}
+
+/**
+ * Allocate a buffer large enough for a frame with the given payload size.
+ * @param {number} maxPayload — payload capacity in bytes
+ * @returns {Uint8Array}
+ */
+export function createFrameBuffer(maxPayload) {
+	return new Uint8Array(HEADER_SIZE + maxPayload + CRC_SIZE)
+}
+
+let nextFrameId = 0
+let lastFrameId = -1
+
+/**
+ * @returns {number} id given to the most recent frame by finishFrame(), or -1
+ */
+export function getLastFrameId() {
+	return lastFrameId
+}
+
+/**
+ * @returns {number} id finishFrame() gives the next frame
+ */
+export function getNextFrameId() {
+	return nextFrameId
+}
+
+/**
+ * Fill in header and CRC around a payload already written at HEADER_SIZE.
+ * @param {Uint8Array} buffer — from createFrameBuffer()
+ * @param {number} format     — one of FORMAT_*
+ * @param {number} length     — payload length in bytes
+ * @returns {Uint8Array} view of the bytes to send
+ */
+export function finishFrame(buffer, format, length) {
+	const id = nextFrameId
+	nextFrameId = (nextFrameId + 1) & 0xffff
+	lastFrameId = id
+
+	buffer[0] = SYNC_0
+	buffer[1] = SYNC_1
+	buffer[2] = VERSION
+	buffer[3] = format
+	buffer[4] = id & 0xff
+	buffer[5] = id >> 8
+	buffer[6] = length & 0xff
+	buffer[7] = length >> 8
+
+	const end = HEADER_SIZE + length
+	const crc = crc32(buffer, 0, end)
+	buffer[end]     = crc & 0xff
+	buffer[end + 1] = (crc >>> 8) & 0xff
+	buffer[end + 2] = (crc >>> 16) & 0xff
+	buffer[end + 3] = crc >>> 24
+
+	return buffer.subarray(0, end + CRC_SIZE)
+}
+
+/**
+ * Incremental parser for frames sent back by the device. They share the
+ * serial line with its text output (the "# rx ..." stats lines), so
+ * everything that is not part of a CRC-valid frame is skipped.
+ *
+ *   const reader = createFrameReader()
+ *   for (const frame of reader.push(bytes)) handle(frame.format, frame.payload)
+ *
+ * @param {number} maxPayload — larger length fields are taken for noise
+ * @returns {{push: function(Uint8Array): {format: number, id: number, payload: Uint8Array}[]}}
+ */
+export function createFrameReader(maxPayload = 1024) {
+	const buffer = new Uint8Array(HEADER_SIZE + maxPayload + CRC_SIZE)
+	let fill = 0
+
+	return {
+		push(bytes) {
+			const frames = []
+			for (let i = 0; i < bytes.length;) {
+				const n = Math.min(bytes.length - i, buffer.length - fill)
+				buffer.set(bytes.subarray(i, i + n), fill)
+				fill += n
+				i += n
+
+				let start = 0
+				for (;;) {
+					while (start < fill && buffer[start] !== SYNC_0) start++
+					if (fill - start < HEADER_SIZE) break
+					const length = buffer[start + 6] | (buffer[start + 7] << 8)
+					if (buffer[start + 1] !== SYNC_1 || buffer[start + 2] !== VERSION || length > maxPayload) {
+						start++
+						continue
+					}
+					const end = start + HEADER_SIZE + length
+					if (fill < end + CRC_SIZE) break
+					const crc = (buffer[end] | (buffer[end + 1] << 8) | (buffer[end + 2] << 16) | (buffer[end + 3] << 24)) >>> 0
+					if (crc !== crc32(buffer, start, end)) {
+						start++
+						continue
+					}
+					frames.push({
+						format: buffer[start + 3],
+						id: buffer[start + 4] | (buffer[start + 5] << 8),
+						payload: buffer.slice(start + HEADER_SIZE, end),
+					})
+					start = end + CRC_SIZE
+				}
+				buffer.copyWithin(0, start, fill)
+				fill -= start
+			}
+			return frames
+		},
+	}
+}
+
+/**
+ * Decode a FORMAT_CAPS payload:
+ *   version u8, width u16 LE, height u16 LE, maxPayload u16 LE,
+ *   frameSlots u8, baud u32 LE, maxBaud u32 LE (both 0 off a serial link),
+ *   n u8, n accepted FORMAT_* values
+ *
+ * @param {Uint8Array} payload
+ * @returns {{width: number, height: number, maxPayload: number, frameSlots: number,
+ *            baud: number, maxBaud: number, formats: Set<number>}|null} null if malformed
+ */
+export function parseCapabilities(payload) {
+	if (payload.length < CAPS_HEADER_SIZE || payload[0] !== CAPS_VERSION) return null
+	const count = payload[16]
+	if (payload.length < CAPS_HEADER_SIZE + count) return null
+
+	const u16 = (i) => payload[i] | (payload[i + 1] << 8)
+	const u32 = (i) => (u16(i) | (u16(i + 2) << 16)) >>> 0
+	return {
+		width: u16(1),
+		height: u16(3),
+		maxPayload: u16(5),
+		frameSlots: payload[7],
+		baud: u32(8),
+		maxBaud: u32(12),
+		formats: new Set(payload.subarray(CAPS_HEADER_SIZE, CAPS_HEADER_SIZE + count)),
+	}
+}
+
+/**
+ * Write a FORMAT_BAUD payload at HEADER_SIZE:
+ *   baud u32 LE, command u8 (BAUD_*), then counters filled in by the
+ *   device: test frames u16, errors u16, overruns u16, elapsedUs u32
+ * @param {Uint8Array} buffer — from createFrameBuffer(BAUD_SIZE)
+ * @param {number} baud
+ * @param {number} command    — BAUD_SWITCH, BAUD_REPORT or BAUD_COMMIT
+ * @returns {number} payload length
+ */
+export function writeBaudPayload(buffer, baud, command) {
+	buffer.fill(0, HEADER_SIZE, HEADER_SIZE + BAUD_SIZE)
+	new DataView(buffer.buffer, buffer.byteOffset).setUint32(HEADER_SIZE, baud, true)
+	buffer[HEADER_SIZE + 4] = command
+	return BAUD_SIZE
+}
+
+/**
+ * Decode a FORMAT_BAUD payload sent by the device.
+ * @param {Uint8Array} payload
+ * @returns {{baud: number, command: number, testFrames: number, errors: number, overruns: number, elapsedUs: number}|null}
+ */
+export function parseBaudPayload(payload) {
+	if (payload.length < BAUD_SIZE) return null
+	const view = new DataView(payload.buffer, payload.byteOffset, payload.length)
+	return {
+		baud: view.getUint32(0, true),
+		command: payload[4],
+		testFrames: view.getUint16(5, true),
+		errors: view.getUint16(7, true),
+		overruns: view.getUint16(9, true),
+		elapsedUs: view.getUint32(11, true),
+	}
+}
+
+/**
+ * Write the FORMAT_TEST payload the device expects for frame `id`
+ * (testPatternByte() in frame_protocol.h).
+ * @param {Uint8Array} buffer — from createFrameBuffer(length)
+ * @param {number} id         — getNextFrameId()
+ * @param {number} length
+ * @returns {number} payload length
+ */
+export function writeTestPayload(buffer, id, length) {
+	for (let i = 0; i < length; i++) {
+		buffer[HEADER_SIZE + i] = (i * 7 + (i >> 8) + id * 13) & 0xff
+	}
+	return length
+}
+
+/**
+ * Decode a FORMAT_CREDIT payload: lastId u16 LE, free u8. The device
+ * has room for `free` more frames after the frame with id lastId.
+ * @param {Uint8Array} payload
+ * @returns {{lastId: number, free: number}|null}
+ */
+export function parseCreditPayload(payload) {
+	if (payload.length < CREDIT_SIZE) return null
+	return { lastId: payload[0] | (payload[1] << 8), free: payload[2] }
+}
+
+/**
+ * Decode a FORMAT_TIMING payload: frameId u16 LE, then the device's
+ * micros() (u32 LE each) when the frame's first and last byte arrived,
+ * when it was decoded and when the swap that showed it was done.
+ * @param {Uint8Array} payload
+ * @returns {{frameId: number, firstByteUs: number, lastByteUs: number, decodedUs: number, swappedUs: number}|null}
+ */
+export function parseTimingPayload(payload) {
+	if (payload.length < TIMING_SIZE) return null
+	const view = new DataView(payload.buffer, payload.byteOffset, payload.length)
+	return {
+		frameId: view.getUint16(0, true),
+		firstByteUs: view.getUint32(2, true),
+		lastByteUs: view.getUint32(6, true),
+		decodedUs: view.getUint32(10, true),
+		swappedUs: view.getUint32(14, true),
+	}
+}
+
+/**
+ * Write a FORMAT_RECTS_RGB565 payload at HEADER_SIZE describing how
+ * `current` differs from `previous` (the frame with id baseId). Each 8×8
+ * tile containing changes contributes the bounding box of its changes.
+ *
+ * @param {Uint8Array} buffer    — from createFrameBuffer()
+ * @param {Uint16Array} current  — RGB565 pixels, row-major
+ * @param {Uint16Array} previous — RGB565 pixels the device currently shows
+ * @param {number} width
+ * @param {number} height
+ * @param {number} baseId        — frame id of `previous`
+ * @param {number} maxLength     — give up once the payload would reach this size
+ * @returns {number} payload length, or -1 if a full frame is cheaper
+ */
+export function writeRectsPayload(buffer, current, previous, width, height, baseId, maxLength) {
+	let pos = HEADER_SIZE + RECTS_HEADER_SIZE
+	let count = 0
+
+	for (let ty = 0; ty < height; ty += RECTS_TILE) {
+		for (let tx = 0; tx < width; tx += RECTS_TILE) {
+			// Bounding box of the changed pixels inside this tile
+			let x0 = width, y0 = height, x1 = -1, y1 = -1
+			const yEnd = Math.min(ty + RECTS_TILE, height)
+			const xEnd = Math.min(tx + RECTS_TILE, width)
+			for (let y = ty; y < yEnd; y++) {
+				for (let x = tx; x < xEnd; x++) {
+					const i = y * width + x
+					if (current[i] !== previous[i]) {
+						if (x < x0) x0 = x
+						if (x > x1) x1 = x
+						if (y < y0) y0 = y
+						if (y > y1) y1 = y
+					}
+				}
+			}
+			if (x1 < 0) continue
+
+			const w = x1 - x0 + 1
+			const h = y1 - y0 + 1
+			if (count === 255 || pos + 4 + w * h * 2 - HEADER_SIZE >= maxLength) return -1
+
+			buffer[pos++] = x0
+			buffer[pos++] = y0
+			buffer[pos++] = w
+			buffer[pos++] = h
+			for (let y = y0; y <= y1; y++) {
+				for (let x = x0; x <= x1; x++) {
+					const rgb16 = current[y * width + x]
+					buffer[pos++] = rgb16 >> 8
+					buffer[pos++] = rgb16 & 0xff
+				}
+			}
+			count++
+		}
+	}
+
+	buffer[HEADER_SIZE]     = baseId & 0xff
+	buffer[HEADER_SIZE + 1] = baseId >> 8
+	buffer[HEADER_SIZE + 2] = count
+	return pos - HEADER_SIZE
+}
+
+/**
+ * Write a FORMAT_XOR_RLE_RGB565 payload at HEADER_SIZE. With `previous`
+ * the values coded are current ^ previous, so unchanged areas become runs
+ * of zeros; without it the frame is coded on its own (a keyframe).
+ *
+ * @param {Uint8Array} buffer         — from createFrameBuffer()
+ * @param {Uint16Array} current       — RGB565 pixels, row-major
+ * @param {Uint16Array|null} previous — RGB565 pixels the device currently shows
+ * @param {number} baseId             — frame id of `previous`
+ * @param {number} maxLength          — give up once the payload would reach this size
+ * @returns {number} payload length, or -1 if a full frame is cheaper
+ */
+export function writeXorRlePayload(buffer, current, previous, baseId, maxLength) {
+	const n = current.length
+	let values = current
+	if (previous) {
+		if (!xorScratch || xorScratch.length !== n) xorScratch = new Uint16Array(n)
+		for (let i = 0; i < n; i++) xorScratch[i] = current[i] ^ previous[i]
+		values = xorScratch
+	}
+
+	const end = HEADER_SIZE + maxLength
+	let pos = HEADER_SIZE + XOR_RLE_HEADER_SIZE
+	let i = 0
+	while (i < n) {
+		let run = 1
+		while (i + run < n && run < 128 && values[i + run] === values[i]) run++
+
+		if (run >= 2) {
+			if (pos + 3 >= end) return -1
+			buffer[pos++] = 0x80 | (run - 1)
+			buffer[pos++] = values[i] >> 8
+			buffer[pos++] = values[i] & 0xff
+			i += run
+			continue
+		}
+
+		// Literals up to the start of the next run
+		let count = 1
+		while (i + count < n && count < 128 &&
+			!(i + count + 1 < n && values[i + count] === values[i + count + 1])) count++
+
+		if (pos + 1 + count * 2 >= end) return -1
+		buffer[pos++] = count - 1
+		for (let k = i; k < i + count; k++) {
+			buffer[pos++] = values[k] >> 8
+			buffer[pos++] = values[k] & 0xff
+		}
+		i += count
+	}
+
+	buffer[HEADER_SIZE]     = baseId & 0xff
+	buffer[HEADER_SIZE + 1] = (baseId >> 8) & 0xff
+	buffer[HEADER_SIZE + 2] = previous ? XOR_RLE_DELTA : 0
+	return pos - HEADER_SIZE
+}
+
+let xorScratch = null
+
+/**
+ * Write a FORMAT_WINDOW_RGB565 payload at HEADER_SIZE holding the
+ * rectangle (x, y, w, h) of `pixels`.
+ * @param {Uint8Array} buffer  — from createFrameBuffer(WINDOW_HEADER_SIZE + w * h * 2)
+ * @param {Uint16Array} pixels — RGB565 pixels of the whole image, row-major
+ * @param {number} width       — image width
+ * @param {number} x
+ * @param {number} y
+ * @param {number} w
+ * @param {number} h
+ * @returns {number} payload length
+ */
+export function writeWindowPayload(buffer, pixels, width, x, y, w, h) {
+	let pos = HEADER_SIZE
+	for (const v of [x, y, w, h]) {
+		buffer[pos++] = v & 0xff
+		buffer[pos++] = v >> 8
+	}
+	for (let row = y; row < y + h; row++) {
+		for (let col = x; col < x + w; col++) {
+			const rgb16 = pixels[row * width + col]
+			buffer[pos++] = rgb16 >> 8
+			buffer[pos++] = rgb16 & 0xff
+		}
+	}
+	return pos - HEADER_SIZE
+}
+
+/**
+ * Write a FORMAT_PALETTE payload at HEADER_SIZE.
+ * @param {Uint8Array} buffer      — from createFrameBuffer()
+ * @param {number[][]} colors      — up to 256 [r, g, b] entries
+ * @returns {number} payload length
+ */
+export function writePalettePayload(buffer, colors) {
+	let pos = HEADER_SIZE
+	for (const [r, g, b] of colors) {
+		buffer[pos++] = r
+		buffer[pos++] = g
+		buffer[pos++] = b
+	}
+	return pos - HEADER_SIZE
+}
+
+/**
+ * Write palette indices packed at `bpp` bits per pixel at HEADER_SIZE.
+ * @param {Uint8Array} buffer  — from createFrameBuffer()
+ * @param {ArrayLike<number>} indices — one palette index per pixel
+ * @param {number} bpp         — 1, 2, 4 or 8
+ * @returns {number} payload length; send it with indexedFormat(bpp)
+ */
+export function writeIndexedPayload(buffer, indices, bpp) {
+	const perByte = 8 / bpp
+	const mask = (1 << bpp) - 1
+	let pos = HEADER_SIZE
+	for (let i = 0; i < indices.length; i += perByte) {
+		let byte = 0
+		for (let k = 0; k < perByte; k++) {
+			byte = (byte << bpp) | ((indices[i + k] ?? 0) & mask)
+		}
+		buffer[pos++] = byte
+	}
+	return pos - HEADER_SIZE
+}
+
+/**
+ * @param {number} bpp — 1, 2, 4 or 8
+ * @returns {number} the FORMAT_INDEXEDx for that depth
+ */
+export function indexedFormat(bpp) {
+	return 0x10 | bpp
+}
+
+/**
+ * Encoder for a stream of RGB565 frames that sends each one in the
+ * smallest format the device accepts and remembers what the device shows
+ * so the next frame can be sent as a delta.
+ *
+ *   const encoder = createFrameEncoder(32, 32, { xorRle: true })
+ *   encoder.pixels[i] = rgb16                 // fill the next frame
+ *   const frame = encoder.encode(buffer)      // buffer from createFrameBuffer(32 * 32 * 2)
+ *   await writer.write(frame)
+ *   encoder.commit()                          // or encoder.reset() if the write failed
+ *
+ * Without `previous` on the device side (a lost frame) deltas are
+ * rejected, so a keyframe is forced every `keyframeInterval` frames.
+ *
+ * @param {number} width
+ * @param {number} height
+ * @param {{rects?: boolean, xorRle?: boolean, keyframeInterval?: number}} options
+ *   rects  — allow FORMAT_RECTS_RGB565 deltas
+ *   xorRle — allow FORMAT_XOR_RLE_RGB565 frames
+ */
+export function createFrameEncoder(width, height, { rects = false, xorRle = false, keyframeInterval = 60 } = {}) {
+	const fullLength = width * height * 2
+	let previous = null
+	let previousId = -1
+	let framesSinceKeyframe = 0
+	let sentKeyframe = false
+
+	return {
+		/** RGB565 pixels of the next frame, row-major */
+		pixels: new Uint16Array(width * height),
+
+		/**
+		 * Encode `pixels` into buffer.
+		 * @param {Uint8Array} buffer — from createFrameBuffer(width * height * 2)
+		 * @returns {Uint8Array} view of the bytes to send
+		 */
+		encode(buffer) {
+			const current = this.pixels
+			const base = framesSinceKeyframe < keyframeInterval ? previous : null
+			let format = FORMAT_RGB565
+			let length = fullLength
+
+			if (base && rects) {
+				const n = writeRectsPayload(buffer, current, base, width, height, previousId, length)
+				if (n >= 0) {
+					format = FORMAT_RECTS_RGB565
+					length = n
+				}
+			}
+			if (xorRle) {
+				// Overwrites the rectangles; they are rewritten if this loses
+				const n = writeXorRlePayload(buffer, current, base, previousId, length)
+				if (n >= 0) {
+					format = FORMAT_XOR_RLE_RGB565
+					length = n
+				} else if (format === FORMAT_RECTS_RGB565) {
+					writeRectsPayload(buffer, current, base, width, height, previousId, fullLength)
+				}
+			}
+			if (format === FORMAT_RGB565) {
+				let idx = HEADER_SIZE
+				for (let i = 0; i < current.length; i++) {
+					buffer[idx++] = current[i] >> 8
+					buffer[idx++] = current[i] & 0xff
+				}
+			}
+
+			sentKeyframe = format === FORMAT_RGB565 || (format === FORMAT_XOR_RLE_RGB565 && !base)
+			return finishFrame(buffer, format, length)
+		},
+
+		/** The last encoded frame reached the device: base the next delta on it */
+		commit() {
+			if (!previous) previous = new Uint16Array(this.pixels.length)
+			previous.set(this.pixels)
+			previousId = getLastFrameId()
+			framesSinceKeyframe = sentKeyframe ? 0 : framesSinceKeyframe + 1
+		},
+
+		/** The last frame may not have arrived: send a keyframe next */
+		reset() {
+			previous = null
+		},
+	}
+}
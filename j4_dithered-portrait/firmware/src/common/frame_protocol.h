@@ -0,0 +1,457 @@
+/**
+ * Binary framing for pixel data streamed to the controller.
+ *
+ * Every frame is self-delimiting and checksummed, so a byte lost or
+ * corrupted on the wire costs at most the frame it belongs to:
+ *
+ *   Offset  Size  Field
+ *   0       2     Sync word 'P' 'X' (0x50 0x58)
+ *   2       1     Protocol version (FRAME_VERSION)
+ *   3       1     Payload format (FRAME_FORMAT_*)
+ *   4       2     Frame id, little-endian, incremented by the sender
+ *   6       2     Payload length in bytes, little-endian
+ *   8       n     Payload
+ *   8+n     4     CRC32 (IEEE 802.3, same as zlib) of bytes 0..8+n-1,
+ *                 little-endian
+ *
+ * Pixel payloads keep the byte order the senders always used:
+ * RGB565 is big-endian (RRRRRGGG GGGBBBBB), RGB888 is R, G, B.
+ *
+ * The file has no Arduino dependencies so it can be compiled on the host.
+ */
+
+#ifndef FRAME_PROTOCOL_H
+#define FRAME_PROTOCOL_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define FRAME_SYNC_0 0x50 // 'P'
+#define FRAME_SYNC_1 0x58 // 'X'
+#define FRAME_VERSION 1
+
+#define FRAME_HEADER_SIZE 8
+#define FRAME_CRC_SIZE 4
+#define FRAME_RESTART_IDS 64 // A frame id this far behind the last one means the sender restarted
+
+// Payload formats
+#define FRAME_FORMAT_RGB565 0x01 // 2 bytes per pixel, big-endian
+#define FRAME_FORMAT_RGB888 0x02 // 3 bytes per pixel
+#define FRAME_FORMAT_RECTS_RGB565 0x03 // Changed rectangles only, see frame_decode.h
+#define FRAME_FORMAT_XOR_RLE_RGB565 0x04 // Run-length coded (XOR delta), see frame_decode.h
+#define FRAME_FORMAT_PALETTE 0x05 // Up to 256 RGB888 entries for the indexed formats
+#define FRAME_FORMAT_WINDOW_RGB565 0x06 // One rectangle of absolute pixels, see frame_decode.h
+#define FRAME_FORMAT_WINDOW_RGB888 0x07
+#define FRAME_FORMAT_INDEXED1 0x11 // Palette indices, 1 bit per pixel, MSB first
+#define FRAME_FORMAT_INDEXED2 0x12 // 2 bits per pixel
+#define FRAME_FORMAT_INDEXED4 0x14 // 4 bits per pixel
+#define FRAME_FORMAT_INDEXED8 0x18 // 1 byte per pixel
+#define FRAME_FORMAT_QUERY 0x20 // Host → device, empty: asks for FRAME_FORMAT_CAPS
+#define FRAME_FORMAT_CAPS 0x21 // Device → host, see DeviceCaps
+#define FRAME_FORMAT_BAUD 0x22 // Baud rate switch, both ways, see BaudMessage
+#define FRAME_FORMAT_TEST 0x23 // Test pattern that verifies a new baud rate, see testPatternByte()
+#define FRAME_FORMAT_CREDIT 0x24 // Device → host: frames it can take, see CreditMessage
+#define FRAME_FORMAT_TIMING 0x25 // Device → host: when a shown frame arrived and was shown, see FrameTiming
+
+#define FRAME_RECTS_HEADER_SIZE 3 // baseId u16, rectangle count u8
+#define FRAME_XOR_RLE_HEADER_SIZE 3 // baseId u16, flags u8
+#define FRAME_XOR_RLE_DELTA 0x01 // Flag: pixels are XORed with frame baseId
+#define FRAME_WINDOW_HEADER_SIZE 8 // x, y, w, h, each u16
+#define FRAME_CAPS_HEADER_SIZE 17 // Capabilities without the format list
+#define FRAME_CAPS_VERSION 1
+#define FRAME_BAUD_SIZE 15
+#define FRAME_CREDIT_SIZE 3
+#define FRAME_TIMING_SIZE 18
+
+// BaudMessage commands (host) and answers (device)
+#define FRAME_BAUD_REFUSED 0 // Device: rate not supported, nothing changes
+#define FRAME_BAUD_SWITCH 1  // Host: switch now, revert unless committed in time. Device: switching
+#define FRAME_BAUD_REPORT 2  // Host: how did the test frames arrive? Device: the counters
+#define FRAME_BAUD_COMMIT 3  // Host: keep the rate. Device: kept
+
+// Bits per pixel of an indexed format, 0 for any other format
+inline uint8_t frameIndexedBpp(uint8_t format) {
+	switch (format) {
+		case FRAME_FORMAT_INDEXED1: return 1;
+		case FRAME_FORMAT_INDEXED2: return 2;
+		case FRAME_FORMAT_INDEXED4: return 4;
+		case FRAME_FORMAT_INDEXED8: return 8;
+		default: return 0;
+	}
+}
+
+struct FrameHeader {
+	uint8_t  version;
+	uint8_t  format;
+	uint16_t id;
+	uint16_t length;
+};
+
+// CRC32 (reflected, polynomial 0xEDB88320) with a 16 entry table:
+// small enough to live in DRAM, fast enough for a few KB per frame.
+inline uint32_t crc32Update(uint32_t crc, const uint8_t *data, size_t len) {
+	static const uint32_t table[16] = {
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+		0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+		0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C,
+	};
+	crc = ~crc;
+	for (size_t i = 0; i < len; i++) {
+		crc ^= data[i];
+		crc = (crc >> 4) ^ table[crc & 0x0F];
+		crc = (crc >> 4) ^ table[crc & 0x0F];
+	}
+	return ~crc;
+}
+
+inline uint32_t crc32(const uint8_t *data, size_t len) {
+	return crc32Update(0, data, len);
+}
+
+inline uint16_t readLE16(const uint8_t *p) {
+	return (uint16_t)p[0] | ((uint16_t)p[1] << 8);
+}
+
+inline uint32_t readLE32(const uint8_t *p) {
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+inline void writeLE16(uint8_t *p, uint16_t v) {
+	p[0] = v & 0xFF;
+	p[1] = v >> 8;
+}
+
+inline void writeLE32(uint8_t *p, uint32_t v) {
+	p[0] = v & 0xFF;
+	p[1] = (v >> 8) & 0xFF;
+	p[2] = (v >> 16) & 0xFF;
+	p[3] = v >> 24;
+}
+
+/**
+ * Writes header and CRC around a payload that has already been placed at
+ * out + FRAME_HEADER_SIZE. Returns the total number of bytes to send.
+ */
+inline size_t encodeFrame(uint8_t *out, uint8_t format, uint16_t id, uint16_t length) {
+	out[0] = FRAME_SYNC_0;
+	out[1] = FRAME_SYNC_1;
+	out[2] = FRAME_VERSION;
+	out[3] = format;
+	writeLE16(&out[4], id);
+	writeLE16(&out[6], length);
+	size_t end = FRAME_HEADER_SIZE + length;
+	writeLE32(&out[end], crc32(out, end));
+	return end + FRAME_CRC_SIZE;
+}
+
+/**
+ * What a device accepts, sent back as the FRAME_FORMAT_CAPS payload:
+ *
+ *   Offset  Size  Field
+ *   0       1     Layout version (FRAME_CAPS_VERSION)
+ *   1       2     Width in pixels, little-endian
+ *   3       2     Height in pixels, little-endian
+ *   5       2     Largest payload accepted, little-endian
+ *   7       1     Frame buffers, i.e. frames that can be in flight
+ *   8       4     Current baud rate, little-endian (0: not a serial link)
+ *   12      4     Highest baud rate supported, little-endian
+ *   16      1     n, number of formats
+ *   17      n     Accepted FRAME_FORMAT_* values
+ *
+ * Senders pick the smallest encoding from the list and size their frames
+ * to the device instead of relying on compile-time constants matching.
+ */
+struct DeviceCaps {
+	uint16_t       width;
+	uint16_t       height;
+	uint16_t       maxPayload;
+	uint8_t        frameSlots;
+	uint32_t       baud;
+	uint32_t       maxBaud;
+	const uint8_t *formats;
+	uint8_t        formatCount;
+};
+
+// Writes the FRAME_FORMAT_CAPS payload, returns its length
+inline size_t writeCaps(uint8_t *payload, const DeviceCaps &caps) {
+	payload[0] = FRAME_CAPS_VERSION;
+	writeLE16(&payload[1], caps.width);
+	writeLE16(&payload[3], caps.height);
+	writeLE16(&payload[5], caps.maxPayload);
+	payload[7] = caps.frameSlots;
+	writeLE32(&payload[8], caps.baud);
+	writeLE32(&payload[12], caps.maxBaud);
+	payload[16] = caps.formatCount;
+	memcpy(&payload[FRAME_CAPS_HEADER_SIZE], caps.formats, caps.formatCount);
+	return FRAME_CAPS_HEADER_SIZE + caps.formatCount;
+}
+
+/**
+ * FRAME_FORMAT_BAUD payload, the same layout in both directions:
+ *
+ *   Offset  Size  Field
+ *   0       4     Baud rate, little-endian
+ *   4       1     FRAME_BAUD_* command or answer
+ *   5       2     Test frames received intact since the switch, little-endian
+ *   7       2     Frames lost to CRC or header errors since the switch
+ *   9       2     UART overruns and line errors since the switch
+ *   11      4     µs from the first to the last intact test frame
+ *
+ * The counters are only filled in by the device (FRAME_BAUD_REPORT).
+ *
+ * A switch goes: the host asks for a rate (SWITCH); the device answers at
+ * the old rate, then both move. The host sends FRAME_FORMAT_TEST frames,
+ * asks for the counters (REPORT) and, if they are good enough, commits.
+ * Without a commit the device goes back to the old rate after a timeout,
+ * so a rate that does not work in either direction undoes itself.
+ */
+struct BaudMessage {
+	uint32_t baud;
+	uint8_t  command;
+	uint16_t testFrames;
+	uint16_t errors;
+	uint16_t overruns;
+	uint32_t elapsedUs;
+};
+
+inline void writeBaudMessage(uint8_t *p, const BaudMessage &m) {
+	writeLE32(&p[0], m.baud);
+	p[4] = m.command;
+	writeLE16(&p[5], m.testFrames);
+	writeLE16(&p[7], m.errors);
+	writeLE16(&p[9], m.overruns);
+	writeLE32(&p[11], m.elapsedUs);
+}
+
+inline bool parseBaudMessage(const uint8_t *p, size_t len, BaudMessage &m) {
+	if (len < FRAME_BAUD_SIZE) return false;
+	m.baud       = readLE32(&p[0]);
+	m.command    = p[4];
+	m.testFrames = readLE16(&p[5]);
+	m.errors     = readLE16(&p[7]);
+	m.overruns   = readLE16(&p[9]);
+	m.elapsedUs  = readLE32(&p[11]);
+	return true;
+}
+
+// Byte i of the FRAME_FORMAT_TEST payload of frame id. Changes with both
+// so a slipped or repeated byte does not match by chance.
+inline uint8_t testPatternByte(uint16_t id, size_t i) {
+	return (uint8_t)(i * 7 + (i >> 8) + id * 13);
+}
+
+/**
+ * FRAME_FORMAT_CREDIT payload, credit-based flow control:
+ *
+ *   Offset  Size  Field
+ *   0       2     Id of the last frame received, little-endian
+ *   2       1     Frames the device can take after that one without dropping
+ *
+ * A sender that has seen a credit sends only while fewer of its frames
+ * came after lastId than the device has room for; otherwise it keeps
+ * just its newest frame until the next credit. The device sends a credit
+ * whenever it has finished with frames and repeats the last one every so
+ * often, so a lost credit only delays the sender. Credits name a frame id
+ * instead of counting frames, so sender and device cannot drift apart.
+ */
+struct CreditMessage {
+	uint16_t lastId;
+	uint8_t  free;
+};
+
+inline void writeCreditMessage(uint8_t *p, const CreditMessage &m) {
+	writeLE16(&p[0], m.lastId);
+	p[2] = m.free;
+}
+
+/**
+ * FRAME_FORMAT_TIMING payload, sent for every frame that was shown:
+ *
+ *   Offset  Size  Field
+ *   0       2     Frame id, little-endian
+ *   2       4     First byte (or datagram) of the frame received
+ *   6       4     Last byte received, frame complete
+ *   10      4     Decoded into the back buffer
+ *   14      4     Swap done, the frame is on the panel
+ *
+ * Times are the device's micros(), little-endian. Only their differences
+ * mean anything to the host: wire time, time waiting for the render task
+ * and decoding, and the swap. The host adds its own side (capture to
+ * write) and the echo's arrival, which covers the rest.
+ */
+struct FrameTiming {
+	uint16_t frameId;
+	uint32_t firstByteUs;
+	uint32_t lastByteUs;
+	uint32_t decodedUs;
+	uint32_t swappedUs;
+};
+
+inline void writeFrameTiming(uint8_t *p, const FrameTiming &t) {
+	writeLE16(&p[0], t.frameId);
+	writeLE32(&p[2], t.firstByteUs);
+	writeLE32(&p[6], t.lastByteUs);
+	writeLE32(&p[10], t.decodedUs);
+	writeLE32(&p[14], t.swappedUs);
+}
+
+/**
+ * Validates a complete frame held in one buffer (e.g. reassembled from
+ * UDP chunks): sync word, version, length and CRC. len must be the exact
+ * frame size. Fills header on success.
+ */
+inline bool parseFrame(const uint8_t *buf, size_t len, size_t maxPayload, FrameHeader &header) {
+	if (len < FRAME_HEADER_SIZE + FRAME_CRC_SIZE) return false;
+	if (buf[0] != FRAME_SYNC_0 || buf[1] != FRAME_SYNC_1 || buf[2] != FRAME_VERSION) return false;
+	header.version = buf[2];
+	header.format  = buf[3];
+	header.id      = readLE16(&buf[4]);
+	header.length  = readLE16(&buf[6]);
+	if (header.length > maxPayload || len != (size_t)FRAME_HEADER_SIZE + header.length + FRAME_CRC_SIZE) return false;
+	size_t end = FRAME_HEADER_SIZE + header.length;
+	return crc32(buf, end) == readLE32(&buf[end]);
+}
+
+/**
+ * Incremental, resynchronising frame parser.
+ *
+ * Bytes are fed in arbitrary slices (a single byte or a whole UART FIFO);
+ * feed() stops right after a complete, CRC-valid frame so the caller can
+ * consume it before handing over the rest. On a bad header or CRC the
+ * parser drops only the first buffered byte and rescans what it already
+ * holds for the next sync word, so a damaged frame never takes the frame
+ * behind it down too.
+ *
+ * MAX_PAYLOAD bounds the accepted length field; larger lengths are treated
+ * as corruption.
+ *
+ * framesLost counts the ids skipped between good frames. A sender that
+ * restarts counts from 0 again: an id more than FRAME_RESTART_IDS behind
+ * the last one starts a new sequence instead of counting as a gap, and
+ * repeated or slightly older ids count nothing.
+ */
+template <size_t MAX_PAYLOAD>
+class FrameParser {
+public:
+	// Statistics, never reset by the parser
+	uint32_t framesOk = 0;
+	uint32_t framesLost = 0;     // Gaps in the frame id sequence
+	uint32_t headerErrors = 0;
+	uint32_t crcErrors = 0;
+	uint32_t bytesDiscarded = 0;
+	uint32_t senderRestarts = 0; // Frame id sequences started over
+
+	/**
+	 * Consumes up to len bytes and returns how many were used.
+	 * When available() turns true the remaining bytes must be fed again
+	 * after release(), once available() is false again.
+	 */
+	size_t feed(const uint8_t *data, size_t len) {
+		size_t used = 0;
+		while (used < len && !_ready) {
+			if (_fill == 0) {
+				// Hunt for the first sync byte without copying
+				const uint8_t *sync = (const uint8_t *)memchr(data + used, FRAME_SYNC_0, len - used);
+				if (sync == NULL) {
+					bytesDiscarded += len - used;
+					return len;
+				}
+				bytesDiscarded += sync - (data + used);
+				used = sync - data;
+			}
+
+			size_t need = (_fill < FRAME_HEADER_SIZE ? FRAME_HEADER_SIZE : frameSize()) - _fill;
+			size_t n = len - used < need ? len - used : need;
+			memcpy(&_buf[_fill], data + used, n);
+			_fill += n;
+			used += n;
+			check();
+		}
+		return used;
+	}
+
+	bool available() const { return _ready; }
+	bool idle() const { return _fill == 0; } // No partial frame buffered
+	const FrameHeader &header() const { return _header; }
+	const uint8_t *payload() const { return &_buf[FRAME_HEADER_SIZE]; }
+
+	// Drops the current frame. Bytes buffered behind it (frames a resync
+	// found after a bad length field) are kept and checked again, so
+	// available() may be true straight away.
+	void release() {
+		size_t size = frameSize();
+		_ready = false;
+		_headerValid = false;
+		_fill -= size;
+		memmove(_buf, &_buf[size], _fill);
+		check();
+	}
+
+private:
+	uint8_t _buf[FRAME_HEADER_SIZE + MAX_PAYLOAD + FRAME_CRC_SIZE];
+	size_t _fill = 0;
+	bool _ready = false;
+	bool _headerValid = false;
+	FrameHeader _header;
+	uint16_t _lastId = 0;
+	bool _haveLastId = false;
+
+	size_t frameSize() const { return FRAME_HEADER_SIZE + _header.length + FRAME_CRC_SIZE; }
+
+	// Validates whatever is buffered; loops because a resync can leave
+	// a complete header or frame in the buffer.
+	void check() {
+		while (!_ready && _fill >= FRAME_HEADER_SIZE) {
+			if (!_headerValid && !parseHeader()) {
+				headerErrors++;
+				resync();
+				continue;
+			}
+			if (_fill < frameSize()) return;
+
+			size_t end = FRAME_HEADER_SIZE + _header.length;
+			if (crc32(_buf, end) != readLE32(&_buf[end])) {
+				crcErrors++;
+				resync();
+				continue;
+			}
+
+			if (_haveLastId) {
+				int16_t step = (int16_t)(uint16_t)(_header.id - _lastId);
+				if (step > 0) framesLost += step - 1;
+				else if (step < -FRAME_RESTART_IDS) senderRestarts++;
+			}
+			_lastId = _header.id;
+			_haveLastId = true;
+			framesOk++;
+			_ready = true;
+		}
+	}
+
+	bool parseHeader() {
+		if (_buf[0] != FRAME_SYNC_0 || _buf[1] != FRAME_SYNC_1) return false;
+		if (_buf[2] != FRAME_VERSION) return false;
+		_header.version = _buf[2];
+		_header.format  = _buf[3];
+		_header.id      = readLE16(&_buf[4]);
+		_header.length  = readLE16(&_buf[6]);
+		if (_header.length > MAX_PAYLOAD) return false;
+		_headerValid = true;
+		return true;
+	}
+
+	// Drops the first buffered byte and moves the next candidate sync
+	// byte (if any) to the front of the buffer.
+	void resync() {
+		_headerValid = false;
+		const uint8_t *next = (const uint8_t *)memchr(&_buf[1], FRAME_SYNC_0, _fill - 1);
+		size_t skip = next ? (size_t)(next - _buf) : _fill;
+		bytesDiscarded += skip;
+		_fill -= skip;
+		memmove(_buf, &_buf[skip], _fill);
+	}
+};
+
+#endif
@@ -4,7 +4,11 @@
  * Receives pixel data (RGB565 16-bit) from a serial connection
  * and displays it on the SmartMatrix panel.
  *
- * Protocol: '*' (0x2A) followed by 2048 bytes of RGB565 pixel data.
+ * Protocol: binary frames (see common/frame_protocol.h) carrying
+ * 2048 bytes of RGB565 pixel data, or a smaller delta against the frame
+ * on screen (changed rectangles or run-length coded XOR, see
+ * common/frame_decode.h). Grayscale images arrive as palette indices
+ * (FRAME_FORMAT_INDEXEDx) expanded through the last palette received.
  *
  * Dependencies:
  * https://github.com/Kameeno/SmartMatrix
@@ -12,6 +16,8 @@
 
 // Pinout configuration for the PicoDriver v.5.0
 #include "common/pico_driver_v5_pinout.h"
+#include "common/frame_protocol.h"
+#include "common/frame_decode.h"
 
 #include <Arduino.h>
 #include <SmartMatrix.h>
@@ -31,16 +37,26 @@ SMARTMATRIX_ALLOCATE_BUFFERS(matrix, TOTAL_WIDTH, TOTAL_HEIGHT, kRefreshDepth, k
 // A single background layer "bg"
 SMARTMATRIX_ALLOCATE_BACKGROUND_LAYER(bg, TOTAL_WIDTH, TOTAL_HEIGHT, COLOR_DEPTH, kbgOptions);
 
-// Incoming color depth from serial (RGB565)
-const uint8_t INCOMING_COLOR_DEPTH = 16;
-
+// Incoming frames are RGB565 (or deltas of it)
 const uint16_t NUM_LEDS = TOTAL_WIDTH * TOTAL_HEIGHT;
-const uint16_t BUFFER_SIZE = NUM_LEDS * (INCOMING_COLOR_DEPTH / 8);
-uint8_t buf[BUFFER_SIZE]; // Buffer for incoming color data
+const uint16_t BUFFER_SIZE = NUM_LEDS * 2;
+
+// Reassembles frames from the serial stream
+FrameParser<BUFFER_SIZE> parser;
+
+// Credit-based flow control (see CreditMessage in common/frame_protocol.h):
+// the next frame arrives while one is shown and waits in the serial
+// receive buffer, which is sized for it
+#define CREDIT_WINDOW 2     // Frames a sender may have on the way
+#define CREDIT_INTERVAL 100 // ms between repeated credits
+const size_t RX_BUFFER_SIZE = (CREDIT_WINDOW - 1) * (FRAME_HEADER_SIZE + BUFFER_SIZE + FRAME_CRC_SIZE) + 256;
+
+uint16_t lastReceivedId = 0;
+uint32_t lastCreditAt = 0;
 
 void setup() {
+	Serial.setRxBufferSize(RX_BUFFER_SIZE); // Only takes effect before begin()
 	Serial.begin(921600);
-	Serial.setTimeout(1);
 
 	pinMode(PICO_LED_PIN, OUTPUT);
 	digitalWrite(PICO_LED_PIN, 1);
@@ -51,49 +67,85 @@ void setup() {
 	matrix.begin();
 }
 
+// Id of the frame shown on the matrix; delta frames must be based on it
+uint16_t currentId = 0;
+bool haveCurrent = false;
+
+// Last palette received, used by the indexed formats
+rgb24 palette[256];
+bool havePalette = false;
+
+// Converts a validated frame into the back buffer and presents it
+void presentFrame(const FrameHeader &header, const uint8_t *buf) {
+	rgb24 *buffer = bg.backBuffer();
+	uint8_t bpp = frameIndexedBpp(header.format);
+
+	if (header.format == FRAME_FORMAT_PALETTE) {
+		if (loadPalette(palette, buf, header.length)) havePalette = true;
+		return;
+	} else if (bpp) {
+		if (!havePalette || header.length != NUM_LEDS * bpp / 8) return;
+		expandIndexed(buffer, NUM_LEDS, buf, bpp, palette);
+	} else if (header.format == FRAME_FORMAT_RGB565 && header.length == BUFFER_SIZE) {
+		expandRgb565(buffer, buf, NUM_LEDS);
+	} else if (header.format == FRAME_FORMAT_RECTS_RGB565) {
+		// Wait for the next full frame if we missed the base
+		if (!haveCurrent || header.length < FRAME_RECTS_HEADER_SIZE || rectsBaseId(buf) != currentId) return;
+		if (!applyRectsRgb565(buffer, TOTAL_WIDTH, TOTAL_HEIGHT, buf, header.length)) return;
+	} else if (header.format == FRAME_FORMAT_XOR_RLE_RGB565) {
+		if (header.length < FRAME_XOR_RLE_HEADER_SIZE) return;
+		if (xorRleIsDelta(buf) && (!haveCurrent || xorRleBaseId(buf) != currentId)) return;
+		if (!applyXorRleRgb565(buffer, NUM_LEDS, buf, header.length)) return;
+	} else {
+		return;
+	}
+	currentId = header.id;
+	haveCurrent = true;
+
+	// Copy back so the back buffer keeps matching the screen for the next delta
+	bg.swapBuffers(true);
+}
+
+// Everything received has been shown: the sender may have CREDIT_WINDOW
+// frames on the way after the last one
+void sendCredit() {
+	static uint8_t out[FRAME_HEADER_SIZE + FRAME_CREDIT_SIZE + FRAME_CRC_SIZE];
+	static uint16_t id = 0;
+	CreditMessage credit;
+	credit.lastId = lastReceivedId;
+	credit.free = CREDIT_WINDOW;
+	writeCreditMessage(&out[FRAME_HEADER_SIZE], credit);
+	Serial.write(out, encodeFrame(out, FRAME_FORMAT_CREDIT, id++, FRAME_CREDIT_SIZE));
+	lastCreditAt = millis();
+}
+
 void loop() {
 
 	static uint32_t frame = 0;
-
-	char chr = Serial.read();
-	// The first byte is a magic number to identify the data format
-	if (chr == '*') {
-
-		uint16_t count = Serial.readBytes((char *)buf, BUFFER_SIZE);
-
-		if (count == BUFFER_SIZE) {
-
-			rgb24 *buffer = bg.backBuffer();
-			rgb24 *col;
-			uint16_t idx = 0;
-
-			if (INCOMING_COLOR_DEPTH == 24) {
-				for (uint16_t i = 0; i < NUM_LEDS; i++) {
-					col = &buffer[i];
-					col->red   = buf[idx++];
-					col->green = buf[idx++];
-					col->blue  = buf[idx++];
-				}
-			} else if (INCOMING_COLOR_DEPTH == 16) {
-				for (uint16_t i = 0; i < NUM_LEDS; i++) {
-					col = &buffer[i];
-
-					uint8_t  high  = buf[idx++];
-					uint8_t  low   = buf[idx++];
-					uint16_t rgb16 = ((uint16_t)high << 8) | low;
-
-					uint8_t r5 = (rgb16 >> 11) & 0x1F;
-					uint8_t g6 = (rgb16 >> 5)  & 0x3F;
-					uint8_t b5 =  rgb16        & 0x1F;
-
-					col->red   = r5 << 3;
-					col->green = g6 << 2;
-					col->blue  = b5 << 3;
-				}
+	static uint8_t chunk[256];
+	bool presented = false;
+
+	// Hand over whatever has arrived, the parser keeps partial frames
+	int avail = Serial.available();
+	while (avail > 0) {
+		size_t len = Serial.readBytes(chunk, avail < (int)sizeof(chunk) ? avail : sizeof(chunk));
+		if (len == 0) break;
+		avail -= len;
+
+		const uint8_t *data = chunk;
+		while (len > 0) {
+			size_t used = parser.feed(data, len);
+			data += used;
+			len  -= used;
+			while (parser.available()) {
+				lastReceivedId = parser.header().id;
+				presentFrame(parser.header(), parser.payload());
+				parser.release();
+				presented = true;
 			}
-			bg.swapBuffers(false);
 		}
 	}
+	if (presented || millis() - lastCreditAt >= CREDIT_INTERVAL) sendCredit();
 
 	// Animate built-in LED as heartbeat
 	digitalWrite(PICO_LED_PIN, frame / 20 % 2);
@@ -8,11 +8,12 @@
  *   4. Send to the 32x32 RGB LED matrix via serial
  */
 
-import { connect, disconnect, isConnected, sendImageData } from './serial.js'
+import { connect, disconnect, isConnected, sendImageData, sendGrayscaleImageData } from './serial.js'
 import { floydSteinberg } from './dither.js'
 import { startCamera, stopCamera, isCameraActive, captureFrame, loadImageFile } from './camera.js'
 
 const MATRIX_SIZE = 32
+const GRAY_BPP = 4 // Grayscale mode: 16 dithered levels, sent as 4 bit palette indices
 
 // ─── DOM Elements ────────────────────────────────────────────────────────────
 
@@ -144,6 +145,7 @@ function applyDither() {
 
 	const options = {
 		grayscale: chkGrayscale.checked,
+		grayLevels: 1 << GRAY_BPP,
 		strength: parseFloat(strengthSlider.value)
 	}
 
@@ -162,10 +164,19 @@ btnSend.addEventListener('click', async () => {
 		log('Serial not connected.')
 		return
 	}
-	await sendImageData(ditheredImageData)
+	await sendDithered()
 	log('Image sent to matrix.')
 })
 
+/**
+ * Send the dithered image; grayscale images go out as palette indices,
+ * a quarter of the size of an RGB565 frame.
+ */
+function sendDithered() {
+	if (chkGrayscale.checked) return sendGrayscaleImageData(ditheredImageData, GRAY_BPP)
+	return sendImageData(ditheredImageData)
+}
+
 // ─── Live Mode ───────────────────────────────────────────────────────────────
 
 btnLive.addEventListener('click', () => {
@@ -209,7 +220,7 @@ async function liveLoop() {
 	applyDither()
 
 	if (isConnected() && ditheredImageData) {
-		await sendImageData(ditheredImageData)
+		await sendDithered()
 	}
 
 	liveRAF = requestAnimationFrame(liveLoop)
@@ -17,11 +17,14 @@
  * @param {ImageData} imageData - Source image (RGBA)
  * @param {object}    options   - Optional settings
  * @param {boolean}   options.grayscale - Convert to grayscale before dithering
+ * @param {number}    options.grayLevels - With grayscale, quantize to this many
+ *                                        gray levels instead of RGB565 (e.g. 16)
  * @param {number}    options.strength  - Error diffusion strength 0.0–1.0 (default 1.0)
  * @returns {ImageData} The dithered image data (same reference, modified in-place)
  */
 export function floydSteinberg(imageData, options = {}) {
-	const { grayscale = false, strength = 1.0 } = options
+	const { grayscale = false, grayLevels = 0, strength = 1.0 } = options
+	const toGray = grayscale && grayLevels >= 2
 
 	const w = imageData.width
 	const h = imageData.height
@@ -58,9 +61,9 @@ export function floydSteinberg(imageData, options = {}) {
 			const oldG = g[i]
 			const oldB = b[i]
 
-			const newR = quantize5bit(oldR)
-			const newG = quantize6bit(oldG)
-			const newB = quantize5bit(oldB)
+			const newR = toGray ? quantizeLevels(oldR, grayLevels) : quantize5bit(oldR)
+			const newG = toGray ? newR : quantize6bit(oldG)
+			const newB = toGray ? newR : quantize5bit(oldB)
 
 			r[i] = newR
 			g[i] = newG
@@ -133,6 +136,15 @@ function quantize6bit(value) {
 	return (level * 255) / 63
 }
 
+/**
+ * Quantize an 8-bit value to `levels` evenly spaced levels.
+ * Output is scaled back to 0–255 range.
+ */
+function quantizeLevels(value, levels) {
+	const level = Math.round(Math.max(0, Math.min(255, value)) / 255 * (levels - 1))
+	return (level * 255) / (levels - 1)
+}
+
 /**
  * Clamp a value to the 0–255 range.
  */
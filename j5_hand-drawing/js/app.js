@@ -4,8 +4,9 @@
  * Single async loop handles everything in sequence:
  *   detect → draw → preview → send → next frame
  *
- * The await on sendImageData provides natural back-pressure:
- * the loop runs as fast as serial allows (~30-40fps).
+ * sendImageData waits for a write in progress, and holds the frame back
+ * while the device has no room for it (newer frames replace it), so the
+ * loop never runs ahead of the matrix.
  * This is the same proven pattern as j4_dithered-portrait live mode.
  */
 
@@ -159,8 +160,8 @@ function processHandDetection() {
 // ─── Main Loop ───────────────────────────────────────────────────────────────
 //
 // Single async loop: detect → draw → preview → send → next frame.
-// The await on sendImageData creates natural back-pressure,
-// throttling to whatever the serial wire can handle (~30-40fps).
+// sendImageData paces the frames by the device's credits; held-back
+// frames are replaced by newer ones rather than queued.
 // When serial is not connected, runs at RAF speed for smooth preview.
 
 async function mainLoop() {
@@ -175,7 +176,7 @@ async function mainLoop() {
 	// 3. Preview on canvas
 	matrixCtx.putImageData(imageData, 0, 0)
 
-	// 4. Send to matrix — await provides back-pressure
+	// 4. Send to matrix
 	if (isConnected() && !serialPaused) {
 		try {
 			await sendImageData(imageData)
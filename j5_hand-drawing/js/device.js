@@ -0,0 +1,521 @@
+/**
+ * What comes back from the device over Web Serial, and format negotiation.
+ *
+ * openDeviceReader() keeps reading the port in the background and picks
+ * protocol frames out of the device's output. queryCapabilities() sends a
+ * FORMAT_QUERY and waits for the FORMAT_CAPS answer: resolution, accepted
+ * formats, buffer depth and baud rates (see parseCapabilities() in
+ * protocol.js). Firmware without the query does not answer; senders then
+ * fall back to DEFAULT_CAPS, the formats every firmware decodes.
+ *
+ * openDevice() does both and then moves the link to the fastest baud rate
+ * the device offers that passes a test (see raiseBaudRate()):
+ *
+ *   const link = await openDevice(port, 921600)
+ *   const encoder = createFrameEncoder(link.caps.width, link.caps.height, pickEncoding(link.caps))
+ *   await link.writer.write(encoder.encode(buffer))
+ *
+ * createPacedWriter() sends frames only while the device has room for
+ * them (FORMAT_CREDIT), holding back just the newest frame otherwise.
+ * Firmware that echoes FORMAT_TIMING frames gets its latency broken down
+ * per stage (createTimingLog()), in the console every TIMING_REPORT_MS and
+ * as CSV for bench/timing_summary in x1_serial_rgb_client:
+ *
+ *   copy((await import('./js/device.js')).getTimingLog().csv())
+ */
+
+import {
+	BAUD_COMMIT, BAUD_REPORT, BAUD_SIZE, BAUD_SWITCH, FORMAT_BAUD, FORMAT_CAPS, FORMAT_QUERY,
+	FORMAT_RECTS_RGB565, FORMAT_RGB565, FORMAT_TEST, FORMAT_XOR_RLE_RGB565, FORMAT_CREDIT, FORMAT_TIMING,
+	createFrameBuffer, createFrameReader, finishFrame, getLastFrameId, getNextFrameId, parseBaudPayload,
+	parseCapabilities, parseCreditPayload, parseTimingPayload, writeBaudPayload, writeTestPayload,
+} from './protocol.js'
+
+const QUERY_ATTEMPTS = 6     // The board may still be booting after the port opened
+const QUERY_INTERVAL_MS = 250
+
+const BAUD_STEPS = [1500000, 2000000, 3000000] // Tried in order, up to the device's maxBaud
+const TEST_FRAMES = 30       // Full-size test frames per step
+const MAX_ERROR_RATE = 0.01  // Share of test frames that may be lost on a usable rate
+const ANSWER_TIMEOUT_MS = 300
+const SETTLE_MS = 20         // The device switches once its answer has left
+const BAUD_TRIAL_MS = 2000   // The device's BAUD_TRIAL_MS: an uncommitted switch is undone after this
+
+const CREDIT_TIMEOUT_MS = 500 // Held back longer than this, a frame goes out anyway (device reset, frame lost)
+
+const TIMING_REPORT_MS = 10000 // console.table of the latency stages this often, 0 = never
+const TIMING_LOG_SIZE = 4096   // Frames kept for csv()
+const TIMING_PENDING = 64      // Frames sent that may still be echoed
+const TIMING_STAGES = ['hold', 'encode', 'write', 'wire', 'decode', 'swap', 'link', 'total']
+
+/**
+ * A 32×32 client that does not answer queries. Only the formats every
+ * firmware decodes, so pickEncoding() cannot choose one it does not.
+ */
+export const DEFAULT_CAPS = Object.freeze({
+	width: 32,
+	height: 32,
+	maxPayload: 32 * 32 * 2,
+	frameSlots: 1,
+	baud: 921600,
+	maxBaud: 921600,
+	formats: new Set([FORMAT_RGB565, FORMAT_RECTS_RGB565, FORMAT_XOR_RLE_RGB565]),
+})
+
+/**
+ * Start reading frames from an open serial port. The port's readable
+ * stays locked until close().
+ * @param {SerialPort} port
+ * @returns {{waitFor: function(number, number): Promise<{format: number, id: number, payload: Uint8Array}|null>,
+ *            onFrame: function(function): void, close: function(): Promise<void>}}
+ */
+export function openDeviceReader(port) {
+	const reader = port.readable.getReader()
+	const frames = createFrameReader()
+	const waiting = []
+	const listeners = []
+
+	const reading = (async () => {
+		try {
+			for (;;) {
+				const { value, done } = await reader.read()
+				if (done) break
+				for (const frame of frames.push(value)) {
+					listeners.forEach((listener) => listener(frame))
+					for (let i = waiting.length - 1; i >= 0; i--) {
+						if (waiting[i].format === frame.format) waiting.splice(i, 1)[0].resolve(frame)
+					}
+				}
+			}
+		} catch (err) {
+			console.warn('Serial read stopped:', err.message)
+		} finally {
+			reader.releaseLock()
+			waiting.splice(0).forEach((w) => w.resolve(null))
+		}
+	})()
+
+	return {
+		/**
+		 * The next frame of a format, or null after timeoutMs.
+		 * @param {number} format
+		 * @param {number} timeoutMs
+		 */
+		waitFor(format, timeoutMs) {
+			return new Promise((resolve) => {
+				const entry = { format, resolve }
+				waiting.push(entry)
+				setTimeout(() => {
+					const i = waiting.indexOf(entry)
+					if (i >= 0) waiting.splice(i, 1)[0].resolve(null)
+				}, timeoutMs)
+			})
+		},
+
+		/** Calls listener(frame) for every frame the device sends */
+		onFrame(listener) {
+			listeners.push(listener)
+		},
+
+		/** Stops reading and unlocks the port's readable */
+		async close() {
+			await reader.cancel()
+			await reading
+		},
+	}
+}
+
+/**
+ * Ask the device what it accepts.
+ * @param {WritableStreamDefaultWriter} writer
+ * @param {ReturnType<typeof openDeviceReader>} device
+ * @param {number} attempts
+ * @returns {Promise<object|null>} the capabilities, null if the device does not answer
+ */
+export async function queryCapabilities(writer, device, attempts = QUERY_ATTEMPTS) {
+	const query = createFrameBuffer(0)
+	for (let i = 0; i < attempts; i++) {
+		const answer = device.waitFor(FORMAT_CAPS, QUERY_INTERVAL_MS)
+		await writer.write(finishFrame(query, FORMAT_QUERY, 0))
+		const frame = await answer
+		const caps = frame && parseCapabilities(frame.payload)
+		if (caps) return caps
+	}
+	return null
+}
+
+/**
+ * Open a serial port, ask the device what it accepts and, if it offers
+ * more than baudRate, move to the fastest rate that passes the test.
+ * @param {SerialPort} port
+ * @param {number} baudRate   — the rate the device starts at
+ * @param {{raiseBaud?: boolean}} options
+ * @returns {Promise<{writer: WritableStreamDefaultWriter, device: ReturnType<typeof openDeviceReader>,
+ *                    caps: object, baud: number, steps: object[]}>} steps: see raiseBaudRate()
+ */
+export async function openDevice(port, baudRate, { raiseBaud = true } = {}) {
+	const link = await openLink(port, baudRate)
+	link.caps = (await queryCapabilities(link.writer, link.device)) ?? DEFAULT_CAPS
+	link.steps = []
+	if (raiseBaud && link.caps.maxBaud > baudRate) {
+		await raiseBaudRate(port, link)
+		link.caps = { ...link.caps, baud: link.baud }
+	}
+	return link
+}
+
+/**
+ * Step up through BAUD_STEPS, up to caps.maxBaud. For each rate: ask the
+ * device to switch, reopen the port at that rate, send TEST_FRAMES test
+ * frames of a full frame's size, ask for the device's counters and commit
+ * if at most MAX_ERROR_RATE of them were lost. The first failing step
+ * ends the climb with the link back on the last good rate.
+ *
+ * Every step is added to link.steps and logged as a table:
+ *   { baud, sent, received, errors, overruns, errorRate, fps, ok }
+ * where fps is the rate full frames arrived at during the test.
+ */
+export async function raiseBaudRate(port, link) {
+	const { caps } = link
+	const length = Math.min(caps.width * caps.height * 2, caps.maxPayload)
+	const buffer = createFrameBuffer(Math.max(length, BAUD_SIZE))
+
+	for (const baud of BAUD_STEPS) {
+		if (baud <= link.baud || baud > caps.maxBaud) continue
+		const step = await tryBaud(port, link, baud, buffer, length)
+		link.steps.push(step)
+		if (!step.ok) break
+	}
+	console.table(link.steps)
+}
+
+async function tryBaud(port, link, baud, buffer, length) {
+	const previous = link.baud
+	const step = { baud, sent: 0, received: 0, errors: 0, overruns: 0, errorRate: 1, fps: 0, ok: false }
+
+	const accepted = await baudCommand(link, buffer, baud, BAUD_SWITCH)
+	if (!accepted || accepted.command !== BAUD_SWITCH) return step // Refused or lost: nothing changed
+
+	try {
+		await reopen(port, link, baud)
+		await sleep(SETTLE_MS)
+		for (let i = 0; i < TEST_FRAMES; i++) {
+			await link.writer.write(finishFrame(buffer, FORMAT_TEST, writeTestPayload(buffer, getNextFrameId(), length)))
+			step.sent++
+		}
+
+		const report = await baudCommand(link, buffer, baud, BAUD_REPORT)
+		if (report) {
+			step.received = report.testFrames
+			step.errors = report.errors
+			step.overruns = report.overruns
+			step.errorRate = 1 - report.testFrames / step.sent
+			step.fps = report.elapsedUs ? (report.testFrames - 1) * 1e6 / report.elapsedUs : 0
+		}
+		if (report && step.errorRate <= MAX_ERROR_RATE) {
+			const committed = await baudCommand(link, buffer, baud, BAUD_COMMIT)
+			step.ok = committed !== null && committed.command === BAUD_COMMIT
+		}
+	} catch (err) {
+		console.warn(`${baud} baud failed:`, err.message)
+	}
+
+	if (!step.ok) await findDevice(port, link, [previous, baud])
+	return step
+}
+
+// Sends a FORMAT_BAUD command and waits for the device's answer
+async function baudCommand(link, buffer, baud, command) {
+	const answer = link.device.waitFor(FORMAT_BAUD, ANSWER_TIMEOUT_MS)
+	await link.writer.write(finishFrame(buffer, FORMAT_BAUD, writeBaudPayload(buffer, baud, command)))
+	const frame = await answer
+	return frame && parseBaudPayload(frame.payload)
+}
+
+// After a failed step: wait until the device has undone the switch and
+// find it on the old rate. If a commit got through but its answer did
+// not, the device stays on the new rate, so that is tried next.
+async function findDevice(port, link, rates) {
+	await sleep(BAUD_TRIAL_MS)
+	for (const baud of rates) {
+		try {
+			if (link.baud !== baud || !link.device) await reopen(port, link, baud)
+			if (await queryCapabilities(link.writer, link.device, 2)) return
+		} catch (err) {
+			console.warn(`No device at ${baud} baud:`, err.message)
+		}
+	}
+	throw new Error('Lost the device while changing the baud rate')
+}
+
+async function openLink(port, baud) {
+	await port.open({ baudRate: baud })
+	return { writer: port.writable.getWriter(), device: openDeviceReader(port), baud }
+}
+
+// Web Serial cannot change the rate of an open port
+async function reopen(port, link, baud) {
+	if (link.device) {
+		link.writer.releaseLock()
+		await link.device.close()
+		link.device = null
+		await port.close()
+	}
+	Object.assign(link, await openLink(port, baud))
+}
+
+function sleep(ms) {
+	return new Promise((resolve) => setTimeout(resolve, ms))
+}
+
+/**
+ * Tracks the device's FORMAT_CREDIT frames: a frame may go out while
+ * fewer frames were sent after the last one the device received than it
+ * has room for. Until the first credit (firmware without flow control),
+ * or without a device, every frame may go out.
+ * @param {ReturnType<typeof openDeviceReader>|null} device
+ */
+export function createCreditGate(device) {
+	let credit = null
+	let lastSent = -1
+	let sentAt = 0
+	const listeners = []
+
+	device?.onFrame((frame) => {
+		if (frame.format !== FORMAT_CREDIT) return
+		credit = parseCreditPayload(frame.payload) ?? credit
+		listeners.forEach((listener) => listener())
+	})
+
+	return {
+		/** Whether the device has room for another frame */
+		ready() {
+			if (!credit || lastSent < 0 || performance.now() - sentAt > CREDIT_TIMEOUT_MS) return true
+			const ahead = ((lastSent - credit.lastId) << 16) >> 16 // Frames sent after lastId, as int16
+			return ahead < credit.free
+		},
+
+		/** Records the id of the frame that went out last */
+		sent(id) {
+			lastSent = id
+			sentAt = performance.now()
+		},
+
+		/** Calls listener() on every credit */
+		onCredit(listener) {
+			listeners.push(listener)
+		},
+	}
+}
+
+/**
+ * Writes frames at the pace the device's credits allow (createCreditGate()).
+ * A frame that finds no room, or another write still going, is held back
+ * and replaced by the next one: once a credit arrives only the newest
+ * frame goes out, so stale frames never queue up in the USB pipe and the
+ * latency stays bounded.
+ *
+ * Frames are encoded when they go out, so delta encoders base them on
+ * what was actually sent:
+ *
+ *   const paced = createPacedWriter(writer, device, onError)
+ *   await paced.write(() => encoder.encode(buffer), () => encoder.commit())
+ *
+ * @param {WritableStreamDefaultWriter|{write: function(Uint8Array): Promise<*>}} writer
+ * @param {ReturnType<typeof openDeviceReader>|null} device — null: no credits (e.g. a WebSocket)
+ * @param {function(Error): void} onError — writing a held-back frame failed
+ */
+export function createPacedWriter(writer, device, onError) {
+	const gate = createCreditGate(device)
+	const timing = device ? createTimingLog(device) : null
+	let pending = null // { encode, written, queuedAt } of the newest frame held back
+	let writing = false
+
+	async function flush() {
+		const { encode, written, queuedAt } = pending
+		pending = null
+		writing = true
+		try {
+			const startedAt = performance.now()
+			const frames = [].concat(encode())
+			const id = getLastFrameId()
+			const encodedAt = performance.now()
+			let result
+			for (const bytes of frames) result = await writer.write(bytes)
+			gate.sent(id)
+			timing?.sent(id, queuedAt, startedAt, encodedAt, performance.now())
+			written?.(result)
+		} finally {
+			writing = false
+		}
+	}
+
+	async function flushHeld() {
+		if (!pending || writing || !gate.ready()) return
+		try {
+			await flush()
+		} catch (err) {
+			onError(err)
+			return
+		}
+		flushHeld()
+	}
+
+	gate.onCredit(flushHeld)
+
+	return {
+		/**
+		 * Send a frame now, or once the device has room for it unless a
+		 * newer frame comes first. Errors of a write done right away are
+		 * thrown, those of a held-back frame go to onError.
+		 * @param {function(): Uint8Array|Uint8Array[]} encode — builds the frame(s) (finishFrame() bytes)
+		 * @param {function(*): void} [written] — called with writer.write()'s result once written
+		 * @returns {Promise<boolean>} true if written now, false if held back
+		 */
+		async write(encode, written) {
+			pending = { encode, written, queuedAt: performance.now() }
+			if (writing || !gate.ready()) return false
+			await flush()
+			flushHeld()
+			return true
+		},
+	}
+}
+
+let timingLog = null
+
+/**
+ * The timing log of the latest paced writer, for the console. Null until
+ * a paced writer was created for a device.
+ * @returns {ReturnType<typeof createTimingLog>|null}
+ */
+export function getTimingLog() {
+	return timingLog
+}
+
+/**
+ * Matches the device's FORMAT_TIMING echoes with when the frames were
+ * handed to write(), encoded and written, and splits each frame's latency
+ * into stages (µs):
+ *
+ *   hold    write() called → encoding starts (waiting for a credit)
+ *   encode  encoding
+ *   write   writer.write() of the frame's bytes, overlaps wire and link
+ *   wire    device: first → last byte received
+ *   decode  device: last byte → decoded (includes waiting for the render task)
+ *   swap    device: decoded → swap done
+ *   link    the rest: USB and UART before the first byte, the echo's way back
+ *   total   write() called → echo received
+ *
+ * Host and device clocks are never compared, only differences on each
+ * side, so link is what total leaves after hold, encode and the device.
+ * @param {ReturnType<typeof openDeviceReader>} device
+ */
+export function createTimingLog(device) {
+	const sent = new Map() // id → host times in ms, oldest first
+	const rows = []        // The last TIMING_LOG_SIZE frames, one array of TIMING_STAGES each
+	let reported = 0       // rows.length at the last report
+	let reportedAt = performance.now()
+
+	device.onFrame((frame) => {
+		if (frame.format !== FORMAT_TIMING) return
+		const echo = parseTimingPayload(frame.payload)
+		const host = echo && sent.get(echo.frameId)
+		if (!host) return
+		sent.delete(echo.frameId)
+
+		const now = performance.now()
+		const us = (ms) => Math.round(ms * 1000)
+		const row = [
+			us(host.startedAt - host.queuedAt),
+			us(host.encodedAt - host.startedAt),
+			us(host.writtenAt - host.encodedAt),
+			(echo.lastByteUs - echo.firstByteUs) >>> 0,
+			(echo.decodedUs - echo.lastByteUs) >>> 0,
+			(echo.swappedUs - echo.decodedUs) >>> 0,
+			0,
+			us(now - host.queuedAt),
+		]
+		row[6] = Math.max(0, row[7] - row[0] - row[1] - row[3] - row[4] - row[5])
+		row.id = echo.frameId
+		rows.push(row)
+		if (rows.length > TIMING_LOG_SIZE) {
+			rows.shift()
+			reported--
+		}
+
+		if (TIMING_REPORT_MS && now - reportedAt >= TIMING_REPORT_MS) {
+			console.table(summarize(rows.slice(Math.max(0, reported))))
+			reported = rows.length
+			reportedAt = now
+		}
+	})
+
+	function summarize(window) {
+		const table = {}
+		TIMING_STAGES.forEach((stage, i) => {
+			const values = window.map((row) => row[i]).sort((a, b) => a - b)
+			const at = (p) => values[Math.min(values.length - 1, Math.floor(p * values.length))]
+			table[stage] = { count: values.length, p50: at(0.5), p90: at(0.9), p99: at(0.99), max: values[values.length - 1] }
+		})
+		return table
+	}
+
+	const log = {
+		/** Records a frame that went out (performance.now() times) */
+		sent(id, queuedAt, startedAt, encodedAt, writtenAt) {
+			sent.set(id, { queuedAt, startedAt, encodedAt, writtenAt })
+			if (sent.size > TIMING_PENDING) sent.delete(sent.keys().next().value) // Never echoed
+		},
+
+		/** Percentiles per stage over the frames logged, in µs */
+		summary() {
+			return summarize(rows)
+		},
+
+		/** The frames logged, one line each, with a header line */
+		csv() {
+			const header = ['id'].concat(TIMING_STAGES.map((stage) => `${stage}_us`)).join(',')
+			return [header].concat(rows.map((row) => [row.id].concat(row).join(','))).join('\n') + '\n'
+		},
+	}
+	timingLog = log
+	return log
+}
+
+/**
+ * createFrameEncoder() options for the smallest encodings the device
+ * accepts. The encoder's keyframes are RGB565, so that must be accepted.
+ * @param {object} caps
+ * @returns {{rects: boolean, xorRle: boolean}}
+ */
+export function pickEncoding(caps) {
+	if (!caps.formats.has(FORMAT_RGB565)) throw new Error('The device does not accept RGB565 frames')
+	return {
+		rects: caps.formats.has(FORMAT_RECTS_RGB565) && caps.width <= 255 && caps.height <= 255,
+		xorRle: caps.formats.has(FORMAT_XOR_RLE_RGB565),
+	}
+}
+
+/**
+ * Scale an image to the device resolution (nearest neighbour), so a 32×32
+ * canvas fills a 64×64 chain instead of garbling it.
+ * @param {ImageData} imageData
+ * @param {number} width
+ * @param {number} height
+ * @returns {{data: Uint8ClampedArray, width: number, height: number}} imageData itself if it fits
+ */
+export function fitImage(imageData, width, height) {
+	if (imageData.width === width && imageData.height === height) return imageData
+
+	const data = new Uint8ClampedArray(width * height * 4)
+	for (let y = 0; y < height; y++) {
+		const sy = Math.floor(y * imageData.height / height)
+		for (let x = 0; x < width; x++) {
+			const sx = Math.floor(x * imageData.width / width)
+			const s = (sy * imageData.width + sx) * 4
+			data.set(imageData.data.subarray(s, s + 4), (y * width + x) * 4)
+		}
+	}
+	return { data, width, height }
+}
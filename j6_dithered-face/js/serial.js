@@ -2,22 +2,34 @@
  * Serial communication module for the 32×32 RGB LED matrix.
  *
  * Handles Web Serial API connection and pixel data transmission.
- * Protocol: sends '*' (0x2A) header followed by RGB565 pixel data.
+ * Protocol: RGB565 pixel data wrapped in the binary frame format
+ * described in protocol.js (sync word, header, payload, CRC32), sent as
+ * a delta against the previous frame whenever that is smaller.
  *
  * Reused from j4_dithered-portrait.
+ *
+ * On connect the device is asked for its resolution and formats
+ * (device.js); frames are scaled to that resolution and only encodings it
+ * accepts are used.
  */
 
+import { createFrameBuffer, createFrameEncoder } from './protocol.js'
+import { DEFAULT_CAPS, createPacedWriter, fitImage, openDevice, pickEncoding } from './device.js'
+
 const BAUD_RATE     = 921600
-const TOTAL_WIDTH   = 32
-const TOTAL_HEIGHT  = 32
 const COLOR_DEPTH   = 16 // 16-bit RGB565
 
-// Pre-allocate buffer: 1 header byte + pixel data
-const PIXEL_DATA = new Uint8Array(1 + TOTAL_WIDTH * TOTAL_HEIGHT * (COLOR_DEPTH / 8))
-PIXEL_DATA[0] = 42 // '*' magic byte
+// Sized to the device on connect: header + pixel data + CRC
+let frameBuffer = null
+let encoder = null
+let caps = null
+let latest = null // RGB565 pixels of the newest frame, encoded when it goes out
+configure(DEFAULT_CAPS)
 
 let writer     = null
 let serialPort = null
+let device     = null
+let paced      = null // Writes frames as the device's credits allow
 
 /**
  * Request and open a serial port connection.
@@ -26,8 +38,11 @@ let serialPort = null
 export async function connect() {
 	try {
 		serialPort = await navigator.serial.requestPort()
-		await serialPort.open({ baudRate: BAUD_RATE })
-		writer = serialPort.writable.getWriter()
+		const link = await openDevice(serialPort, BAUD_RATE)
+		writer = link.writer
+		device = link.device
+		configure(link.caps)
+		paced = createPacedWriter(writer, device, writeFailed)
 		return true
 	} catch (err) {
 		console.error('Serial connection error:', err)
@@ -42,6 +57,7 @@ export async function connect() {
  */
 export async function disconnect() {
 	try {
+		if (device) { await device.close(); device = null }
 		if (writer) { writer.releaseLock(); writer = null }
 		if (serialPort) { await serialPort.close(); serialPort = null }
 	} catch (err) {
@@ -63,23 +79,47 @@ export function isConnected() {
 export async function sendImageData(imageData) {
 	if (!writer) return
 
-	const px = imageData.data
-	let idx = 1 // skip header byte
+	const px = fitImage(imageData, caps.width, caps.height).data
 
-	for (let i = 0; i < px.length; i += 4) {
-		const rgb16 = packRGB16(px[i], px[i + 1], px[i + 2])
-		PIXEL_DATA[idx++] = (rgb16 >> 8) & 0xFF
-		PIXEL_DATA[idx++] =  rgb16       & 0xFF
+	for (let i = 0, j = 0; i < px.length; i += 4, j++) {
+		latest[j] = packRGB16(px[i], px[i + 1], px[i + 2])
 	}
 
 	try {
-		await writer.write(PIXEL_DATA)
+		await paced.write(encodeLatest, () => encoder.commit())
 	} catch (err) {
-		console.error('Serial write error:', err)
-		writer = null
+		writeFailed(err)
 	}
 }
 
+/**
+ * @returns {object} what the connected device accepts (DEFAULT_CAPS if it did not say)
+ */
+export function getCapabilities() {
+	return caps
+}
+
+// Encodes the newest pixels; called by the paced writer when the frame goes out
+function encodeLatest() {
+	encoder.pixels.set(latest)
+	return encoder.encode(frameBuffer)
+}
+
+// A frame did not get out: the port is gone
+function writeFailed(err) {
+	console.error('Serial write error:', err)
+	writer = null
+	encoder.reset()
+}
+
+// Sizes the encoder to the device and picks its encodings
+function configure(deviceCaps) {
+	caps = deviceCaps
+	frameBuffer = createFrameBuffer(caps.width * caps.height * (COLOR_DEPTH / 8))
+	encoder = createFrameEncoder(caps.width, caps.height, pickEncoding(caps))
+	latest = new Uint16Array(caps.width * caps.height)
+}
+
 /** Convert 8-bit RGB → 16-bit RGB565 */
 function packRGB16(r, g, b) {
 	return ((r >> 3) << 11) | ((g >> 2) << 5) | (b >> 3)
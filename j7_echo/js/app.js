@@ -7,11 +7,12 @@
  * Pipeline each frame:
  *   detect hand → update ritual → render SDF → preview → send serial
  *
- * The await on sendImageData provides natural back-pressure:
- * the loop runs as fast as serial allows (~25-35fps at 32×32).
+ * sendImageData waits for a write in progress, and holds the frame back
+ * while the device has no room for it (newer frames replace it), so the
+ * loop never runs ahead of the matrix.
  */
 
-import { connect, disconnect, isConnected, sendImageData } from './serial.js'
+import { connect, connectWebSocket, disconnect, isConnected, sendImageData } from './serial.js'
 import * as Hand from './hand.js'
 import * as SDF from './sdf.js'
 import * as Ritual from './ritual.js'
@@ -23,6 +24,8 @@ const MATRIX_SIZE = 32
 const video          = document.getElementById('video')
 const matrixCanvas   = document.getElementById('matrixCanvas')
 const btnConnect     = document.getElementById('btnConnect')
+const btnConnectWs   = document.getElementById('btnConnectWs')
+const wsUrlInput     = document.getElementById('wsUrlInput')
 const btnStart       = document.getElementById('btnStart')
 const btnSimRelease  = document.getElementById('btnSimRelease')
 const btnSimReceive  = document.getElementById('btnSimReceive')
@@ -96,6 +99,24 @@ btnConnect.addEventListener('click', async () => {
 	}
 })
 
+btnConnectWs.addEventListener('click', async () => {
+	if (isConnected()) {
+		await disconnect()
+		btnConnectWs.textContent = 'Connect WebSocket'
+		statusDot.className = 'status-dot offline'
+		log('WebSocket disconnected.')
+	} else {
+		const ok = await connectWebSocket(wsUrlInput.value)
+		if (ok) {
+			btnConnectWs.textContent = 'Disconnect'
+			statusDot.className = 'status-dot online'
+			log('WebSocket connected!')
+		} else {
+			log('WebSocket connection failed.')
+		}
+	}
+})
+
 // ─── Start / Stop Tracking ──────────────────────────────────────────────────
 
 btnStart.addEventListener('click', async () => {
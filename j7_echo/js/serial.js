@@ -2,20 +2,37 @@
  * Serial communication module for the 32x32 RGB LED matrix.
  *
  * Handles Web Serial API connection and pixel data transmission.
- * Protocol: sends '*' (0x2A) followed by RGB565 pixel data.
+ * Protocol: RGB565 pixel data wrapped in the binary frame format
+ * described in protocol.js (sync word, header, payload, CRC32), sent as
+ * a delta against the previous frame whenever that is smaller.
+ *
+ * connectWebSocket() sends the same frames to the wireless client instead;
+ * frames it has no room for are dropped (see websocket.js).
+ *
+ * On connect the device is asked for its resolution and formats
+ * (device.js); frames are scaled to that resolution and only encodings it
+ * accepts are used.
  */
 
+import { createFrameBuffer, createFrameEncoder } from './protocol.js'
+import { DEFAULT_CAPS, createPacedWriter, fitImage, openDevice, pickEncoding } from './device.js'
+import { openWebSocket } from './websocket.js'
+
 const BAUD_RATE = 921600
-const TOTAL_WIDTH = 32
-const TOTAL_HEIGHT = 32
 const COLOR_DEPTH = 16 // 16-bit RGB565
 
-// Pre-allocate the pixel data buffer: 1 byte header + pixel data
-const PIXEL_DATA = new Uint8Array(1 + TOTAL_WIDTH * TOTAL_HEIGHT * (COLOR_DEPTH / 8))
-PIXEL_DATA[0] = 42 // '*' magic byte
+// Sized to the device on connect: header + pixel data + CRC
+let frameBuffer = null
+let encoder = null
+let caps = null
+let latest = null // RGB565 pixels of the newest frame, encoded when it goes out
+configure(DEFAULT_CAPS)
 
 let writer = null
 let serialPort = null
+let device = null
+let paced = null // Writes frames as the device's credits allow
+let webSocket = null
 
 /**
  * Request and open a serial port connection.
@@ -24,8 +41,11 @@ let serialPort = null
 export async function connect() {
 	try {
 		serialPort = await navigator.serial.requestPort()
-		await serialPort.open({ baudRate: BAUD_RATE })
-		writer = serialPort.writable.getWriter()
+		const link = await openDevice(serialPort, BAUD_RATE)
+		writer = link.writer
+		device = link.device
+		configure(link.caps)
+		paced = createPacedWriter(writer, device, writeFailed)
 		return true
 	} catch (err) {
 		console.error('Serial connection error:', err)
@@ -36,10 +56,39 @@ export async function connect() {
 }
 
 /**
- * Disconnect from the serial port.
+ * Open a WebSocket to the wireless client instead of a serial port.
+ * @param {string} url - e.g. 'ws://192.168.1.103:81'
+ * @returns {Promise<boolean>} true if connected successfully
+ */
+export async function connectWebSocket(url) {
+	try {
+		webSocket = await openWebSocket(url)
+		writer = webSocket
+		configure(DEFAULT_CAPS) // Start over with a full frame
+		paced = createPacedWriter(writer, null, writeFailed)
+		return true
+	} catch (err) {
+		console.error('WebSocket connection error:', err)
+		writer = null
+		webSocket = null
+		return false
+	}
+}
+
+/**
+ * Disconnect from the serial port or WebSocket.
  */
 export async function disconnect() {
 	try {
+		if (webSocket) {
+			webSocket.close()
+			webSocket = null
+			writer = null
+		}
+		if (device) {
+			await device.close()
+			device = null
+		}
 		if (writer) {
 			writer.releaseLock()
 			writer = null
@@ -54,41 +103,64 @@ export async function disconnect() {
 }
 
 /**
- * Check if the serial port is connected and ready.
+ * Check if the serial port or WebSocket is connected and ready.
  * @returns {boolean}
  */
 export function isConnected() {
-	return writer !== null
+	return writer !== null && !(webSocket && webSocket.closed)
 }
 
 /**
  * Send an ImageData (32x32 RGBA) to the matrix via serial.
- * Converts to RGB565 before sending.
+ * Converts to RGB565 and sends it in the smallest frame format.
  * @param {ImageData} imageData - 32x32 RGBA image data
  */
 export async function sendImageData(imageData) {
 	if (!writer) return
 
-	const pixels = imageData.data
-	let idx = 1 // Start after the magic byte
+	const pixels = fitImage(imageData, caps.width, caps.height).data
 
-	for (let i = 0; i < pixels.length; i += 4) {
-		const r = pixels[i + 0]
-		const g = pixels[i + 1]
-		const b = pixels[i + 2]
-		const rgb16 = packRGB16(r, g, b)
-		PIXEL_DATA[idx++] = (rgb16 >> 8) & 0xFF // high byte
-		PIXEL_DATA[idx++] = rgb16 & 0xFF         // low byte
+	for (let i = 0, j = 0; i < pixels.length; i += 4, j++) {
+		latest[j] = packRGB16(pixels[i], pixels[i + 1], pixels[i + 2])
 	}
 
 	try {
-		await writer.write(PIXEL_DATA)
+		await paced.write(encodeLatest, (sent) => {
+			if (sent !== false) encoder.commit() // false: dropped by the WebSocket
+		})
 	} catch (err) {
-		// Don't null writer on transient errors — just skip this frame
-		console.warn('Serial write skipped:', err.message)
+		writeFailed(err)
 	}
 }
 
+/**
+ * @returns {object} what the connected device accepts (DEFAULT_CAPS if it did not say)
+ */
+export function getCapabilities() {
+	return caps
+}
+
+// Encodes the newest pixels; called by the paced writer when the frame goes out
+function encodeLatest() {
+	encoder.pixels.set(latest)
+	return encoder.encode(frameBuffer)
+}
+
+// A frame did not get out. Don't null writer on transient errors — just
+// skip the frame and send a keyframe next
+function writeFailed(err) {
+	console.warn('Serial write skipped:', err.message)
+	encoder.reset()
+}
+
+// Sizes the encoder to the device and picks its encodings
+function configure(deviceCaps) {
+	caps = deviceCaps
+	frameBuffer = createFrameBuffer(caps.width * caps.height * (COLOR_DEPTH / 8))
+	encoder = createFrameEncoder(caps.width, caps.height, pickEncoding(caps))
+	latest = new Uint16Array(caps.width * caps.height)
+}
+
 /**
  * Convert 8-bit RGB to 16-bit RGB565.
  * Pack into: RRRRRGGG GGGBBBBB
@@ -0,0 +1,71 @@
+/**
+ * WebSocket link to the wireless client (x2_wirelss_rgb_client built with
+ * RECEIVER = RECEIVER_WEBSOCKET).
+ *
+ * Every binary message carries one frame in the format of protocol.js.
+ * The device grants credit for a few messages at a time (binary message
+ * 'K' n) and hands it back as it shows frames. write() sends only while
+ * credit is left and otherwise drops the frame, returning false, so a fast
+ * page never builds up a queue: the panel always gets the newest frame.
+ *
+ * The returned object can stand in for a Web Serial writer:
+ *
+ *   const sent = await writer.write(frame)
+ *   if (sent !== false) encoder.commit()
+ */
+
+const CREDIT = 0x4B // 'K'
+
+/**
+ * Opens a WebSocket to the device.
+ * @param {string} url — e.g. 'ws://192.168.1.103:81'
+ * @returns {Promise<{write: function(Uint8Array): Promise<boolean>, close: function(), readonly closed: boolean, readonly dropped: number}>}
+ */
+export function openWebSocket(url) {
+	return new Promise((resolve, reject) => {
+		const socket = new WebSocket(url)
+		socket.binaryType = 'arraybuffer'
+
+		let credit = 0
+		let dropped = 0
+		let closed = false
+
+		const writer = {
+			/**
+			 * Sends a frame if the device has room for it.
+			 * @param {Uint8Array} frame
+			 * @returns {Promise<boolean>} false if the frame was dropped
+			 */
+			async write(frame) {
+				if (closed) throw new Error('WebSocket closed')
+				if (credit === 0) {
+					dropped++
+					return false
+				}
+				credit--
+				socket.send(frame) // Copied by the browser, the buffer can be reused
+				return true
+			},
+			close() {
+				socket.close()
+			},
+			get closed() {
+				return closed
+			},
+			get dropped() {
+				return dropped
+			},
+		}
+
+		socket.addEventListener('message', (event) => {
+			if (!(event.data instanceof ArrayBuffer)) return
+			const message = new Uint8Array(event.data)
+			if (message.length === 2 && message[0] === CREDIT) credit += message[1]
+		})
+		socket.addEventListener('open', () => resolve(writer))
+		socket.addEventListener('error', () => reject(new Error(`Cannot connect to ${url}`)))
+		socket.addEventListener('close', () => {
+			closed = true
+		})
+	})
+}
@@ -3,14 +3,21 @@
  *
  * Receives pixel data over USB serial and displays it on the matrix.
  *
- * Protocol (from host):
- *   Byte 0      : '*' (0x2A) — start-of-frame marker
- *   Bytes 1–2048: 16-bit RGB565 pixel data, big-endian, row-major
+ * Protocol (from host), see common/frame_protocol.h:
+ *   Bytes 0–7      : header — sync 'PX', version, format, frame id, length
+ *   Bytes 8–2055   : 16-bit RGB565 pixel data, big-endian, row-major
+ *   Bytes 2056–2059: CRC32 of header + payload
+ *
+ * The web app sends only the changed rectangles (FRAME_FORMAT_RECTS_RGB565)
+ * or a run-length coded XOR delta (FRAME_FORMAT_XOR_RLE_RGB565) when that is
+ * smaller than a full frame, see common/frame_decode.h.
  *
  * Hardware: ESP32 + PicoDriver v5 + SmartMatrix (Kameeno fork)
  */
 
 #include "common/pico_driver_v5_pinout.h"
+#include "common/frame_protocol.h"
+#include "common/frame_decode.h"
 
 #include <Arduino.h>
 #include <SmartMatrix.h>
@@ -29,14 +36,24 @@ SMARTMATRIX_ALLOCATE_BUFFERS(matrix, TOTAL_WIDTH, TOTAL_HEIGHT, kRefreshDepth, k
 SMARTMATRIX_ALLOCATE_BACKGROUND_LAYER(bg, TOTAL_WIDTH, TOTAL_HEIGHT, COLOR_DEPTH, kbgOptions);
 
 // ─── Serial protocol ────────────────────────────────────────────────────────
-const uint8_t  INCOMING_COLOR_DEPTH = 16;
 const uint16_t NUM_LEDS    = TOTAL_WIDTH * TOTAL_HEIGHT;
-const uint16_t BUFFER_SIZE = NUM_LEDS * (INCOMING_COLOR_DEPTH / 8);
-uint8_t buf[BUFFER_SIZE];
+const uint16_t BUFFER_SIZE = NUM_LEDS * 2; // RGB565
+
+FrameParser<BUFFER_SIZE> parser;
+
+// Credit-based flow control (see CreditMessage in common/frame_protocol.h):
+// the next frame arrives while one is shown and waits in the serial
+// receive buffer, which is sized for it
+#define CREDIT_WINDOW 2     // Frames a sender may have on the way
+#define CREDIT_INTERVAL 100 // ms between repeated credits
+const size_t RX_BUFFER_SIZE = (CREDIT_WINDOW - 1) * (FRAME_HEADER_SIZE + BUFFER_SIZE + FRAME_CRC_SIZE) + 256;
+
+uint16_t lastReceivedId = 0;
+uint32_t lastCreditAt = 0;
 
 void setup() {
+	Serial.setRxBufferSize(RX_BUFFER_SIZE); // Only takes effect before begin()
 	Serial.begin(921600);
-	Serial.setTimeout(1);
 
 	pinMode(PICO_LED_PIN, OUTPUT);
 	digitalWrite(PICO_LED_PIN, HIGH);
@@ -47,33 +64,72 @@ void setup() {
 	matrix.begin();
 }
 
-void loop() {
-	static uint32_t frame = 0;
-
-	char chr = Serial.read();
-
-	if (chr == '*') {
-		uint16_t count = Serial.readBytes((char *)buf, BUFFER_SIZE);
-
-		if (count == BUFFER_SIZE) {
-			rgb24 *buffer = bg.backBuffer();
+// Id of the frame shown on the matrix; delta frames must be based on it
+uint16_t currentId = 0;
+bool haveCurrent = false;
+
+void presentFrame(const FrameHeader &header, const uint8_t *buf) {
+	rgb24 *buffer = bg.backBuffer();
+
+	if (header.format == FRAME_FORMAT_RGB565 && header.length == BUFFER_SIZE) {
+		expandRgb565(buffer, buf, NUM_LEDS);
+	} else if (header.format == FRAME_FORMAT_RECTS_RGB565) {
+		// Wait for the next full frame if we missed the base
+		if (!haveCurrent || header.length < FRAME_RECTS_HEADER_SIZE || rectsBaseId(buf) != currentId) return;
+		if (!applyRectsRgb565(buffer, TOTAL_WIDTH, TOTAL_HEIGHT, buf, header.length)) return;
+	} else if (header.format == FRAME_FORMAT_XOR_RLE_RGB565) {
+		if (header.length < FRAME_XOR_RLE_HEADER_SIZE) return;
+		if (xorRleIsDelta(buf) && (!haveCurrent || xorRleBaseId(buf) != currentId)) return;
+		if (!applyXorRleRgb565(buffer, NUM_LEDS, buf, header.length)) return;
+	} else {
+		return;
+	}
+	currentId = header.id;
+	haveCurrent = true;
 
-			for (uint16_t i = 0; i < NUM_LEDS; i++) {
-				rgb24 *col  = &buffer[i];
-				uint16_t idx = i * 2;
+	// Copy back so the back buffer keeps matching the screen for the next delta
+	bg.swapBuffers(true);
+}
 
-				uint8_t  high  = buf[idx];
-				uint8_t  low   = buf[idx + 1];
-				uint16_t rgb16 = ((uint16_t)high << 8) | low;
+// Everything received has been shown: the sender may have CREDIT_WINDOW
+// frames on the way after the last one
+void sendCredit() {
+	static uint8_t out[FRAME_HEADER_SIZE + FRAME_CREDIT_SIZE + FRAME_CRC_SIZE];
+	static uint16_t id = 0;
+	CreditMessage credit;
+	credit.lastId = lastReceivedId;
+	credit.free = CREDIT_WINDOW;
+	writeCreditMessage(&out[FRAME_HEADER_SIZE], credit);
+	Serial.write(out, encodeFrame(out, FRAME_FORMAT_CREDIT, id++, FRAME_CREDIT_SIZE));
+	lastCreditAt = millis();
+}
 
-				col->red   = ((rgb16 >> 11) & 0x1F) << 3;
-				col->green = ((rgb16 >> 5)  & 0x3F) << 2;
-				col->blue  = ( rgb16        & 0x1F) << 3;
+void loop() {
+	static uint32_t frame = 0;
+	static uint8_t chunk[256];
+	bool presented = false;
+
+	// Feed whatever is waiting; partial frames stay in the parser
+	int avail = Serial.available();
+	while (avail > 0) {
+		size_t len = Serial.readBytes(chunk, avail < (int)sizeof(chunk) ? avail : sizeof(chunk));
+		if (len == 0) break;
+		avail -= len;
+
+		const uint8_t *data = chunk;
+		while (len > 0) {
+			size_t used = parser.feed(data, len);
+			data += used;
+			len  -= used;
+			while (parser.available()) {
+				lastReceivedId = parser.header().id;
+				presentFrame(parser.header(), parser.payload());
+				parser.release();
+				presented = true;
 			}
-
-			bg.swapBuffers(false);
 		}
 	}
+	if (presented || millis() - lastCreditAt >= CREDIT_INTERVAL) sendCredit();
 
 	// Blink onboard LED as heartbeat
 	digitalWrite(PICO_LED_PIN, (frame / 20) % 2);
@@ -4,12 +4,15 @@
  * Architecture:
  *   index.html           – markup & styles
  *   js/main.js           – this file (entry point, render loop, UI binding)
- *   js/serial.js         – Web Serial API wrapper
+ *   js/serial.js         – Web Serial API wrapper (or WebSocket)
+ *   js/websocket.js      – WebSocket link to the wireless client
+ *   js/protocol.js       – binary frame format shared with the firmware
  *   js/canvas.js         – canvas init & helpers
  *   js/generators/*.js   – pluggable pixel-art generators
  */
 
-import { connect, isConnected, sendFrame } from './serial.js'
+import { connect, connectWebSocket, isConnected, sendFrame } from './serial.js'
+import { createFrameBuffer } from './protocol.js'
 import { initCanvas, clear, getImageData } from './canvas.js'
 
 // ── Generators (lazy-loaded ES modules) ─────────────────────────────────────
@@ -29,11 +32,13 @@ const W = 32
 const H = 32
 const COLOR_DEPTH = 16
 const TARGET_FPS = 30
-const SEND_BUFFER = new Uint8Array(1 + W * H * (COLOR_DEPTH / 8))
+const SEND_BUFFER = createFrameBuffer(W * H * (COLOR_DEPTH / 8))
 
 // ── DOM references ──────────────────────────────────────────────────────────
 const canvasEl   = document.getElementById('canvas')
 const btnConnect = document.getElementById('btn-connect')
+const inputWsUrl = document.getElementById('input-ws-url')
+const btnConnectWs = document.getElementById('btn-connect-ws')
 const selGen     = document.getElementById('sel-generator')
 const paramsDiv  = document.getElementById('params')
 const logEl      = document.getElementById('log')
@@ -88,6 +93,16 @@ function init() {
 		log(ok ? 'Serial connected ✓' : 'Connection failed ✗')
 		btnConnect.textContent = ok ? 'Connected' : 'Connect Serial Port'
 		btnConnect.disabled = ok
+		btnConnectWs.disabled = ok
+	})
+
+	btnConnectWs.addEventListener('click', async () => {
+		log(`Connecting to ${inputWsUrl.value}…`)
+		const ok = await connectWebSocket(inputWsUrl.value)
+		log(ok ? 'WebSocket connected ✓' : 'Connection failed ✗')
+		btnConnectWs.textContent = ok ? 'Connected' : 'Connect WebSocket'
+		btnConnectWs.disabled = ok
+		btnConnect.disabled = ok
 	})
 
 	btnPause.addEventListener('click', () => {
@@ -4,14 +4,40 @@
  * Handles connecting to the serial port and sending pixel frames
  * using the RGB565 protocol expected by the LED matrix firmware.
  *
- * Protocol:
- *   Byte 0      : '*' (0x2A) — start-of-frame marker
- *   Bytes 1–2048: 16-bit RGB565 pixel data, big-endian, row-major
+ * Protocol: RGB565 pixel data (big-endian, row-major) wrapped in the
+ * binary frame format described in protocol.js.
+ *
+ * Frames are sent as rectangle or XOR-RLE deltas against the previously
+ * sent frame when that is smaller (see createFrameEncoder()).
+ *
+ * On connect the device is asked for its resolution and formats
+ * (device.js); frames are scaled to that resolution and only encodings it
+ * accepts are used. Firmware that does not answer gets DEFAULT_CAPS. If
+ * the device offers a faster baud rate the link moves to the fastest one
+ * that passes a test (raiseBaudRate() in device.js). Frames go out only
+ * while the device has room for them (createPacedWriter() in device.js);
+ * until then the newest frame waits and replaces older ones.
+ *
+ * The same frames can go to the wireless client over a WebSocket instead
+ * (connectWebSocket()). The device then sets the pace: frames it has no
+ * room for are dropped here and the next delta is taken against the last
+ * frame that was actually sent.
  */
 
+import { createFrameBuffer, createFrameEncoder } from './protocol.js'
+import { DEFAULT_CAPS, createPacedWriter, fitImage, openDevice, pickEncoding } from './device.js'
+import { openWebSocket } from './websocket.js'
+
 const BAUD_RATE = 921600
 
-/** @type {WritableStreamDefaultWriter|null} */
+let encoder = null
+let caps = DEFAULT_CAPS
+let device = null
+let frameBuffer = null // Used when the caller's buffer is too small for the device
+let latest = null      // RGB565 pixels of the newest frame, encoded when it goes out
+let paced = null       // Writes frames as the device's credits allow
+
+/** @type {WritableStreamDefaultWriter|{write: function(Uint8Array): Promise<boolean>}|null} */
 let writer = null
 
 /**
@@ -21,8 +47,11 @@ let writer = null
 export async function connect() {
 	try {
 		const port = await navigator.serial.requestPort()
-		await port.open({ baudRate: BAUD_RATE })
-		writer = port.writable.getWriter()
+		const link = await openDevice(port, BAUD_RATE)
+		writer = link.writer
+		device = link.device
+		configure(link.caps)
+		paced = createPacedWriter(writer, device, writeFailed)
 		return true
 	} catch (err) {
 		console.error('Serial connect error:', err)
@@ -32,45 +61,85 @@ export async function connect() {
 }
 
 /**
- * @returns {boolean} whether a serial connection is active
+ * Open a WebSocket to the wireless client.
+ * @param {string} url — e.g. 'ws://192.168.1.103:81'
+ * @returns {Promise<boolean>} true on success
+ */
+export async function connectWebSocket(url) {
+	try {
+		writer = await openWebSocket(url)
+		configure(DEFAULT_CAPS) // Start over with a full frame
+		paced = createPacedWriter(writer, null, writeFailed)
+		return true
+	} catch (err) {
+		console.error('WebSocket connect error:', err)
+		writer = null
+		return false
+	}
+}
+
+/**
+ * @returns {boolean} whether a serial or WebSocket connection is active
  */
 export function isConnected() {
 	return writer !== null
 }
 
 /**
- * Send a full frame of pixel data extracted from the canvas.
- * Converts RGBA → RGB565 and prepends the start marker.
+ * @returns {object} what the connected device accepts (DEFAULT_CAPS if it did not say)
+ */
+export function getCapabilities() {
+	return caps
+}
+
+/**
+ * Send a frame of pixel data extracted from the canvas.
+ * Converts RGBA → RGB565 and sends it in the smallest format available.
  *
  * @param {ImageData} imageData — canvas pixel data (RGBA)
- * @param {Uint8Array} buffer   — pre-allocated send buffer (1 + W*H*2 bytes)
+ * @param {Uint8Array} buffer   — pre-allocated frame buffer (createFrameBuffer(W*H*2))
  */
 export async function sendFrame(imageData, buffer) {
 	if (!writer) return
 
-	const pixels = imageData.data
-	buffer[0] = 42 // '*'
-	let idx = 1
-
-	for (let i = 0; i < pixels.length; i += 4) {
-		const r = pixels[i]
-		const g = pixels[i + 1]
-		const b = pixels[i + 2]
-		const rgb16 = packRGB565(r, g, b)
-		buffer[idx++] = (rgb16 >> 8) & 0xff // high byte
-		buffer[idx++] = rgb16 & 0xff         // low byte
+	const pixels = fitImage(imageData, caps.width, caps.height).data
+	if (buffer.length < frameBuffer.length) buffer = frameBuffer
+
+	for (let i = 0, j = 0; i < pixels.length; i += 4, j++) {
+		latest[j] = packRGB565(pixels[i], pixels[i + 1], pixels[i + 2])
 	}
 
+	const encode = () => {
+		encoder.pixels.set(latest)
+		return encoder.encode(buffer)
+	}
 	try {
-		await writer.write(buffer)
+		await paced.write(encode, (sent) => {
+			if (sent !== false) encoder.commit() // false: dropped by the WebSocket
+		})
 	} catch (err) {
-		console.error('Serial write error:', err)
-		writer = null
+		writeFailed(err)
 	}
 }
 
 // ── Helpers ──────────────────────────────────────────────────────────────────
 
+// A frame did not get out: the connection is gone
+function writeFailed(err) {
+	console.error('Serial write error:', err)
+	writer = null
+	encoder.reset()
+}
+
+// Sizes the encoder to the device and picks its encodings
+function configure(deviceCaps) {
+	caps = deviceCaps
+	console.log(`Device: ${caps.width}×${caps.height}, formats ${[...caps.formats].map((f) => f.toString(16)).join(' ')}`)
+	encoder = createFrameEncoder(caps.width, caps.height, pickEncoding(caps))
+	frameBuffer = createFrameBuffer(caps.width * caps.height * 2)
+	latest = new Uint16Array(caps.width * caps.height)
+}
+
 /**
  * Pack 8-bit RGB into 16-bit RGB565.
  * Layout: RRRRRGGG GGGBBBBB
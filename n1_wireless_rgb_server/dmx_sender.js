@@ -0,0 +1,182 @@
+// Sends a test animation as Art-Net or sACN (E1.31) universes, the way a
+// lighting desk would, to try the client's DMX mode (or
+// x2_wirelss_rgb_client/bench/dmx_receive on this machine).
+//
+// Pixels are RGB, 170 per universe. Red and green scroll a gradient, the
+// blue channel of every pixel holds the frame counter so a receiver can
+// tell whether a frame was shown torn. With --sync 1 a sync packet
+// (ArtSync / E1.31 sync) follows each frame and --shuffle 1 sends the
+// universes of a frame in random order.
+//
+// Usage:
+//   node dmx_sender.js [--protocol artnet|sacn] [--target 127.0.0.1] [--port 6454|5568]
+//                      [--universe 0|1] [--pixels 1024] [--fps 40] [--sync 0]
+//                      [--sync-address 7000] [--multicast 0] [--shuffle 0]
+
+const dgram = require('dgram');
+const crypto = require('crypto');
+
+const options = {
+	'protocol': 'artnet',
+	'target': '127.0.0.1',
+	'port': 0,
+	'universe': -1,
+	'pixels': 1024,
+	'width': 32,
+	'fps': 40,
+	'sync': 0,
+	'sync-address': 7000,
+	'multicast': 0,
+	'shuffle': 0,
+};
+
+for (let i = 2; i < process.argv.length; i += 2) {
+	const key = process.argv[i].replace(/^--/, '');
+	if (!(key in options) || i + 1 >= process.argv.length) {
+		console.error(`Unknown or incomplete option ${process.argv[i]}`);
+		process.exit(1);
+	}
+	options[key] = typeof options[key] === 'number' ? Number(process.argv[i + 1]) : process.argv[i + 1];
+}
+
+const SACN = options.protocol === 'sacn';
+const PORT = options.port || (SACN ? 5568 : 6454);
+const START = options.universe >= 0 ? options.universe : (SACN ? 1 : 0);
+const PIXELS_PER_UNIVERSE = 170;
+const UNIVERSES = Math.ceil(options.pixels / PIXELS_PER_UNIVERSE);
+const SYNC_ADDRESS = options.sync ? options['sync-address'] : 0;
+
+const CID = crypto.randomBytes(16);
+const SOURCE_NAME = 'n1 dmx_sender';
+
+// -- Art-Net ---------------------------------------------------------------
+
+function artDmx(universe, sequence, data) {
+	const length = data.length + (data.length & 1); // Must be even
+	const packet = Buffer.alloc(18 + length);
+	packet.write('Art-Net\0', 0, 'ascii');
+	packet.writeUInt16LE(0x5000, 8);
+	packet.writeUInt16BE(14, 10);            // Protocol version
+	packet[12] = sequence;
+	packet[13] = 0;                          // Physical
+	packet[14] = universe & 0xFF;            // SubUni
+	packet[15] = (universe >> 8) & 0x7F;     // Net
+	packet.writeUInt16BE(length, 16);
+	data.copy(packet, 18);
+	return packet;
+}
+
+function artSync() {
+	const packet = Buffer.alloc(14);
+	packet.write('Art-Net\0', 0, 'ascii');
+	packet.writeUInt16LE(0x5200, 8);
+	packet.writeUInt16BE(14, 10);
+	return packet;
+}
+
+// -- sACN (E1.31) ----------------------------------------------------------
+
+function rootLayer(packet, vector) {
+	packet.writeUInt16BE(0x0010, 0);         // Preamble size
+	packet.writeUInt16BE(0x0000, 2);         // Postamble size
+	packet.write('ASC-E1.17\0\0\0', 4, 'ascii');
+	packet.writeUInt16BE(0x7000 | (packet.length - 16), 16);
+	packet.writeUInt32BE(vector, 18);
+	CID.copy(packet, 22);
+}
+
+function e131Data(universe, sequence, data) {
+	const packet = Buffer.alloc(126 + data.length);
+	rootLayer(packet, 0x00000004);
+	packet.writeUInt16BE(0x7000 | (packet.length - 38), 38);
+	packet.writeUInt32BE(0x00000002, 40);
+	packet.write(SOURCE_NAME, 44, 'utf8');
+	packet[108] = 100;                       // Priority
+	packet.writeUInt16BE(SYNC_ADDRESS, 109);
+	packet[111] = sequence;
+	packet[112] = 0;                         // Options
+	packet.writeUInt16BE(universe, 113);
+	packet.writeUInt16BE(0x7000 | (packet.length - 115), 115);
+	packet[117] = 0x02;                      // DMP vector: set property
+	packet[118] = 0xA1;                      // Address and data type
+	packet.writeUInt16BE(0, 119);            // First property address
+	packet.writeUInt16BE(1, 121);            // Address increment
+	packet.writeUInt16BE(data.length + 1, 123);
+	packet[125] = 0;                         // Start code
+	data.copy(packet, 126);
+	return packet;
+}
+
+function e131Sync(sequence) {
+	const packet = Buffer.alloc(49);
+	rootLayer(packet, 0x00000008);
+	packet.writeUInt16BE(0x7000 | (packet.length - 38), 38);
+	packet.writeUInt32BE(0x00000001, 40);
+	packet[44] = sequence;
+	packet.writeUInt16BE(SYNC_ADDRESS, 45);
+	return packet;
+}
+
+function sacnAddress(universe) {
+	return options.multicast ? `239.255.${universe >> 8}.${universe & 0xFF}` : options.target;
+}
+
+// -- Sending ---------------------------------------------------------------
+
+const socket = dgram.createSocket('udp4');
+const pixels = Buffer.alloc(options.pixels * 3);
+const sequences = new Array(UNIVERSES + 1).fill(0);
+let frame = 0;
+let sent = 0;
+
+// Art-Net sequence numbers skip 0 (which means "not used")
+function nextSequence(i) {
+	sequences[i] = (sequences[i] + 1) & 0xFF;
+	if (!SACN && sequences[i] === 0) sequences[i] = 1;
+	return sequences[i];
+}
+
+function send(packet, address) {
+	socket.send(packet, PORT, address);
+	sent++;
+}
+
+function render() {
+	const shift = frame % 256;
+	for (let i = 0; i < options.pixels; i++) {
+		const x = i % options.width;
+		const y = Math.floor(i / options.width);
+		pixels[i * 3] = (x * 8 + shift) & 0xFF;
+		pixels[i * 3 + 1] = (y * 8) & 0xFF;
+		pixels[i * 3 + 2] = frame & 0xFF;
+	}
+}
+
+function sendFrame() {
+	render();
+
+	const order = [...Array(UNIVERSES).keys()];
+	if (options.shuffle) order.sort(() => Math.random() - 0.5);
+
+	for (const i of order) {
+		const universe = START + i;
+		const data = pixels.subarray(i * PIXELS_PER_UNIVERSE * 3, Math.min((i + 1) * PIXELS_PER_UNIVERSE * 3, pixels.length));
+		const sequence = nextSequence(i);
+		if (SACN) send(e131Data(universe, sequence, data), sacnAddress(universe));
+		else send(artDmx(universe, sequence, data), options.target);
+	}
+
+	if (options.sync) {
+		if (SACN) send(e131Sync(nextSequence(UNIVERSES)), sacnAddress(SYNC_ADDRESS));
+		else send(artSync(), options.target);
+	}
+	frame++;
+}
+
+socket.bind(() => {
+	socket.setBroadcast(true);
+	console.log(`${SACN ? 'sACN' : 'Art-Net'} to ${options.target}:${PORT}, universes ${START}-${START + UNIVERSES - 1}, ` +
+		`${options.fps} fps${options.sync ? ', with sync' : ''}`);
+	setInterval(sendFrame, 1000 / options.fps);
+	setInterval(() => console.log(`${frame} frames, ${sent} packets`), 1000);
+});
@@ -1,52 +1,167 @@
 const dgram = require('dgram');
+const fs = require('fs');
+const protocol = require('./protocol');
 
 const server = dgram.createSocket('udp4');
 
 const UDP_PORT = 44444;
-const CLIENT_ADDRESS = '192.168.1.103';
+const CLIENT_ADDRESS = process.env.CLIENT_ADDRESS || '192.168.1.103';
+const CLIENT_PORT = Number(process.env.CLIENT_PORT) || UDP_PORT;
 
-const COLOR_DEPTH = 16;
-const CHUNK_SIZE = 1024; // Safe UDP packet size
+let COLOR_DEPTH = 16; // 24 if the client does not take RGB565
+const PRESENTATION_TIMESTAMPS = true; // Let the client pace frames by their send time
+const PARITY_GROUPS = Number(process.env.PARITY_GROUPS ?? 1); // Parity chunks per frame, 0 = no FEC
 
-const TOTAL_WIDTH = 32;
-const TOTAL_HEIGHT = 32;
+// Until the client says otherwise (see queryCapabilities())
+let TOTAL_WIDTH = 32;
+let TOTAL_HEIGHT = 32;
+
+const QUERY_ATTEMPTS = 10;
+const QUERY_INTERVAL = 300; // ms between queries while the client does not answer
 
 const INTERVAL = 1000 / 120; // 60 FPS
 
-// Create a buffer of 32x32 pixels with 16-bit color (2 bytes per pixel)
-const pixels = new Uint8Array(TOTAL_WIDTH * TOTAL_HEIGHT * (COLOR_DEPTH / 8));
+// Per-stage latency from the client's FORMAT_TIMING echoes, see onTiming()
+const TIMING_LOG = process.env.TIMING_LOG || ''; // CSV file for x1_serial_rgb_client/bench/timing_summary
+const TIMING_REPORT_INTERVAL = 10000; // ms between latency summaries on the console
+const TIMING_PENDING = 64; // Frames sent that may still be echoed
+const TIMING_STAGES = ['encode', 'send', 'wire', 'decode', 'swap', 'link', 'total'];
 
-server.bind(UDP_PORT);
+// Pixels of one frame in the wire format, allocated once the size is known
+let pixels = null;
 
-// Function to send pixels in chunks
-function sendPixels(pixels, clientAddress = CLIENT_ADDRESS, clientPort = UDP_PORT, chunkSize = CHUNK_SIZE) {
+let frameId = 0;
 
-    const totalChunks = Math.ceil(pixels.length / chunkSize);
+// Function to send pixels as one protocol frame, split into chunks.
+// The frame is stamped with the time it was rendered; the client shows
+// it at that time (mapped onto its clock) plus its jitter buffer delay.
+function sendPixels(pixels, clientAddress = CLIENT_ADDRESS, clientPort = CLIENT_PORT,
+                    timestamp = PRESENTATION_TIMESTAMPS ? protocol.timestampUs() : undefined) {
 
-    for (let i = 0; i < totalChunks; i++) {
-        const start = i * chunkSize;
-        const end = Math.min(start + chunkSize, pixels.length);
-        const chunk = pixels.slice(start, end);
+    const format = COLOR_DEPTH === 16 ? protocol.FORMAT_RGB565 : protocol.FORMAT_RGB888;
+    const id = frameId;
+    frameId = (frameId + 1) & 0xFFFF;
 
-        // Prepend chunk index and total chunks to the data
-        const chunkHeader = new Uint8Array([i, totalChunks]);
-        const chunkWithHeader = new Uint8Array(chunkHeader.length + chunk.length);
-        chunkWithHeader.set(chunkHeader);
-        chunkWithHeader.set(chunk, chunkHeader.length);
+    const host = { startedAt: nowUs(), encodedAt: 0, sentAt: 0 };
+    const chunks = protocol.chunkFrame(protocol.encodeFrame(format, id, pixels), id, timestamp, PARITY_GROUPS);
+    host.encodedAt = nowUs();
+    timingSent(id, host);
 
-        server.send(chunkWithHeader, clientPort, clientAddress, (err) => {
+    let left = chunks.length;
+    chunks.forEach((chunk, i) => {
+        server.send(chunk, clientPort, clientAddress, (err) => {
             if (err) {
-                console.log(`Error sending chunk ${i}:`, err);
-            } else {
-                console.log(`Chunk ${i + 1}/${totalChunks} sent to ${clientAddress}:${clientPort}`);
+                console.log(`Error sending chunk ${i} of frame ${id}:`, err);
             }
+            if (--left === 0) host.sentAt = nowUs();
         });
-    }
+    });
+}
+
+// Host clock in µs, for differences only
+function nowUs() {
+	return Number(process.hrtime.bigint() / 1000n);
+}
+
+// Frames sent, by id, until the client echoes them
+const timingPending = new Map();
+const timingRows = [];
+const timingFile = TIMING_LOG ? fs.createWriteStream(TIMING_LOG) : null;
+timingFile?.write(['id'].concat(TIMING_STAGES.map((stage) => `${stage}_us`)).join(',') + '\n');
+let timingReportedAt = Date.now();
+
+function timingSent(id, host) {
+	timingPending.set(id, host);
+	if (timingPending.size > TIMING_PENDING) timingPending.delete(timingPending.keys().next().value); // Never shown
 }
 
+// Splits a frame's latency into stages (µs): encoding and chunking, sending
+// the datagrams, first to last chunk on the client, last chunk to decoded
+// (including the jitter buffer's delay), the swap, and what the total from
+// sendPixels() to the echo leaves for the network both ways (link). Host
+// and client clocks are never compared, only differences on each side.
+function onTiming(timing) {
+	const host = timingPending.get(timing.frameId);
+	if (!host || !host.sentAt) return;
+	timingPending.delete(timing.frameId);
+
+	const row = [
+		host.encodedAt - host.startedAt,
+		host.sentAt - host.encodedAt,
+		(timing.lastByteUs - timing.firstByteUs) >>> 0,
+		(timing.decodedUs - timing.lastByteUs) >>> 0,
+		(timing.swappedUs - timing.decodedUs) >>> 0,
+		0,
+		nowUs() - host.startedAt,
+	];
+	row[5] = Math.max(0, row[6] - row[0] - row[2] - row[3] - row[4]);
+	timingRows.push(row);
+	timingFile?.write([timing.frameId].concat(row).join(',') + '\n');
+
+	if (Date.now() - timingReportedAt < TIMING_REPORT_INTERVAL) return;
+	const table = {};
+	TIMING_STAGES.forEach((stage, i) => {
+		const values = timingRows.map((r) => r[i]).sort((a, b) => a - b);
+		const at = (p) => values[Math.min(values.length - 1, Math.floor(p * values.length))];
+		table[stage] = { count: values.length, p50: at(0.5), p90: at(0.9), p99: at(0.99), max: values[values.length - 1] };
+	});
+	console.table(table);
+	timingRows.length = 0;
+	timingReportedAt = Date.now();
+}
+
+// Asks the client for its resolution and formats. Resolves with the
+// capabilities, or null if it does not answer (older firmware).
+function queryCapabilities() {
+	return new Promise((resolve) => {
+		const query = protocol.encodeFrame(protocol.FORMAT_QUERY, 0, new Uint8Array(0));
+		let attempts = 0;
+
+		const onMessage = (message) => {
+			const frame = protocol.decodeFrame(message);
+			const caps = frame && frame.format === protocol.FORMAT_CAPS && protocol.parseCapabilities(frame.payload);
+			if (caps) finish(caps);
+		};
+		const ask = () => {
+			if (attempts++ === QUERY_ATTEMPTS) return finish(null);
+			server.send(query, CLIENT_PORT, CLIENT_ADDRESS);
+		};
+		const timer = setInterval(ask, QUERY_INTERVAL);
+		function finish(caps) {
+			clearInterval(timer);
+			server.off('message', onMessage);
+			resolve(caps);
+		}
+
+		server.on('message', onMessage);
+		ask();
+	});
+}
+
+// Full frames only: the client drops deltas after a lost frame until the
+// next keyframe, so the smallest usable format is RGB565, else RGB888
+server.bind(UDP_PORT, async () => {
+	const caps = await queryCapabilities();
+	if (caps) {
+		TOTAL_WIDTH = caps.width;
+		TOTAL_HEIGHT = caps.height;
+		COLOR_DEPTH = caps.formats.has(protocol.FORMAT_RGB565) ? 16 : 24;
+		console.log(`Client ${CLIENT_ADDRESS}: ${TOTAL_WIDTH}x${TOTAL_HEIGHT}, ${caps.frameSlots} frame buffers, sending ${COLOR_DEPTH} bit`);
+	} else {
+		console.log(`No answer from ${CLIENT_ADDRESS}, sending ${TOTAL_WIDTH}x${TOTAL_HEIGHT} at ${COLOR_DEPTH} bit`);
+	}
+	pixels = new Uint8Array(TOTAL_WIDTH * TOTAL_HEIGHT * (COLOR_DEPTH / 8));
+	server.on('message', (message) => {
+		const frame = protocol.decodeFrame(message);
+		const timing = frame && frame.format === protocol.FORMAT_TIMING && protocol.parseTiming(frame.payload);
+		if (timing) onTiming(timing);
+	});
+	setInterval(renderFrame, INTERVAL);
+});
+
 let frame = 0;
 
-setInterval(() => {
+function renderFrame() {
 
 	// Gradient
 	if (frame % pixels.length == 0) {
@@ -139,18 +254,24 @@ setInterval(() => {
 			// const d = Math.sqrt(u * u + v * v);
 			// const gray = (Math.sin(d * 7.0 - frame * 0.3) * 0.5 + 0.5) * 255.0;
 			// const rgb16 = rgb565(gray, gray, gray);
-			const rgb16 = rgb565(color.r, color.g, color.b)
-			const bytes = getBytesFrom16Bit(rgb16);
-
-			pixels[idx++] = bytes[0];
-			pixels[idx++] = bytes[1];
+			if (COLOR_DEPTH === 16) {
+				const rgb16 = rgb565(color.r, color.g, color.b)
+				const bytes = getBytesFrom16Bit(rgb16);
+
+				pixels[idx++] = bytes[0];
+				pixels[idx++] = bytes[1];
+			} else {
+				pixels[idx++] = color.r;
+				pixels[idx++] = color.g;
+				pixels[idx++] = color.b;
+			}
 		}
 	}
 	frame++
 
     sendPixels(pixels);
 
-}, INTERVAL);
+}
 
 
 // -- HELPERS ---------------------------------------------------------------
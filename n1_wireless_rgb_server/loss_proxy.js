@@ -0,0 +1,98 @@
+// Forwards UDP datagrams while dropping, reordering and duplicating some
+// of them, to measure how the client copes with a noisy Wi-Fi link.
+//
+// Losses follow a two-state (Gilbert-Elliott) model: in the "bad" state
+// every datagram is lost, in the "good" state none. --loss sets the long
+// term loss rate, --burst the average number of datagrams lost in a row
+// (1 = independent losses).
+//
+// Usage:
+//   node loss_proxy.js [--listen 44445] [--target 127.0.0.1:44446]
+//                      [--loss 0.07] [--burst 1] [--reorder 0] [--duplicate 0]
+//
+// Example, measuring forward error correction on one machine:
+//   ../x2_wirelss_rgb_client/bench/udp_receive 44446
+//   node loss_proxy.js --loss 0.07
+//   CLIENT_ADDRESS=127.0.0.1 CLIENT_PORT=44445 PARITY_GROUPS=1 node index.js
+
+const dgram = require('dgram');
+
+const options = {
+	listen: 44445,
+	target: '127.0.0.1:44446',
+	loss: 0.07,
+	burst: 1,
+	reorder: 0,
+	duplicate: 0,
+	seed: 1,
+};
+
+for (let i = 2; i < process.argv.length; i += 2) {
+	const key = process.argv[i].replace(/^--/, '');
+	if (!(key in options) || i + 1 >= process.argv.length) {
+		console.error(`Unknown or incomplete option ${process.argv[i]}`);
+		process.exit(1);
+	}
+	options[key] = typeof options[key] === 'number' ? Number(process.argv[i + 1]) : process.argv[i + 1];
+}
+
+const [targetHost, targetPort] = options.target.split(':');
+
+// Repeatable runs for the same seed
+let seed = options.seed;
+function random() {
+	seed = (seed * 1103515245 + 12345) & 0x7fffffff;
+	return seed / 0x80000000;
+}
+
+// Transition probabilities for the requested loss rate and burst length
+const leaveBad = 1 / Math.max(1, options.burst);
+const enterBad = options.loss >= 1 ? 1 : options.loss * leaveBad / (1 - options.loss);
+let bad = false;
+
+const stats = { received: 0, forwarded: 0, dropped: 0, reordered: 0, duplicated: 0 };
+let held = null; // Datagram waiting to be sent after the next one
+
+const socket = dgram.createSocket('udp4');
+
+function forward(message) {
+	socket.send(message, Number(targetPort), targetHost);
+	stats.forwarded++;
+}
+
+socket.on('message', (message) => {
+	stats.received++;
+
+	bad = bad ? random() >= leaveBad : random() < enterBad;
+	if (bad) {
+		stats.dropped++;
+		return;
+	}
+
+	if (held === null && random() < options.reorder) {
+		held = message;
+		stats.reordered++;
+		return;
+	}
+
+	forward(message);
+	if (random() < options.duplicate) {
+		forward(message);
+		stats.duplicated++;
+	}
+	if (held !== null) {
+		forward(held);
+		held = null;
+	}
+});
+
+socket.bind(options.listen, () => {
+	console.log(`Forwarding :${options.listen} → ${options.target}, loss ${options.loss}, burst ${options.burst}, ` +
+		`reorder ${options.reorder}, duplicate ${options.duplicate}`);
+});
+
+setInterval(() => {
+	const rate = stats.received ? (100 * stats.dropped / stats.received).toFixed(1) : '0.0';
+	console.log(`${stats.received} in, ${stats.forwarded} out, ${stats.dropped} dropped (${rate}%), ` +
+		`${stats.reordered} reordered, ${stats.duplicated} duplicated`);
+}, 1000);
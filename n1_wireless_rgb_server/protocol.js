@@ -0,0 +1,258 @@
+// Frame protocol and UDP chunking, matching src/common/frame_protocol.h
+// and src/common/chunk_reassembly.h of x2_wirelss_rgb_client.
+//
+// Frame: 'P' 'X' version format id(u16 LE) length(u16 LE) payload CRC32(LE)
+// Chunk: 'C' index count flags frameId(u16 LE) [timestamp(u32 LE)]
+//        [tileX(u16 LE) tileY(u16 LE)] data (at most CHUNK_DATA_SIZE bytes of it)
+//
+// With CHUNK_FLAG_TIMESTAMP the chunks carry the time the frame should be
+// shown, in microseconds of the sender's clock (see timestampUs()). The
+// client maps it onto its own clock and presents the frame at that moment
+// plus a fixed delay, see src/common/jitter_buffer.h of the client.
+//
+// With parity groups G > 0 (flag bits 4-6) data chunk i belongs to group
+// i % G, and G parity chunks (CHUNK_FLAG_PARITY, index = group) follow the
+// data, each the XOR of its group's chunks. The client rebuilds one lost
+// chunk per group, i.e. up to G lost in a row.
+//
+// Video wall (src/common/wall_sync.h): every tile's part of the wall image
+// is sent as a frame of its own, its chunks tagged with the tile offset
+// (CHUNK_FLAG_TILE), and shown by all tiles together once a commit beacon
+// 'G' flags frameId(u16 LE) presentAt(u32 LE) names the frame id.
+//
+// A frame with FORMAT_QUERY and no payload, sent as a datagram of its own,
+// asks the client what it accepts; it answers with a FORMAT_CAPS frame
+// (see parseCapabilities()) to the sender's address and port.
+//
+// Clients built with TIMING_ECHO answer every frame they show with a
+// FORMAT_TIMING frame (see parseTiming()) to where the last datagram came
+// from.
+
+const MAGIC_0 = 0x50; // 'P'
+const MAGIC_1 = 0x58; // 'X'
+const VERSION = 1;
+const HEADER_SIZE = 8;
+const CRC_SIZE = 4;
+
+const FORMAT_RGB565 = 0x01;
+const FORMAT_RGB888 = 0x02;
+const FORMAT_RECTS_RGB565 = 0x03;
+const FORMAT_XOR_RLE_RGB565 = 0x04;
+const FORMAT_QUERY = 0x20;
+const FORMAT_CAPS = 0x21;
+const FORMAT_TIMING = 0x25;
+const CAPS_HEADER_SIZE = 17;
+const CAPS_VERSION = 1;
+const TIMING_SIZE = 18;
+
+const CHUNK_MAGIC = 0x43; // 'C'
+const CHUNK_HEADER_SIZE = 6;
+const CHUNK_TIMESTAMP_SIZE = 4;
+const CHUNK_FLAG_TIMESTAMP = 0x01;
+const CHUNK_FLAG_PARITY = 0x02;
+const CHUNK_FLAG_TILE = 0x04;
+const CHUNK_TILE_SIZE = 4;
+const CHUNK_PARITY_SHIFT = 4;
+const CHUNK_MAX_PARITY = 7;
+const CHUNK_DATA_SIZE = 1024;
+const CHUNK_MAX_COUNT = 32;
+
+const WALL_BEACON_MAGIC = 0x47; // 'G'
+const WALL_BEACON_SIZE = 8;
+
+const CRC_TABLE = new Uint32Array(256);
+for (let i = 0; i < 256; i++) {
+	let c = i;
+	for (let k = 0; k < 8; k++) c = c & 1 ? 0xEDB88320 ^ (c >>> 1) : c >>> 1;
+	CRC_TABLE[i] = c >>> 0;
+}
+
+function crc32(data, start = 0, end = data.length) {
+	let crc = 0xFFFFFFFF;
+	for (let i = start; i < end; i++) crc = CRC_TABLE[(crc ^ data[i]) & 0xFF] ^ (crc >>> 8);
+	return (crc ^ 0xFFFFFFFF) >>> 0;
+}
+
+/**
+ * Wraps a payload in a protocol frame.
+ * @param format One of the FORMAT_ constants
+ * @param id Frame id, wraps at 16 bits
+ * @param payload Uint8Array
+ * @returns {Buffer} The complete frame
+ */
+function encodeFrame(format, id, payload) {
+	const frame = Buffer.alloc(HEADER_SIZE + payload.length + CRC_SIZE);
+	frame[0] = MAGIC_0;
+	frame[1] = MAGIC_1;
+	frame[2] = VERSION;
+	frame[3] = format;
+	frame.writeUInt16LE(id & 0xFFFF, 4);
+	frame.writeUInt16LE(payload.length, 6);
+	frame.set(payload, HEADER_SIZE);
+	frame.writeUInt32LE(crc32(frame, 0, HEADER_SIZE + payload.length), HEADER_SIZE + payload.length);
+	return frame;
+}
+
+/**
+ * Checks a frame received as one datagram.
+ * @param data Buffer holding exactly one frame
+ * @returns {{format: number, id: number, payload: Buffer}|null} null if it is not a valid frame
+ */
+function decodeFrame(data) {
+	if (data.length < HEADER_SIZE + CRC_SIZE || data[0] !== MAGIC_0 || data[1] !== MAGIC_1 || data[2] !== VERSION) return null;
+	const length = data.readUInt16LE(6);
+	if (data.length !== HEADER_SIZE + length + CRC_SIZE) return null;
+	if (data.readUInt32LE(HEADER_SIZE + length) !== crc32(data, 0, HEADER_SIZE + length)) return null;
+	return { format: data[3], id: data.readUInt16LE(4), payload: data.subarray(HEADER_SIZE, HEADER_SIZE + length) };
+}
+
+/**
+ * Decodes a FORMAT_CAPS payload (src/common/frame_protocol.h, DeviceCaps).
+ * @param payload Buffer
+ * @returns {{width, height, maxPayload, frameSlots, baud, maxBaud, formats: Set<number>}|null}
+ */
+function parseCapabilities(payload) {
+	if (payload.length < CAPS_HEADER_SIZE || payload[0] !== CAPS_VERSION) return null;
+	const count = payload[16];
+	if (payload.length < CAPS_HEADER_SIZE + count) return null;
+	return {
+		width: payload.readUInt16LE(1),
+		height: payload.readUInt16LE(3),
+		maxPayload: payload.readUInt16LE(5),
+		frameSlots: payload[7],
+		baud: payload.readUInt32LE(8),
+		maxBaud: payload.readUInt32LE(12),
+		formats: new Set(payload.subarray(CAPS_HEADER_SIZE, CAPS_HEADER_SIZE + count)),
+	};
+}
+
+/**
+ * Decodes a FORMAT_TIMING payload (src/common/frame_protocol.h, FrameTiming):
+ * the client's micros() when the frame's first and last chunk arrived,
+ * when it was decoded and when the swap showing it was done.
+ * @param payload Buffer
+ * @returns {{frameId, firstByteUs, lastByteUs, decodedUs, swappedUs}|null}
+ */
+function parseTiming(payload) {
+	if (payload.length < TIMING_SIZE) return null;
+	return {
+		frameId: payload.readUInt16LE(0),
+		firstByteUs: payload.readUInt32LE(2),
+		lastByteUs: payload.readUInt32LE(6),
+		decodedUs: payload.readUInt32LE(10),
+		swappedUs: payload.readUInt32LE(14),
+	};
+}
+
+/**
+ * The sender clock for presentation timestamps: microseconds, wrapping at
+ * 32 bits like micros() on the client.
+ * @returns {number}
+ */
+function timestampUs() {
+	return Number((process.hrtime.bigint() / 1000n) & 0xFFFFFFFFn);
+}
+
+/**
+ * Splits a frame into datagrams, each with its chunk header.
+ * @param frame Buffer returned by encodeFrame
+ * @param id The frame id used for the frame
+ * @param timestamp Optional presentation time from timestampUs()
+ * @param parityGroups Parity chunks to add, 0 for none
+ * @param tile Optional {x, y} offset of the wall tile the frame is for
+ * @returns {Buffer[]} Data chunks, then parity chunks
+ */
+function chunkFrame(frame, id, timestamp, parityGroups = 0, tile) {
+	const count = Math.ceil(frame.length / CHUNK_DATA_SIZE);
+	if (count > CHUNK_MAX_COUNT) throw new Error(`Frame of ${frame.length} bytes needs more than ${CHUNK_MAX_COUNT} chunks`);
+	const groups = Math.min(parityGroups, count, CHUNK_MAX_PARITY);
+
+	const timed = timestamp !== undefined;
+	const tiled = tile !== undefined;
+	const headerSize = CHUNK_HEADER_SIZE + (timed ? CHUNK_TIMESTAMP_SIZE : 0) + (tiled ? CHUNK_TILE_SIZE : 0);
+	const flags = (timed ? CHUNK_FLAG_TIMESTAMP : 0) | (tiled ? CHUNK_FLAG_TILE : 0) | (groups << CHUNK_PARITY_SHIFT);
+
+	const header = (index, flags, size) => {
+		const chunk = Buffer.alloc(headerSize + size);
+		chunk[0] = CHUNK_MAGIC;
+		chunk[1] = index;
+		chunk[2] = count;
+		chunk[3] = flags;
+		chunk.writeUInt16LE(id & 0xFFFF, 4);
+		let offset = CHUNK_HEADER_SIZE;
+		if (timed) {
+			chunk.writeUInt32LE(timestamp >>> 0, offset);
+			offset += CHUNK_TIMESTAMP_SIZE;
+		}
+		if (tiled) {
+			chunk.writeUInt16LE(tile.x, offset);
+			chunk.writeUInt16LE(tile.y, offset + 2);
+		}
+		return chunk;
+	};
+
+	const chunks = [];
+	for (let i = 0; i < count; i++) {
+		const data = frame.subarray(i * CHUNK_DATA_SIZE, Math.min((i + 1) * CHUNK_DATA_SIZE, frame.length));
+		const chunk = header(i, flags, data.length);
+		chunk.set(data, headerSize);
+		chunks.push(chunk);
+	}
+
+	for (let g = 0; g < groups; g++) {
+		// Only a group holding nothing but the short last chunk has shorter parity
+		const size = g < count - 1 ? CHUNK_DATA_SIZE : frame.length - g * CHUNK_DATA_SIZE;
+		const chunk = header(g, flags | CHUNK_FLAG_PARITY, size);
+		for (let i = g; i < count; i += groups) {
+			const data = chunks[i];
+			for (let j = headerSize; j < data.length; j++) chunk[j] ^= data[j];
+		}
+		chunks.push(chunk);
+	}
+	return chunks;
+}
+
+/**
+ * The commit beacon of a video wall frame.
+ * @param id The frame id all tiles of the frame were sent with
+ * @param presentAt Presentation time from timestampUs()
+ * @returns {Buffer}
+ */
+function encodeWallBeacon(id, presentAt) {
+	const beacon = Buffer.alloc(WALL_BEACON_SIZE);
+	beacon[0] = WALL_BEACON_MAGIC;
+	beacon[1] = 0;
+	beacon.writeUInt16LE(id & 0xFFFF, 2);
+	beacon.writeUInt32LE(presentAt >>> 0, 4);
+	return beacon;
+}
+
+module.exports = {
+	HEADER_SIZE,
+	CRC_SIZE,
+	FORMAT_RGB565,
+	FORMAT_RGB888,
+	FORMAT_RECTS_RGB565,
+	FORMAT_XOR_RLE_RGB565,
+	FORMAT_QUERY,
+	FORMAT_CAPS,
+	FORMAT_TIMING,
+	CHUNK_HEADER_SIZE,
+	CHUNK_TIMESTAMP_SIZE,
+	CHUNK_FLAG_TIMESTAMP,
+	CHUNK_FLAG_PARITY,
+	CHUNK_FLAG_TILE,
+	CHUNK_TILE_SIZE,
+	CHUNK_MAX_PARITY,
+	CHUNK_DATA_SIZE,
+	CHUNK_MAX_COUNT,
+	WALL_BEACON_SIZE,
+	crc32,
+	encodeFrame,
+	decodeFrame,
+	parseCapabilities,
+	parseTiming,
+	timestampUs,
+	chunkFrame,
+	encodeWallBeacon,
+};
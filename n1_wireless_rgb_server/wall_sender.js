@@ -0,0 +1,125 @@
+// Drives a video wall of several x2_wirelss_rgb_client boards (built with
+// WALL_TILE, WALL_TILE_X / WALL_TILE_Y set to their tile's x / y).
+//
+// The layout file describes the wall image and where each tile sits in it
+// (see wall.json). Every frame the whole wall is rendered, each tile's
+// viewport is cut out and sent as a frame of its own, tagged with the tile
+// offset, all with the same frame id, to the multicast group. After
+// commitDelayMs (time for every tile to receive its part) a commit beacon
+// names the frame id, and all tiles swap together.
+//
+// The test pattern is a bar sweeping across the whole wall, which shows
+// tearing at the tile edges, and the frame id in the blue channel of
+// every pixel, which lets x2_wirelss_rgb_client/bench/wall_receive check
+// that the tiles agree.
+//
+// Usage:
+//   node wall_sender.js [--layout wall.json] [--interface 192.168.1.10] [--loopback 0]
+
+const dgram = require('dgram');
+const fs = require('fs');
+const path = require('path');
+const protocol = require('./protocol');
+
+const options = {
+	'layout': path.join(__dirname, 'wall.json'),
+	'interface': '',
+	'loopback': 0,
+};
+
+for (let i = 2; i < process.argv.length; i += 2) {
+	const key = process.argv[i].replace(/^--/, '');
+	if (!(key in options) || i + 1 >= process.argv.length) {
+		console.error(`Unknown or incomplete option ${process.argv[i]}`);
+		process.exit(1);
+	}
+	options[key] = typeof options[key] === 'number' ? Number(process.argv[i + 1]) : process.argv[i + 1];
+}
+
+const layout = JSON.parse(fs.readFileSync(options.layout, 'utf8'));
+const RGB565 = layout.format !== 'rgb888';
+const BYTES_PER_PIXEL = RGB565 ? 2 : 3;
+const FORMAT = RGB565 ? protocol.FORMAT_RGB565 : protocol.FORMAT_RGB888;
+
+for (const tile of layout.tiles) {
+	if (tile.x < 0 || tile.y < 0 || tile.x + tile.width > layout.width || tile.y + tile.height > layout.height) {
+		console.error(`Tile at ${tile.x},${tile.y} lies outside the ${layout.width}x${layout.height} wall`);
+		process.exit(1);
+	}
+	tile.pixels = new Uint8Array(tile.width * tile.height * BYTES_PER_PIXEL);
+}
+
+// The wall image, RGB888
+const wall = new Uint8Array(layout.width * layout.height * 3);
+
+function render(frame) {
+	const bar = frame % layout.width;
+	for (let y = 0; y < layout.height; y++) {
+		for (let x = 0; x < layout.width; x++) {
+			const i = (y * layout.width + x) * 3;
+			const d = Math.abs(x - bar);
+			wall[i] = d < 2 ? 255 : (x * 255 / layout.width) & 0xFF;
+			wall[i + 1] = d < 2 ? 255 : (y * 255 / layout.height) & 0xFF;
+			wall[i + 2] = frame & 0xFF;
+		}
+	}
+}
+
+// Copies a tile's viewport out of the wall image, in the wire format
+function cut(tile) {
+	let o = 0;
+	for (let y = tile.y; y < tile.y + tile.height; y++) {
+		for (let x = tile.x; x < tile.x + tile.width; x++) {
+			const i = (y * layout.width + x) * 3;
+			if (RGB565) {
+				const rgb565 = ((wall[i] & 0xF8) << 8) | ((wall[i + 1] & 0xFC) << 3) | (wall[i + 2] >> 3);
+				tile.pixels[o++] = rgb565 >> 8;
+				tile.pixels[o++] = rgb565 & 0xFF;
+			} else {
+				tile.pixels[o++] = wall[i];
+				tile.pixels[o++] = wall[i + 1];
+				tile.pixels[o++] = wall[i + 2];
+			}
+		}
+	}
+	return tile.pixels;
+}
+
+const socket = dgram.createSocket('udp4');
+let frameId = 0;
+let frame = 0;
+let sent = 0;
+
+function send(datagram) {
+	socket.send(datagram, layout.port, layout.group);
+	sent++;
+}
+
+function sendFrame() {
+	const id = frameId;
+	frameId = (frameId + 1) & 0xFFFF;
+
+	render(frame++);
+	for (const tile of layout.tiles) {
+		const data = protocol.encodeFrame(FORMAT, id, cut(tile));
+		const chunks = protocol.chunkFrame(data, id, undefined, layout.parityGroups, tile);
+		chunks.forEach(send);
+	}
+
+	// Commit once every tile had time to get its part; the tiles show the
+	// frame at presentAt (mapped onto their clocks) plus their jitter delay
+	setTimeout(() => {
+		const beacon = protocol.encodeWallBeacon(id, protocol.timestampUs());
+		for (let i = 0; i < layout.beaconRepeat; i++) send(beacon);
+	}, layout.commitDelayMs);
+}
+
+socket.bind(() => {
+	socket.setMulticastTTL(1);
+	socket.setMulticastLoopback(options.loopback !== 0);
+	if (options.interface) socket.setMulticastInterface(options.interface);
+	console.log(`${layout.width}x${layout.height} wall of ${layout.tiles.length} tiles to ${layout.group}:${layout.port}, ` +
+		`${layout.fps} fps, commit after ${layout.commitDelayMs} ms`);
+	setInterval(sendFrame, 1000 / layout.fps);
+	setInterval(() => console.log(`${frame} frames, ${sent} datagrams`), 1000);
+});
@@ -1,5 +1,9 @@
 /**
  * This Processing sketch sends all the pixels of the canvas to the serial port.
+ *
+ * A frame only goes out while the device has room for it (credits, see
+ * protocol.pde); otherwise it is skipped and the next draw() sends a
+ * newer one, so frames never pile up on the way to the matrix.
  */
 
 import processing.serial.*;
@@ -51,6 +55,9 @@ void draw() {
   // --------------------------------------------------------------------------
   // Write to the serial port (if open)
   if (serial != null) {
+    readCredits(serial);
+    if (!creditReady()) return; // Skipped before encoding, so the next delta is still based on what was sent
+
     loadPixels();
     int idx = 0;
     if (COLOR_DEPTH == 24) {
@@ -72,8 +79,10 @@ void draw() {
         buffer[idx++] = bytes[1];
       }
     }
-    serial.write('*');     // The 'data' command
-    serial.write(buffer);  // ...and the pixel values
+    // Header, pixel values and CRC (see protocol.pde); RGB565 may go out as an XOR-RLE delta
+    byte[] frame = COLOR_DEPTH == 24 ? encodeFrame(FORMAT_RGB888, buffer, buffer.length) : encodeRgb565Frame(buffer, buffer.length);
+    serial.write(frame);
+    creditSent();
   }
 }
 
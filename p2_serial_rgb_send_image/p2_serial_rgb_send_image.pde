@@ -107,8 +107,9 @@ void draw() {
         buffer[idx++] = bytes[1];
       }
     }
-    serial.write('*');     // The 'data' command
-    serial.write(buffer);  // ...and the pixel values
+    // Header, pixel values and CRC (see protocol.pde); RGB565 may go out as an XOR-RLE delta
+    byte[] frame = COLOR_DEPTH == 24 ? encodeFrame(FORMAT_RGB888, buffer, buffer.length) : encodeRgb565Frame(buffer, buffer.length);
+    serial.write(frame);
   }
 }
 
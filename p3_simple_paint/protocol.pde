@@ -0,0 +1,235 @@
+/**
+ * Binary frame protocol shared with the firmware (common/frame_protocol.h).
+ *
+ *   Offset  Size  Field
+ *   0       2     Sync word 'P' 'X' (0x50 0x58)
+ *   2       1     Protocol version
+ *   3       1     Payload format (FORMAT_*)
+ *   4       2     Frame id, little-endian
+ *   6       2     Payload length, little-endian
+ *   8       n     Payload
+ *   8+n     4     CRC32 (zlib) of header + payload, little-endian
+ *
+ * FORMAT_XOR_RLE_RGB565 payload (run-length coded, optionally XORed with
+ * the frame with id baseId):
+ *   baseId u16 LE, flags u8 (XOR_RLE_DELTA),
+ *   tokens covering every pixel:
+ *     c < 0x80   c + 1 literal RGB565 values (big-endian) follow
+ *     c >= 0x80  (c & 0x7F) + 1 repeats of the one value that follows
+ *
+ * FORMAT_PALETTE payload: n × { R, G, B } (1 <= n <= 256), kept by the
+ * device for the FORMAT_INDEXEDx frames that follow: one palette index
+ * per pixel, 1/2/4/8 bits each, packed MSB first.
+ *
+ * FORMAT_CREDIT frames come back from the device: lastId u16 LE, free u8,
+ * i.e. it has room for `free` frames after frame lastId. Call
+ * readCredits() every frame and send only when creditReady().
+ */
+
+import java.util.zip.CRC32;
+
+final int FRAME_HEADER_SIZE = 8;
+final int FRAME_CRC_SIZE    = 4;
+final int FRAME_VERSION     = 1;
+
+final int FORMAT_RGB565 = 0x01;
+final int FORMAT_RGB888 = 0x02;
+final int FORMAT_XOR_RLE_RGB565 = 0x04;
+final int FORMAT_PALETTE        = 0x05;
+final int FORMAT_INDEXED        = 0x10; // | bits per pixel (1, 2, 4 or 8)
+final int FORMAT_CREDIT         = 0x24; // Device → host
+
+final int XOR_RLE_HEADER_SIZE = 3;
+final int XOR_RLE_DELTA       = 0x01;
+final int KEYFRAME_INTERVAL   = 60; // Frames between XOR-RLE keyframes
+final int CREDIT_SIZE         = 3;
+final int CREDIT_TIMEOUT_MS   = 500; // Held back longer than this, a frame goes out anyway
+
+int nextFrameId = 0;
+
+// Last RGB565 frame sent (id nextFrameId - 1), the base of the next XOR-RLE delta
+int[] previousFrame;
+int framesSinceKeyframe;
+
+// Last credit from the device (-1: none yet, send freely) and last frame sent
+int creditLastId = -1;
+int creditFree;
+int lastSentId = -1;
+int lastSentAt;
+
+// Bytes read back from the device, up to the end of the last complete frame
+byte[] replyBuffer = new byte[64];
+int replyFill;
+
+// Wraps length bytes of payload into a frame, ready for serial.write()
+byte[] encodeFrame(int format, byte[] payload, int length) {
+  byte[] frame = new byte[FRAME_HEADER_SIZE + length + FRAME_CRC_SIZE];
+  frame[0] = 'P';
+  frame[1] = 'X';
+  frame[2] = (byte)FRAME_VERSION;
+  frame[3] = (byte)format;
+  frame[4] = (byte)(nextFrameId & 0xFF);
+  frame[5] = (byte)(nextFrameId >> 8 & 0xFF);
+  frame[6] = (byte)(length & 0xFF);
+  frame[7] = (byte)(length >> 8 & 0xFF);
+  System.arraycopy(payload, 0, frame, FRAME_HEADER_SIZE, length);
+  nextFrameId = (nextFrameId + 1) & 0xFFFF;
+
+  CRC32 crc = new CRC32();
+  crc.update(frame, 0, FRAME_HEADER_SIZE + length);
+  long c = crc.getValue();
+  int end = FRAME_HEADER_SIZE + length;
+  frame[end]     = (byte)(c & 0xFF);
+  frame[end + 1] = (byte)(c >> 8 & 0xFF);
+  frame[end + 2] = (byte)(c >> 16 & 0xFF);
+  frame[end + 3] = (byte)(c >> 24 & 0xFF);
+  return frame;
+}
+
+// Wraps RGB565 pixels (big-endian, as for FORMAT_RGB565) into the
+// smaller of a full frame and an XOR-RLE frame against the previous one
+byte[] encodeRgb565Frame(byte[] pixels, int length) {
+  int count = length / 2;
+  int[] current = new int[count];
+  for (int i = 0; i < count; i++) {
+    current[i] = (pixels[i * 2] & 0xFF) << 8 | (pixels[i * 2 + 1] & 0xFF);
+  }
+
+  boolean delta = previousFrame != null && previousFrame.length == count && framesSinceKeyframe < KEYFRAME_INTERVAL;
+  int[] values = new int[count];
+  for (int i = 0; i < count; i++) {
+    values[i] = delta ? current[i] ^ previousFrame[i] : current[i];
+  }
+
+  byte[] payload = new byte[length];
+  int rleLength = writeXorRle(payload, values, length);
+
+  previousFrame = current;
+  if (rleLength < 0) {
+    framesSinceKeyframe = 0;
+    return encodeFrame(FORMAT_RGB565, pixels, length);
+  }
+
+  int baseId = (nextFrameId - 1) & 0xFFFF;
+  payload[0] = (byte)(baseId & 0xFF);
+  payload[1] = (byte)(baseId >> 8 & 0xFF);
+  payload[2] = (byte)(delta ? XOR_RLE_DELTA : 0);
+  framesSinceKeyframe = delta ? framesSinceKeyframe + 1 : 0;
+  return encodeFrame(FORMAT_XOR_RLE_RGB565, payload, rleLength);
+}
+
+// Run-length codes values after the XOR-RLE header.
+// Returns the payload length, or -1 once it would reach maxLength.
+int writeXorRle(byte[] out, int[] values, int maxLength) {
+  int n = values.length;
+  int pos = XOR_RLE_HEADER_SIZE;
+  int i = 0;
+  while (i < n) {
+    int run = 1;
+    while (i + run < n && run < 128 && values[i + run] == values[i]) run++;
+
+    if (run >= 2) {
+      if (pos + 3 >= maxLength) return -1;
+      out[pos++] = (byte)(0x80 | (run - 1));
+      out[pos++] = (byte)(values[i] >> 8);
+      out[pos++] = (byte)(values[i] & 0xFF);
+      i += run;
+      continue;
+    }
+
+    // Literals up to the start of the next run
+    int count = 1;
+    while (i + count < n && count < 128 && !(i + count + 1 < n && values[i + count] == values[i + count + 1])) count++;
+
+    if (pos + 1 + count * 2 >= maxLength) return -1;
+    out[pos++] = (byte)(count - 1);
+    for (int k = i; k < i + count; k++) {
+      out[pos++] = (byte)(values[k] >> 8);
+      out[pos++] = (byte)(values[k] & 0xFF);
+    }
+    i += count;
+  }
+  return pos;
+}
+
+// Wraps up to 256 colors into a palette frame
+byte[] encodePaletteFrame(color[] palette) {
+  byte[] payload = new byte[palette.length * 3];
+  for (int i = 0; i < palette.length; i++) {
+    payload[i * 3]     = (byte)(palette[i] >> 16 & 0xFF);
+    payload[i * 3 + 1] = (byte)(palette[i] >> 8 & 0xFF);
+    payload[i * 3 + 2] = (byte)(palette[i] & 0xFF);
+  }
+  return encodeFrame(FORMAT_PALETTE, payload, payload.length);
+}
+
+// Packs one palette index per pixel into bpp (1, 2, 4 or 8) bits, MSB first
+byte[] encodeIndexedFrame(int[] indices, int bpp) {
+  int perByte = 8 / bpp;
+  int mask = (1 << bpp) - 1;
+  byte[] payload = new byte[(indices.length * bpp + 7) / 8];
+  for (int i = 0; i < indices.length; i++) {
+    int shift = 8 - bpp * (i % perByte + 1);
+    payload[i / perByte] |= (byte)((indices[i] & mask) << shift);
+  }
+  return encodeFrame(FORMAT_INDEXED | bpp, payload, payload.length);
+}
+
+// Reads what the device sent back and keeps the newest credit. Its text
+// output (the stats lines) and other frames are skipped.
+void readCredits(Serial serial) {
+  byte[] bytes = serial.readBytes();
+  if (bytes == null) return;
+  for (int i = 0; i < bytes.length; i++) {
+    if (replyFill == replyBuffer.length) parseReplies();
+    if (replyFill == replyBuffer.length) replyFill = 0; // Nothing but noise
+    replyBuffer[replyFill++] = bytes[i];
+  }
+  parseReplies();
+}
+
+void parseReplies() {
+  int start = 0;
+  while (true) {
+    while (start < replyFill && replyBuffer[start] != 'P') start++;
+    if (replyFill - start < FRAME_HEADER_SIZE) break;
+    int length = (replyBuffer[start + 6] & 0xFF) | (replyBuffer[start + 7] & 0xFF) << 8;
+    if (replyBuffer[start + 1] != 'X' || replyBuffer[start + 2] != FRAME_VERSION ||
+        FRAME_HEADER_SIZE + length + FRAME_CRC_SIZE > replyBuffer.length) {
+      start++;
+      continue;
+    }
+    int end = start + FRAME_HEADER_SIZE + length;
+    if (replyFill < end + FRAME_CRC_SIZE) break;
+
+    CRC32 crc = new CRC32();
+    crc.update(replyBuffer, start, end - start);
+    long expected = (replyBuffer[end] & 0xFFL) | (replyBuffer[end + 1] & 0xFFL) << 8 |
+                    (replyBuffer[end + 2] & 0xFFL) << 16 | (replyBuffer[end + 3] & 0xFFL) << 24;
+    if (crc.getValue() != expected) {
+      start++;
+      continue;
+    }
+    if (replyBuffer[start + 3] == FORMAT_CREDIT && length >= CREDIT_SIZE) {
+      creditLastId = (replyBuffer[end - 3] & 0xFF) | (replyBuffer[end - 2] & 0xFF) << 8;
+      creditFree = replyBuffer[end - 1] & 0xFF;
+    }
+    start = end + FRAME_CRC_SIZE;
+  }
+  System.arraycopy(replyBuffer, start, replyBuffer, 0, replyFill - start);
+  replyFill -= start;
+}
+
+// True if the device has room for another frame: fewer frames went out
+// after the last one it received than it has room for
+boolean creditReady() {
+  if (creditLastId < 0 || lastSentId < 0 || millis() - lastSentAt > CREDIT_TIMEOUT_MS) return true;
+  int ahead = (short)(lastSentId - creditLastId);
+  return ahead < creditFree;
+}
+
+// Call after serial.write() of a frame from encodeFrame()
+void creditSent() {
+  lastSentId = (nextFrameId - 1) & 0xFFFF;
+  lastSentAt = millis();
+}
@@ -1,5 +1,8 @@
 /**
  * This Processing sketch sends all the pixels of the canvas to the serial port.
+ *
+ * The thresholded image only has two colors, so with INDEXED it is sent as
+ * 1 bit palette indices: 128 bytes per frame instead of 2048.
  */
 
 import processing.serial.*;
@@ -8,6 +11,8 @@ final int TOTAL_WIDTH  = 32;
 final int TOTAL_HEIGHT = 32;
 final int COLOR_DEPTH  = 16; // 24 or 16 bits
 final int BAUD_RATE    = 921600;
+final boolean INDEXED  = true; // Send black / white as 1 bit palette indices
+final int PALETTE_INTERVAL = 60; // Frames between palette resends (in case one is lost)
 
 Serial serial;
 byte[]buffer;
@@ -62,7 +67,17 @@ void draw() {
 
   // --------------------------------------------------------------------------
   // Write to the serial port (if open)
-  if (serial != null) {
+  if (serial != null && INDEXED) {
+    loadPixels();
+    if ((frameCount - 1) % PALETTE_INTERVAL == 0) {
+      serial.write(encodePaletteFrame(new color[]{color(0), color(255)}));
+    }
+    int[] indices = new int[pixels.length];
+    for (int i=0; i<pixels.length; i++) {
+      indices[i] = (pixels[i] & 0xFF) > 127 ? 1 : 0; // Black or white
+    }
+    serial.write(encodeIndexedFrame(indices, 1));
+  } else if (serial != null) {
     loadPixels();
     int idx = 0;
     if (COLOR_DEPTH == 24) {
@@ -84,8 +99,9 @@ void draw() {
         buffer[idx++] = bytes[1];
       }
     }
-    serial.write('*');     // The 'data' command
-    serial.write(buffer);  // ...and the pixel values
+    // Header, pixel values and CRC (see protocol.pde); RGB565 may go out as an XOR-RLE delta
+    byte[] frame = COLOR_DEPTH == 24 ? encodeFrame(FORMAT_RGB888, buffer, buffer.length) : encodeRgb565Frame(buffer, buffer.length);
+    serial.write(frame);
   }
 }
 
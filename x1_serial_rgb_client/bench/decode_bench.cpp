@@ -0,0 +1,146 @@
+/**
+ * Host benchmark for the frame decoders in src/common/frame_decode.h.
+ *
+ * Reads the sequences written by encode_sequences.mjs, runs every frame
+ * through the FrameParser and the same decode path as the client, checks
+ * the result against the source frames and prints bytes and decode time
+ * per frame. Decode times are for the host CPU; on the ESP32 the client
+ * reports its own ("dec" in the stats line).
+ *
+ * Build and run (from this folder):
+ *   node encode_sequences.mjs
+ *   g++ -O2 -o decode_bench decode_bench.cpp
+ *   ./decode_bench out/j8-*.frames out/p4-*.frames
+ */
+
+#include "../src/common/frame_protocol.h"
+#include "../src/common/frame_decode.h"
+
+#include <chrono>
+#include <stdio.h>
+#include <string>
+#include <vector>
+
+#define WIDTH 32
+#define HEIGHT 32
+#define NUM_LEDS (WIDTH * HEIGHT)
+#define REPEAT 200 // Decode every frame this often for stable timings
+
+struct Pixel {
+	uint8_t red, green, blue;
+};
+
+static std::vector<uint8_t> readFile(const std::string &path) {
+	std::vector<uint8_t> data;
+	FILE *f = fopen(path.c_str(), "rb");
+	if (f == NULL) return data;
+	uint8_t chunk[4096];
+	size_t n;
+	while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) data.insert(data.end(), chunk, chunk + n);
+	fclose(f);
+	return data;
+}
+
+// Same rules as decodeFrame() in main.cpp
+static bool decode(Pixel *image, const FrameHeader &header, const uint8_t *buf) {
+	switch (header.format) {
+		case FRAME_FORMAT_RGB565:
+			if (header.length != NUM_LEDS * 2) return false;
+			expandRgb565(image, buf, NUM_LEDS);
+			return true;
+		case FRAME_FORMAT_RECTS_RGB565:
+			return applyRectsRgb565(image, WIDTH, HEIGHT, buf, header.length);
+		case FRAME_FORMAT_XOR_RLE_RGB565:
+			return applyXorRleRgb565(image, NUM_LEDS, buf, header.length);
+		default:
+			return false;
+	}
+}
+
+static FrameParser<NUM_LEDS * 3> parser;
+
+int main(int argc, char **argv) {
+	if (argc < 2) {
+		fprintf(stderr, "usage: %s out/<sequence>.frames ...\n", argv[0]);
+		return 1;
+	}
+
+	printf("%-22s %7s %10s %8s %12s %12s\n", "sequence", "frames", "bytes/fr", "ratio", "decode us", "max us");
+	int failures = 0;
+
+	for (int a = 1; a < argc; a++) {
+		std::string path = argv[a];
+		std::string base = path.substr(0, path.rfind('.'));
+		std::string name = base.substr(base.rfind('/') + 1);
+		std::vector<uint8_t> stream = readFile(path);
+		std::vector<uint8_t> source = readFile(base + ".rgb565");
+		if (stream.empty() || source.empty()) {
+			fprintf(stderr, "%s: cannot read %s or its .rgb565\n", name.c_str(), path.c_str());
+			failures++;
+			continue;
+		}
+
+		static Pixel image[NUM_LEDS];
+		static Pixel scratch[NUM_LEDS];
+		size_t frames = 0, mismatches = 0;
+		double totalUs = 0, maxUs = 0;
+
+		const uint8_t *data = stream.data();
+		size_t len = stream.size();
+		while (len > 0 || parser.available()) {
+			size_t used = parser.feed(data, len);
+			data += used;
+			len  -= used;
+			if (!parser.available()) continue;
+
+			const FrameHeader &header = parser.header();
+			const uint8_t *payload = parser.payload();
+
+			// Time REPEAT decodes on a copy of the current image so deltas
+			// always see their real base
+			auto t0 = std::chrono::steady_clock::now();
+			for (int r = 0; r < REPEAT; r++) {
+				memcpy(scratch, image, sizeof(image));
+				decode(scratch, header, payload);
+			}
+			auto t1 = std::chrono::steady_clock::now();
+			double copyUs = 0;
+			{
+				auto c0 = std::chrono::steady_clock::now();
+				for (int r = 0; r < REPEAT; r++) {
+					memcpy(scratch, image, sizeof(image));
+					__asm__ __volatile__("" : : "r"(scratch) : "memory");
+				}
+				auto c1 = std::chrono::steady_clock::now();
+				copyUs = std::chrono::duration<double, std::micro>(c1 - c0).count() / REPEAT;
+			}
+			double us = std::chrono::duration<double, std::micro>(t1 - t0).count() / REPEAT - copyUs;
+			if (us < 0) us = 0;
+			totalUs += us;
+			if (us > maxUs) maxUs = us;
+
+			if (!decode(image, header, payload)) mismatches++;
+			parser.release();
+
+			// Compare with the source frame
+			if (frames * NUM_LEDS * 2 + NUM_LEDS * 2 <= source.size()) {
+				const uint8_t *expected = &source[frames * NUM_LEDS * 2];
+				for (size_t i = 0; i < NUM_LEDS; i++) {
+					if (packRgb565(image[i]) != (((uint16_t)expected[i * 2] << 8) | expected[i * 2 + 1])) {
+						mismatches++;
+						break;
+					}
+				}
+			}
+			frames++;
+		}
+
+		if (frames * NUM_LEDS * 2 != source.size()) mismatches++;
+		double bytesPerFrame = frames ? (double)stream.size() / frames : 0;
+		printf("%-22s %7zu %10.0f %7.1fx %12.2f %12.2f%s\n", name.c_str(), frames, bytesPerFrame,
+		       (FRAME_HEADER_SIZE + NUM_LEDS * 2 + FRAME_CRC_SIZE) / bytesPerFrame,
+		       frames ? totalUs / frames : 0, maxUs, mismatches ? "  MISMATCH" : "");
+		if (mismatches) failures++;
+	}
+	return failures ? 1 : 0;
+}
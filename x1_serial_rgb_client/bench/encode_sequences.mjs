@@ -0,0 +1,205 @@
+/**
+ * Encodes test sequences the way the web senders do and writes them out
+ * for decode_bench.cpp.
+ *
+ * Sequences: every j8_pixel_art generator (FRAMES frames each) and every
+ * p4_image_sequence_loader/data folder (each PNG shown HOLD frames, as the
+ * sketch does). For each sequence it prints the average bytes per frame
+ * on the wire for every encoding and writes
+ *
+ *   out/<name>.rgb565   the source frames, RGB565 big-endian
+ *   out/<name>.frames   the same frames encoded with createFrameEncoder()
+ *                       (rects + XOR-RLE), as sent over the serial port
+ *
+ * Usage: node encode_sequences.mjs
+ */
+
+import fs from 'node:fs'
+import path from 'node:path'
+import zlib from 'node:zlib'
+import { fileURLToPath } from 'node:url'
+
+const HERE = path.dirname(fileURLToPath(import.meta.url))
+const REPO = path.join(HERE, '..', '..')
+const OUT = path.join(HERE, 'out')
+
+const {
+	HEADER_SIZE, CRC_SIZE, createFrameBuffer, createFrameEncoder,
+} = await import(path.join(REPO, 'j8_pixel_art/web/js/protocol.js'))
+
+const W = 32
+const H = 32
+const FRAMES = 300 // Per generator, 10 s at the editor's 30 fps
+const HOLD = 4     // p4 shows each image for 4 draw() calls
+
+// Same sequence of "random" numbers on every run
+let seed = 1
+Math.random = () => {
+	seed = (seed * 1103515245 + 12345) & 0x7fffffff
+	return seed / 0x80000000
+}
+
+// ── Sources ──────────────────────────────────────────────────────────────────
+
+// Minimal 2D context: the generators only use createImageData / putImageData
+function createContext() {
+	let image = null
+	return {
+		createImageData: (w, h) => ({ width: w, height: h, data: new Uint8ClampedArray(w * h * 4) }),
+		putImageData: (data) => { image = data },
+		get image() { return image },
+	}
+}
+
+async function generatorSequence(file) {
+	const gen = await import(path.join(REPO, 'j8_pixel_art/web/js/generators', file))
+	const ctx = createContext()
+	if (gen.setup) gen.setup(W, H)
+
+	const frames = []
+	for (let frame = 0; frame < FRAMES; frame++) {
+		gen.draw(ctx, frame, W, H)
+		frames.push(toRgb565(ctx.image.data, 4))
+	}
+	return { name: 'j8-' + gen.name.toLowerCase().replace(/\W+/g, '-'), frames }
+}
+
+function imageSequence(dir) {
+	const frames = []
+	for (const file of fs.readdirSync(dir).filter((f) => f.endsWith('.png')).sort()) {
+		const pixels = toRgb565(decodePng(fs.readFileSync(path.join(dir, file))), 3)
+		for (let i = 0; i < HOLD; i++) frames.push(pixels)
+	}
+	return { name: 'p4-' + path.basename(dir), frames }
+}
+
+function toRgb565(data, channels) {
+	const out = new Uint16Array(W * H)
+	for (let i = 0, j = 0; j < out.length; i += channels, j++) {
+		out[j] = ((data[i] >> 3) << 11) | ((data[i + 1] >> 2) << 5) | (data[i + 2] >> 3)
+	}
+	return out
+}
+
+// Non-interlaced 8 bit RGB / RGBA and 1–8 bit palette PNGs (what the p4
+// images use), returned as RGB
+function decodePng(buf) {
+	let pos = 8
+	let width = 0, height = 0, depth = 0, type = 0
+	let palette = null
+	const idat = []
+	while (pos < buf.length) {
+		const len = buf.readUInt32BE(pos)
+		const chunk = buf.toString('ascii', pos + 4, pos + 8)
+		const body = buf.subarray(pos + 8, pos + 8 + len)
+		if (chunk === 'IHDR') {
+			width = body.readUInt32BE(0)
+			height = body.readUInt32BE(4)
+			depth = body[8]
+			type = body[9]
+			if (body[12] !== 0) throw new Error('Interlaced PNGs are not supported')
+		} else if (chunk === 'PLTE') {
+			palette = body
+		} else if (chunk === 'IDAT') {
+			idat.push(body)
+		}
+		pos += 12 + len
+	}
+	if (width !== W || height !== H) throw new Error(`PNG is ${width}×${height}`)
+
+	const channels = { 2: 3, 3: 1, 6: 4 }[type]
+	if (!channels || (type !== 3 && depth !== 8)) throw new Error(`Unsupported PNG (type ${type}, depth ${depth})`)
+
+	// Undo the per-row filters
+	const raw = zlib.inflateSync(Buffer.concat(idat))
+	const stride = Math.ceil(width * channels * depth / 8)
+	const bpp = Math.max(1, channels * depth / 8)
+	const rows = new Uint8Array(height * stride)
+	for (let y = 0; y < height; y++) {
+		const filter = raw[y * (stride + 1)]
+		for (let x = 0; x < stride; x++) {
+			const v = raw[y * (stride + 1) + 1 + x]
+			const a = x >= bpp ? rows[y * stride + x - bpp] : 0
+			const b = y > 0 ? rows[(y - 1) * stride + x] : 0
+			const c = x >= bpp && y > 0 ? rows[(y - 1) * stride + x - bpp] : 0
+			let p = 0
+			if (filter === 1) p = a
+			else if (filter === 2) p = b
+			else if (filter === 3) p = (a + b) >> 1
+			else if (filter === 4) {
+				const pa = Math.abs(b - c), pb = Math.abs(a - c), pc = Math.abs(a + b - 2 * c)
+				p = pa <= pb && pa <= pc ? a : pb <= pc ? b : c
+			}
+			rows[y * stride + x] = (v + p) & 0xff
+		}
+	}
+
+	const data = new Uint8Array(width * height * 3)
+	for (let y = 0, i = 0; y < height; y++) {
+		for (let x = 0; x < width; x++, i += 3) {
+			if (type === 3) {
+				const bit = x * depth
+				const index = (rows[y * stride + (bit >> 3)] >> (8 - depth - (bit & 7))) & ((1 << depth) - 1)
+				data.set(palette.subarray(index * 3, index * 3 + 3), i)
+			} else {
+				data.set(rows.subarray(y * stride + x * channels, y * stride + x * channels + 3), i)
+			}
+		}
+	}
+	return data
+}
+
+// ── Encoding ─────────────────────────────────────────────────────────────────
+
+const ENCODINGS = {
+	'rects':   { rects: true },
+	'xor-rle': { xorRle: true },
+	'both':    { rects: true, xorRle: true },
+}
+
+// Total bytes on the wire for the sequence, optionally keeping the frames
+function encode(frames, options, keep) {
+	const encoder = createFrameEncoder(W, H, options)
+	const buffer = createFrameBuffer(W * H * 2)
+	const chunks = []
+	let total = 0
+	for (const pixels of frames) {
+		encoder.pixels.set(pixels)
+		const frame = encoder.encode(buffer)
+		encoder.commit()
+		total += frame.length
+		if (keep) chunks.push(Buffer.from(frame))
+	}
+	return { total, chunks }
+}
+
+const sequences = []
+for (const file of fs.readdirSync(path.join(REPO, 'j8_pixel_art/web/js/generators')).sort()) {
+	if (file.endsWith('.js')) sequences.push(await generatorSequence(file))
+}
+const dataDir = path.join(REPO, 'p4_image_sequence_loader/data')
+for (const dir of fs.readdirSync(dataDir).sort()) {
+	sequences.push(imageSequence(path.join(dataDir, dir)))
+}
+
+fs.mkdirSync(OUT, { recursive: true })
+
+const full = HEADER_SIZE + W * H * 2 + CRC_SIZE
+console.log('Average bytes per frame (ratio to a full RGB565 frame of %d bytes)\n', full)
+console.log('sequence'.padEnd(22) + Object.keys(ENCODINGS).map((k) => k.padStart(16)).join(''))
+
+for (const { name, frames } of sequences) {
+	let line = name.padEnd(22)
+	for (const [key, options] of Object.entries(ENCODINGS)) {
+		const keep = key === 'both'
+		const { total, chunks } = encode(frames, options, keep)
+		const avg = total / frames.length
+		line += `${avg.toFixed(0)} (${(full / avg).toFixed(1)}×)`.padStart(16)
+		if (keep) fs.writeFileSync(path.join(OUT, name + '.frames'), Buffer.concat(chunks))
+	}
+	console.log(line)
+
+	const raw = Buffer.alloc(frames.length * W * H * 2)
+	frames.forEach((pixels, f) => pixels.forEach((v, i) => raw.writeUInt16BE(v, (f * W * H + i) * 2)))
+	fs.writeFileSync(path.join(OUT, name + '.rgb565'), raw)
+}
@@ -0,0 +1,206 @@
+/**
+ * Host test for FrameParser in src/common/frame_protocol.h.
+ *
+ * Builds streams of frames, damages some of them the way a serial link
+ * does (dropped bytes, flipped bits in the length field or CRC, line
+ * noise between frames) and feeds them through the parser in slices of
+ * various sizes. Payloads are full of sync words and plausible headers.
+ * Every frame that was not damaged must come out intact and in order,
+ * and every other byte must be counted in bytesDiscarded. A sender that
+ * restarts its frame ids from 0 must not count as lost frames.
+ *
+ * Build and run (from this folder):
+ *   g++ -O2 -o parser_test parser_test.cpp
+ *   ./parser_test
+ */
+
+#include "../src/common/frame_protocol.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+#define MAX_PAYLOAD 4096
+#define FRAMES 29
+#define RANDOM_TRIALS 2000
+
+enum Damage {
+	NONE,
+	DROP_BYTE,     // One byte of the frame lost
+	LONG_LENGTH,   // Length field says 2000, the parser swallows the frames behind
+	HUGE_LENGTH,   // Length field above MAX_PAYLOAD
+	SHORT_LENGTH,  // Length field too small
+	BAD_CRC,       // A bit flipped in the CRC
+	BAD_PAYLOAD,   // A bit flipped in the payload
+	NOISE_BEFORE,  // Garbage with sync bytes in front of the frame, frame itself intact
+	DAMAGE_COUNT
+};
+
+static const char *damageNames[DAMAGE_COUNT] = {
+	"none", "dropped byte", "long length", "huge length", "short length", "bad crc", "bad payload", "noise before",
+};
+
+static FrameParser<MAX_PAYLOAD> parser;
+
+struct Expected {
+	uint16_t id;
+	std::vector<uint8_t> payload;
+};
+
+// A payload that keeps looking like the start of a frame
+static std::vector<uint8_t> makePayload(uint16_t id, size_t length) {
+	std::vector<uint8_t> payload(length);
+	for (size_t i = 0; i < length; i++) payload[i] = (uint8_t)(i * 31 + id);
+	for (size_t i = 0; i + 8 <= length; i += 37) {
+		uint8_t fake[8] = {FRAME_SYNC_0, FRAME_SYNC_1, FRAME_VERSION, FRAME_FORMAT_RGB565, 0, 0, 0, 0};
+		writeLE16(&fake[4], (uint16_t)(id + 1));
+		writeLE16(&fake[6], (uint16_t)(i % 300));
+		memcpy(&payload[i], fake, sizeof(fake));
+	}
+	if (length > 0) payload[length - 1] = FRAME_SYNC_0;
+	return payload;
+}
+
+// Appends frame id with the given damage to stream; records it in
+// expected if it should arrive
+static void appendFrame(std::vector<uint8_t> &stream, std::vector<Expected> &expected, uint16_t id, size_t length,
+                        Damage damage, unsigned &seed) {
+	std::vector<uint8_t> payload = makePayload(id, length);
+	std::vector<uint8_t> frame(FRAME_HEADER_SIZE + length + FRAME_CRC_SIZE);
+	memcpy(&frame[FRAME_HEADER_SIZE], payload.data(), length);
+	encodeFrame(frame.data(), FRAME_FORMAT_RGB565, id, (uint16_t)length);
+
+	switch (damage) {
+		case NONE: break;
+		case DROP_BYTE: frame.erase(frame.begin() + rand_r(&seed) % frame.size()); break;
+		case LONG_LENGTH: writeLE16(&frame[6], 2000); break;
+		case HUGE_LENGTH: writeLE16(&frame[6], MAX_PAYLOAD + 1); break;
+		case SHORT_LENGTH: writeLE16(&frame[6], (uint16_t)(length / 2)); break;
+		case BAD_CRC: frame[frame.size() - 1 - rand_r(&seed) % FRAME_CRC_SIZE] ^= 1 << rand_r(&seed) % 8; break;
+		case BAD_PAYLOAD: frame[FRAME_HEADER_SIZE + rand_r(&seed) % length] ^= 1 << rand_r(&seed) % 8; break;
+		case NOISE_BEFORE: {
+			const uint8_t noise[] = {FRAME_SYNC_0, 0x00, FRAME_SYNC_0, FRAME_SYNC_1, FRAME_VERSION, 0x01, 0x07};
+			stream.insert(stream.end(), noise, noise + 1 + rand_r(&seed) % sizeof(noise));
+			break;
+		}
+		default: break;
+	}
+	stream.insert(stream.end(), frame.begin(), frame.end());
+	if (damage == NONE || damage == NOISE_BEFORE) expected.push_back({id, payload});
+}
+
+// Good frames after the test frames, enough to fill any length field a
+// damaged header can claim, so the parser has settled by the end
+static void appendTail(std::vector<uint8_t> &stream, std::vector<Expected> &expected, uint16_t id, unsigned &seed) {
+	size_t start = stream.size();
+	while (stream.size() - start < FRAME_HEADER_SIZE + MAX_PAYLOAD + FRAME_CRC_SIZE) {
+		appendFrame(stream, expected, id++, 500, NONE, seed);
+	}
+}
+
+/**
+ * Feeds stream in slices of slice bytes (0: random sizes) and checks what
+ * comes out against expected. Returns false and prints why on a mismatch.
+ */
+static bool run(const char *name, const std::vector<uint8_t> &stream, const std::vector<Expected> &expected,
+                size_t slice, unsigned seed) {
+	parser = FrameParser<MAX_PAYLOAD>();
+
+	size_t got = 0, goodBytes = 0;
+	bool ok = true;
+	const uint8_t *data = stream.data();
+	size_t len = stream.size();
+	while (len > 0 || parser.available()) {
+		size_t n = slice ? slice : 1 + rand_r(&seed) % 300;
+		if (n > len) n = len;
+		size_t used = parser.feed(data, n);
+		data += used;
+		len  -= used;
+		while (parser.available()) {
+			const FrameHeader &header = parser.header();
+			if (got >= expected.size() || header.id != expected[got].id ||
+			    header.length != expected[got].payload.size() ||
+			    memcmp(parser.payload(), expected[got].payload.data(), header.length) != 0) {
+				printf("%s, slice %zu: frame %zu is id %u, expected %d\n", name, slice, got, header.id,
+				       got < expected.size() ? expected[got].id : -1);
+				ok = false;
+			}
+			goodBytes += FRAME_HEADER_SIZE + header.length + FRAME_CRC_SIZE;
+			got++;
+			parser.release();
+		}
+	}
+
+	if (got != expected.size()) {
+		printf("%s, slice %zu: got %zu of %zu frames\n", name, slice, got, expected.size());
+		ok = false;
+	}
+	if (!parser.idle() || goodBytes + parser.bytesDiscarded != stream.size()) {
+		printf("%s, slice %zu: %zu bytes in frames + %u discarded, stream has %zu\n", name, slice, goodBytes,
+		       parser.bytesDiscarded, stream.size());
+		ok = false;
+	}
+	return ok;
+}
+
+int main() {
+	static const size_t slices[] = {1, 7, 64, 100000, 0};
+	int failures = 0, runs = 0;
+
+	// Every kind of damage on frame 0, a frame in the middle and the last
+	// frame, one at a time
+	for (int d = DROP_BYTE; d < DAMAGE_COUNT; d++) {
+		static const int positions[] = {0, FRAMES / 2, FRAMES - 1};
+		for (int p : positions) {
+			unsigned seed = d * 100 + p;
+			std::vector<uint8_t> stream;
+			std::vector<Expected> expected;
+			for (int i = 0; i < FRAMES; i++) {
+				appendFrame(stream, expected, (uint16_t)i, 40 + i * 13, i == p ? (Damage)d : NONE, seed);
+			}
+			appendTail(stream, expected, FRAMES, seed);
+			char name[64];
+			snprintf(name, sizeof(name), "%s at frame %d", damageNames[d], p);
+			for (size_t slice : slices) {
+				failures += !run(name, stream, expected, slice, seed);
+				runs++;
+			}
+		}
+	}
+
+	// Random damage on about a third of the frames, neighbours included
+	for (int trial = 0; trial < RANDOM_TRIALS; trial++) {
+		unsigned seed = 1000 + trial;
+		std::vector<uint8_t> stream;
+		std::vector<Expected> expected;
+		for (int i = 0; i < FRAMES; i++) {
+			Damage damage = rand_r(&seed) % 3 == 0 ? (Damage)(1 + rand_r(&seed) % (DAMAGE_COUNT - 1)) : NONE;
+			appendFrame(stream, expected, (uint16_t)(trial * FRAMES + i), 1 + rand_r(&seed) % 400, damage, seed);
+		}
+		appendTail(stream, expected, (uint16_t)(trial * FRAMES + FRAMES), seed);
+		char name[64];
+		snprintf(name, sizeof(name), "random trial %d", trial);
+		failures += !run(name, stream, expected, 0, seed);
+		runs++;
+	}
+
+	// The sender restarts after 18000 frames and counts from 0 again; one
+	// frame is lost before and one after the restart
+	{
+		unsigned seed = 1;
+		std::vector<uint8_t> stream;
+		std::vector<Expected> expected;
+		for (int i = 0; i < 18000; i++) appendFrame(stream, expected, (uint16_t)i, 20, i == 500 ? BAD_CRC : NONE, seed);
+		for (int i = 0; i < 1000; i++) appendFrame(stream, expected, (uint16_t)i, 20, i == 700 ? BAD_CRC : NONE, seed);
+		bool ok = run("sender restart", stream, expected, 64, seed);
+		if (parser.framesLost != 2 || parser.senderRestarts != 1) {
+			printf("sender restart: %u lost, %u restarts, expected 2 and 1\n", parser.framesLost, parser.senderRestarts);
+			ok = false;
+		}
+		failures += !ok;
+		runs++;
+	}
+
+	printf("%d of %d runs passed\n", runs - failures, runs);
+	return failures ? 1 : 0;
+}
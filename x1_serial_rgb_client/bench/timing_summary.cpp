@@ -0,0 +1,149 @@
+/**
+ * Summarises the per-frame latency logs built from the clients'
+ * FRAME_FORMAT_TIMING echoes (see FrameTiming in frame_protocol.h).
+ *
+ * The logs are CSV with a header line and one line per frame shown: the
+ * frame id first, then one column per stage in µs, e.g. from the web
+ * senders (device.js, getTimingLog().csv()):
+ *
+ *   id,hold_us,encode_us,write_us,wire_us,decode_us,swap_us,link_us,total_us
+ *
+ * or from n1_wireless_rgb_server (TIMING_LOG=file.csv). Every column is
+ * printed with its percentiles and a histogram in powers of two, so a
+ * stage that is usually quick but sometimes stalls stands out.
+ *
+ * Build and run (from this folder):
+ *   g++ -O2 -o timing_summary timing_summary.cpp
+ *   ./timing_summary timing.csv ...      (or from stdin: ./timing_summary < timing.csv)
+ */
+
+#include <algorithm>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+
+#define BUCKETS 24   // Histogram buckets: < 1 µs, < 2 µs, ... < 2^23 µs (8.4 s), and above
+#define BAR_WIDTH 40 // Characters for the largest bucket
+
+struct Column {
+	std::string name;
+	std::vector<uint32_t> values;
+};
+
+static std::vector<std::string> split(const char *line) {
+	std::vector<std::string> fields;
+	std::string field;
+	for (const char *p = line; *p && *p != '\n' && *p != '\r'; p++) {
+		if (*p == ',') {
+			fields.push_back(field);
+			field.clear();
+		} else {
+			field += *p;
+		}
+	}
+	fields.push_back(field);
+	return fields;
+}
+
+// Adds the lines of one log. The header names the columns; a log with
+// other columns than the first one read is skipped.
+static bool readLog(FILE *f, const char *name, std::vector<Column> &columns) {
+	char line[1024];
+	if (fgets(line, sizeof(line), f) == NULL) return true; // Empty
+	std::vector<std::string> header = split(line);
+	if (header.size() < 2 || header[0] != "id") {
+		fprintf(stderr, "%s: no header line starting with id\n", name);
+		return false;
+	}
+	if (columns.empty()) {
+		for (size_t i = 1; i < header.size(); i++) columns.push_back({header[i], {}});
+	} else {
+		bool same = header.size() == columns.size() + 1;
+		for (size_t i = 1; same && i < header.size(); i++) same = header[i] == columns[i - 1].name;
+		if (!same) {
+			fprintf(stderr, "%s: other columns than the first log, skipped\n", name);
+			return false;
+		}
+	}
+
+	size_t skipped = 0;
+	while (fgets(line, sizeof(line), f)) {
+		std::vector<std::string> fields = split(line);
+		if (fields.size() != columns.size() + 1) {
+			skipped++;
+			continue;
+		}
+		for (size_t i = 1; i < fields.size(); i++) columns[i - 1].values.push_back(strtoul(fields[i].c_str(), NULL, 10));
+	}
+	if (skipped) fprintf(stderr, "%s: %zu malformed lines skipped\n", name, skipped);
+	return true;
+}
+
+// Value at quantile q of sorted values
+static uint32_t percentile(const std::vector<uint32_t> &sorted, double q) {
+	size_t i = (size_t)(q * sorted.size());
+	return sorted[std::min(i, sorted.size() - 1)];
+}
+
+static void printHistogram(const std::vector<uint32_t> &values) {
+	size_t counts[BUCKETS + 1] = {};
+	for (uint32_t v : values) {
+		int bucket = 0;
+		while (bucket < BUCKETS && v >= (1u << bucket)) bucket++;
+		counts[bucket]++;
+	}
+	size_t largest = *std::max_element(counts, counts + BUCKETS + 1);
+	for (int b = 0; b <= BUCKETS; b++) {
+		if (counts[b] == 0) continue;
+		int bar = (int)((counts[b] * BAR_WIDTH + largest - 1) / largest);
+		if (b == BUCKETS) {
+			printf("    >= %8u us %7zu %5.1f%% ", 1u << (BUCKETS - 1), counts[b], counts[b] * 100.0 / values.size());
+		} else {
+			printf("    <  %8u us %7zu %5.1f%% ", 1u << b, counts[b], counts[b] * 100.0 / values.size());
+		}
+		for (int i = 0; i < bar; i++) putchar('#');
+		putchar('\n');
+	}
+}
+
+int main(int argc, char **argv) {
+	std::vector<Column> columns;
+	if (argc < 2) {
+		readLog(stdin, "stdin", columns);
+	}
+	for (int i = 1; i < argc; i++) {
+		FILE *f = fopen(argv[i], "r");
+		if (f == NULL) {
+			fprintf(stderr, "cannot read %s\n", argv[i]);
+			return 1;
+		}
+		readLog(f, argv[i], columns);
+		fclose(f);
+	}
+	if (columns.empty() || columns[0].values.empty()) {
+		fprintf(stderr, "usage: %s timing.csv ... (no frames read)\n", argv[0]);
+		return 1;
+	}
+
+	printf("%zu frames\n\n", columns[0].values.size());
+	printf("%-12s %10s %10s %10s %10s %10s %10s\n", "stage us", "mean", "p50", "p90", "p99", "p99.9", "max");
+	for (Column &column : columns) {
+		std::vector<uint32_t> sorted = column.values;
+		std::sort(sorted.begin(), sorted.end());
+		double sum = 0;
+		for (uint32_t v : sorted) sum += v;
+		std::string name = column.name.size() > 3 && column.name.compare(column.name.size() - 3, 3, "_us") == 0
+			? column.name.substr(0, column.name.size() - 3) : column.name;
+		printf("%-12s %10.0f %10u %10u %10u %10u %10u\n", name.c_str(), sum / sorted.size(), percentile(sorted, 0.5),
+		       percentile(sorted, 0.9), percentile(sorted, 0.99), percentile(sorted, 0.999), sorted.back());
+	}
+
+	for (Column &column : columns) {
+		printf("\n%s\n", column.name.c_str());
+		printHistogram(column.values);
+	}
+	return 0;
+}
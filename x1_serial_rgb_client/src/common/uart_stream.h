@@ -0,0 +1,121 @@
+/**
+ * Interrupt-fed UART receive path built on the ESP-IDF UART driver.
+ *
+ * The Arduino Serial object copies bytes out of a small FIFO and its
+ * readBytes() busy-waits for the rest of a frame. Here the driver ISR
+ * fills a large ring buffer and posts events to a queue; read() sleeps on
+ * that queue until bytes (or a line idle timeout) arrive and then returns
+ * whatever is buffered, so the caller never spins and never loses the
+ * part of a frame that was already received.
+ *
+ * Uses UART0 (the USB bridge), so Serial.begin() must not be called.
+ */
+
+#ifndef UART_STREAM_H
+#define UART_STREAM_H
+
+#include <Arduino.h>
+#include <driver/uart.h>
+
+#define UART_STREAM_PORT UART_NUM_0
+#define UART_STREAM_RX_PIN 3
+#define UART_STREAM_TX_PIN 1
+#define UART_STREAM_RX_BUFFER 8192 // Holds ~4 RGB565 frames
+#define UART_STREAM_TX_BUFFER 1024
+#define UART_STREAM_EVENT_QUEUE 32
+
+class UartStream {
+public:
+	// Statistics
+	uint32_t overflows = 0;    // FIFO or ring buffer overruns (data lost)
+	uint32_t lineErrors = 0;   // Parity / framing errors
+
+	bool begin(uint32_t baud) {
+		uart_config_t config = {};
+		config.baud_rate = (int)baud;
+		config.data_bits = UART_DATA_8_BITS;
+		config.parity    = UART_PARITY_DISABLE;
+		config.stop_bits = UART_STOP_BITS_1;
+		config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+
+		if (uart_param_config(UART_STREAM_PORT, &config) != ESP_OK) return false;
+		if (uart_set_pin(UART_STREAM_PORT, UART_STREAM_TX_PIN, UART_STREAM_RX_PIN,
+		                 UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE) != ESP_OK) return false;
+		if (uart_driver_install(UART_STREAM_PORT, UART_STREAM_RX_BUFFER, UART_STREAM_TX_BUFFER,
+		                        UART_STREAM_EVENT_QUEUE, &_events, 0) != ESP_OK) return false;
+
+		// Wake up every 120 bytes, or after ~2 idle byte times at the end
+		// of a burst, instead of the driver defaults
+		uart_intr_config_t intr = {};
+		intr.intr_enable_mask = UART_RXFIFO_FULL_INT_ENA_M | UART_RXFIFO_TOUT_INT_ENA_M |
+		                        UART_FRM_ERR_INT_ENA_M | UART_RXFIFO_OVF_INT_ENA_M;
+		intr.rxfifo_full_thresh = 120;
+		intr.rx_timeout_thresh  = 2;
+		uart_intr_config(UART_STREAM_PORT, &intr);
+		return true;
+	}
+
+	/**
+	 * Copies up to len buffered bytes into dst. If nothing is buffered,
+	 * sleeps on the event queue for at most wait ticks first.
+	 * Returns the number of bytes copied (0 on timeout).
+	 */
+	size_t read(uint8_t *dst, size_t len, TickType_t wait) {
+		size_t buffered = 0;
+		uart_get_buffered_data_len(UART_STREAM_PORT, &buffered);
+
+		if (buffered == 0) {
+			uart_event_t event;
+			if (xQueueReceive(_events, &event, wait) != pdTRUE) return 0;
+			handleEvent(event);
+			uart_get_buffered_data_len(UART_STREAM_PORT, &buffered);
+			if (buffered == 0) return 0;
+		} else {
+			// Keep the queue from filling up with stale data events
+			uart_event_t event;
+			while (xQueueReceive(_events, &event, 0) == pdTRUE) handleEvent(event);
+		}
+
+		int n = uart_read_bytes(UART_STREAM_PORT, dst, buffered < len ? buffered : len, 0);
+		return n > 0 ? (size_t)n : 0;
+	}
+
+	size_t write(const uint8_t *src, size_t len) {
+		int n = uart_write_bytes(UART_STREAM_PORT, (const char *)src, len);
+		return n > 0 ? (size_t)n : 0;
+	}
+
+	/**
+	 * Changes the baud rate once everything already written has left, so
+	 * a last answer still goes out at the old rate. Buffered input is
+	 * kept: the frame parser drops whatever was garbled by the change.
+	 */
+	bool setBaudRate(uint32_t baud) {
+		uart_wait_tx_done(UART_STREAM_PORT, pdMS_TO_TICKS(100));
+		return uart_set_baudrate(UART_STREAM_PORT, baud) == ESP_OK;
+	}
+
+private:
+	QueueHandle_t _events = NULL;
+
+	void handleEvent(const uart_event_t &event) {
+		switch (event.type) {
+			case UART_FIFO_OVF:
+			case UART_BUFFER_FULL:
+				// Bytes were dropped: the frame parser will reject the frame
+				// in flight and resync, so just make room again
+				overflows++;
+				uart_flush_input(UART_STREAM_PORT);
+				xQueueReset(_events);
+				break;
+			case UART_FRAME_ERR:
+			case UART_PARITY_ERR:
+				lineErrors++;
+				break;
+			default:
+				break;
+		}
+	}
+};
+
+#endif
@@ -8,21 +8,84 @@
  *
  * Fork of the library that allows control of the special 32x32 matrix
  * https://github.com/Kameeno/SmartMatrix
+ *
+ * Frames are wrapped in the binary protocol described in
+ * common/frame_protocol.h (sync word, header, payload, CRC32) and received
+ * through the interrupt-driven UART driver in common/uart_stream.h.
+ *
+ * With PIPELINED set, receiving and presenting run as two FreeRTOS tasks:
+ * core 0 parses the UART stream into a pool of frame buffers, core 1
+ * decodes every complete frame in order and swaps once for the newest
+ * (common/frame_pipeline.h).
+ *
+ * Besides full RGB565 / RGB888 frames the client accepts rectangle delta
+ * frames (FRAME_FORMAT_RECTS_RGB565) and run-length coded XOR deltas
+ * (FRAME_FORMAT_XOR_RLE_RGB565) that patch the image in place. A delta
+ * is only applied on top of the frame it was computed against; otherwise
+ * it is dropped until the sender's next keyframe.
+ *
+ * Content with few colours can be sent as 1/2/4/8 bit palette indices
+ * (FRAME_FORMAT_INDEXEDx) after the palette itself (FRAME_FORMAT_PALETTE);
+ * the indices are expanded through the palette straight into the back
+ * buffer. A 1 bpp frame is 128 bytes instead of 2048.
+ *
+ * Several panels can be chained to one controller (PANELS_WIDE ×
+ * PANELS_HIGH, e.g. 2 × 1 for 64×32 or 2 × 2 for 64×64). Window frames
+ * (FRAME_FORMAT_WINDOW_RGB565 / _RGB888) replace one rectangle of the
+ * image, so a sender can update a single panel or split a frame that is
+ * too slow on the wire: at 921600 baud a 64×64 RGB565 frame alone takes
+ * 89 ms.
+ *
+ * Senders can ask what the client accepts: a FRAME_FORMAT_QUERY frame is
+ * answered with a FRAME_FORMAT_CAPS frame on the serial port (resolution,
+ * formats, buffer depth and baud rates, see DeviceCaps), so they can size
+ * and encode their frames to match instead of sharing constants with the
+ * firmware.
+ *
+ * The client starts at BAUD_RATE; a sender can move it up to
+ * MAX_BAUD_RATE with FRAME_FORMAT_BAUD (see BaudMessage). The new rate is
+ * on trial until the sender, having checked a burst of FRAME_FORMAT_TEST
+ * frames against the counters reported back, commits it; otherwise the
+ * client returns to the old rate after BAUD_TRIAL_MS.
+ *
+ * Senders that wait for credits (FRAME_FORMAT_CREDIT, see CreditMessage)
+ * never have more than CREDIT_WINDOW frames on the way or queued here, so
+ * the latency stays bounded and nothing is dropped for lack of a slot. A
+ * credit goes out whenever decoded frames gave their slots back, and
+ * every CREDIT_INTERVAL ms in case one was lost.
+ *
+ * With TIMING_ECHO set every frame that reaches the panel is answered with
+ * a FRAME_FORMAT_TIMING frame (see FrameTiming): when its first and last
+ * byte arrived, when it was decoded and when the swap finished, so a
+ * sender can break its end-to-end latency down per stage.
+ *
+ * With PANEL_BENCH set the client ignores the serial input and renders a
+ * test pattern as fast as it can, printing the refresh rate and the frame
+ * rate the chain reaches next to what the UART could deliver. Build it
+ * once per panel count and kRefreshDepth to find where it stops scaling.
  */
 
 // Pinout configuration for the PicoDriver v.5.0
 #include "common/pico_driver_v5_pinout.h"
+#include "common/frame_protocol.h"
+#include "common/uart_stream.h"
+#include "common/frame_pipeline.h"
+#include "common/frame_decode.h"
 
 #include <Arduino.h>
 #include <SmartMatrix.h>
 
 #define COLOR_DEPTH 24   // valid: 24, 48
-#define TOTAL_WIDTH 32   // Size of the total (chained) with of the matrix/matrices
-#define TOTAL_HEIGHT 32  // Size of the total (chained) height of the matrix/matrices
+#define PANEL_WIDTH 32   // Size of a single panel
+#define PANEL_HEIGHT 32
+#define PANELS_WIDE 1    // Panels chained horizontally
+#define PANELS_HIGH 1    // Panels chained vertically
+#define TOTAL_WIDTH (PANEL_WIDTH * PANELS_WIDE)   // Size of the total (chained) with of the matrix/matrices
+#define TOTAL_HEIGHT (PANEL_HEIGHT * PANELS_HIGH) // Size of the total (chained) height of the matrix/matrices
 #define kRefreshDepth 24 // Valid: 24, 36, 48
 #define kDmaBufferRows 4 // Valid: 2-4
 #define kPanelType SM_PANELTYPE_HUB75_32ROW_32COL_MOD8SCAN // custom
-#define kMatrixOptions (SM_HUB75_OPTIONS_NONE)
+#define kMatrixOptions (SM_HUB75_OPTIONS_NONE) // SM_HUB75_OPTIONS_C_SHAPE_STACKING for rows of panels wired as a serpentine
 #define kbgOptions (SM_BACKGROUND_OPTIONS_NONE)
 
 // SmartMatrix setup & buffer alloction
@@ -32,16 +95,70 @@ SMARTMATRIX_ALLOCATE_BUFFERS(matrix, TOTAL_WIDTH, TOTAL_HEIGHT, kRefreshDepth, k
 SMARTMATRIX_ALLOCATE_BACKGROUND_LAYER(bg, TOTAL_WIDTH, TOTAL_HEIGHT, COLOR_DEPTH, kbgOptions);
 
 
-// RGB32 or RGB24 (RRRRRGGG GGGBBBBB)?
-const uint8_t INCOMING_COLOR_DEPTH = 16;
+const uint32_t NUM_LEDS = (uint32_t)TOTAL_WIDTH * TOTAL_HEIGHT;
+const size_t MAX_PAYLOAD = FRAME_WINDOW_HEADER_SIZE + NUM_LEDS * 3; // Largest format is an RGB888 window of the whole image
+
+static_assert(MAX_PAYLOAD <= 0xFFFF, "A frame payload is at most 65535 bytes (16 bit length field)");
+
+#define BAUD_RATE 921600      // Rate after reset
+#define MAX_BAUD_RATE 3000000 // Highest rate a sender may switch to (the CP2102N goes to 3 Mbaud)
+#define MIN_BAUD_RATE 115200  // Lowest
+#define BAUD_TRIAL_MS 2000    // Back to the old rate unless a switch is committed within this
+
+#define PIPELINED 1          // 1: receive on core 0, decode/present on core 1
+#define FRAME_SLOTS 4        // Frame buffers in the pipeline pool (power of two)
+#define CREDIT_WINDOW 2      // Frames a sender may have queued here; more only add latency
+#define CREDIT_INTERVAL 100  // ms between repeated credits
+#define STATS_INTERVAL 2000  // ms between timing reports on the serial port, 0 = off
+#define TIMING_ECHO 1        // 1: send a FRAME_FORMAT_TIMING frame for every frame shown
+#define PANEL_BENCH 0        // 1: render a test pattern instead of receiving, report the reachable fps
 
-const uint16_t NUM_LEDS = TOTAL_WIDTH * TOTAL_HEIGHT;
-const uint16_t BUFFER_SIZE = NUM_LEDS * (INCOMING_COLOR_DEPTH / 8); 
-uint8_t buf[BUFFER_SIZE]; // A buffer for the incoming color data
+static_assert(CREDIT_WINDOW <= FRAME_SLOTS, "Credits are for frames the pool can hold");
+
+// Interrupt-fed serial input and the frame parser it feeds
+UartStream uart;
+FrameParser<MAX_PAYLOAD> parser;
+
+// Everything decodeFrame() accepts, reported to senders
+const uint8_t FORMATS[] = {
+	FRAME_FORMAT_RGB565, FRAME_FORMAT_RGB888, FRAME_FORMAT_RECTS_RGB565, FRAME_FORMAT_XOR_RLE_RGB565,
+	FRAME_FORMAT_PALETTE, FRAME_FORMAT_INDEXED1, FRAME_FORMAT_INDEXED2, FRAME_FORMAT_INDEXED4,
+	FRAME_FORMAT_INDEXED8, FRAME_FORMAT_WINDOW_RGB565, FRAME_FORMAT_WINDOW_RGB888,
+};
+
+// Pipeline state (only used with PIPELINED)
+FramePool<MAX_PAYLOAD, FRAME_SLOTS> pool;
+TaskHandle_t renderTask = NULL;
+
+// Per-stage timings
+StageTimer receiveTimer; // First to last byte of a frame on the wire
+StageTimer decodeTimer;  // Pixel format conversion into the back buffer
+StageTimer presentTimer; // swapBuffers()
+StageTimer latencyTimer; // Last byte received to swap done
+uint32_t framesMerged = 0; // Frames decoded but shown together with a newer one
+
+// Baud rate switching, done by the receiving side (see handleBaud())
+uint32_t baudRate = BAUD_RATE;
+uint32_t fallbackBaud = 0;    // Rate to return to while a switch is on trial, 0 = none
+uint32_t trialStart = 0;      // millis() of the switch
+uint32_t trialErrors = 0;     // Parser errors at the switch
+uint32_t trialOverruns = 0;   // UART overruns and line errors at the switch
+uint16_t testFrames = 0;      // Intact FRAME_FORMAT_TEST frames since the switch
+uint16_t testErrors = 0;      // ... and ones with the wrong content
+uint32_t firstTestAt = 0;
+uint32_t lastTestAt = 0;
+uint32_t baudReverts = 0;     // Switches that were not committed
+
+// Credit-based flow control, see sendCredit()
+std::atomic<uint16_t> lastReceivedId{0}; // Last frame taken off the wire
+std::atomic<uint8_t> framesHeld{0};      // Frames published but not decoded yet
+uint32_t lastCreditAt = 0;               // millis() of the last credit sent
+
+void receiveTask(void *);
+void renderLoop(void *);
 
 void setup() {
-	Serial.begin(921600);
-	Serial.setTimeout(1); 
+	uart.begin(BAUD_RATE);
 
 	pinMode(PICO_LED_PIN, OUTPUT);
 	digitalWrite(PICO_LED_PIN, 1);
@@ -50,52 +167,400 @@ void setup() {
 	matrix.addLayer(&bg);
 	matrix.setBrightness(255);
 	matrix.begin();
+
+	if (PIPELINED && !PANEL_BENCH) {
+		xTaskCreatePinnedToCore(renderLoop, "render", 4096, NULL, 2, &renderTask, 1);
+		xTaskCreatePinnedToCore(receiveTask, "receive", 4096, NULL, 3, NULL, 0);
+	}
 }
 
-void loop() {
+// Id of the frame currently held in the back buffer (valid once a full
+// frame was decoded). Delta frames must name it as their base.
+uint16_t currentId = 0;
+bool haveCurrent = false;
+bool currentIs565 = false; // XOR deltas need the exact RGB565 values
+uint32_t deltasRejected = 0;
 
-	static uint32_t frame = 0;
+// Last palette received, used by the indexed formats
+rgb24 palette[256];
+bool havePalette = false;
+
+// Converts a validated frame into the back buffer.
+// Returns false (and leaves the back buffer alone) for palettes, unknown
+// formats and for deltas against a frame we do not have.
+bool decodeFrame(const FrameHeader &header, const uint8_t *buf) {
+	rgb24 *buffer = bg.backBuffer();
+	uint8_t bpp = frameIndexedBpp(header.format);
+
+	if (header.format == FRAME_FORMAT_PALETTE) {
+		if (loadPalette(palette, buf, header.length)) havePalette = true;
+		return false; // Nothing to show yet
+	} else if (bpp) {
+		if (!havePalette || header.length != NUM_LEDS * bpp / 8) return false;
+		expandIndexed(buffer, NUM_LEDS, buf, bpp, palette);
+	} else if (header.format == FRAME_FORMAT_RGB888 && header.length == NUM_LEDS * 3) {
+		expandRgb888(buffer, buf, NUM_LEDS);
+	} else if (header.format == FRAME_FORMAT_RGB565 && header.length == NUM_LEDS * 2) {
+		expandRgb565(buffer, buf, NUM_LEDS);
+	} else if (header.format == FRAME_FORMAT_WINDOW_RGB565 || header.format == FRAME_FORMAT_WINDOW_RGB888) {
+		bool is565 = header.format == FRAME_FORMAT_WINDOW_RGB565;
+		if (!applyWindow(buffer, TOTAL_WIDTH, TOTAL_HEIGHT, buf, header.length, is565 ? 2 : 3)) return false;
+		// Patches the image like a delta, but does not need a base
+		currentId = header.id;
+		currentIs565 = currentIs565 && is565;
+		return true;
+	} else if (header.format == FRAME_FORMAT_RECTS_RGB565) {
+		if (!haveCurrent || header.length < FRAME_RECTS_HEADER_SIZE || rectsBaseId(buf) != currentId ||
+		    !applyRectsRgb565(buffer, TOTAL_WIDTH, TOTAL_HEIGHT, buf, header.length)) {
+			deltasRejected++;
+			return false;
+		}
+		currentId = header.id;
+		return true; // Keeps currentIs565: the patched pixels are RGB565 too
+	} else if (header.format == FRAME_FORMAT_XOR_RLE_RGB565) {
+		if (header.length < FRAME_XOR_RLE_HEADER_SIZE) return false;
+		bool delta = xorRleIsDelta(buf);
+		if ((delta && (!haveCurrent || !currentIs565 || xorRleBaseId(buf) != currentId)) ||
+		    !applyXorRleRgb565(buffer, NUM_LEDS, buf, header.length)) {
+			deltasRejected++;
+			return false;
+		}
+	} else {
+		return false;
+	}
+	currentId = header.id;
+	haveCurrent = true;
+	currentIs565 = header.format == FRAME_FORMAT_RGB565 || header.format == FRAME_FORMAT_XOR_RLE_RGB565;
+	return true;
+}
+
+// Shows the back buffer. Copying it back after the swap keeps the back
+// buffer equal to what is on screen, which delta frames patch. Returns
+// when the swap was done.
+uint32_t swapFrame(uint32_t receivedAt) {
+	uint32_t t0 = micros();
+	bg.swapBuffers(true);
+	uint32_t t1 = micros();
+	presentTimer.add(t1 - t0);
+	latencyTimer.add(t1 - receivedAt);
+	return t1;
+}
+
+void sendTiming(const FrameTiming &timing);
+
+// Decodes a single frame and swaps it in
+void presentFrame(const FrameHeader &header, const uint8_t *buf, uint32_t firstByteAt, uint32_t receivedAt) {
+	uint32_t t0 = micros();
+	if (!decodeFrame(header, buf)) return; // Keep the current image
+	uint32_t t1 = micros();
+	decodeTimer.add(t1 - t0);
+	uint32_t swappedAt = swapFrame(receivedAt);
+	if (TIMING_ECHO) sendTiming({header.id, firstByteAt, receivedAt, t1, swappedAt});
+}
+
+// Prints averages (max) per stage, e.g.
+// "# rx 46012 (46210) dec 212 (260) swap 3105 (16020) lat 3420 (16400) us | 21.7 fps, 0 dropped, 0 merged, 0 lost, 0 restarts, 0 deltas rejected | 921600 baud, 0 reverted"
+void reportStats() {
+	static uint32_t lastReport = 0;
+	uint32_t now = millis();
+	if (STATS_INTERVAL == 0 || now - lastReport < STATS_INTERVAL) return;
+
+	char line[224];
+	int len = snprintf(line, sizeof(line),
+		"# rx %lu (%lu) dec %lu (%lu) swap %lu (%lu) lat %lu (%lu) us | %.1f fps, %lu dropped, %lu merged, %lu lost, %lu restarts, %lu deltas rejected | %lu baud, %lu reverted\n",
+		(unsigned long)receiveTimer.averageUs(), (unsigned long)receiveTimer.maxUs,
+		(unsigned long)decodeTimer.averageUs(), (unsigned long)decodeTimer.maxUs,
+		(unsigned long)presentTimer.averageUs(), (unsigned long)presentTimer.maxUs,
+		(unsigned long)latencyTimer.averageUs(), (unsigned long)latencyTimer.maxUs,
+		presentTimer.count * 1000.0f / (now - lastReport),
+		(unsigned long)pool.dropped, (unsigned long)framesMerged, (unsigned long)parser.framesLost,
+		(unsigned long)parser.senderRestarts,
+		(unsigned long)deltasRejected, (unsigned long)baudRate, (unsigned long)baudReverts);
+	uart.write((const uint8_t *)line, len);
+
+	receiveTimer.reset();
+	decodeTimer.reset();
+	presentTimer.reset();
+	latencyTimer.reset();
+	lastReport = now;
+}
+
+// Ids of the frames sent back to the host (by both tasks)
+std::atomic<uint16_t> replyId{0};
+
+// Answers a FRAME_FORMAT_QUERY
+void sendCaps() {
+	static uint8_t out[FRAME_HEADER_SIZE + FRAME_CAPS_HEADER_SIZE + sizeof(FORMATS) + FRAME_CRC_SIZE];
+
+	DeviceCaps caps;
+	caps.width       = TOTAL_WIDTH;
+	caps.height      = TOTAL_HEIGHT;
+	caps.maxPayload  = MAX_PAYLOAD;
+	caps.frameSlots  = PIPELINED ? FRAME_SLOTS : 1;
+	caps.baud        = baudRate;
+	caps.maxBaud     = MAX_BAUD_RATE;
+	caps.formats     = FORMATS;
+	caps.formatCount = sizeof(FORMATS);
+	size_t len = writeCaps(&out[FRAME_HEADER_SIZE], caps);
+	uart.write(out, encodeFrame(out, FRAME_FORMAT_CAPS, replyId++, len));
+}
+
+void sendBaud(const BaudMessage &message) {
+	static uint8_t out[FRAME_HEADER_SIZE + FRAME_BAUD_SIZE + FRAME_CRC_SIZE];
+	writeBaudMessage(&out[FRAME_HEADER_SIZE], message);
+	uart.write(out, encodeFrame(out, FRAME_FORMAT_BAUD, replyId++, FRAME_BAUD_SIZE));
+}
+
+uint32_t parserErrors() {
+	return parser.crcErrors + parser.headerErrors;
+}
+
+// Moves to a new rate (after the answer has left) and restarts the test counters
+void switchBaud(uint32_t baud) {
+	uart.setBaudRate(baud);
+	baudRate = baud;
+	trialStart = millis();
+	trialErrors = parserErrors();
+	trialOverruns = uart.overflows + uart.lineErrors;
+	testFrames = 0;
+	testErrors = 0;
+}
 
-	char chr = Serial.read();
-	// The first byte is a magic number to identify the data format
-	if (chr == '*') { 
-
-
-		uint16_t count = Serial.readBytes((char *)buf, BUFFER_SIZE);
-		
-		if (count == BUFFER_SIZE) {
-
-			rgb24 *buffer = bg.backBuffer();
-			rgb24 *col;
-			uint16_t idx = 0;
-
-			if (INCOMING_COLOR_DEPTH == 24) {
-				for (uint16_t i = 0; i < NUM_LEDS; i++) {
-					col = &buffer[i];
-					col->red   = buf[idx++];
-					col->green = buf[idx++];
-					col->blue  = buf[idx++];
-				}
-			} else if (INCOMING_COLOR_DEPTH == 16) {
-				for (uint16_t i = 0; i < NUM_LEDS; i++) {
-					col = &buffer[i];
-
-					uint8_t  high  = buf[idx++];
-					uint8_t  low   = buf[idx++];
-					uint16_t rgb16 = ((uint16_t)high << 8) | low;
-
-					uint8_t r5 = (rgb16 >> 11) & 0x1F;
-					uint8_t g6 = (rgb16 >> 5)  & 0x3F;
-					uint8_t b5 =  rgb16        & 0x1F;
-
-					col->red   = r5 << 3;
-					col->green = g6 << 2;
-					col->blue  = b5 << 3;
-				}
+// FRAME_FORMAT_BAUD from the host
+void handleBaud(const uint8_t *payload, size_t len) {
+	BaudMessage request, answer = {};
+	if (!parseBaudMessage(payload, len, request)) return;
+	answer.baud = request.baud;
+
+	if (request.command == FRAME_BAUD_SWITCH) {
+		if (request.baud < MIN_BAUD_RATE || request.baud > MAX_BAUD_RATE) {
+			answer.command = FRAME_BAUD_REFUSED;
+			sendBaud(answer);
+			return;
+		}
+		answer.command = FRAME_BAUD_SWITCH;
+		sendBaud(answer);
+		if (!fallbackBaud) fallbackBaud = baudRate; // Trying another rate falls back to the last committed one
+		switchBaud(request.baud);
+	} else if (request.command == FRAME_BAUD_REPORT) {
+		answer.command    = FRAME_BAUD_REPORT;
+		answer.baud       = baudRate;
+		answer.testFrames = testFrames;
+		answer.errors     = testErrors + (parserErrors() - trialErrors);
+		answer.overruns   = uart.overflows + uart.lineErrors - trialOverruns;
+		answer.elapsedUs  = testFrames > 1 ? lastTestAt - firstTestAt : 0;
+		sendBaud(answer);
+	} else if (request.command == FRAME_BAUD_COMMIT && request.baud == baudRate) {
+		fallbackBaud = 0;
+		answer.command = FRAME_BAUD_COMMIT;
+		sendBaud(answer);
+	}
+}
+
+// Tells the sender the last frame that arrived and how many more it may
+// send (CreditMessage). Sent by the decoding side only.
+void sendCredit() {
+	static uint8_t out[FRAME_HEADER_SIZE + FRAME_CREDIT_SIZE + FRAME_CRC_SIZE];
+	CreditMessage credit;
+	credit.lastId = lastReceivedId; // Read first: a frame arriving meanwhile only lowers the credit
+	uint8_t held = framesHeld;
+	credit.free = held < CREDIT_WINDOW ? CREDIT_WINDOW - held : 0;
+	writeCreditMessage(&out[FRAME_HEADER_SIZE], credit);
+	uart.write(out, encodeFrame(out, FRAME_FORMAT_CREDIT, replyId++, FRAME_CREDIT_SIZE));
+	lastCreditAt = millis();
+}
+
+// Tells the sender when a frame it sent arrived and was shown (FrameTiming).
+// Sent by the decoding side only.
+void sendTiming(const FrameTiming &timing) {
+	static uint8_t out[FRAME_HEADER_SIZE + FRAME_TIMING_SIZE + FRAME_CRC_SIZE];
+	writeFrameTiming(&out[FRAME_HEADER_SIZE], timing);
+	uart.write(out, encodeFrame(out, FRAME_FORMAT_TIMING, replyId++, FRAME_TIMING_SIZE));
+}
+
+// FRAME_FORMAT_TEST: counts it if every byte is where it should be
+void countTestFrame(const FrameHeader &header, const uint8_t *payload, uint32_t now) {
+	for (size_t i = 0; i < header.length; i++) {
+		if (payload[i] != testPatternByte(header.id, i)) {
+			testErrors++;
+			return;
+		}
+	}
+	if (testFrames == 0) firstTestAt = now;
+	lastTestAt = now;
+	testFrames++;
+}
+
+// Returns to the old rate when a switch was not committed in time
+void checkBaudTrial() {
+	if (!fallbackBaud || millis() - trialStart < BAUD_TRIAL_MS) return;
+	switchBaud(fallbackBaud);
+	fallbackBaud = 0;
+	baudReverts++;
+}
+
+// Handles the frames that are meant for the client rather than the panel.
+// Returns false for everything else.
+bool handleControl(const FrameHeader &header, const uint8_t *payload, uint32_t now) {
+	switch (header.format) {
+		case FRAME_FORMAT_QUERY: sendCaps(); return true;
+		case FRAME_FORMAT_BAUD:  handleBaud(payload, header.length); return true;
+		case FRAME_FORMAT_TEST:  countTestFrame(header, payload, now); return true;
+		default: return false;
+	}
+}
+
+// Hands a slice of received bytes to the parser and calls onFrame for every
+// frame completed along the way. Partial frames stay in the parser, control
+// frames are handled right here.
+template <typename F>
+void feedParser(const uint8_t *data, size_t len, F onFrame) {
+	static uint32_t frameStart = 0;
+	uint32_t now = micros();
+	while (len > 0) {
+		if (parser.idle()) frameStart = now;
+		size_t used = parser.feed(data, len);
+		data += used;
+		len  -= used;
+		while (parser.available()) {
+			if (!handleControl(parser.header(), parser.payload(), now)) {
+				receiveTimer.add(now - frameStart);
+				onFrame(parser.header(), parser.payload(), frameStart, now);
+			}
+			parser.release();
+		}
+	}
+}
+
+// Core 0: UART → parser → frame pool
+void receiveTask(void *) {
+	static uint8_t chunk[512];
+	for (;;) {
+		size_t len = uart.read(chunk, sizeof(chunk), pdMS_TO_TICKS(100));
+		checkBaudTrial();
+		pool.reclaim();
+		feedParser(chunk, len, [](const FrameHeader &header, const uint8_t *payload, uint32_t firstByteAt, uint32_t now) {
+			PipelineFrame *slot = pool.acquire();
+			if (slot == NULL) {
+				lastReceivedId = header.id; // Renderer is behind, counted in pool.dropped
+				return;
+			}
+			slot->header = header;
+			slot->receivedAt = now;
+			slot->receiveUs = now - firstByteAt;
+			memcpy(slot->data, payload, header.length);
+			framesHeld++; // Before lastReceivedId, see sendCredit()
+			lastReceivedId = header.id;
+			pool.publish(slot);
+			xTaskNotifyGive(renderTask);
+		});
+	}
+}
+
+// Core 1: frame pool → back buffer → swap.
+// Everything published since the last swap is decoded in order (deltas
+// depend on their predecessors) and shown with a single swap.
+void renderLoop(void *) {
+	for (;;) {
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(100));
+
+		PipelineFrame *frame;
+		FrameTiming shown; // The newest frame decoded, the one the swap shows
+		uint8_t decoded = 0, taken = 0;
+		while ((frame = pool.pop()) != NULL) {
+			uint32_t t0 = micros();
+			if (decodeFrame(frame->header, frame->data)) {
+				uint32_t t1 = micros();
+				decodeTimer.add(t1 - t0);
+				shown.frameId = frame->header.id;
+				shown.firstByteUs = frame->receivedAt - frame->receiveUs;
+				shown.lastByteUs = frame->receivedAt;
+				shown.decodedUs = t1;
+				decoded++;
 			}
-			bg.swapBuffers(false);
+			pool.recycle(frame);
+			framesHeld--;
+			taken++;
+		}
+		// Before the swap, so the next frame is on the wire while it waits
+		if (taken || millis() - lastCreditAt >= CREDIT_INTERVAL) sendCredit();
+		if (decoded) {
+			framesMerged += decoded - 1;
+			shown.swappedUs = swapFrame(shown.lastByteUs);
+			if (TIMING_ECHO) sendTiming(shown);
+		}
+		reportStats();
+	}
+}
+
+// Frame rate the UART allows for a full frame of bytesPerPixel (10 bits per byte on the wire)
+float wireFps(uint8_t bytesPerPixel) {
+	return BAUD_RATE / 10.0f / (FRAME_HEADER_SIZE + NUM_LEDS * bytesPerPixel + FRAME_CRC_SIZE);
+}
+
+// PANEL_BENCH: decodes a moving RGB565 gradient and swaps as fast as the
+// matrix allows. Reports e.g.
+// "# bench 64x32 (2 panels) depth 24: refresh 240 Hz, dec 310 (330) swap 2890 (3010) us, 320.1 fps | wire 10.5 fps RGB565, 7.0 fps RGB888"
+void benchFrame() {
+	static uint8_t pixels[NUM_LEDS * 2];
+	static uint32_t frame = 0;
+	static uint32_t lastReport = millis();
+
+	for (uint32_t y = 0; y < TOTAL_HEIGHT; y++) {
+		for (uint32_t x = 0; x < TOTAL_WIDTH; x++) {
+			uint16_t rgb16 = (((x + frame) & 0x1F) << 11) | (((y * 2 + frame) & 0x3F) << 5) | (frame & 0x1F);
+			uint8_t *p = &pixels[(y * TOTAL_WIDTH + x) * 2];
+			p[0] = rgb16 >> 8;
+			p[1] = rgb16 & 0xFF;
 		}
 	}
+	frame++;
+
+	uint32_t t0 = micros();
+	expandRgb565(bg.backBuffer(), pixels, NUM_LEDS);
+	decodeTimer.add(micros() - t0);
+	swapFrame(micros());
+
+	uint32_t now = millis();
+	if (now - lastReport < (STATS_INTERVAL ? STATS_INTERVAL : 2000)) return;
+	char line[192];
+	int len = snprintf(line, sizeof(line),
+		"# bench %dx%d (%d panels) depth %d: refresh %u Hz, dec %lu (%lu) swap %lu (%lu) us, %.1f fps | wire %.1f fps RGB565, %.1f fps RGB888\n",
+		TOTAL_WIDTH, TOTAL_HEIGHT, PANELS_WIDE * PANELS_HIGH, kRefreshDepth, (unsigned)matrix.getRefreshRate(),
+		(unsigned long)decodeTimer.averageUs(), (unsigned long)decodeTimer.maxUs,
+		(unsigned long)presentTimer.averageUs(), (unsigned long)presentTimer.maxUs,
+		presentTimer.count * 1000.0f / (now - lastReport), wireFps(2), wireFps(3));
+	uart.write((const uint8_t *)line, len);
+	decodeTimer.reset();
+	presentTimer.reset();
+	latencyTimer.reset();
+	lastReport = now;
+}
+
+void loop() {
+
+	static uint32_t frame = 0;
+
+	if (PANEL_BENCH) {
+		benchFrame();
+	} else if (PIPELINED) {
+		// The tasks do the work, loop() only blinks
+		delay(20);
+	} else {
+		static uint8_t chunk[512];
+
+		// Sleeps until the UART has data (or 10 ms pass), then takes all of it
+		size_t len = uart.read(chunk, sizeof(chunk), pdMS_TO_TICKS(10));
+		checkBaudTrial();
+		bool presented = false;
+		feedParser(chunk, len, [&presented](const FrameHeader &header, const uint8_t *payload, uint32_t firstByteAt, uint32_t now) {
+			lastReceivedId = header.id;
+			presentFrame(header, payload, firstByteAt, now);
+			presented = true;
+		});
+		if (presented || millis() - lastCreditAt >= CREDIT_INTERVAL) sendCredit();
+		reportStats();
+	}
 
 	digitalWrite(PICO_LED_PIN, frame / 20 % 2);   // Let's animate the built-in LED as well
 	frame++;
@@ -0,0 +1,84 @@
+/**
+ * Host stand-in for the client's DMX mode: runs the firmware's DmxReceiver
+ * on local sockets and prints, once a second, how many frames were shown
+ * and how many of them were torn.
+ *
+ * n1_wireless_rgb_server/dmx_sender.js puts the frame counter into the
+ * blue channel of every pixel, so a frame is torn when the blue channel
+ * is not the same everywhere at the moment it is shown. With sync packets
+ * no frame should be torn, even with universes arriving out of order.
+ *
+ * Build and run (from this folder):
+ *   g++ -O2 -o dmx_receive dmx_receive.cpp
+ *   ./dmx_receive [seconds]
+ *   node ../../n1_wireless_rgb_server/dmx_sender.js --protocol sacn --sync 1
+ */
+
+#include "../src/common/dmx_receiver.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_LEDS (32 * 32)
+#define ARTNET_START_UNIVERSE 0
+#define SACN_START_UNIVERSE 1
+#define DMX_SYNC_TIMEOUT_MS 4000
+
+struct ImageTarget {
+	uint8_t pixels[NUM_LEDS * 3];
+	uint32_t torn = 0;
+
+	uint8_t *backBuffer() { return pixels; }
+
+	void present() {
+		for (size_t i = 1; i < NUM_LEDS; i++) {
+			if (pixels[i * 3 + 2] != pixels[2]) {
+				torn++;
+				break;
+			}
+		}
+	}
+};
+
+static DmxReceiver dmx(ARTNET_START_UNIVERSE, SACN_START_UNIVERSE, NUM_LEDS, DMX_SYNC_TIMEOUT_MS);
+static ImageTarget image;
+
+static uint32_t millis() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000ULL + ts.tv_nsec / 1000000);
+}
+
+static void report(const char *label, uint32_t shown) {
+	printf("%s%u packets, %u frames shown (%u in the last interval), %u torn, %u partial, %u syncs, "
+	       "%u ignored, %u out of order\n",
+	       label, dmx.packets, dmx.framesShown, shown, image.torn, dmx.framesPartial, dmx.syncs,
+	       dmx.ignored, dmx.outOfOrder);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 0;
+	if (!dmx.begin(ARTNET_PORT, SACN_PORT)) {
+		perror("bind");
+		return 1;
+	}
+	printf("Listening for Art-Net on %d and sACN on %d\n", ARTNET_PORT, SACN_PORT);
+
+	uint32_t start = millis(), lastReport = start, lastShown = 0;
+	for (;;) {
+		uint32_t now = millis();
+		dmx.poll(image, now, 100);
+
+		if (now - lastReport >= 1000) {
+			report("", dmx.framesShown - lastShown);
+			lastShown = dmx.framesShown;
+			lastReport = now;
+		}
+		if (seconds && now - start >= (uint32_t)seconds * 1000) break;
+	}
+
+	report("total: ", 0);
+	return 0;
+}
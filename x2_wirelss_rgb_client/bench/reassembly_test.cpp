@@ -0,0 +1,210 @@
+/**
+ * Host test for ChunkReassembler in src/common/chunk_reassembly.h and
+ * WallCommitter in src/common/wall_sync.h.
+ *
+ * Feeds chunked frames through the reassembler at 60 fps: in order, with
+ * chunks reversed and repeated, a late chunk of an old frame, and a sender
+ * that restarts and counts its frame ids from 0 again, both right away
+ * and after a pause. Checks which frames come out and prints the
+ * reassembler's counters for every case. The wall cases commit held
+ * frames with beacons across the same kinds of sender restart.
+ *
+ * Build and run (from this folder):
+ *   g++ -O2 -o reassembly_test reassembly_test.cpp
+ *   ./reassembly_test
+ */
+
+#include "../src/common/frame_protocol.h"
+#include "../src/common/frame_pipeline.h"
+#include "../src/common/chunk_reassembly.h"
+#include "../src/common/wall_sync.h"
+
+#include <stdio.h>
+
+#define NUM_LEDS (32 * 32)
+#define MAX_FRAME (FRAME_HEADER_SIZE + NUM_LEDS * 2 + FRAME_CRC_SIZE)
+#define FRAME_SLOTS 8
+#define REASSEMBLY_FRAMES 3
+#define FRAME_US 16667 // 60 fps
+#define WALL_HOLD_FRAMES 4
+
+typedef ChunkReassembler<MAX_FRAME, FRAME_SLOTS, REASSEMBLY_FRAMES> Reassembler;
+typedef WallCommitter<MAX_FRAME, FRAME_SLOTS, WALL_HOLD_FRAMES> Committer;
+
+static FramePool<MAX_FRAME, FRAME_SLOTS> pool;
+
+struct Datagram {
+	uint8_t data[CHUNK_HEADER_SIZE + CHUNK_DATA_SIZE];
+	size_t size;
+};
+
+enum Order {
+	IN_ORDER,
+	REVERSED, // Last chunk first
+	REPEATED, // Every chunk twice
+};
+
+static uint32_t now = 0;
+
+// Splits frame id into datagrams the way n1's chunkFrame() does
+static size_t makeDatagrams(uint16_t id, Datagram *out) {
+	static uint8_t frame[MAX_FRAME];
+	uint8_t *payload = frame + FRAME_HEADER_SIZE;
+	for (size_t i = 0; i < NUM_LEDS * 2; i++) payload[i] = (uint8_t)(i * 7 + id);
+	size_t length = encodeFrame(frame, FRAME_FORMAT_RGB565, id, NUM_LEDS * 2);
+
+	ChunkHeader chunk = {};
+	chunk.count = (length + CHUNK_DATA_SIZE - 1) / CHUNK_DATA_SIZE;
+	chunk.frameId = id;
+	for (size_t i = 0; i < chunk.count; i++) {
+		size_t size = i + 1 < chunk.count ? CHUNK_DATA_SIZE : length - i * CHUNK_DATA_SIZE;
+		chunk.index = i;
+		writeChunkHeader(out[i].data, chunk);
+		memcpy(out[i].data + CHUNK_HEADER_SIZE, frame + i * CHUNK_DATA_SIZE, size);
+		out[i].size = CHUNK_HEADER_SIZE + size;
+	}
+	return chunk.count;
+}
+
+// Returns the id of the frame the datagram completed, or -1
+static int receive(Reassembler &reassembler, const Datagram &d) {
+	ChunkHeader chunk;
+	if (!parseChunkHeader(d.data, chunk)) return -1;
+	uint8_t *target = reassembler.begin(chunk, d.size - CHUNK_HEADER_SIZE, now);
+	if (target == NULL) return -1;
+	memcpy(target, d.data + CHUNK_HEADER_SIZE, d.size - CHUNK_HEADER_SIZE);
+	PipelineFrame *frame = reassembler.end(now);
+	if (frame == NULL) return -1;
+	int id = frame->header.id;
+	pool.publish(frame);
+	pool.recycle(pool.pop());
+	pool.reclaim();
+	return id;
+}
+
+// Sends frame id one frame time after the last one; true if it came out
+static bool sendFrame(Reassembler &reassembler, uint16_t id, Order order = IN_ORDER) {
+	Datagram datagrams[4];
+	size_t count = makeDatagrams(id, datagrams);
+	now += FRAME_US;
+	int completed = -1;
+	for (size_t i = 0; i < count; i++) {
+		const Datagram &d = datagrams[order == REVERSED ? count - 1 - i : i];
+		int c = receive(reassembler, d);
+		if (order == REPEATED && receive(reassembler, d) >= 0) return false; // Completed twice
+		if (c >= 0) completed = c;
+	}
+	return completed == id;
+}
+
+// Sends count frames with consecutive ids from first; returns how many came out
+static int sendFrames(Reassembler &reassembler, uint16_t first, int count, Order order = IN_ORDER) {
+	int got = 0;
+	for (int i = 0; i < count; i++) got += sendFrame(reassembler, (uint16_t)(first + i), order);
+	return got;
+}
+
+// Holds frame id as if it had been reassembled, then commits it one
+// frame time later; true if the commit produced it
+static bool commitFrame(Committer &wall, uint16_t id) {
+	PipelineFrame *held = pool.acquire();
+	if (held == NULL) return false;
+	held->header.id = id;
+	wall.hold(held);
+	now += FRAME_US;
+	WallBeacon beacon = {id, now};
+	PipelineFrame *frame = wall.commit(beacon, now);
+	if (frame == NULL) return false;
+	bool ok = frame->header.id == id && wall.commit(beacon, now) == NULL; // The repeat is ignored
+	pool.publish(frame);
+	pool.recycle(pool.pop());
+	pool.reclaim();
+	return ok;
+}
+
+static int commitFrames(Committer &wall, uint16_t first, int count) {
+	int got = 0;
+	for (int i = 0; i < count; i++) got += commitFrame(wall, (uint16_t)(first + i));
+	return got;
+}
+
+static int failures = 0;
+
+static void check(const char *name, int got, int expected, const Reassembler &reassembler) {
+	bool ok = got == expected;
+	printf("%-34s %5d of %5d frames  %s | %u lost, %u torn, %u late, %u dup, %u restarts\n", name, got, expected,
+	       ok ? "ok  " : "FAIL", reassembler.framesLost, reassembler.framesTorn, reassembler.chunksLate,
+	       reassembler.chunksDuplicate, reassembler.senderRestarts);
+	if (!ok) failures++;
+}
+
+int main() {
+	{
+		Reassembler reassembler(pool);
+		check("in order", sendFrames(reassembler, 0, 1000), 1000, reassembler);
+	}
+	{
+		Reassembler reassembler(pool);
+		check("chunks reversed", sendFrames(reassembler, 0, 1000, REVERSED), 1000, reassembler);
+	}
+	{
+		Reassembler reassembler(pool);
+		check("chunks repeated", sendFrames(reassembler, 0, 1000, REPEATED), 1000, reassembler);
+	}
+	{
+		// A chunk of a frame a few frames old is late, not a restart
+		Reassembler reassembler(pool);
+		sendFrames(reassembler, 0, 100);
+		Datagram old[4];
+		makeDatagrams(90, old);
+		receive(reassembler, old[0]);
+		int got = sendFrames(reassembler, 100, 100);
+		check("late chunk", got, 100, reassembler);
+		if (reassembler.chunksLate != 1 || reassembler.senderRestarts != 0) failures++;
+	}
+	{
+		// The sender restarts after 18000 frames and counts from 0 again
+		Reassembler reassembler(pool);
+		sendFrames(reassembler, 0, 18000);
+		int got = sendFrames(reassembler, 0, 18000);
+		check("sender restart", got, 18000, reassembler);
+		if (reassembler.senderRestarts != 1) failures++;
+	}
+	{
+		// The sender restarts after 30 frames, too few ids back to tell,
+		// but after a pause
+		Reassembler reassembler(pool);
+		sendFrames(reassembler, 0, 30);
+		now += CHUNK_RESTART_US;
+		int got = sendFrames(reassembler, 0, 100);
+		check("sender restart after a pause", got, 100, reassembler);
+		if (reassembler.senderRestarts != 1) failures++;
+	}
+
+	{
+		Committer wall(pool);
+		commitFrames(wall, 0, 18000);
+		// A frame of the old sequence that never got its beacon
+		PipelineFrame *orphan = pool.acquire();
+		orphan->header.id = 18000;
+		wall.hold(orphan);
+		int got = commitFrames(wall, 0, 18000);
+		bool ok = got == 18000 && wall.senderRestarts == 1 && wall.size() == 0;
+		printf("%-34s %5d of %5d frames  %s | %u missed, %u uncommitted, %u restarts\n", "wall: sender restart", got,
+		       18000, ok ? "ok  " : "FAIL", wall.framesMissed, wall.framesUncommitted, wall.senderRestarts);
+		if (!ok) failures++;
+	}
+	{
+		Committer wall(pool);
+		commitFrames(wall, 0, 30);
+		now += CHUNK_RESTART_US;
+		int got = commitFrames(wall, 0, 100);
+		bool ok = got == 100 && wall.senderRestarts == 1;
+		printf("%-34s %5d of %5d frames  %s | %u missed, %u uncommitted, %u restarts\n", "wall: restart after a pause", got,
+		       100, ok ? "ok  " : "FAIL", wall.framesMissed, wall.framesUncommitted, wall.senderRestarts);
+		if (!ok) failures++;
+	}
+
+	printf("%s\n", failures ? "FAILED" : "all passed");
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,160 @@
+/**
+ * Compares the CPU work per frame of the two UDP receive paths of the
+ * client, without a network: the datagrams of a chunked RGB888 frame are
+ * prepared once and then fed through
+ *
+ *   polled:   what WiFiUDP does per datagram - parsePacket() allocates a
+ *             1460 byte buffer, copies the datagram into it (recvfrom),
+ *             copies it again into a new cbuf and frees the buffer; the
+ *             client then read()s header, extension and payload out of the
+ *             cbuf (a third copy) and the cbuf is freed
+ *   in place: the AsyncUDP path - header parsed from the pbuf, payload
+ *             copied once into its frame slot
+ *
+ * Both feed the same ChunkReassembler (with the CRC check of a complete
+ * frame), so the difference is the copying and the heap traffic. The
+ * socket layer itself (the pbuf → recvfrom copy inside lwIP, the mailbox
+ * hand-over to the reading task) is not part of the polled figure here, so
+ * on the device the gap is larger; the client's "cpu" stat measures both
+ * paths there (UDP_ASYNC 0 / 1).
+ *
+ * Build and run (from this folder):
+ *   g++ -O2 -o receive_copies receive_copies.cpp
+ *   ./receive_copies [frames]
+ */
+
+#include "../src/common/frame_protocol.h"
+#include "../src/common/frame_pipeline.h"
+#include "../src/common/chunk_reassembly.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_LEDS (32 * 32)
+#define MAX_FRAME (FRAME_HEADER_SIZE + NUM_LEDS * 3 + FRAME_CRC_SIZE)
+#define FRAME_SLOTS 8
+#define REASSEMBLY_FRAMES 3
+#define WIFIUDP_BUFFER 1460 // What WiFiUDP::parsePacket() allocates
+
+static FramePool<MAX_FRAME, FRAME_SLOTS> pool;
+static ChunkReassembler<MAX_FRAME, FRAME_SLOTS, REASSEMBLY_FRAMES> reassembler(pool);
+
+struct Datagram {
+	uint8_t data[CHUNK_HEADER_SIZE + CHUNK_DATA_SIZE];
+	size_t size;
+};
+
+static uint64_t cpuNs() {
+	timespec ts;
+	clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+	return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+// Splits frame `id` into datagrams the way n1's chunkFrame() does
+static size_t makeDatagrams(uint16_t id, Datagram *out) {
+	static uint8_t frame[MAX_FRAME];
+	uint8_t *payload = frame + FRAME_HEADER_SIZE;
+	for (size_t i = 0; i < NUM_LEDS * 3; i++) payload[i] = (uint8_t)(i * 7 + id);
+	size_t length = encodeFrame(frame, FRAME_FORMAT_RGB888, id, NUM_LEDS * 3);
+
+	ChunkHeader chunk = {};
+	chunk.count = (length + CHUNK_DATA_SIZE - 1) / CHUNK_DATA_SIZE;
+	chunk.frameId = id;
+	for (size_t i = 0; i < chunk.count; i++) {
+		size_t size = i + 1 < chunk.count ? CHUNK_DATA_SIZE : length - i * CHUNK_DATA_SIZE;
+		chunk.index = i;
+		writeChunkHeader(out[i].data, chunk);
+		memcpy(out[i].data + CHUNK_HEADER_SIZE, frame + i * CHUNK_DATA_SIZE, size);
+		out[i].size = CHUNK_HEADER_SIZE + size;
+	}
+	return chunk.count;
+}
+
+static bool finish(uint32_t now) {
+	PipelineFrame *frame = reassembler.end(now);
+	if (frame == NULL) return false;
+	pool.publish(frame);
+	pool.recycle(pool.pop());
+	pool.reclaim();
+	return true;
+}
+
+// The AsyncUDP path: everything straight from the pbuf
+static bool receiveInPlace(const Datagram &d, uint32_t now) {
+	ChunkHeader chunk;
+	if (d.size <= CHUNK_HEADER_SIZE || !parseChunkHeader(d.data, chunk)) return false;
+	size_t headerSize = chunkHeaderSize(chunk);
+	if (d.size <= headerSize) return false;
+	parseChunkExtension(d.data, chunk);
+	uint8_t *target = reassembler.begin(chunk, d.size - headerSize, now);
+	if (target == NULL) return false;
+	memcpy(target, d.data + headerSize, d.size - headerSize);
+	return finish(now);
+}
+
+// The WiFiUDP path: two heap buffers and three copies per datagram
+static bool receivePolled(const Datagram &d, uint32_t now) {
+	uint8_t *buf = new uint8_t[WIFIUDP_BUFFER];
+	memcpy(buf, d.data, d.size); // recvfrom()
+	uint8_t *cbuf = new uint8_t[d.size];
+	memcpy(cbuf, buf, d.size);   // rx_buffer->write()
+	delete[] buf;
+
+	bool completed = false;
+	uint8_t head[CHUNK_MAX_HEADER_SIZE];
+	ChunkHeader chunk;
+	memcpy(head, cbuf, CHUNK_HEADER_SIZE); // read() of the header
+	if (parseChunkHeader(head, chunk)) {
+		size_t headerSize = chunkHeaderSize(chunk);
+		memcpy(head + CHUNK_HEADER_SIZE, cbuf + CHUNK_HEADER_SIZE, headerSize - CHUNK_HEADER_SIZE);
+		parseChunkExtension(head, chunk);
+		uint8_t *target = reassembler.begin(chunk, d.size - headerSize, now);
+		if (target) {
+			memcpy(target, cbuf + headerSize, d.size - headerSize); // read() of the payload
+			completed = finish(now);
+		}
+	}
+	delete[] cbuf;
+	return completed;
+}
+
+// Frame ids keep counting so the reassembler never sees an old one; the
+// datagrams are made in untimed batches of BATCH consecutive ids
+#define BATCH 256
+static Datagram batch[BATCH][4];
+static size_t counts[BATCH];
+static uint16_t nextId = 0;
+
+template <typename Receive>
+static double run(const char *label, Receive receive, int n) {
+	uint32_t ok = 0;
+	uint64_t ns = 0;
+	for (int done = 0; done < n; done += BATCH) {
+		for (int f = 0; f < BATCH; f++) counts[f] = makeDatagrams(nextId++, batch[f]);
+		uint64_t t0 = cpuNs();
+		for (int f = 0; f < BATCH; f++) {
+			for (size_t i = 0; i < counts[f]; i++) ok += receive(batch[f][i], done + f);
+		}
+		ns += cpuNs() - t0;
+	}
+	n = (n + BATCH - 1) / BATCH * BATCH;
+	double usPerFrame = ns / 1000.0 / n;
+	printf("%-9s %6.2f us per frame (%u of %d frames complete)\n", label, usPerFrame, ok, n);
+	return usPerFrame;
+}
+
+int main(int argc, char **argv) {
+	int n = argc > 1 ? atoi(argv[1]) : 100000;
+
+	// Warm up, then alternate the paths to even out turbo and caches
+	run("warm-up", receiveInPlace, n / 10);
+	double polled = 0, inPlace = 0;
+	for (int round = 0; round < 3; round++) {
+		polled += run("polled", receivePolled, n);
+		inPlace += run("in place", receiveInPlace, n);
+	}
+	printf("in place needs %.0f%% of the CPU time of polled, %.2f us per frame less\n",
+	       100.0 * inPlace / polled, (polled - inPlace) / 3);
+	return 0;
+}
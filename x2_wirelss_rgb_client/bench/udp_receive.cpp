@@ -0,0 +1,110 @@
+/**
+ * Host stand-in for the wireless client: receives chunked frames on a UDP
+ * port with the same ChunkReassembler as the firmware and prints, once a
+ * second, how many frames arrived, were lost and were rebuilt from parity.
+ *
+ * Together with n1_wireless_rgb_server/loss_proxy.js this measures the
+ * forward error correction on Linux (see the example there). The
+ * recovery rate is the share of frames that would have been lost without
+ * parity: recovered / (recovered + lost).
+ *
+ * Build and run (from this folder):
+ *   g++ -O2 -o udp_receive udp_receive.cpp
+ *   ./udp_receive [port] [seconds]
+ */
+
+#include "../src/common/frame_protocol.h"
+#include "../src/common/frame_pipeline.h"
+#include "../src/common/chunk_reassembly.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <time.h>
+#include <unistd.h>
+
+#define NUM_LEDS (32 * 32)
+#define MAX_FRAME (FRAME_HEADER_SIZE + NUM_LEDS * 3 + FRAME_CRC_SIZE)
+#define FRAME_SLOTS 8
+#define REASSEMBLY_FRAMES 3
+#define FEC_MAX_GROUPS 4 // More than the firmware, to try larger settings
+
+static FramePool<MAX_FRAME, FRAME_SLOTS> pool;
+static ChunkReassembler<MAX_FRAME, FRAME_SLOTS, REASSEMBLY_FRAMES, FEC_MAX_GROUPS> reassembler(pool);
+
+static uint32_t micros() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+static void report(const char *label) {
+	uint32_t lost = reassembler.framesLost;
+	uint32_t recovered = reassembler.framesRecovered;
+	uint32_t total = reassembler.framesOk + lost;
+	printf("%s%u frames, %u ok, %u lost (%.1f%%), %u recovered with %u chunks, recovery rate %.1f%% | "
+	       "%u torn, %u reordered, %u late, %u dup, %u bad, %u corrupt, %u parity unused\n",
+	       label, total, reassembler.framesOk, lost, total ? 100.0 * lost / total : 0.0,
+	       recovered, reassembler.chunksRecovered,
+	       recovered + lost ? 100.0 * recovered / (recovered + lost) : 100.0,
+	       reassembler.framesTorn, reassembler.chunksReordered, reassembler.chunksLate,
+	       reassembler.chunksDuplicate, reassembler.chunksMalformed, reassembler.framesCorrupt,
+	       reassembler.parityUnused);
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+	int port = argc > 1 ? atoi(argv[1]) : 44446;
+	int seconds = argc > 2 ? atoi(argv[2]) : 0;
+
+	int sock = socket(AF_INET, SOCK_DGRAM, 0);
+	sockaddr_in addr = {};
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_ANY);
+	addr.sin_port = htons(port);
+	if (sock < 0 || bind(sock, (sockaddr *)&addr, sizeof(addr)) < 0) {
+		perror("bind");
+		return 1;
+	}
+	timeval timeout = {0, 100000};
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+	printf("Listening on UDP port %d\n", port);
+
+	uint8_t datagram[2048];
+	uint32_t start = micros(), lastReport = start;
+	for (;;) {
+		ssize_t size = recv(sock, datagram, sizeof(datagram), 0);
+		uint32_t now = micros();
+
+		ChunkHeader chunk;
+		if (size > CHUNK_HEADER_SIZE && parseChunkHeader(datagram, chunk) &&
+		    (size_t)size > chunkHeaderSize(chunk)) {
+			parseChunkExtension(datagram, chunk);
+			size_t headerSize = chunkHeaderSize(chunk);
+			uint8_t *target = reassembler.begin(chunk, size - headerSize, now);
+			if (target) {
+				memcpy(target, datagram + headerSize, size - headerSize);
+				PipelineFrame *frame = reassembler.end(now);
+				if (frame) {
+					// Nothing to show: hand the buffer straight back
+					pool.publish(frame);
+					pool.recycle(pool.pop());
+				}
+			}
+			pool.reclaim();
+		}
+
+		if (now - lastReport >= 1000000) {
+			report("");
+			lastReport = now;
+		}
+		if (seconds && now - start >= (uint32_t)seconds * 1000000) break;
+	}
+
+	report("total: ");
+	close(sock);
+	return 0;
+}
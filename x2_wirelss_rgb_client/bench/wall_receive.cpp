@@ -0,0 +1,226 @@
+/**
+ * Host stand-in for a video wall: runs one receiver per tile, each with
+ * its own socket on the wall's multicast group and the firmware's
+ * reassembler, WallCommitter and jitter buffer, and prints once a second
+ * how far apart the tiles would swap the same frame and whether they
+ * always showed the same frame id.
+ *
+ * n1_wireless_rgb_server/wall_sender.js puts the frame id into the blue
+ * channel of every pixel; a tile's frame is checked against it. With a
+ * loss rate every tile drops that share of the datagrams on its own, like
+ * boards with different reception, which shows as missed and torn frames.
+ *
+ * Build and run (from this folder):
+ *   g++ -O2 -o wall_receive wall_receive.cpp
+ *   ./wall_receive [seconds] [loss %] [tile x,y ...]     (default: 0,0 32,0)
+ *   node ../../n1_wireless_rgb_server/wall_sender.js --loopback 1
+ */
+
+#include "../src/common/frame_protocol.h"
+#include "../src/common/frame_pipeline.h"
+#include "../src/common/chunk_reassembly.h"
+#include "../src/common/jitter_buffer.h"
+#include "../src/common/wall_sync.h"
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define WALL_GROUP "239.255.80.1"
+#define UDP_PORT 44444
+#define MAX_TILES 8
+#define NUM_LEDS (32 * 32)
+#define MAX_FRAME (FRAME_HEADER_SIZE + NUM_LEDS * 3 + FRAME_CRC_SIZE)
+#define FRAME_SLOTS 16
+#define REASSEMBLY_FRAMES 3
+#define FEC_MAX_GROUPS 2
+#define WALL_HOLD_FRAMES 2
+#define JITTER_DELAY_MS 35
+#define CLOCK_WINDOW_MS 2000
+#define CLOCK_RESET_MS 500
+#define HISTORY 256 // Frame ids remembered for comparing the tiles
+
+static uint32_t micros() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+struct Tile {
+	uint16_t x, y;
+	int sock;
+	FramePool<MAX_FRAME, FRAME_SLOTS> pool;
+	ChunkReassembler<MAX_FRAME, FRAME_SLOTS, REASSEMBLY_FRAMES, FEC_MAX_GROUPS> reassembler;
+	WallCommitter<MAX_FRAME, FRAME_SLOTS, WALL_HOLD_FRAMES> wall;
+	JitterBuffer<FRAME_SLOTS> jitter;
+	uint32_t wrongImage = 0; // Blue channel does not match the frame id
+
+	Tile() : reassembler(pool), wall(pool),
+	         jitter(JITTER_DELAY_MS * 1000UL, CLOCK_WINDOW_MS * 1000UL, CLOCK_RESET_MS * 1000UL) {}
+};
+
+// Due time of each frame id per tile, to compare once all tiles have it
+struct Due {
+	uint16_t id;
+	bool valid;
+	uint32_t at[MAX_TILES];
+	uint32_t have; // Bit per tile
+};
+
+static Tile tiles[MAX_TILES];
+static int tileCount = 0;
+static Due history[HISTORY];
+
+// Spread of due times across tiles for frames all of them committed
+static uint32_t compared = 0, skewTotal = 0, skewMax = 0, partial = 0;
+
+static void settle(Due &due) {
+	if (!due.valid) return;
+	if (due.have == ((1u << tileCount) - 1)) {
+		uint32_t first = due.at[0], last = due.at[0];
+		for (int t = 1; t < tileCount; t++) {
+			if ((int32_t)(due.at[t] - first) < 0) first = due.at[t];
+			if ((int32_t)(due.at[t] - last) > 0) last = due.at[t];
+		}
+		uint32_t skew = last - first;
+		compared++;
+		skewTotal += skew;
+		if (skew > skewMax) skewMax = skew;
+	} else {
+		partial++; // Some tiles would have shown the previous frame: a tear
+	}
+	due.valid = false;
+}
+
+static void record(int t, const PipelineFrame *frame, uint32_t dueAt) {
+	Due &due = history[frame->header.id % HISTORY];
+	if (due.valid && due.id != frame->header.id) settle(due);
+	if (!due.valid) {
+		due.valid = true;
+		due.id = frame->header.id;
+		due.have = 0;
+	}
+	due.at[t] = dueAt;
+	due.have |= 1u << t;
+}
+
+static double loss = 0;
+
+static void receive(int t) {
+	Tile &tile = tiles[t];
+	uint8_t datagram[2048];
+	ssize_t size = recv(tile.sock, datagram, sizeof(datagram), MSG_DONTWAIT);
+	uint32_t now = micros();
+	if (size <= 0 || rand() < loss * RAND_MAX) return;
+
+	PipelineFrame *frame = NULL;
+	WallBeacon beacon;
+	ChunkHeader chunk;
+	if (parseWallBeacon(datagram, size, beacon)) {
+		frame = tile.wall.commit(beacon, now);
+	} else if (size > CHUNK_HEADER_SIZE && parseChunkHeader(datagram, chunk) &&
+	           (size_t)size > chunkHeaderSize(chunk)) {
+		parseChunkExtension(datagram, chunk);
+		if (!chunkIsTile(chunk, tile.x, tile.y)) return;
+		size_t headerSize = chunkHeaderSize(chunk);
+		uint8_t *target = tile.reassembler.begin(chunk, size - headerSize, now);
+		if (target == NULL) return;
+		memcpy(target, datagram + headerSize, size - headerSize);
+		PipelineFrame *complete = tile.reassembler.end(now);
+		if (complete) tile.wall.hold(complete);
+	}
+	tile.pool.reclaim();
+	if (frame == NULL) return;
+
+	// What the render task does, minus the waiting: the due time is what
+	// the tiles have to agree on
+	tile.pool.publish(frame);
+	frame = tile.pool.pop();
+	tile.jitter.push(frame);
+	tile.jitter.pop();
+	const uint8_t *pixels = frame->data + FRAME_HEADER_SIZE;
+	uint8_t blue = frame->header.format == FRAME_FORMAT_RGB565 ? (pixels[1] & 0x1F) << 3 : pixels[2];
+	uint8_t expected = frame->header.format == FRAME_FORMAT_RGB565 ? (frame->header.id & 0xF8) : frame->header.id & 0xFF;
+	if (blue != expected) tile.wrongImage++;
+	record(t, frame, tile.jitter.dueAt(frame));
+	tile.pool.recycle(frame);
+}
+
+static void report(const char *label) {
+	printf("%sskew avg %u max %u us over %u frames, %u torn |", label, compared ? skewTotal / compared : 0, skewMax,
+	       compared, partial);
+	for (int t = 0; t < tileCount; t++) {
+		printf(" %u,%u: %u committed %u missed %u uncommitted %u lost %u wrong%s", tiles[t].x, tiles[t].y,
+		       tiles[t].wall.framesCommitted, tiles[t].wall.framesMissed, tiles[t].wall.framesUncommitted,
+		       tiles[t].reassembler.framesLost, tiles[t].wrongImage, t + 1 < tileCount ? " |" : "");
+	}
+	printf("\n");
+	fflush(stdout);
+}
+
+int main(int argc, char **argv) {
+	int seconds = argc > 1 ? atoi(argv[1]) : 0;
+	loss = argc > 2 ? atof(argv[2]) / 100 : 0;
+	for (int i = 3; i < argc && tileCount < MAX_TILES; i++) {
+		unsigned x, y;
+		if (sscanf(argv[i], "%u,%u", &x, &y) != 2) {
+			fprintf(stderr, "Tiles are given as x,y\n");
+			return 1;
+		}
+		tiles[tileCount].x = x;
+		tiles[tileCount].y = y;
+		tileCount++;
+	}
+	if (tileCount == 0) {
+		tiles[0].x = 0;
+		tiles[1].x = 32;
+		tileCount = 2;
+	}
+
+	pollfd fds[MAX_TILES];
+	for (int t = 0; t < tileCount; t++) {
+		int sock = socket(AF_INET, SOCK_DGRAM, 0);
+		int on = 1;
+		setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		addr.sin_port = htons(UDP_PORT);
+		ip_mreq group = {};
+		group.imr_multiaddr.s_addr = inet_addr(WALL_GROUP);
+		group.imr_interface.s_addr = htonl(INADDR_ANY);
+		if (sock < 0 || bind(sock, (sockaddr *)&addr, sizeof(addr)) < 0 ||
+		    setsockopt(sock, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group)) < 0) {
+			perror("multicast socket");
+			return 1;
+		}
+		tiles[t].sock = sock;
+		fds[t].fd = sock;
+		fds[t].events = POLLIN;
+	}
+	printf("%d tiles on %s:%d\n", tileCount, WALL_GROUP, UDP_PORT);
+
+	uint32_t start = micros(), lastReport = start;
+	for (;;) {
+		poll(fds, tileCount, 100);
+		uint32_t now = micros();
+		for (int t = 0; t < tileCount; t++) {
+			if (fds[t].revents & POLLIN) receive(t);
+		}
+
+		if (now - lastReport >= 1000000) {
+			report("");
+			lastReport = now;
+		}
+		if (seconds && now - start >= (uint32_t)seconds * 1000000) break;
+	}
+
+	for (int i = 0; i < HISTORY; i++) settle(history[i]);
+	report("total: ");
+	return 0;
+}
@@ -0,0 +1,80 @@
+/**
+ * Host stand-in for the client's WebSocket mode: accepts frames with the
+ * firmware's WebSocketServer, validates them and, like the render task,
+ * hands credit back after a simulated present time. Prints frames per
+ * second and the message counters once a second.
+ *
+ * Build and run (from this folder):
+ *   g++ -O2 -o ws_receive ws_receive.cpp
+ *   ./ws_receive [port] [present ms] [seconds]
+ * then point a web app's WebSocket connect at ws://localhost:<port>.
+ */
+
+#include "../src/common/frame_protocol.h"
+#include "../src/common/websocket_server.h"
+
+#include <stdlib.h>
+#include <time.h>
+
+#define NUM_LEDS (32 * 32)
+#define MAX_PAYLOAD (NUM_LEDS * 3)
+#define MAX_FRAME (FRAME_HEADER_SIZE + MAX_PAYLOAD + FRAME_CRC_SIZE)
+#define WEBSOCKET_WINDOW 3
+
+static WebSocketServer ws;
+static uint8_t frames[WEBSOCKET_WINDOW][MAX_FRAME];
+
+static uint32_t micros() {
+	timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000);
+}
+
+int main(int argc, char **argv) {
+	int port = argc > 1 ? atoi(argv[1]) : 8081;
+	uint32_t presentUs = (argc > 2 ? atoi(argv[2]) : 16) * 1000;
+	int seconds = argc > 3 ? atoi(argv[3]) : 0;
+
+	if (!ws.begin(port, WEBSOCKET_WINDOW)) {
+		perror("listen");
+		return 1;
+	}
+	printf("Listening on ws://localhost:%d, %u ms per frame\n", port, presentUs / 1000);
+
+	// Frames wait in a queue and are "shown" one per presentUs
+	uint32_t queued = 0, slot = 0, valid = 0, invalid = 0, shown = 0;
+	uint32_t start = micros(), lastShow = start, lastReport = start, lastShown = 0;
+	for (;;) {
+		size_t length = ws.poll(frames[slot], MAX_FRAME, micros(), 1);
+		if (length) {
+			FrameHeader header;
+			if (parseFrame(frames[slot], length, MAX_PAYLOAD, header)) {
+				valid++;
+				queued++;
+				slot = (slot + 1) % WEBSOCKET_WINDOW;
+			} else {
+				invalid++;
+				ws.grant(1);
+			}
+		}
+
+		uint32_t now = micros();
+		if (queued && now - lastShow >= presentUs) {
+			queued--;
+			shown++;
+			lastShow = now;
+			ws.grant(1);
+		}
+
+		if (now - lastReport >= 1000000) {
+			printf("%.1f fps, %u valid, %u invalid, %u messages, %u too large, %u connections, %u protocol errors\n",
+			       (shown - lastShown) * 1e6 / (now - lastReport), valid, invalid, ws.messages,
+			       ws.messagesTooLarge, ws.connections, ws.protocolErrors);
+			fflush(stdout);
+			lastShown = shown;
+			lastReport = now;
+		}
+		if (seconds && now - start >= (uint32_t)seconds * 1000000) break;
+	}
+	return 0;
+}
@@ -0,0 +1,413 @@
+/**
+ * Reassembly of frames sent as several UDP datagrams.
+ *
+ * The sender wraps a frame in the format of frame_protocol.h (header,
+ * payload, CRC32) and splits it into chunks of CHUNK_DATA_SIZE bytes, each
+ * sent as one datagram behind this header:
+ *
+ *   Offset  Size  Field
+ *   0       1     Magic 'C' (0x43)
+ *   1       1     Chunk index, 0 .. count-1
+ *   2       1     Chunk count (at most CHUNK_MAX_COUNT)
+ *   3       1     Flags, see below
+ *   4       2     Frame id, little-endian (same as in the frame header)
+ *   6       4     Presentation time, little-endian (only with CHUNK_FLAG_TIMESTAMP)
+ *   +0      2     Tile x, little-endian (only with CHUNK_FLAG_TILE)
+ *   +2      2     Tile y, little-endian (only with CHUNK_FLAG_TILE)
+ *
+ * With CHUNK_FLAG_TIMESTAMP every chunk of the frame carries the moment
+ * the sender wants it shown, in microseconds of the sender's own clock;
+ * see jitter_buffer.h.
+ *
+ * With CHUNK_FLAG_TILE the frame is one tile of a video wall, the part of
+ * the wall image whose top left corner is at (x, y); a wall client only
+ * takes the chunks of its own tile (see wall_sync.h).
+ *
+ * Chunk i carries bytes [i * CHUNK_DATA_SIZE, ...) of the frame; all but
+ * the last chunk are exactly CHUNK_DATA_SIZE bytes.
+ *
+ * Forward error correction: bits 4-6 of the flags give a number of parity
+ * groups G (0 = none), the same in every chunk of the frame. Data chunk i
+ * belongs to group i % G. After the data the sender adds one chunk per
+ * group with CHUNK_FLAG_PARITY set and the group number as index, holding
+ * the XOR of the group's data chunks (each zero-padded to the longest).
+ * One lost chunk per group can be rebuilt, so G consecutive losses are
+ * recovered; a lost last chunk gets its length from the frame header.
+ *
+ * Several frames can be in flight at once, each in its own buffer from
+ * the FramePool, so chunks that arrive reordered or interleaved with the
+ * next frame's never end up in the wrong image. When a frame completes
+ * (and passes its CRC) it is published and every older frame still being
+ * assembled is abandoned: the newest complete frame always wins.
+ *
+ * Chunks of frames no newer than the last completed one are late and
+ * dropped. A sender that restarts counts its frame ids from 0 again, so
+ * an id more than CHUNK_RESTART_FRAMES behind the newest, or any id after
+ * CHUNK_RESTART_US without chunks, starts a new sequence instead.
+ *
+ * Chunk data is written straight from the socket into the frame buffer:
+ *
+ *   uint8_t *dst = reassembler.begin(header, dataSize, micros());
+ *   if (dst) { read dataSize bytes into dst; frame = reassembler.end(micros()); }
+ */
+
+#ifndef CHUNK_REASSEMBLY_H
+#define CHUNK_REASSEMBLY_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "frame_protocol.h"
+#include "frame_pipeline.h"
+
+#define CHUNK_MAGIC 0x43 // 'C'
+#define CHUNK_HEADER_SIZE 6
+#define CHUNK_TIMESTAMP_SIZE 4
+#define CHUNK_TILE_SIZE 4
+#define CHUNK_MAX_HEADER_SIZE (CHUNK_HEADER_SIZE + CHUNK_TIMESTAMP_SIZE + CHUNK_TILE_SIZE)
+#define CHUNK_FLAG_TIMESTAMP 0x01
+#define CHUNK_FLAG_PARITY 0x02     // Parity chunk, index is the parity group
+#define CHUNK_FLAG_TILE 0x04       // Video wall tile offset follows
+#define CHUNK_PARITY_SHIFT 4       // Flag bits 4-6: number of parity groups
+#define CHUNK_PARITY_MASK 0x70
+#define CHUNK_DATA_SIZE 1024 // Fits a 1500 byte MTU with room to spare
+#define CHUNK_MAX_COUNT 32   // One bit each in a uint32_t
+#define CHUNK_RESTART_FRAMES 64   // Frame ids this far back mean the sender restarted
+#define CHUNK_RESTART_US 2000000  // After this long without chunks any frame id is a new start
+
+struct ChunkHeader {
+	uint8_t  index;
+	uint8_t  count;
+	uint8_t  flags;
+	uint16_t frameId;
+	uint32_t timestamp; // Valid with CHUNK_FLAG_TIMESTAMP
+	uint16_t tileX;     // Valid with CHUNK_FLAG_TILE
+	uint16_t tileY;
+};
+
+inline bool parseChunkHeader(const uint8_t *p, ChunkHeader &chunk) {
+	if (p[0] != CHUNK_MAGIC) return false;
+	chunk.index   = p[1];
+	chunk.count   = p[2];
+	chunk.flags   = p[3];
+	chunk.frameId = readLE16(&p[4]);
+	chunk.timestamp = 0;
+	chunk.tileX = chunk.tileY = 0;
+	return true;
+}
+
+// Total header size of a chunk, given its parsed flags
+inline size_t chunkHeaderSize(const ChunkHeader &chunk) {
+	return CHUNK_HEADER_SIZE + (chunk.flags & CHUNK_FLAG_TIMESTAMP ? CHUNK_TIMESTAMP_SIZE : 0) +
+	       (chunk.flags & CHUNK_FLAG_TILE ? CHUNK_TILE_SIZE : 0);
+}
+
+// Reads the fields that follow the fixed header (chunkHeaderSize() bytes in p)
+inline void parseChunkExtension(const uint8_t *p, ChunkHeader &chunk) {
+	p += CHUNK_HEADER_SIZE;
+	if (chunk.flags & CHUNK_FLAG_TIMESTAMP) {
+		chunk.timestamp = readLE32(p);
+		p += CHUNK_TIMESTAMP_SIZE;
+	}
+	if (chunk.flags & CHUNK_FLAG_TILE) {
+		chunk.tileX = readLE16(p);
+		chunk.tileY = readLE16(p + 2);
+	}
+}
+
+inline void writeChunkHeader(uint8_t *p, const ChunkHeader &chunk) {
+	p[0] = CHUNK_MAGIC;
+	p[1] = chunk.index;
+	p[2] = chunk.count;
+	p[3] = chunk.flags;
+	writeLE16(&p[4], chunk.frameId);
+	p += CHUNK_HEADER_SIZE;
+	if (chunk.flags & CHUNK_FLAG_TIMESTAMP) {
+		writeLE32(p, chunk.timestamp);
+		p += CHUNK_TIMESTAMP_SIZE;
+	}
+	if (chunk.flags & CHUNK_FLAG_TILE) {
+		writeLE16(p, chunk.tileX);
+		writeLE16(p + 2, chunk.tileY);
+	}
+}
+
+// Parity groups of the chunk's frame, 0 without forward error correction
+inline uint8_t chunkParityGroups(const ChunkHeader &chunk) {
+	return (chunk.flags & CHUNK_PARITY_MASK) >> CHUNK_PARITY_SHIFT;
+}
+
+// a - b for 16 bit frame ids that wrap around
+inline int16_t frameIdDiff(uint16_t a, uint16_t b) {
+	return (int16_t)(uint16_t)(a - b);
+}
+
+/**
+ * MAX_FRAME and SLOTS describe the FramePool the buffers come from (MAX_FRAME
+ * holds a whole protocol frame), ENTRIES is the number of frames that may
+ * be assembled at the same time and PARITY the most parity groups per frame
+ * that are used for recovery (each costs CHUNK_DATA_SIZE bytes per entry;
+ * frames with more groups are still received, without recovery).
+ */
+template <size_t MAX_FRAME, size_t SLOTS, size_t ENTRIES, size_t PARITY = 0>
+class ChunkReassembler {
+public:
+	// Statistics, never reset
+	uint32_t framesOk = 0;
+	uint32_t framesLost = 0;   // Gaps in the sequence of completed frame ids
+	uint32_t framesTorn = 0;   // Partial frames abandoned for a newer complete one
+	uint32_t chunksReordered = 0; // Chunks of a frame older than the newest one seen
+	uint32_t chunksLate = 0;   // Chunks of a frame already completed or abandoned
+	uint32_t chunksDuplicate = 0;
+	uint32_t chunksMalformed = 0;
+	uint32_t framesCorrupt = 0; // Complete, but failing the header or CRC check
+	uint32_t chunksRecovered = 0; // Rebuilt from parity
+	uint32_t framesRecovered = 0; // Completed thanks to at least one rebuilt chunk
+	uint32_t parityUnused = 0;    // Parity chunks for frames already complete
+	uint32_t senderRestarts = 0;  // Frame id sequences started over, see restarted()
+
+	explicit ChunkReassembler(FramePool<MAX_FRAME, SLOTS> &pool) : _pool(pool) {}
+
+	/**
+	 * Accepts the header of a chunk carrying size bytes of data. Returns
+	 * where the data must be written, or NULL if the chunk is to be
+	 * dropped (the caller then discards the datagram).
+	 */
+	uint8_t *begin(const ChunkHeader &chunk, size_t size, uint32_t now) {
+		_current = NULL;
+		bool parity = (chunk.flags & CHUNK_FLAG_PARITY) != 0;
+		uint8_t groups = chunkParityGroups(chunk);
+		if (chunk.count == 0 || chunk.count > CHUNK_MAX_COUNT || size == 0 || size > CHUNK_DATA_SIZE ||
+		    (parity ? chunk.index >= groups
+		            : chunk.index >= chunk.count ||
+		              (chunk.index + 1 < chunk.count && size != CHUNK_DATA_SIZE) ||
+		              (size_t)chunk.index * CHUNK_DATA_SIZE + size > MAX_FRAME)) {
+			chunksMalformed++;
+			return NULL;
+		}
+
+		if (restarted(chunk.frameId, now)) {
+			senderRestarts++;
+			for (size_t i = 0; i < ENTRIES; i++) {
+				if (_entries[i].frame) release(_entries[i]);
+			}
+			_haveCompleted = false;
+			_haveNewest = false;
+		}
+		_lastChunkAt = now;
+
+		if (_haveCompleted && frameIdDiff(chunk.frameId, _lastCompleted) <= 0) {
+			if (parity) parityUnused++;
+			else chunksLate++;
+			return NULL;
+		}
+		if (parity && groups > PARITY) return NULL; // Cannot use it
+
+		if (_haveNewest && frameIdDiff(chunk.frameId, _newest) < 0) {
+			chunksReordered++;
+		} else {
+			_newest = chunk.frameId;
+			_haveNewest = true;
+		}
+
+		Entry *entry = find(chunk.frameId);
+		if (entry == NULL) {
+			entry = allocate(chunk);
+			if (entry == NULL) return NULL; // No buffer, counted in pool.dropped
+			entry->firstChunkAt = now;
+		} else if (entry->count != chunk.count) {
+			chunksMalformed++;
+			return NULL;
+		}
+
+		uint32_t bit = (uint32_t)1 << chunk.index;
+		if ((parity ? entry->parityReceived : entry->received) & bit) {
+			chunksDuplicate++;
+			return NULL;
+		}
+
+		_current = entry;
+		_currentBit = bit;
+		_currentIndex = chunk.index;
+		_currentSize = size;
+		_currentParity = parity;
+		if (parity) return _scratch;
+		if (chunk.index + 1 == chunk.count) entry->length = (size_t)chunk.index * CHUNK_DATA_SIZE + size;
+		return entry->frame->data + (size_t)chunk.index * CHUNK_DATA_SIZE;
+	}
+
+	/**
+	 * Marks the chunk accepted by begin() as received. If it completed a
+	 * valid frame, returns it (header filled in, data holding the whole
+	 * protocol frame) for the caller to publish; otherwise NULL.
+	 */
+	PipelineFrame *end(uint32_t now) {
+		Entry *entry = _current;
+		if (entry == NULL) return NULL;
+		_current = NULL;
+
+		if (entry->groups) {
+			uint8_t group = _currentParity ? _currentIndex : _currentIndex % entry->groups;
+			const uint8_t *data = _currentParity ? _scratch
+			                                     : entry->frame->data + (size_t)_currentIndex * CHUNK_DATA_SIZE;
+			xorInto(entry->parity[group], data, _currentSize);
+			if (_currentParity) entry->parityReceived |= _currentBit;
+			else entry->received |= _currentBit;
+			recover(*entry, group);
+		} else {
+			entry->received |= _currentBit;
+		}
+
+		uint32_t all = entry->count == 32 ? 0xFFFFFFFF : ((uint32_t)1 << entry->count) - 1;
+		if (entry->received != all) return NULL;
+
+		PipelineFrame *frame = entry->frame;
+		uint16_t id = entry->frameId;
+		bool recovered = entry->recovered;
+		entry->frame = NULL;
+
+		// A rebuilt last chunk is zero-padded; the frame header knows the length
+		if (entry->length == 0) {
+			entry->length = FRAME_HEADER_SIZE + readLE16(&frame->data[6]) + FRAME_CRC_SIZE;
+			if (entry->length <= (size_t)(entry->count - 1) * CHUNK_DATA_SIZE ||
+			    entry->length > (size_t)entry->count * CHUNK_DATA_SIZE) entry->length = 0;
+		}
+
+		if (!parseFrame(frame->data, entry->length, MAX_FRAME - FRAME_HEADER_SIZE - FRAME_CRC_SIZE, frame->header) ||
+		    frame->header.id != id) {
+			framesCorrupt++;
+			_pool.cancel(frame);
+			return NULL;
+		}
+
+		if (_haveCompleted) framesLost += (uint16_t)(id - _lastCompleted - 1);
+		_lastCompleted = id;
+		_haveCompleted = true;
+		framesOk++;
+		if (recovered) framesRecovered++;
+
+		// Everything older can no longer be shown
+		for (size_t i = 0; i < ENTRIES; i++) {
+			if (_entries[i].frame && frameIdDiff(_entries[i].frameId, id) < 0) release(_entries[i]);
+		}
+
+		frame->receivedAt = now;
+		frame->receiveUs = now - entry->firstChunkAt;
+		frame->presentAt = entry->timestamp;
+		frame->timed = entry->timed;
+		return frame;
+	}
+
+private:
+	struct Entry {
+		PipelineFrame *frame = NULL; // NULL: entry unused
+		uint16_t frameId = 0;
+		uint8_t  count = 0;
+		uint32_t received = 0;       // Bit per chunk
+		size_t   length = 0;         // Known once the last chunk arrived (or was rebuilt)
+		uint32_t firstChunkAt = 0;
+		uint32_t timestamp = 0;
+		bool     timed = false;
+		uint8_t  groups = 0;         // Parity groups used for recovery, 0 = none
+		uint32_t parityReceived = 0; // Bit per group
+		bool     recovered = false;
+		uint8_t  parity[PARITY ? PARITY : 1][PARITY ? CHUNK_DATA_SIZE : 1]; // XOR of all chunks received per group
+	};
+
+	FramePool<MAX_FRAME, SLOTS> &_pool;
+	Entry _entries[ENTRIES];
+	Entry *_current = NULL;
+	uint32_t _currentBit = 0;
+	uint8_t _currentIndex = 0;
+	size_t _currentSize = 0;
+	bool _currentParity = false;
+	uint8_t _scratch[PARITY ? CHUNK_DATA_SIZE : 1]; // Parity chunks land here
+	uint16_t _lastCompleted = 0;
+	bool _haveCompleted = false;
+	uint16_t _newest = 0;
+	bool _haveNewest = false;
+	uint32_t _lastChunkAt = 0;
+
+	// True if frameId starts a new sequence: far behind the newest frame
+	// (the sender restarted and counts from 0 again), or after a silence
+	bool restarted(uint16_t frameId, uint32_t now) const {
+		if (!_haveNewest) return false;
+		return now - _lastChunkAt > CHUNK_RESTART_US || frameIdDiff(frameId, _newest) < -CHUNK_RESTART_FRAMES;
+	}
+
+	Entry *find(uint16_t frameId) {
+		for (size_t i = 0; i < ENTRIES; i++) {
+			if (_entries[i].frame && _entries[i].frameId == frameId) return &_entries[i];
+		}
+		return NULL;
+	}
+
+	// A free entry with a buffer for a new frame, evicting the oldest
+	// partial frame if all entries are busy
+	Entry *allocate(const ChunkHeader &chunk) {
+		Entry *entry = NULL;
+		for (size_t i = 0; i < ENTRIES && entry == NULL; i++) {
+			if (_entries[i].frame == NULL) entry = &_entries[i];
+		}
+		if (entry == NULL) {
+			entry = &_entries[0];
+			for (size_t i = 1; i < ENTRIES; i++) {
+				if (frameIdDiff(_entries[i].frameId, entry->frameId) < 0) entry = &_entries[i];
+			}
+			if (frameIdDiff(chunk.frameId, entry->frameId) < 0) {
+				chunksLate++; // Older than everything in flight
+				return NULL;
+			}
+			release(*entry);
+		}
+
+		entry->frame = _pool.acquire();
+		if (entry->frame == NULL) return NULL;
+		entry->frameId = chunk.frameId;
+		entry->count = chunk.count;
+		entry->received = 0;
+		entry->length = 0;
+		entry->timed = (chunk.flags & CHUNK_FLAG_TIMESTAMP) != 0;
+		entry->timestamp = chunk.timestamp;
+		uint8_t groups = chunkParityGroups(chunk);
+		entry->groups = groups <= PARITY ? groups : 0;
+		entry->parityReceived = 0;
+		entry->recovered = false;
+		if (entry->groups) memset(entry->parity, 0, sizeof(entry->parity));
+		return entry;
+	}
+
+	void release(Entry &entry) {
+		framesTorn++;
+		_pool.cancel(entry.frame);
+		entry.frame = NULL;
+	}
+
+	static void xorInto(uint8_t *dst, const uint8_t *src, size_t size) {
+		for (size_t i = 0; i < size; i++) dst[i] ^= src[i];
+	}
+
+	// With the group's parity and all but one of its data chunks in, the
+	// accumulated XOR is the missing chunk
+	void recover(Entry &entry, uint8_t group) {
+		if (!(entry.parityReceived & ((uint32_t)1 << group))) return;
+
+		int missing = -1;
+		for (uint8_t i = group; i < entry.count; i += entry.groups) {
+			if (entry.received & ((uint32_t)1 << i)) continue;
+			if (missing >= 0) return; // Two or more missing
+			missing = i;
+		}
+		if (missing < 0) return;
+
+		size_t offset = (size_t)missing * CHUNK_DATA_SIZE;
+		if (offset >= MAX_FRAME) return;
+		size_t size = MAX_FRAME - offset < CHUNK_DATA_SIZE ? MAX_FRAME - offset : CHUNK_DATA_SIZE;
+		memcpy(entry.frame->data + offset, entry.parity[group], size);
+		entry.received |= (uint32_t)1 << missing;
+		entry.recovered = true;
+		chunksRecovered++;
+	}
+};
+
+#endif
@@ -0,0 +1,355 @@
+/**
+ * Art-Net and sACN (E1.31) receiver that maps DMX universes onto pixels.
+ *
+ * Each universe carries DMX_PIXELS_PER_UNIVERSE RGB pixels (510 of its 512
+ * channels), in order: universe start + n holds pixels n * 170 ... The
+ * channel data is RGB888, the layout of a SmartMatrix rgb24 buffer, so it
+ * is read from the socket straight into the back buffer: the header is
+ * peeked to find the universe, then recvmsg() scatters the header into a
+ * scratch buffer and the channels into their place in the image.
+ *
+ * A frame is shown (Target::present()) when
+ *   - a sync packet arrives (ArtSync, or an E1.31 sync packet for the sync
+ *     address named in the data), for senders that synchronise: all
+ *     universes of a frame then appear at once. Without sync packets for
+ *     syncTimeoutMs the receiver falls back to:
+ *   - every mapped universe has arrived, or
+ *   - a universe arrives a second time before that (the sender skips some
+ *     universes or one was lost): the frame collected so far is shown
+ *     first.
+ *
+ * Only one source is expected: sACN priorities are ignored, as are preview
+ * data, non-zero start codes and terminated streams. Packets that are
+ * older than the last one of their universe (by sequence number) are
+ * dropped.
+ *
+ * The socket API is lwIP's on the ESP32 and POSIX on a host, so the same
+ * code runs in bench/dmx_receive.cpp.
+ */
+
+#ifndef DMX_RECEIVER_H
+#define DMX_RECEIVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#ifdef ARDUINO
+#include <lwip/sockets.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#define ARTNET_PORT 6454
+#define SACN_PORT 5568
+#define DMX_PIXELS_PER_UNIVERSE 170
+#define DMX_MAX_UNIVERSES 32     // One bit each in a uint32_t
+#define DMX_HEADER_MAX 126       // Largest header in front of the channel data (E1.31)
+
+#define ARTNET_OP_DMX 0x5000
+#define ARTNET_OP_SYNC 0x5200
+#define ARTNET_DMX_HEADER_SIZE 18
+
+#define E131_ROOT_DATA 0x00000004
+#define E131_ROOT_EXTENDED 0x00000008
+#define E131_FRAMING_DATA 0x00000002
+#define E131_EXTENDED_SYNC 0x00000001
+#define E131_DATA_HEADER_SIZE 126
+#define E131_SYNC_SIZE 49
+#define E131_OPTION_PREVIEW 0x80
+#define E131_OPTION_TERMINATED 0x40
+
+enum DmxProtocol { DMX_ARTNET, DMX_SACN };
+enum DmxPacketType { DMX_PACKET_OTHER, DMX_PACKET_DATA, DMX_PACKET_SYNC };
+
+struct DmxPacket {
+	uint8_t  protocol;
+	uint8_t  type;
+	uint16_t universe;    // Art-Net port address or sACN universe; the sync address of a sync packet
+	uint16_t syncAddress; // sACN data: universe of the sync packets to wait for, 0 = none
+	uint8_t  sequence;    // 0 = not used (Art-Net only)
+	uint16_t dataOffset;  // Channel data position in the datagram
+	uint16_t dataLength;  // Number of channels
+};
+
+inline uint16_t readBE16(const uint8_t *p) {
+	return ((uint16_t)p[0] << 8) | p[1];
+}
+
+inline uint32_t readBE32(const uint8_t *p) {
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// ArtDmx and ArtSync; other opcodes come back as DMX_PACKET_OTHER
+inline bool parseArtNet(const uint8_t *p, size_t len, DmxPacket &packet) {
+	if (len < 12 || memcmp(p, "Art-Net", 8) != 0) return false;
+	packet.protocol = DMX_ARTNET;
+	packet.type = DMX_PACKET_OTHER;
+	packet.syncAddress = 0;
+	uint16_t op = p[8] | (p[9] << 8);
+
+	if (op == ARTNET_OP_SYNC) {
+		packet.type = DMX_PACKET_SYNC;
+		packet.universe = 0;
+	} else if (op == ARTNET_OP_DMX && len >= ARTNET_DMX_HEADER_SIZE) {
+		uint16_t length = readBE16(&p[16]);
+		if (length < 2 || length > 512) return true;
+		packet.type = DMX_PACKET_DATA;
+		packet.sequence = p[12];
+		packet.universe = ((p[15] & 0x7F) << 8) | p[14];
+		packet.dataOffset = ARTNET_DMX_HEADER_SIZE;
+		packet.dataLength = length;
+	}
+	return true;
+}
+
+// E1.31 data packets with start code 0 and E1.31 sync packets
+inline bool parseE131(const uint8_t *p, size_t len, DmxPacket &packet) {
+	if (len < E131_SYNC_SIZE || readBE16(&p[0]) != 0x0010 || memcmp(&p[4], "ASC-E1.17\0\0\0", 12) != 0) return false;
+	packet.protocol = DMX_SACN;
+	packet.type = DMX_PACKET_OTHER;
+	packet.syncAddress = 0;
+	uint32_t root = readBE32(&p[18]);
+	uint32_t framing = readBE32(&p[40]);
+
+	if (root == E131_ROOT_EXTENDED && framing == E131_EXTENDED_SYNC) {
+		packet.type = DMX_PACKET_SYNC;
+		packet.sequence = p[44];
+		packet.universe = readBE16(&p[45]);
+	} else if (root == E131_ROOT_DATA && framing == E131_FRAMING_DATA && len >= E131_DATA_HEADER_SIZE) {
+		uint16_t count = readBE16(&p[123]); // Includes the start code
+		if (p[117] != 0x02 || p[118] != 0xA1 || p[125] != 0 || count < 1 || count > 513 ||
+		    (p[112] & (E131_OPTION_PREVIEW | E131_OPTION_TERMINATED))) return true;
+		packet.type = DMX_PACKET_DATA;
+		packet.syncAddress = readBE16(&p[109]);
+		packet.sequence = p[111];
+		packet.universe = readBE16(&p[113]);
+		packet.dataOffset = E131_DATA_HEADER_SIZE;
+		packet.dataLength = count - 1;
+	}
+	return true;
+}
+
+// 239.255.hi.lo, the multicast group of an sACN universe (network order)
+inline uint32_t sacnMulticastAddress(uint16_t universe) {
+	return htonl(0xEFFF0000 | universe);
+}
+
+class DmxReceiver {
+public:
+	// Statistics, never reset
+	uint32_t packets = 0;
+	uint32_t framesShown = 0;
+	uint32_t framesPartial = 0; // Shown because a universe repeated before all arrived
+	uint32_t syncs = 0;         // Sync packets that showed a frame
+	uint32_t ignored = 0;       // Unmapped universes, other packets and protocols
+	uint32_t outOfOrder = 0;
+
+	/**
+	 * numPixels are mapped from artnetStart (Art-Net port address) and
+	 * sacnStart (sACN universe) on.
+	 */
+	DmxReceiver(uint16_t artnetStart, uint16_t sacnStart, size_t numPixels, uint32_t syncTimeoutMs)
+		: _artnetStart(artnetStart), _sacnStart(sacnStart), _numPixels(numPixels), _syncTimeoutMs(syncTimeoutMs) {
+		_universes = (numPixels + DMX_PIXELS_PER_UNIVERSE - 1) / DMX_PIXELS_PER_UNIVERSE;
+		if (_universes > DMX_MAX_UNIVERSES) _universes = DMX_MAX_UNIVERSES;
+		_all = _universes == 32 ? 0xFFFFFFFF : ((uint32_t)1 << _universes) - 1;
+	}
+
+	/**
+	 * Opens the Art-Net and sACN sockets (0 skips one) and joins the
+	 * multicast groups of the mapped sACN universes and of sacnSync (the
+	 * sync address the sender uses, 0 for none).
+	 */
+	bool begin(uint16_t artnetPort = ARTNET_PORT, uint16_t sacnPort = SACN_PORT, uint16_t sacnSync = 0) {
+		if (artnetPort && (_artnet = openSocket(artnetPort)) < 0) return false;
+		if (sacnPort) {
+			if ((_sacn = openSocket(sacnPort)) < 0) return false;
+			for (size_t i = 0; i <= _universes; i++) {
+				uint16_t universe = i < _universes ? _sacnStart + i : sacnSync;
+				if (universe == 0) continue;
+				ip_mreq group = {};
+				group.imr_multiaddr.s_addr = sacnMulticastAddress(universe);
+				group.imr_interface.s_addr = htonl(INADDR_ANY);
+				setsockopt(_sacn, IPPROTO_IP, IP_ADD_MEMBERSHIP, &group, sizeof(group));
+			}
+		}
+		return true;
+	}
+
+	/**
+	 * Waits at most timeoutMs for datagrams and handles all that are
+	 * waiting. Target provides uint8_t *backBuffer() (RGB888, numPixels)
+	 * and present(), which shows the back buffer and leaves it equal to
+	 * what is on screen. Returns the number of datagrams handled.
+	 */
+	template <class Target>
+	int poll(Target &target, uint32_t nowMs, uint32_t timeoutMs) {
+		fd_set fds;
+		FD_ZERO(&fds);
+		if (_artnet >= 0) FD_SET(_artnet, &fds);
+		if (_sacn >= 0) FD_SET(_sacn, &fds);
+		timeval timeout = {(long)(timeoutMs / 1000), (long)(timeoutMs % 1000) * 1000};
+		int maxFd = _artnet > _sacn ? _artnet : _sacn;
+		if (select(maxFd + 1, &fds, NULL, NULL, &timeout) <= 0) return 0;
+
+		int handled = 0;
+		while (_artnet >= 0 && receive(_artnet, target, nowMs)) handled++;
+		while (_sacn >= 0 && receive(_sacn, target, nowMs)) handled++;
+		return handled;
+	}
+
+	// Handles one waiting datagram; false if there was none
+	template <class Target>
+	bool receive(int sock, Target &target, uint32_t nowMs) {
+		uint8_t head[DMX_HEADER_MAX];
+		int len = recv(sock, head, sizeof(head), MSG_PEEK | MSG_DONTWAIT);
+		if (len <= 0) return false;
+		packets++;
+
+		DmxPacket packet;
+		bool known = parseArtNet(head, len, packet) || parseE131(head, len, packet);
+		if (known && packet.type == DMX_PACKET_SYNC) {
+			discard(sock);
+			if (sync(packet, nowMs) && _received) {
+				syncs++;
+				show(target);
+			}
+			return true;
+		}
+
+		int index = known && packet.type == DMX_PACKET_DATA ? universeIndex(packet) : -1;
+		if (index < 0) {
+			ignored++;
+			discard(sock);
+			return true;
+		}
+		if (!inOrder(index, packet)) {
+			outOfOrder++;
+			discard(sock);
+			return true;
+		}
+
+		uint32_t bit = (uint32_t)1 << index;
+		bool synced = isSynced(packet, nowMs);
+		if (!synced && (_received & bit)) {
+			framesPartial++;
+			show(target);
+		}
+
+		// Header into scratch, channels straight into the back buffer
+		size_t offset = (size_t)index * DMX_PIXELS_PER_UNIVERSE * 3;
+		size_t size = packet.dataLength;
+		if (size > DMX_PIXELS_PER_UNIVERSE * 3) size = DMX_PIXELS_PER_UNIVERSE * 3;
+		if (size > _numPixels * 3 - offset) size = _numPixels * 3 - offset;
+		iovec parts[2];
+		parts[0].iov_base = head;
+		parts[0].iov_len = packet.dataOffset;
+		parts[1].iov_base = target.backBuffer() + offset;
+		parts[1].iov_len = size;
+		msghdr message = {};
+		message.msg_iov = parts;
+		message.msg_iovlen = 2;
+		recvmsg(sock, &message, MSG_DONTWAIT);
+
+		_received |= bit;
+		if (!synced && _received == _all) show(target);
+		return true;
+	}
+
+private:
+	uint16_t _artnetStart;
+	uint16_t _sacnStart;
+	size_t _numPixels;
+	uint32_t _syncTimeoutMs;
+	size_t _universes;
+	uint32_t _all;
+	int _artnet = -1;
+	int _sacn = -1;
+
+	uint32_t _received = 0; // Universes written since the last present()
+	uint8_t _sequence[DMX_MAX_UNIVERSES] = {};
+	uint32_t _haveSequence = 0;
+
+	bool _artSync = false;  // ArtSync seen within the timeout
+	uint32_t _lastArtSync = 0;
+	bool _sacnSync = false;
+	uint32_t _lastSacnSync = 0;
+	uint16_t _sacnSyncAddress = 0; // From the data packets
+
+	static int openSocket(uint16_t port) {
+		int sock = socket(AF_INET, SOCK_DGRAM, 0);
+		if (sock < 0) return -1;
+		int on = 1;
+		setsockopt(sock, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		addr.sin_port = htons(port);
+		if (bind(sock, (sockaddr *)&addr, sizeof(addr)) < 0) {
+			close(sock);
+			return -1;
+		}
+		return sock;
+	}
+
+	// Drops a datagram (the rest of a datagram is discarded by any read)
+	static void discard(int sock) {
+		uint8_t byte;
+		recv(sock, &byte, 1, MSG_DONTWAIT);
+	}
+
+	int universeIndex(const DmxPacket &packet) const {
+		uint16_t start = packet.protocol == DMX_ARTNET ? _artnetStart : _sacnStart;
+		if (packet.universe < start || packet.universe - start >= (int)_universes) return -1;
+		return packet.universe - start;
+	}
+
+	// Drops packets up to 20 sequence numbers behind the last (E1.31 6.7.2)
+	bool inOrder(int index, const DmxPacket &packet) {
+		if (packet.protocol == DMX_ARTNET && packet.sequence == 0) return true;
+		uint32_t bit = (uint32_t)1 << index;
+		int8_t diff = (int8_t)(packet.sequence - _sequence[index]);
+		if ((_haveSequence & bit) && diff <= 0 && diff > -20) return false;
+		_sequence[index] = packet.sequence;
+		_haveSequence |= bit;
+		return true;
+	}
+
+	bool isSynced(const DmxPacket &packet, uint32_t nowMs) {
+		if (packet.protocol == DMX_ARTNET) {
+			if (_artSync && nowMs - _lastArtSync >= _syncTimeoutMs) _artSync = false;
+			return _artSync;
+		}
+		if (packet.syncAddress == 0) return false;
+		_sacnSyncAddress = packet.syncAddress;
+		if (_sacnSync && nowMs - _lastSacnSync >= _syncTimeoutMs) _sacnSync = false;
+		return _sacnSync;
+	}
+
+	// Notes a sync packet; true if it is one the data waits for
+	bool sync(const DmxPacket &packet, uint32_t nowMs) {
+		if (packet.protocol == DMX_ARTNET) {
+			_artSync = true;
+			_lastArtSync = nowMs;
+			return true;
+		}
+		if (_sacnSyncAddress != 0 && packet.universe != _sacnSyncAddress) return false;
+		_sacnSync = true;
+		_lastSacnSync = nowMs;
+		return true;
+	}
+
+	template <class Target>
+	void show(Target &target) {
+		target.present();
+		framesShown++;
+		_received = 0;
+	}
+};
+
+#endif
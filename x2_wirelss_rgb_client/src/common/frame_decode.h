@@ -0,0 +1,235 @@
+/**
+ * Payload decoders for the formats in frame_protocol.h.
+ *
+ * They write into any array of structs with red/green/blue byte members,
+ * so the SmartMatrix rgb24 back buffer can be the destination on the
+ * device and a plain struct on the host.
+ */
+
+#ifndef FRAME_DECODE_H
+#define FRAME_DECODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "frame_protocol.h"
+
+// RRRRRGGG GGGBBBBB → 8 bit per channel
+template <typename RGB>
+inline void storeRgb565(RGB &c, uint16_t rgb16) {
+	c.red   = ((rgb16 >> 11) & 0x1F) << 3;
+	c.green = ((rgb16 >> 5)  & 0x3F) << 2;
+	c.blue  = ( rgb16        & 0x1F) << 3;
+}
+
+// Inverse of storeRgb565()
+template <typename RGB>
+inline uint16_t packRgb565(const RGB &c) {
+	return ((uint16_t)(c.red >> 3) << 11) | ((uint16_t)(c.green >> 2) << 5) | (c.blue >> 3);
+}
+
+// Big-endian RGB565 pixels → 8 bit per channel
+template <typename RGB>
+inline void expandRgb565(RGB *dst, const uint8_t *src, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		storeRgb565(dst[i], ((uint16_t)src[0] << 8) | src[1]);
+		src += 2;
+	}
+}
+
+template <typename RGB>
+inline void expandRgb888(RGB *dst, const uint8_t *src, size_t count) {
+	for (size_t i = 0; i < count; i++) {
+		dst[i].red   = *src++;
+		dst[i].green = *src++;
+		dst[i].blue  = *src++;
+	}
+}
+
+/**
+ * FRAME_FORMAT_RECTS_RGB565 payload:
+ *
+ *   baseId u16 LE   Id of the frame the rectangles patch
+ *   count  u8       Number of rectangles
+ *   count × { x u8, y u8, w u8, h u8, w*h RGB565 pixels (big-endian, row-major) }
+ */
+inline uint16_t rectsBaseId(const uint8_t *payload) {
+	return readLE16(payload);
+}
+
+/**
+ * Patches dst (width × height, row-major) with the rectangles of a
+ * FRAME_FORMAT_RECTS_RGB565 payload. The whole payload is validated
+ * before the first pixel is written, so a malformed frame leaves dst
+ * untouched. Returns false in that case.
+ */
+template <typename RGB>
+bool applyRectsRgb565(RGB *dst, uint16_t width, uint16_t height, const uint8_t *payload, size_t len) {
+	if (len < FRAME_RECTS_HEADER_SIZE) return false;
+	uint8_t count = payload[2];
+
+	size_t pos = FRAME_RECTS_HEADER_SIZE;
+	for (uint8_t r = 0; r < count; r++) {
+		if (pos + 4 > len) return false;
+		const uint8_t *rect = &payload[pos];
+		if (rect[0] + rect[2] > width || rect[1] + rect[3] > height) return false;
+		pos += 4 + (size_t)rect[2] * rect[3] * 2;
+	}
+	if (pos != len) return false;
+
+	pos = FRAME_RECTS_HEADER_SIZE;
+	for (uint8_t r = 0; r < count; r++) {
+		uint8_t x = payload[pos], y = payload[pos + 1];
+		uint8_t w = payload[pos + 2], h = payload[pos + 3];
+		pos += 4;
+		for (uint8_t row = 0; row < h; row++) {
+			expandRgb565(&dst[(size_t)(y + row) * width + x], &payload[pos], w);
+			pos += w * 2;
+		}
+	}
+	return true;
+}
+
+/**
+ * FRAME_FORMAT_WINDOW_RGB565 / FRAME_FORMAT_WINDOW_RGB888 payload:
+ *
+ *   x u16 LE, y u16 LE, w u16 LE, h u16 LE
+ *   w*h pixels, row-major, RGB565 (big-endian) or RGB888
+ *
+ * Unlike the rectangle deltas a window does not depend on an earlier
+ * frame: it replaces its area and leaves the rest of the image as it is.
+ * On chained panels a sender can update one panel, or split a frame that
+ * takes too long on the wire into several windows.
+ *
+ * Writes the window into dst (width × height, row-major). Returns false
+ * and leaves dst untouched if it does not fit or the length is wrong.
+ */
+template <typename RGB>
+bool applyWindow(RGB *dst, uint16_t width, uint16_t height, const uint8_t *payload, size_t len, uint8_t bytesPerPixel) {
+	if (len < FRAME_WINDOW_HEADER_SIZE) return false;
+	uint32_t x = readLE16(&payload[0]), y = readLE16(&payload[2]);
+	uint32_t w = readLE16(&payload[4]), h = readLE16(&payload[6]);
+	if (x + w > width || y + h > height) return false;
+	if (len != FRAME_WINDOW_HEADER_SIZE + (size_t)w * h * bytesPerPixel) return false;
+
+	const uint8_t *src = &payload[FRAME_WINDOW_HEADER_SIZE];
+	for (uint32_t row = 0; row < h; row++) {
+		RGB *out = &dst[(size_t)(y + row) * width + x];
+		if (bytesPerPixel == 2) expandRgb565(out, src, w);
+		else expandRgb888(out, src, w);
+		src += (size_t)w * bytesPerPixel;
+	}
+	return true;
+}
+
+/**
+ * FRAME_FORMAT_XOR_RLE_RGB565 payload:
+ *
+ *   baseId u16 LE   Id of the frame the delta applies to
+ *   flags  u8       FRAME_XOR_RLE_DELTA: values are XORed with frame baseId,
+ *                   otherwise they are plain pixels (a keyframe)
+ *   tokens covering exactly width × height pixels, row-major:
+ *     c < 0x80      c + 1 literal values follow (RGB565, big-endian)
+ *     c >= 0x80     (c & 0x7F) + 1 repeats of the single value that follows
+ *
+ * In a delta an unchanged pixel XORs to zero, so still areas collapse
+ * into runs of zeros, which the decoder skips without touching dst.
+ */
+inline uint16_t xorRleBaseId(const uint8_t *payload) {
+	return readLE16(payload);
+}
+
+inline bool xorRleIsDelta(const uint8_t *payload) {
+	return payload[2] & FRAME_XOR_RLE_DELTA;
+}
+
+/**
+ * Decodes a FRAME_FORMAT_XOR_RLE_RGB565 payload into dst (count pixels).
+ * For a delta, dst must hold the base frame as written by expandRgb565().
+ * The token stream is validated first; returns false and leaves dst
+ * untouched if it is malformed or does not cover exactly count pixels.
+ */
+template <typename RGB>
+bool applyXorRleRgb565(RGB *dst, size_t count, const uint8_t *payload, size_t len) {
+	if (len < FRAME_XOR_RLE_HEADER_SIZE) return false;
+
+	size_t pos = FRAME_XOR_RLE_HEADER_SIZE;
+	size_t pixels = 0;
+	while (pos < len) {
+		uint8_t c = payload[pos++];
+		size_t n = (c & 0x7F) + 1;
+		pos += c & 0x80 ? 2 : n * 2;
+		pixels += n;
+	}
+	if (pos != len || pixels != count) return false;
+
+	bool delta = xorRleIsDelta(payload);
+	pos = FRAME_XOR_RLE_HEADER_SIZE;
+	RGB *out = dst;
+	while (pos < len) {
+		uint8_t c = payload[pos++];
+		size_t n = (c & 0x7F) + 1;
+		if (c & 0x80) {
+			uint16_t v = ((uint16_t)payload[pos] << 8) | payload[pos + 1];
+			pos += 2;
+			if (!delta) {
+				for (size_t i = 0; i < n; i++) storeRgb565(out[i], v);
+			} else if (v != 0) {
+				for (size_t i = 0; i < n; i++) storeRgb565(out[i], packRgb565(out[i]) ^ v);
+			}
+		} else if (!delta) {
+			expandRgb565(out, &payload[pos], n);
+			pos += n * 2;
+		} else {
+			for (size_t i = 0; i < n; i++, pos += 2) {
+				uint16_t v = ((uint16_t)payload[pos] << 8) | payload[pos + 1];
+				storeRgb565(out[i], packRgb565(out[i]) ^ v);
+			}
+		}
+		out += n;
+	}
+	return true;
+}
+
+/**
+ * FRAME_FORMAT_PALETTE payload: n × { R, G, B } with 1 <= n <= 256, loaded
+ * into entries 0..n-1. The palette stays in effect for every following
+ * FRAME_FORMAT_INDEXEDx frame until the next one arrives.
+ * Returns the number of entries loaded, 0 if the payload is malformed.
+ */
+template <typename RGB>
+size_t loadPalette(RGB *palette, const uint8_t *payload, size_t len) {
+	if (len == 0 || len % 3 != 0 || len > 256 * 3) return 0;
+	expandRgb888(palette, payload, len / 3);
+	return len / 3;
+}
+
+// Indices packed MSB first, so the leftmost pixel is in the top bits
+template <uint8_t BPP, typename RGB>
+inline void expandIndexedBits(RGB *dst, size_t count, const uint8_t *src, const RGB *palette) {
+	const uint8_t mask = (1 << BPP) - 1;
+	for (size_t i = 0; i < count; src++) {
+		uint8_t bits = *src;
+		for (int shift = 8 - BPP; shift >= 0 && i < count; shift -= BPP) {
+			dst[i++] = palette[(bits >> shift) & mask];
+		}
+	}
+}
+
+/**
+ * Expands count palette indices of bpp (1, 2, 4 or 8) bits through the
+ * palette into dst. src must hold (count * bpp + 7) / 8 bytes.
+ */
+template <typename RGB>
+void expandIndexed(RGB *dst, size_t count, const uint8_t *src, uint8_t bpp, const RGB *palette) {
+	switch (bpp) {
+		case 1: expandIndexedBits<1>(dst, count, src, palette); break;
+		case 2: expandIndexedBits<2>(dst, count, src, palette); break;
+		case 4: expandIndexedBits<4>(dst, count, src, palette); break;
+		case 8:
+			for (size_t i = 0; i < count; i++) dst[i] = palette[src[i]];
+			break;
+	}
+}
+
+#endif
@@ -0,0 +1,158 @@
+/**
+ * Building blocks for a two-stage receive → decode/present pipeline.
+ *
+ * The receive task (core 0, next to the Wi-Fi / UART drivers) fills
+ * buffers taken from a FramePool and publishes them; the render task
+ * (core 1) decodes the published frames into the SmartMatrix back buffer,
+ * swaps once for the newest and hands the buffers back. Buffers travel through
+ * single-producer/single-consumer queues, so no locks are taken on the
+ * hot path.
+ *
+ * StageTimer collects per-stage timings so the slowest stage can be read
+ * off directly.
+ */
+
+#ifndef FRAME_PIPELINE_H
+#define FRAME_PIPELINE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+
+#include "frame_protocol.h"
+
+/**
+ * Lock-free ring buffer for exactly one producer and one consumer.
+ * N must be a power of two; the queue holds at most N - 1 items.
+ */
+template <typename T, size_t N>
+class SpscQueue {
+	static_assert((N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+	bool push(const T &item) {
+		size_t head = _head.load(std::memory_order_relaxed);
+		size_t next = (head + 1) & (N - 1);
+		if (next == _tail.load(std::memory_order_acquire)) return false; // Full
+		_items[head] = item;
+		_head.store(next, std::memory_order_release);
+		return true;
+	}
+
+	bool pop(T &item) {
+		size_t tail = _tail.load(std::memory_order_relaxed);
+		if (tail == _head.load(std::memory_order_acquire)) return false; // Empty
+		item = _items[tail];
+		_tail.store((tail + 1) & (N - 1), std::memory_order_release);
+		return true;
+	}
+
+	bool empty() const {
+		return _tail.load(std::memory_order_acquire) == _head.load(std::memory_order_acquire);
+	}
+
+private:
+	T _items[N];
+	std::atomic<size_t> _head{0};
+	std::atomic<size_t> _tail{0};
+};
+
+struct PipelineFrame {
+	FrameHeader header;
+	uint32_t    receivedAt; // micros() when the last byte arrived
+	uint32_t    receiveUs;  // First to last byte
+	uint32_t    presentAt = 0;    // Sender's presentation time in µs, its own clock
+	bool        timed = false;    // presentAt is valid
+	uint8_t    *data;
+};
+
+/**
+ * SLOTS (a power of two) frame buffers of MAX_PAYLOAD bytes. All slots
+ * start on the free queue; the receiver acquire()s one, fills it and
+ * publish()es it, the renderer takes it with pop() and returns it with
+ * recycle().
+ */
+template <size_t MAX_PAYLOAD, size_t SLOTS>
+class FramePool {
+public:
+	// Statistics
+	std::atomic<uint32_t> dropped{0};  // Frames discarded because no slot was free
+
+	FramePool() {
+		for (size_t i = 0; i < SLOTS; i++) {
+			_slots[i].data = _storage[i];
+			_free.push(&_slots[i]);
+		}
+	}
+
+	// Receiver side: a free slot, or NULL if the renderer holds them all
+	PipelineFrame *acquire() {
+		PipelineFrame *frame = NULL;
+		if (!_free.pop(frame)) dropped++;
+		return frame;
+	}
+
+	// Receiver side: returns a slot that will not be published after all
+	void cancel(PipelineFrame *frame) { _free.push(frame); }
+
+	// Receiver side: makes a complete frame visible to the renderer
+	void publish(PipelineFrame *frame) { _ready.push(frame); }
+
+	// Receiver side: takes back the slots the renderer is done with and
+	// returns how many there were
+	size_t reclaim() {
+		PipelineFrame *frame;
+		size_t count = 0;
+		while (_recycled.pop(frame)) {
+			_free.push(frame);
+			count++;
+		}
+		return count;
+	}
+
+	// Renderer side: the oldest published frame, or NULL. Frames come out
+	// in arrival order so delta frames can be applied in sequence.
+	PipelineFrame *pop() {
+		PipelineFrame *frame = NULL;
+		_ready.pop(frame);
+		return frame;
+	}
+
+	// Renderer side: hands a slot back to the receiver
+	void recycle(PipelineFrame *frame) { _recycled.push(frame); }
+
+private:
+	uint8_t _storage[SLOTS][MAX_PAYLOAD] __attribute__((aligned(4)));
+	PipelineFrame _slots[SLOTS];
+
+	// Sizes exceed SLOTS so a push can never fail
+	SpscQueue<PipelineFrame *, SLOTS * 2> _free;     // Receiver only
+	SpscQueue<PipelineFrame *, SLOTS * 2> _ready;    // Receiver → renderer
+	SpscQueue<PipelineFrame *, SLOTS * 2> _recycled; // Renderer → receiver
+};
+
+/**
+ * Running average and maximum of a stage duration in microseconds.
+ * Written by one task, read (approximately) by any.
+ */
+struct StageTimer {
+	uint32_t count = 0;
+	uint32_t totalUs = 0;
+	uint32_t maxUs = 0;
+
+	void add(uint32_t us) {
+		count++;
+		totalUs += us;
+		if (us > maxUs) maxUs = us;
+	}
+
+	uint32_t averageUs() const { return count ? totalUs / count : 0; }
+
+	void reset() {
+		count = 0;
+		totalUs = 0;
+		maxUs = 0;
+	}
+};
+
+#endif
@@ -0,0 +1,147 @@
+/**
+ * Paced presentation of frames that arrive in bursts.
+ *
+ * The sender stamps every frame with the moment it wants it shown, in
+ * microseconds of its own clock (CHUNK_FLAG_TIMESTAMP, chunk_reassembly.h).
+ * ClockOffsetEstimator maps that clock onto micros(): the smallest
+ * "arrival minus timestamp" seen recently belongs to the frame that got
+ * through fastest, so it is the best estimate of the offset between the
+ * two clocks plus the minimum network delay.
+ *
+ * JitterBuffer holds complete frames until their presentation time,
+ * which is the mapped timestamp plus a fixed delay. The delay is the depth
+ * of the buffer: frames that are late by less than it are still shown on
+ * time, at the cost of that much extra latency.
+ *
+ * Frames without a timestamp are due the moment they arrive, so senders
+ * that do not stamp their frames behave as before.
+ */
+
+#ifndef JITTER_BUFFER_H
+#define JITTER_BUFFER_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "frame_pipeline.h"
+
+/**
+ * Windowed minimum of (local - sender) clock differences. The minimum of
+ * the current and the previous window is used, so the estimate follows
+ * clock drift within two windows. A difference more than resetUs above
+ * the estimate (sender restarted, clock jumped back) restarts it.
+ */
+class ClockOffsetEstimator {
+public:
+	uint32_t resets = 0; // Statistics
+
+	ClockOffsetEstimator(uint32_t windowUs, uint32_t resetUs) : _windowUs(windowUs), _resetUs(resetUs) {}
+
+	// Adds a frame stamped senderUs that arrived at localUs
+	void add(uint32_t senderUs, uint32_t localUs) {
+		uint32_t diff = localUs - senderUs;
+		if (!_valid || (int32_t)(diff - _offset) > (int32_t)_resetUs) {
+			if (_valid) resets++;
+			_valid = true;
+			_offset = _windowMin = _previousMin = diff;
+			_windowStart = localUs;
+			return;
+		}
+
+		if ((int32_t)(diff - _windowMin) < 0) _windowMin = diff;
+		if (localUs - _windowStart >= _windowUs) {
+			_previousMin = _windowMin;
+			_windowMin = diff;
+			_windowStart = localUs;
+		}
+		_offset = (int32_t)(_windowMin - _previousMin) < 0 ? _windowMin : _previousMin;
+	}
+
+	bool valid() const { return _valid; }
+
+	// local - sender, in µs (wraps like micros())
+	uint32_t offset() const { return _offset; }
+
+	uint32_t toLocal(uint32_t senderUs) const { return senderUs + _offset; }
+
+private:
+	uint32_t _windowUs;
+	uint32_t _resetUs;
+	bool _valid = false;
+	uint32_t _offset = 0;
+	uint32_t _windowMin = 0;
+	uint32_t _previousMin = 0;
+	uint32_t _windowStart = 0;
+};
+
+/**
+ * Up to N frames (taken from a FramePool) waiting for their presentation
+ * time, in arrival order. Used by the render task only.
+ */
+template <size_t N>
+class JitterBuffer {
+public:
+	ClockOffsetEstimator clock;
+
+	// Statistics
+	uint32_t framesLate = 0;  // Due more than a delay ago when they were shown
+	uint32_t framesEarly = 0; // Shown before they were due because the buffer was full
+
+	JitterBuffer(uint32_t delayUs, uint32_t clockWindowUs, uint32_t clockResetUs)
+		: clock(clockWindowUs, clockResetUs), _delayUs(delayUs) {}
+
+	// Takes a complete frame; false if full (shouldDrain() prevents that)
+	bool push(PipelineFrame *frame) {
+		if (_count == N) return false;
+		if (frame->timed) clock.add(frame->presentAt, frame->receivedAt);
+		_frames[(_first + _count) % N] = frame;
+		_count++;
+		return true;
+	}
+
+	// The oldest frame, or NULL
+	PipelineFrame *head() const { return _count ? _frames[_first] : NULL; }
+
+	PipelineFrame *pop() {
+		if (_count == 0) return NULL;
+		PipelineFrame *frame = _frames[_first];
+		_first = (_first + 1) % N;
+		_count--;
+		return frame;
+	}
+
+	size_t size() const { return _count; }
+
+	// True when frames have to go out now to keep buffers flowing back to
+	// the receiver, whether they are due or not
+	bool shouldDrain(size_t limit) const { return _count >= limit; }
+
+	// micros() at which the frame should be shown
+	uint32_t dueAt(const PipelineFrame *frame) const {
+		if (!frame->timed || !clock.valid()) return frame->receivedAt;
+		return clock.toLocal(frame->presentAt) + _delayUs;
+	}
+
+	// µs until the head frame is due (0 if due or overdue), or -1 if empty
+	int32_t untilDue(uint32_t now) const {
+		if (_count == 0) return -1;
+		int32_t wait = (int32_t)(dueAt(_frames[_first]) - now);
+		return wait > 0 ? wait : 0;
+	}
+
+	// Records how a frame's presentation compared to its due time
+	void presented(const PipelineFrame *frame, uint32_t now, bool drained) {
+		if (!frame->timed) return;
+		int32_t error = (int32_t)(now - dueAt(frame));
+		if (drained && error < 0) framesEarly++;
+		else if (error > (int32_t)_delayUs) framesLate++;
+	}
+
+private:
+	uint32_t _delayUs;
+	PipelineFrame *_frames[N];
+	size_t _first = 0;
+	size_t _count = 0;
+};
+
+#endif
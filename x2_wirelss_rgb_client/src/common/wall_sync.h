@@ -0,0 +1,169 @@
+/**
+ * Synchronised presentation for a video wall of several clients.
+ *
+ * The sender renders the whole wall and sends every tile's part of it as
+ * an ordinary chunked frame (chunk_reassembly.h) tagged with the tile's
+ * offset (CHUNK_FLAG_TILE), all tiles of one wall frame with the same
+ * frame id, to one multicast group. Each client keeps the chunks of the
+ * tile offset it is configured for and drops the rest before copying
+ * anything.
+ *
+ * Complete frames are not shown right away: a client holds them until a
+ * commit beacon for their frame id arrives. The beacon is a datagram of
+ * its own on the same group:
+ *
+ *   Offset  Size  Field
+ *   0       1     Magic 'G' (0x47)
+ *   1       1     Flags, 0
+ *   2       2     Frame id, little-endian
+ *   4       4     Presentation time, little-endian (sender µs)
+ *
+ * The sender commits a frame once all tiles had time to receive it (it may
+ * repeat the beacon against loss). A committed frame becomes a timed frame
+ * whose arrival time is the beacon's, and goes through the jitter buffer
+ * as usual: the clients feed the clock estimator with beacon arrivals
+ * only, which every client hears in the same multicast transmission, so
+ * their estimates (and the swap times derived from them) agree to within
+ * the spread of their receive latencies rather than that of the much
+ * larger frame datagrams.
+ *
+ * A client that missed a tile cannot show that frame; the beacon is then
+ * counted as missed and its tile keeps the previous image.
+ *
+ * Beacons repeat, so one for a frame id no newer than the last committed
+ * is ignored. A restarted sender counts from 0 again: as in the
+ * reassembler, a beacon more than CHUNK_RESTART_FRAMES behind the last
+ * commit, or any beacon after CHUNK_RESTART_US without one, starts over.
+ */
+
+#ifndef WALL_SYNC_H
+#define WALL_SYNC_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "frame_protocol.h"
+#include "frame_pipeline.h"
+#include "chunk_reassembly.h"
+
+#define WALL_BEACON_MAGIC 0x47 // 'G'
+#define WALL_BEACON_SIZE 8
+
+struct WallBeacon {
+	uint16_t frameId;
+	uint32_t presentAt; // Sender µs
+};
+
+inline bool parseWallBeacon(const uint8_t *p, size_t size, WallBeacon &beacon) {
+	if (size < WALL_BEACON_SIZE || p[0] != WALL_BEACON_MAGIC) return false;
+	beacon.frameId = readLE16(&p[2]);
+	beacon.presentAt = readLE32(&p[4]);
+	return true;
+}
+
+inline void writeWallBeacon(uint8_t *p, const WallBeacon &beacon) {
+	p[0] = WALL_BEACON_MAGIC;
+	p[1] = 0;
+	writeLE16(&p[2], beacon.frameId);
+	writeLE32(&p[4], beacon.presentAt);
+}
+
+// True if a chunk belongs to the tile at (x, y)
+inline bool chunkIsTile(const ChunkHeader &chunk, uint16_t x, uint16_t y) {
+	return (chunk.flags & CHUNK_FLAG_TILE) && chunk.tileX == x && chunk.tileY == y;
+}
+
+/**
+ * Up to N complete frames waiting for their commit beacon. Used by the
+ * receiver only, frames come from and go back to its FramePool.
+ */
+template <size_t MAX_FRAME, size_t SLOTS, size_t N>
+class WallCommitter {
+public:
+	// Statistics, never reset
+	uint32_t framesCommitted = 0;
+	uint32_t framesMissed = 0;      // Committed, but not (completely) received here
+	uint32_t framesUncommitted = 0; // Received, but a later frame was committed first
+	uint32_t senderRestarts = 0;    // Frame id sequences started over
+
+	explicit WallCommitter(FramePool<MAX_FRAME, SLOTS> &pool) : _pool(pool) {}
+
+	// Takes a complete frame from the reassembler
+	void hold(PipelineFrame *frame) {
+		if (_count == N) {
+			_pool.cancel(_frames[0]);
+			framesUncommitted++;
+			remove(0);
+		}
+		_frames[_count++] = frame;
+	}
+
+	/**
+	 * Handles a beacon that arrived at localUs. Returns the committed frame,
+	 * ready to publish as a timed frame, or NULL.
+	 */
+	PipelineFrame *commit(const WallBeacon &beacon, uint32_t localUs) {
+		if (_haveCommitted && (localUs - _lastBeaconAt > CHUNK_RESTART_US ||
+		                       frameIdDiff(beacon.frameId, _lastCommitted) < -CHUNK_RESTART_FRAMES)) {
+			senderRestarts++;
+			_haveCommitted = false;
+			// Frames of the old sequence look newer than anything to come
+			for (size_t i = 0; i < _count;) {
+				if (frameIdDiff(_frames[i]->header.id, beacon.frameId) > CHUNK_RESTART_FRAMES) {
+					_pool.cancel(_frames[i]);
+					framesUncommitted++;
+					remove(i);
+				} else {
+					i++;
+				}
+			}
+		}
+		_lastBeaconAt = localUs;
+		if (_haveCommitted && frameIdDiff(beacon.frameId, _lastCommitted) <= 0) return NULL; // Repeat
+		_lastCommitted = beacon.frameId;
+		_haveCommitted = true;
+
+		PipelineFrame *committed = NULL;
+		for (size_t i = 0; i < _count;) {
+			int16_t age = frameIdDiff(_frames[i]->header.id, beacon.frameId);
+			if (age > 0) {
+				i++; // Newer, waits for its own beacon
+				continue;
+			}
+			if (age == 0) {
+				committed = _frames[i];
+			} else {
+				_pool.cancel(_frames[i]);
+				framesUncommitted++;
+			}
+			remove(i);
+		}
+
+		if (committed == NULL) {
+			framesMissed++;
+			return NULL;
+		}
+		framesCommitted++;
+		committed->presentAt = beacon.presentAt;
+		committed->timed = true;
+		committed->receivedAt = localUs;
+		return committed;
+	}
+
+	size_t size() const { return _count; }
+
+private:
+	FramePool<MAX_FRAME, SLOTS> &_pool;
+	PipelineFrame *_frames[N];
+	size_t _count = 0;
+	uint16_t _lastCommitted = 0;
+	bool _haveCommitted = false;
+	uint32_t _lastBeaconAt = 0;
+
+	void remove(size_t i) {
+		for (; i + 1 < _count; i++) _frames[i] = _frames[i + 1];
+		_count--;
+	}
+};
+
+#endif
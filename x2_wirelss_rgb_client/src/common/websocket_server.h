@@ -0,0 +1,459 @@
+/**
+ * Minimal WebSocket server (RFC 6455) for binary frame messages.
+ *
+ * One client at a time; a new connection replaces the old one (a browser
+ * tab that reloads). Every binary message is expected to be one frame in
+ * the format of frame_protocol.h. Its payload is unmasked straight into
+ * the buffer the caller passes to poll(), so there are no intermediate
+ * copies, no String objects and no heap allocations; fragmented messages
+ * are joined in place.
+ *
+ * Flow control: the server grants the client credit for a number of
+ * messages, one binary message of two bytes 'K' n per grant. The client
+ * sends a message only while it holds credit and the caller hands credit
+ * back with grant() as it finishes frames, so at most `window` frames are
+ * ever queued on the device and the browser drops frames at the source
+ * instead of building up latency (see websocket.js of the web apps).
+ *
+ * Text messages are ignored, pings answered, close frames echoed.
+ * Uses the lwIP socket API on the ESP32 and POSIX on a host.
+ */
+
+#ifndef WEBSOCKET_SERVER_H
+#define WEBSOCKET_SERVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <ctype.h>
+#include <errno.h>
+
+#ifdef ARDUINO
+#include <lwip/sockets.h>
+#else
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/select.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+#define WS_HANDSHAKE_MAX 1024 // Longest HTTP upgrade request accepted
+#define WS_CONTROL_MAX 125
+#define WS_CREDIT 0x4B // 'K'
+
+#define WS_OP_CONTINUATION 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+
+// SHA-1 of a short message, for the handshake only
+inline void sha1(const uint8_t *data, size_t len, uint8_t digest[20]) {
+	uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+	uint8_t block[64];
+	uint64_t bits = (uint64_t)len * 8;
+	size_t blocks = (len + 8) / 64 + 1;
+
+	for (size_t b = 0; b < blocks; b++) {
+		for (size_t i = 0; i < 64; i++) {
+			size_t pos = b * 64 + i;
+			if (pos < len) block[i] = data[pos];
+			else if (pos == len) block[i] = 0x80;
+			else if (b == blocks - 1 && i >= 56) block[i] = (uint8_t)(bits >> ((63 - i) * 8));
+			else block[i] = 0;
+		}
+
+		uint32_t w[80];
+		for (int i = 0; i < 16; i++) {
+			w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+			       ((uint32_t)block[i * 4 + 2] << 8) | block[i * 4 + 3];
+		}
+		for (int i = 16; i < 80; i++) {
+			uint32_t x = w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16];
+			w[i] = (x << 1) | (x >> 31);
+		}
+
+		uint32_t a = h[0], bb = h[1], c = h[2], d = h[3], e = h[4];
+		for (int i = 0; i < 80; i++) {
+			uint32_t f, k;
+			if (i < 20)      { f = (bb & c) | (~bb & d);           k = 0x5A827999; }
+			else if (i < 40) { f = bb ^ c ^ d;                     k = 0x6ED9EBA1; }
+			else if (i < 60) { f = (bb & c) | (bb & d) | (c & d);  k = 0x8F1BBCDC; }
+			else             { f = bb ^ c ^ d;                     k = 0xCA62C1D6; }
+			uint32_t t = ((a << 5) | (a >> 27)) + f + e + k + w[i];
+			e = d;
+			d = c;
+			c = (bb << 30) | (bb >> 2);
+			bb = a;
+			a = t;
+		}
+		h[0] += a; h[1] += bb; h[2] += c; h[3] += d; h[4] += e;
+	}
+
+	for (int i = 0; i < 20; i++) digest[i] = (uint8_t)(h[i / 4] >> (24 - (i % 4) * 8));
+}
+
+// Base64 of len bytes into out (4 * ceil(len / 3) characters plus a terminator)
+inline void base64(const uint8_t *data, size_t len, char *out) {
+	static const char digits[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+	size_t o = 0;
+	for (size_t i = 0; i < len; i += 3) {
+		uint32_t v = (uint32_t)data[i] << 16;
+		if (i + 1 < len) v |= (uint32_t)data[i + 1] << 8;
+		if (i + 2 < len) v |= data[i + 2];
+		out[o++] = digits[(v >> 18) & 63];
+		out[o++] = digits[(v >> 12) & 63];
+		out[o++] = i + 1 < len ? digits[(v >> 6) & 63] : '=';
+		out[o++] = i + 2 < len ? digits[v & 63] : '=';
+	}
+	out[o] = 0;
+}
+
+class WebSocketServer {
+public:
+	// Statistics, never reset
+	uint32_t connections = 0;
+	uint32_t messages = 0;
+	uint32_t messagesTooLarge = 0; // Dropped, larger than the buffer
+	uint32_t protocolErrors = 0;   // Connections closed for malformed frames
+
+	/**
+	 * Listens on port. window is the number of messages the client may
+	 * have outstanding.
+	 */
+	bool begin(uint16_t port, uint8_t window) {
+		_window = window;
+		_listen = socket(AF_INET, SOCK_STREAM, 0);
+		if (_listen < 0) return false;
+		int on = 1;
+		setsockopt(_listen, SOL_SOCKET, SO_REUSEADDR, &on, sizeof(on));
+		sockaddr_in addr = {};
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_ANY);
+		addr.sin_port = htons(port);
+		if (bind(_listen, (sockaddr *)&addr, sizeof(addr)) < 0 || listen(_listen, 1) < 0) {
+			close(_listen);
+			_listen = -1;
+			return false;
+		}
+		return true;
+	}
+
+	bool connected() const { return _client >= 0 && _state != HANDSHAKE; }
+
+	/**
+	 * Waits at most timeoutMs for the network and handles what arrived:
+	 * connections, the handshake, control frames and message data, which
+	 * is unmasked into dst (capacity bytes). Returns the length of a
+	 * complete binary message in dst, else 0. The caller must pass the
+	 * same dst until a message is returned; with dst NULL message data
+	 * stays in the socket and TCP holds the sender back.
+	 */
+	size_t poll(uint8_t *dst, size_t capacity, uint32_t nowUs, uint32_t timeoutMs) {
+		fd_set fds;
+		FD_ZERO(&fds);
+		FD_SET(_listen, &fds);
+		if (_client >= 0) FD_SET(_client, &fds);
+		timeval timeout = {(long)(timeoutMs / 1000), (long)(timeoutMs % 1000) * 1000};
+		int maxFd = _listen > _client ? _listen : _client;
+		if (select(maxFd + 1, &fds, NULL, NULL, &timeout) <= 0) return 0;
+
+		if (FD_ISSET(_listen, &fds)) accept();
+		if (_client < 0) return 0;
+		return read(dst, capacity, nowUs);
+	}
+
+	// micros() when the first byte of the message last returned by poll() arrived
+	uint32_t messageStartedAt() const { return _messageStartedAt; }
+
+	// Returns credit for up to `frames` messages the caller is done with
+	void grant(uint32_t frames) {
+		if (frames > _outstanding) frames = _outstanding;
+		_outstanding -= frames;
+		while (frames > 0) {
+			uint8_t n = frames > 255 ? 255 : frames;
+			sendCredit(n);
+			frames -= n;
+		}
+	}
+
+private:
+	enum State { HANDSHAKE, HEADER, PAYLOAD, CONTROL, DISCARD };
+
+	int _listen = -1;
+	int _client = -1;
+	uint8_t _window = 1;
+	uint32_t _outstanding = 0; // Messages received and not yet granted back
+	State _state = HANDSHAKE;
+
+	char _request[WS_HANDSHAKE_MAX + 1];
+	size_t _requestLength = 0;
+
+	uint8_t _header[14];
+	size_t _headerLength = 0;
+	uint8_t _opcode = 0;
+	bool _fin = false;
+	uint64_t _remaining = 0; // Payload bytes of the current frame still to read
+	uint8_t _mask[4];
+	uint8_t _maskPos = 0;
+
+	bool _inMessage = false;   // A binary message has started
+	bool _dropMessage = false; // ... but does not fit
+	size_t _messageLength = 0;
+	uint32_t _messageStartedAt = 0;
+
+	uint8_t _control[WS_CONTROL_MAX];
+	size_t _controlLength = 0;
+
+	void accept() {
+		int client = ::accept(_listen, NULL, NULL);
+		if (client < 0) return;
+		if (_client >= 0) close(_client); // The newest client wins
+		_client = client;
+		int on = 1;
+		setsockopt(_client, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on));
+		_state = HANDSHAKE;
+		_requestLength = 0;
+		_headerLength = 0;
+		_inMessage = false;
+		_outstanding = 0;
+	}
+
+	void disconnect() {
+		close(_client);
+		_client = -1;
+	}
+
+	size_t read(uint8_t *dst, size_t capacity, uint32_t nowUs) {
+		for (;;) {
+			if (_state == HANDSHAKE) {
+				int n = recv(_client, _request + _requestLength, WS_HANDSHAKE_MAX - _requestLength, MSG_DONTWAIT);
+				if (n <= 0) return closedOrIdle(n);
+				_requestLength += n;
+				_request[_requestLength] = 0;
+				if (strstr(_request, "\r\n\r\n") == NULL) {
+					if (_requestLength == WS_HANDSHAKE_MAX) disconnect();
+					return 0;
+				}
+				if (!handshake()) {
+					disconnect();
+					return 0;
+				}
+				continue;
+			}
+
+			if (_state == HEADER) {
+				size_t need = headerSize();
+				int n = recv(_client, _header + _headerLength, need - _headerLength, MSG_DONTWAIT);
+				if (n <= 0) return closedOrIdle(n);
+				if (_headerLength == 0 && !_inMessage) _messageStartedAt = nowUs;
+				_headerLength += n;
+				if (_headerLength < 2 || _headerLength < headerSize()) continue;
+				if (!startFrame(capacity)) {
+					protocolErrors++;
+					disconnect();
+					return 0;
+				}
+				if (_state == PAYLOAD && _remaining == 0) {
+					_state = HEADER;
+					if (_fin) return finishMessage();
+				} else if (_state == DISCARD && _remaining == 0) {
+					endDiscard();
+				}
+				continue;
+			}
+
+			if (_state == PAYLOAD) {
+				if (dst == NULL) return 0; // Leave it in the socket until there is room
+				int n = recv(_client, dst + _messageLength, (size_t)_remaining, MSG_DONTWAIT);
+				if (n <= 0) return closedOrIdle(n);
+				unmask(dst + _messageLength, n);
+				_messageLength += n;
+				_remaining -= n;
+				if (_remaining > 0) continue;
+				_state = HEADER;
+				if (_fin) return finishMessage();
+				continue;
+			}
+
+			if (_state == CONTROL) {
+				int n = 0;
+				if (_remaining > 0) {
+					n = recv(_client, _control + _controlLength, (size_t)_remaining, MSG_DONTWAIT);
+					if (n <= 0) return closedOrIdle(n);
+					unmask(_control + _controlLength, n);
+					_controlLength += n;
+					_remaining -= n;
+				}
+				if (_remaining > 0) continue;
+				_state = HEADER;
+				if (_opcode == WS_OP_PING) {
+					sendFrame(WS_OP_PONG, _control, _controlLength);
+				} else if (_opcode == WS_OP_CLOSE) {
+					sendFrame(WS_OP_CLOSE, _control, _controlLength < 2 ? _controlLength : 2);
+					disconnect();
+					return 0;
+				}
+				continue;
+			}
+
+			// DISCARD: text messages and binary messages that do not fit
+			uint8_t scratch[128];
+			int n = recv(_client, scratch, _remaining < sizeof(scratch) ? (size_t)_remaining : sizeof(scratch), MSG_DONTWAIT);
+			if (n <= 0) return closedOrIdle(n);
+			_remaining -= n;
+			if (_remaining == 0) endDiscard();
+		}
+	}
+
+	void endDiscard() {
+		_state = HEADER;
+		if (_fin && _inMessage) {
+			// An oversized binary message: its credit comes back at once
+			_inMessage = false;
+			messagesTooLarge++;
+			sendCredit(1);
+		}
+	}
+
+	size_t closedOrIdle(int n) {
+		if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) disconnect();
+		return 0;
+	}
+
+	// Header bytes needed, as far as they can be told from what is in
+	size_t headerSize() const {
+		if (_headerLength < 2) return 2;
+		size_t size = 2 + 4; // Client frames are always masked
+		uint8_t len = _header[1] & 0x7F;
+		if (len == 126) size += 2;
+		else if (len == 127) size += 8;
+		return size;
+	}
+
+	bool startFrame(size_t capacity) {
+		_fin = (_header[0] & 0x80) != 0;
+		_opcode = _header[0] & 0x0F;
+		if (!(_header[1] & 0x80) || (_header[0] & 0x70)) return false; // Unmasked, or extensions
+
+		uint8_t len = _header[1] & 0x7F;
+		size_t pos = 2;
+		_remaining = len;
+		if (len == 126) {
+			_remaining = ((uint64_t)_header[2] << 8) | _header[3];
+			pos = 4;
+		} else if (len == 127) {
+			_remaining = 0;
+			for (int i = 0; i < 8; i++) _remaining = (_remaining << 8) | _header[2 + i];
+			pos = 10;
+		}
+		memcpy(_mask, &_header[pos], 4);
+		_maskPos = 0;
+		_headerLength = 0;
+
+		if (_opcode >= WS_OP_CLOSE) {
+			if (!_fin || _remaining > WS_CONTROL_MAX) return false;
+			_controlLength = 0;
+			_state = CONTROL;
+			return true;
+		}
+
+		if (_opcode == WS_OP_BINARY) {
+			if (_inMessage) return false;
+			_inMessage = true;
+			_dropMessage = false;
+			_messageLength = 0;
+		} else if (_opcode == WS_OP_CONTINUATION) {
+			if (!_inMessage) {
+				_state = DISCARD; // Continues a text message
+				return true;
+			}
+		} else {
+			_state = DISCARD; // Text
+			return true;
+		}
+
+		if (_dropMessage || _messageLength + _remaining > capacity) {
+			_dropMessage = true;
+			_state = DISCARD;
+			return true;
+		}
+		_state = PAYLOAD;
+		return true;
+	}
+
+	size_t finishMessage() {
+		_inMessage = false;
+		messages++;
+		_outstanding++;
+		return _messageLength;
+	}
+
+	void unmask(uint8_t *data, size_t len) {
+		for (size_t i = 0; i < len; i++) {
+			data[i] ^= _mask[_maskPos];
+			_maskPos = (_maskPos + 1) & 3;
+		}
+	}
+
+	bool handshake() {
+		// Find the key, header names are case-insensitive
+		const char *name = "\r\nsec-websocket-key:";
+		const char *key = NULL;
+		for (char *p = _request; *p && key == NULL; p++) {
+			size_t i = 0;
+			while (name[i] && tolower((unsigned char)p[i]) == name[i]) i++;
+			if (name[i] == 0) key = p + i;
+		}
+		if (key == NULL) {
+			const char *reply = "HTTP/1.1 426 Upgrade Required\r\nUpgrade: websocket\r\nContent-Length: 0\r\n\r\n";
+			send(_client, reply, strlen(reply), 0);
+			return false;
+		}
+		while (*key == ' ') key++;
+		size_t keyLength = 0;
+		while (key[keyLength] && key[keyLength] != '\r' && key[keyLength] != ' ') keyLength++;
+
+		static const char GUID[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+		uint8_t input[64 + sizeof(GUID)];
+		if (keyLength == 0 || keyLength > 64) return false;
+		memcpy(input, key, keyLength);
+		memcpy(input + keyLength, GUID, sizeof(GUID) - 1);
+		uint8_t digest[20];
+		sha1(input, keyLength + sizeof(GUID) - 1, digest);
+		char accept[29];
+		base64(digest, sizeof(digest), accept);
+
+		char reply[160];
+		int len = snprintf(reply, sizeof(reply),
+			"HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+			"Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+		if (send(_client, reply, len, 0) != len) return false;
+
+		_state = HEADER;
+		connections++;
+		sendCredit(_window);
+		return true;
+	}
+
+	void sendCredit(uint8_t n) {
+		uint8_t credit[2] = {WS_CREDIT, n};
+		sendFrame(WS_OP_BINARY, credit, sizeof(credit));
+	}
+
+	// Server frames are never masked
+	void sendFrame(uint8_t opcode, const uint8_t *payload, size_t len) {
+		if (_client < 0) return;
+		uint8_t frame[2 + WS_CONTROL_MAX];
+		frame[0] = 0x80 | opcode;
+		frame[1] = (uint8_t)len;
+		memcpy(frame + 2, payload, len);
+		send(_client, frame, 2 + len, 0);
+	}
+};
+
+#endif
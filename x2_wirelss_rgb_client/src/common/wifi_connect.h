@@ -0,0 +1,140 @@
+/**
+ * Joins the Wi-Fi network in the background, with a fast path for
+ * reconnects.
+ *
+ * A full connect scans every channel for the access point and then waits
+ * for DHCP, which takes seconds. Once connected, the channel, BSSID and IP
+ * configuration are kept in NVS (Preferences, namespace "wifi"); the next
+ * boot joins that access point directly on that channel and, with cacheIp
+ * set, reuses the address instead of asking DHCP again. If the fast path
+ * does not connect within fastTimeoutMs (another access point, new
+ * channel), the connector falls back to a full connect, which stores the
+ * new values. The cache is only written when something changed.
+ *
+ * begin() returns at once; call poll() regularly until it reports
+ * CONNECTED or FAILED (no connection within timeoutMs).
+ */
+
+#ifndef WIFI_CONNECT_H
+#define WIFI_CONNECT_H
+
+#include <Arduino.h>
+#include <WiFi.h>
+#include <Preferences.h>
+
+#define WIFI_CACHE_VERSION 1
+
+// What the fast path needs, stored as one blob
+struct WifiCache {
+	uint8_t  version;
+	char     ssid[33];
+	uint8_t  bssid[6];
+	uint8_t  channel;
+	uint32_t ip;
+	uint32_t gateway;
+	uint32_t subnet;
+	uint32_t dns;
+};
+
+class WifiConnector {
+public:
+	enum State { CONNECTING_FAST, CONNECTING, CONNECTED, FAILED };
+
+	// Timeline in millis(), 0 = not yet
+	uint32_t startedAt = 0;
+	uint32_t connectedAt = 0;
+	bool fast = false;       // Connected on the fast path
+	bool fastFailed = false; // Tried the fast path and fell back
+
+	WifiConnector(uint32_t fastTimeoutMs, uint32_t timeoutMs, bool cacheIp)
+		: _fastTimeoutMs(fastTimeoutMs), _timeoutMs(timeoutMs), _cacheIp(cacheIp) {}
+
+	void begin(const char *ssid, const char *pwd, uint32_t nowMs) {
+		_ssid = ssid;
+		_pwd = pwd;
+		startedAt = _stateAt = nowMs;
+
+		WiFi.persistent(false); // The core would write the credentials to flash on every begin()
+		WiFi.mode(WIFI_STA);
+		WiFi.setAutoReconnect(true);
+
+		if (load() && strcmp(_cache.ssid, ssid) == 0) {
+			if (_cacheIp && _cache.ip) {
+				WiFi.config(IPAddress(_cache.ip), IPAddress(_cache.gateway), IPAddress(_cache.subnet),
+				            IPAddress(_cache.dns));
+			}
+			WiFi.begin(ssid, pwd, _cache.channel, _cache.bssid);
+			_state = CONNECTING_FAST;
+		} else {
+			WiFi.begin(ssid, pwd);
+			_state = CONNECTING;
+		}
+	}
+
+	// Checks progress, falls back to a full connect and stores the cache
+	State poll(uint32_t nowMs) {
+		if (_state == CONNECTED || _state == FAILED) return _state;
+
+		if (WiFi.status() == WL_CONNECTED) {
+			connectedAt = nowMs;
+			fast = _state == CONNECTING_FAST;
+			_state = CONNECTED;
+			save();
+		} else if (_state == CONNECTING_FAST && nowMs - _stateAt > _fastTimeoutMs) {
+			fastFailed = true;
+			WiFi.disconnect();
+			if (_cacheIp && _cache.ip) WiFi.config(IPAddress((uint32_t)0), IPAddress((uint32_t)0), IPAddress((uint32_t)0)); // DHCP again
+			WiFi.begin(_ssid, _pwd);
+			_state = CONNECTING;
+			_stateAt = nowMs;
+		} else if (nowMs - startedAt > _timeoutMs) {
+			_state = FAILED;
+		}
+		return _state;
+	}
+
+	State state() const { return _state; }
+
+private:
+	uint32_t _fastTimeoutMs;
+	uint32_t _timeoutMs;
+	bool _cacheIp;
+	const char *_ssid = NULL;
+	const char *_pwd = NULL;
+	State _state = CONNECTING;
+	uint32_t _stateAt = 0;
+	WifiCache _cache = {};
+
+	bool load() {
+		Preferences prefs;
+		if (!prefs.begin("wifi", true)) return false;
+		bool ok = prefs.getBytes("link", &_cache, sizeof(_cache)) == sizeof(_cache) &&
+		          _cache.version == WIFI_CACHE_VERSION && _cache.channel != 0;
+		prefs.end();
+		if (!ok) memset(&_cache, 0, sizeof(_cache));
+		return ok;
+	}
+
+	void save() {
+		WifiCache cache;
+		memset(&cache, 0, sizeof(cache)); // Padding too, for the memcmp() below
+		cache.version = WIFI_CACHE_VERSION;
+		strncpy(cache.ssid, _ssid, sizeof(cache.ssid) - 1);
+		uint8_t *bssid = WiFi.BSSID();
+		if (bssid) memcpy(cache.bssid, bssid, sizeof(cache.bssid));
+		cache.channel = WiFi.channel();
+		cache.ip = WiFi.localIP();
+		cache.gateway = WiFi.gatewayIP();
+		cache.subnet = WiFi.subnetMask();
+		cache.dns = WiFi.dnsIP();
+		if (memcmp(&cache, &_cache, sizeof(cache)) == 0) return; // Spare the flash
+
+		Preferences prefs;
+		if (!prefs.begin("wifi", false)) return;
+		prefs.putBytes("link", &cache, sizeof(cache));
+		prefs.end();
+		_cache = cache;
+	}
+};
+
+#endif
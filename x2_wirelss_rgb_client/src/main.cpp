@@ -1,5 +1,6 @@
 /**
- * The controller acts as a client, expecting (pixel) data from the serial port.
+ * The controller acts as a client, expecting (pixel) data over Wi-Fi: by
+ * default as UDP datagrams, taken from lwIP by an AsyncUDP callback.
  *
  * The SmartMatrix library offers many tools (and examples) to display graphics,
  * animations and texts.
@@ -8,15 +9,82 @@
  *
  * Fork of the library that allows control of the special 32x32 matrix
  * https://github.com/Kameeno/SmartMatrix
+ *
+ * Frames use the format of common/frame_protocol.h (header, payload,
+ * CRC32) and arrive split into UDP chunks tagged with their frame id
+ * (common/chunk_reassembly.h). Several frames can be assembled at once,
+ * so reordered or lost datagrams never mix two frames into one image; the
+ * newest complete frame is shown and older partial ones are abandoned.
+ * Parity chunks, when the sender adds them, rebuild lost chunks.
+ *
+ * With PIPELINED set, UDP chunks are reassembled into a pool of frame
+ * buffers off core 1 and a task on core 1 decodes every complete frame in
+ * order and swaps once for the newest (see common/frame_pipeline.h).
+ *
+ * With UDP_ASYNC set, datagrams come from AsyncUDP: the callback gets a
+ * pointer into the lwIP pbuf, parses the chunk header in place and copies
+ * the payload once, into its frame slot. The polled WiFiUDP path
+ * (parsePacket() allocates and copies every datagram into its own buffer,
+ * then read() copies it again) is kept for comparison; the "cpu" figure of
+ * the stats line is the receive time per frame of either path.
+ *
+ * Frames the sender stamps with a presentation time wait in a jitter
+ * buffer (common/jitter_buffer.h) and are swapped in at that time plus
+ * JITTER_DELAY_MS, so bursts on the network do not show up as uneven
+ * motion. Frames without a timestamp are shown as soon as they arrive.
+ *
+ * The panel starts before the network: while Wi-Fi connects in the
+ * background (common/wifi_connect.h, with a fast reconnect from the
+ * channel, BSSID and IP cached in NVS) a dot runs around the border, cyan
+ * on the fast path, amber on a full connect. Once connected the border
+ * turns green and stays until the first frame. The time from start-up to
+ * each boot step is printed with the first frame.
+ *
+ * With WALL_TILE set the client is one tile of a video wall: it listens on
+ * the wall's multicast group, keeps the chunks tagged with its tile offset
+ * and shows a frame when the sender's commit beacon for it arrives, at the
+ * same moment as the other tiles (common/wall_sync.h).
+ *
+ * A sender can ask what the client accepts: a datagram holding a
+ * FRAME_FORMAT_QUERY frame is answered with a FRAME_FORMAT_CAPS frame
+ * (resolution, formats and buffer depth, see DeviceCaps) sent back to
+ * where the query came from.
+ *
+ * With TIMING_ECHO set every frame shown is answered with a
+ * FRAME_FORMAT_TIMING frame (see FrameTiming: first and last chunk, decode
+ * and swap times), so the sender can break its latency down per stage.
+ * The render task queues them; the receiving side sends them to where the
+ * latest datagram came from (UDP only, not as a wall tile).
+ *
+ * RECEIVER selects where frames come from. RECEIVER_DMX makes the client
+ * an Art-Net / sACN (E1.31) node instead: DMX universes, 170 pixels each,
+ * are read straight into the back buffer and shown on sync packets or once
+ * all universes arrived (common/dmx_receiver.h).
+ *
+ * RECEIVER_WEBSOCKET takes frames from a browser over a WebSocket
+ * (common/websocket_server.h), one binary message per frame, unmasked
+ * straight into the frame pool and shown by the render task. The page gets
+ * credit for WEBSOCKET_WINDOW frames and a credit back for every frame
+ * shown, so it never sends faster than the panel can show.
  */
 
 // Pinout configuration for the PicoDriver v.5.0
 #include "common/pico_driver_v5_pinout.h"
+#include "common/frame_protocol.h"
+#include "common/frame_pipeline.h"
+#include "common/frame_decode.h"
+#include "common/chunk_reassembly.h"
+#include "common/jitter_buffer.h"
+#include "common/dmx_receiver.h"
+#include "common/websocket_server.h"
+#include "common/wifi_connect.h"
+#include "common/wall_sync.h"
 
 #include <Arduino.h>
 
 #include <WiFi.h>
 #include <WiFiUdp.h>
+#include <AsyncUDP.h>
 
 
 /* WiFi network name and password */
@@ -25,6 +93,13 @@ const char * pwd = "25jan2022";
 
 #define UDP_PORT 44444
 
+#define WIFI_FAST_TIMEOUT_MS 3000 // Fall back to a full connect when the cached AP does not answer
+#define WIFI_TIMEOUT_MS 20000     // Restart if there is no connection after this long
+#define WIFI_CACHE_IP 1           // 1: reuse the last DHCP address on the fast path
+#define STATUS_FRAME_MS 40        // Status animation while connecting
+
+WifiConnector wifi(WIFI_FAST_TIMEOUT_MS, WIFI_TIMEOUT_MS, WIFI_CACHE_IP);
+
 // IP address to send UDP data to.
 // it can be ip address of the server or 
 // a network broadcast address
@@ -34,6 +109,7 @@ const char * pwd = "25jan2022";
 
 //create UDP instance
 WiFiUDP udp;
+AsyncUDP asyncUdp;
 
 
 #include <SmartMatrix.h>
@@ -55,135 +131,647 @@ SMARTMATRIX_ALLOCATE_BUFFERS(matrix, TOTAL_WIDTH, TOTAL_HEIGHT, kRefreshDepth, k
 SMARTMATRIX_ALLOCATE_BACKGROUND_LAYER(bg, TOTAL_WIDTH, TOTAL_HEIGHT, COLOR_DEPTH, kbgOptions);
 
 
-// RGB32 or RGB24 (RRRRRGGG GGGBBBBB)?
-const uint8_t INCOMING_COLOR_DEPTH = 16;
-
 const uint16_t NUM_LEDS = TOTAL_WIDTH * TOTAL_HEIGHT;
-const uint16_t BUFFER_SIZE = NUM_LEDS * (INCOMING_COLOR_DEPTH / 8);
-static uint8_t buf[BUFFER_SIZE] __attribute__((aligned(4))); // Align buffer for better memory access
-static uint8_t receivedChunks[8] = {0};
-
-const uint16_t CHUNK_SIZE = 1024;
-const uint16_t HEADER_SIZE = 2;   // [currentChunk, totalChunks]
-
-// Add these global variables for FPS calculation
-static uint32_t frameCount = 0;
-static uint32_t lastFPSUpdate = 0;
-static float currentFPS = 0;
+const uint16_t MAX_PAYLOAD = NUM_LEDS * 3; // Largest format is RGB888
+const uint16_t MAX_FRAME = FRAME_HEADER_SIZE + MAX_PAYLOAD + FRAME_CRC_SIZE;
 
 // Add these constants at the top with other definitions
-#define FPS_UPDATE_INTERVAL 1000  // Update FPS every second
 #define LED_BLINK_INTERVAL 500    // LED blink interval in ms
 
+#define PIPELINED 1          // 1: receive on core 0, decode/present on core 1
+#define UDP_ASYNC 1          // 1: AsyncUDP callback on the pbuf, 0: poll WiFiUDP
+#define WALL_TILE 0          // 1: one tile of a video wall, needs UDP_ASYNC
+#define WALL_GROUP IPAddress(239, 255, 80, 1) // Multicast group of the wall sender
+#define WALL_TILE_X 0        // Offset of this tile in the wall image, in pixels
+#define WALL_TILE_Y 0
+#define WALL_HOLD_FRAMES 2   // Complete frames waiting for their commit beacon
+#define FRAME_SLOTS 16       // Frame buffers in the pipeline pool (power of two)
+#define REASSEMBLY_FRAMES 3  // Frames that can be assembled at the same time
+#define FEC_MAX_GROUPS 2     // Parity groups per frame used to rebuild lost chunks (1 KB RAM each per frame)
+#define JITTER_DELAY_MS 35   // Extra latency for timestamped frames, absorbs that much jitter
+#define JITTER_SPIN_US 1500  // Busy-wait this last stretch before a scheduled swap
+#define CLOCK_WINDOW_MS 2000 // Clock offset estimate: minimum over one to two windows
+#define CLOCK_RESET_MS 500   // Restart the estimate when a frame is this much "later"
+#define STATS_INTERVAL 2000  // ms between timing reports on Serial, 0 = off
+#define TIMING_ECHO 1        // 1: send a FRAME_FORMAT_TIMING frame back for every frame shown
+
+#define RECEIVER_UDP 0        // Chunked frames over UDP
+#define RECEIVER_DMX 1        // Art-Net / sACN universes
+#define RECEIVER_WEBSOCKET 2  // Frames over a WebSocket, e.g. from a web app
+#define RECEIVER RECEIVER_UDP
+
+#define WEBSOCKET_PORT 81
+#define WEBSOCKET_WINDOW 3    // Frames the browser may have in flight
+
+#define ARTNET_START_UNIVERSE 0   // Art-Net port address of the first 170 pixels
+#define SACN_START_UNIVERSE 1     // sACN universe of the first 170 pixels
+#define SACN_SYNC_UNIVERSE 0      // Multicast sync address the sender uses, 0 = none or unicast
+#define DMX_SYNC_TIMEOUT_MS 4000  // Without sync packets for this long, show frames once complete
+
+// Frame buffers, filled straight from the socket by the reassembler
+FramePool<MAX_FRAME, FRAME_SLOTS> pool;
+ChunkReassembler<MAX_FRAME, FRAME_SLOTS, REASSEMBLY_FRAMES, FEC_MAX_GROUPS> reassembler(pool);
+TaskHandle_t renderTask = NULL;
+
+// Complete frames waiting for their presentation time. At most
+// JITTER_MAX_FRAMES are held back so the reassembler (and the frame being
+// received) always find a free buffer; beyond that frames are shown early.
+JitterBuffer<FRAME_SLOTS> jitter(JITTER_DELAY_MS * 1000UL, CLOCK_WINDOW_MS * 1000UL, CLOCK_RESET_MS * 1000UL);
+const size_t JITTER_MAX_FRAMES = FRAME_SLOTS - REASSEMBLY_FRAMES - (WALL_TILE ? WALL_HOLD_FRAMES : 0) - 1;
+
+// Video wall: complete frames of this tile wait here for their commit
+static_assert(!WALL_TILE || UDP_ASYNC, "WALL_TILE needs UDP_ASYNC");
+WallCommitter<MAX_FRAME, FRAME_SLOTS, WALL_HOLD_FRAMES> wall(pool);
+
+// Everything decodeFrame() accepts, reported to senders
+const uint8_t FORMATS[] = {
+	FRAME_FORMAT_RGB565, FRAME_FORMAT_RGB888, FRAME_FORMAT_RECTS_RGB565, FRAME_FORMAT_XOR_RLE_RGB565,
+	FRAME_FORMAT_PALETTE, FRAME_FORMAT_INDEXED1, FRAME_FORMAT_INDEXED2, FRAME_FORMAT_INDEXED4,
+	FRAME_FORMAT_INDEXED8,
+};
+const size_t CAPS_FRAME_SIZE = FRAME_HEADER_SIZE + FRAME_CAPS_HEADER_SIZE + sizeof(FORMATS) + FRAME_CRC_SIZE;
+const size_t QUERY_FRAME_SIZE = FRAME_HEADER_SIZE + FRAME_CRC_SIZE;
+
+// Timings of the frames shown, from the render task to the receiving side
+// that sends them. A wall tile's frames arrive by beacon, and the other
+// receivers have no one to send them to.
+const bool TIMING_REPLIES = TIMING_ECHO && RECEIVER == RECEIVER_UDP && !WALL_TILE;
+const size_t TIMING_FRAME_SIZE = FRAME_HEADER_SIZE + FRAME_TIMING_SIZE + FRAME_CRC_SIZE;
+SpscQueue<FrameTiming, 16> timings;
+
+// Per-stage timings
+StageTimer receiveTimer; // First to last chunk of a frame
+StageTimer decodeTimer;  // Pixel format conversion into the back buffer
+StageTimer presentTimer; // swapBuffers()
+StageTimer latencyTimer; // Last chunk received to swap done
+StageTimer paceTimer;    // Distance of a scheduled swap from its due time
+StageTimer cpuTimer;     // CPU time spent on the datagrams of a frame
+uint32_t receiveCpuUs = 0; // ... so far for the frame being completed
+uint32_t framesMerged = 0; // Frames decoded but shown together with a newer one
+
+// DMX channel data is copied into the back buffer as it is
+static_assert(sizeof(rgb24) == 3, "DMX mode needs a packed RGB888 back buffer (COLOR_DEPTH 24)");
+DmxReceiver dmx(ARTNET_START_UNIVERSE, SACN_START_UNIVERSE, NUM_LEDS, DMX_SYNC_TIMEOUT_MS);
+
+WebSocketServer ws;
+
+// Boot timeline in millis() (since the app started), 0 = not yet
+uint32_t bootSetupAt = 0;
+uint32_t bootMatrixAt = 0;
+uint32_t bootListenAt = 0;
+uint32_t bootFirstFrameAt = 0;
+
+void onDatagram(AsyncUDPPacket &packet);
+void receiveTask(void *);
+void renderLoop(void *);
+void dmxTask(void *);
+void webSocketTask(void *);
+
 void setup() {
-	// Serial.begin(921600);
-	// Serial.setTimeout(1); 
+	bootSetupAt = millis();
+	if (STATS_INTERVAL) Serial.begin(115200);
 
 	pinMode(PICO_LED_PIN, OUTPUT);
 	digitalWrite(PICO_LED_PIN, 1);
 
-	// Serial.begin(115200);
+	// The panel first, it shows the Wi-Fi state until frames arrive
+	bg.enableColorCorrection(true);
+	matrix.addLayer(&bg);
+	matrix.setBrightness(255);
+	matrix.begin();
+	bootMatrixAt = millis();
+
+	// Connects in the background, loop() takes it from here
+	wifi.begin(ssid, pwd, millis());
+}
+
+// Draws the connection state into the panel: a dot with a short tail
+// running around the border while connecting, a green border once connected
+void showStatus(uint32_t nowMs) {
+	const int perimeter = 2 * (TOTAL_WIDTH + TOTAL_HEIGHT) - 4;
+	WifiConnector::State state = wifi.state();
+	rgb24 color = state == WifiConnector::CONNECTED ? rgb24(0, 160, 0) :
+	              state == WifiConnector::CONNECTING_FAST ? rgb24(0, 160, 255) : rgb24(255, 120, 0);
+
+	bg.fillScreen(rgb24(0, 0, 0));
+	int head = nowMs / STATUS_FRAME_MS;
+	for (int i = 0; i < perimeter; i++) {
+		int age = (head - i) % perimeter;
+		if (age < 0) age += perimeter;
+		if (state != WifiConnector::CONNECTED && age > 3) continue;
+		uint8_t fade = state == WifiConnector::CONNECTED ? 1 : 1 << age;
+		rgb24 c(color.red / fade, color.green / fade, color.blue / fade);
+
+		// Position i along the border, clockwise from the top left corner
+		int x, y;
+		if (i < TOTAL_WIDTH) { x = i; y = 0; }
+		else if (i < TOTAL_WIDTH + TOTAL_HEIGHT - 1) { x = TOTAL_WIDTH - 1; y = i - TOTAL_WIDTH + 1; }
+		else if (i < 2 * TOTAL_WIDTH + TOTAL_HEIGHT - 2) { x = 2 * TOTAL_WIDTH + TOTAL_HEIGHT - 3 - i; y = TOTAL_HEIGHT - 1; }
+		else { x = 0; y = perimeter - i; }
+		bg.drawPixel(x, y, c);
+	}
+	bg.swapBuffers(true);
+}
+
+// Prints, once, when each boot step was done, e.g.
+// "boot: setup 310, matrix 352, wifi 1104 (fast, channel 6), listening 1106, first frame 1190 ms"
+void reportBoot() {
+	if (bootFirstFrameAt) return;
+	bootFirstFrameAt = millis();
+	if (STATS_INTERVAL == 0) return;
+	Serial.printf("boot: setup %lu, matrix %lu, wifi %lu (%s, channel %d), listening %lu, first frame %lu ms\n",
+		(unsigned long)bootSetupAt, (unsigned long)bootMatrixAt, (unsigned long)wifi.connectedAt,
+		wifi.fast ? "fast" : wifi.fastFailed ? "fast path failed, full" : "full", (int)WiFi.channel(),
+		(unsigned long)bootListenAt, (unsigned long)bootFirstFrameAt);
+}
+
+// Opens the sockets and starts the tasks of the selected receiver. From
+// here on they own the panel.
+void startReceiver() {
+	if (RECEIVER == RECEIVER_UDP && !UDP_ASYNC) udp.begin(UDP_PORT);
+
+	if (RECEIVER == RECEIVER_DMX) {
+		dmx.begin(ARTNET_PORT, SACN_PORT, SACN_SYNC_UNIVERSE);
+		xTaskCreatePinnedToCore(dmxTask, "dmx", 4096, NULL, 3, NULL, 0);
+	} else if (RECEIVER == RECEIVER_WEBSOCKET) {
+		ws.begin(WEBSOCKET_PORT, WEBSOCKET_WINDOW);
+		xTaskCreatePinnedToCore(renderLoop, "render", 4096, NULL, 2, &renderTask, 1);
+		xTaskCreatePinnedToCore(webSocketTask, "websocket", 4096, NULL, 3, NULL, 0);
+	} else if (PIPELINED) {
+		xTaskCreatePinnedToCore(renderLoop, "render", 4096, NULL, 2, &renderTask, 1);
+		if (!UDP_ASYNC) xTaskCreatePinnedToCore(receiveTask, "receive", 4096, NULL, 3, NULL, 0);
+	}
 
-	//Connect to the WiFi network
-	WiFi.begin(ssid, pwd);
-	// Serial.println("");
+	// AsyncUDP runs the callback on its own task; without PIPELINED loop()
+	// presents what it publishes
+	if (RECEIVER == RECEIVER_UDP && UDP_ASYNC) {
+		asyncUdp.onPacket(onDatagram);
+		if (WALL_TILE) asyncUdp.listenMulticast(WALL_GROUP, UDP_PORT);
+		else asyncUdp.listen(UDP_PORT);
+	}
+	bootListenAt = millis();
+}
 
-	// Add WiFi connection timeout
-	uint32_t connectionStart = millis();
-	const uint32_t WIFI_TIMEOUT = 20000; // 20 seconds timeout
-	
-	while (WiFi.status() != WL_CONNECTED) {
-		if (millis() - connectionStart > WIFI_TIMEOUT) {
-			ESP.restart(); // Restart if cannot connect
+// Id of the frame currently held in the back buffer (valid once a full
+// frame was decoded). Delta frames must name it as their base.
+uint16_t currentId = 0;
+bool haveCurrent = false;
+bool currentIs565 = false; // XOR deltas need the exact RGB565 values
+uint32_t deltasRejected = 0;
+
+// Last palette received, used by the indexed formats
+rgb24 palette[256];
+bool havePalette = false;
+
+// Converts a validated frame into the back buffer.
+// Returns false (and leaves the back buffer alone) for palettes, unknown
+// formats and for deltas against a frame we do not have.
+bool decodeFrame(const FrameHeader &header, const uint8_t *buf) {
+	rgb24 *buffer = bg.backBuffer();
+	uint8_t bpp = frameIndexedBpp(header.format);
+
+	if (header.format == FRAME_FORMAT_PALETTE) {
+		if (loadPalette(palette, buf, header.length)) havePalette = true;
+		return false; // Nothing to show yet
+	} else if (bpp) {
+		if (!havePalette || header.length != NUM_LEDS * bpp / 8) return false;
+		expandIndexed(buffer, NUM_LEDS, buf, bpp, palette);
+	} else if (header.format == FRAME_FORMAT_RGB888 && header.length == NUM_LEDS * 3) {
+		expandRgb888(buffer, buf, NUM_LEDS);
+	} else if (header.format == FRAME_FORMAT_RGB565 && header.length == NUM_LEDS * 2) {
+		expandRgb565(buffer, buf, NUM_LEDS);
+	} else if (header.format == FRAME_FORMAT_RECTS_RGB565) {
+		if (!haveCurrent || header.length < FRAME_RECTS_HEADER_SIZE || rectsBaseId(buf) != currentId ||
+		    !applyRectsRgb565(buffer, TOTAL_WIDTH, TOTAL_HEIGHT, buf, header.length)) {
+			deltasRejected++;
+			return false;
+		}
+		currentId = header.id;
+		return true; // Keeps currentIs565: the patched pixels are RGB565 too
+	} else if (header.format == FRAME_FORMAT_XOR_RLE_RGB565) {
+		if (header.length < FRAME_XOR_RLE_HEADER_SIZE) return false;
+		bool delta = xorRleIsDelta(buf);
+		if ((delta && (!haveCurrent || !currentIs565 || xorRleBaseId(buf) != currentId)) ||
+		    !applyXorRleRgb565(buffer, NUM_LEDS, buf, header.length)) {
+			deltasRejected++;
+			return false;
 		}
-		delay(500);
+	} else {
+		return false;
 	}
-	udp.begin(UDP_PORT);
+	currentId = header.id;
+	haveCurrent = true;
+	currentIs565 = header.format == FRAME_FORMAT_RGB565 || header.format == FRAME_FORMAT_XOR_RLE_RGB565;
+	return true;
+}
 
-	// Serial.println("");
-	// Serial.print("Connected to ");
-	// Serial.println(ssid);
-	// Serial.print("IP address: ");
-	// Serial.println(WiFi.localIP());
-	// Serial.print("Port: ");
-	// Serial.println(UDP_PORT);
-	// Serial.print("Buffer size: ");
-	// Serial.println(BUFFER_SIZE);  // This will show 3072 for 32x32x3
+// Shows the back buffer. Copying it back after the swap keeps the back
+// buffer equal to what is on screen, which delta frames patch. Returns
+// when the swap was done.
+uint32_t swapFrame(uint32_t receivedAt) {
+	uint32_t t0 = micros();
+	bg.swapBuffers(true);
+	uint32_t t1 = micros();
+	presentTimer.add(t1 - t0);
+	latencyTimer.add(t1 - receivedAt);
+	reportBoot();
+	return t1;
+}
 
-	bg.enableColorCorrection(true);
-	matrix.addLayer(&bg);
-	matrix.setBrightness(255);
-	matrix.begin();
+// Moves published frames into the jitter buffer, then decodes every
+// frame that is due (in order: deltas depend on their predecessors) and
+// shows the result with a single swap at the due time of the first one,
+// or straight away if that has passed.
+// Returns µs until the next frame is due, or -1 if none is waiting.
+int32_t presentFrames() {
+	PipelineFrame *frame;
+	while ((frame = pool.pop()) != NULL) jitter.push(frame);
+
+	bool drain = jitter.shouldDrain(JITTER_MAX_FRAMES);
+	int32_t wait = jitter.untilDue(micros());
+	if (wait < 0 || (wait > JITTER_SPIN_US && !drain)) return wait;
+
+	// Not before the head is due, and not before now: everything already
+	// due goes out with one swap, so a backlog after a stall catches up
+	uint32_t now = micros();
+	uint32_t target = drain ? now : jitter.dueAt(jitter.head());
+	if ((int32_t)(target - now) < 0) target = now;
+	uint8_t taken = 0, decoded = 0;
+	PipelineFrame shown;
+	uint32_t decodedAt = 0;
+	while ((frame = jitter.head()) != NULL) {
+		if (taken && !jitter.shouldDrain(JITTER_MAX_FRAMES) && (int32_t)(jitter.dueAt(frame) - target) > 0) break;
+		jitter.pop();
+		taken++;
+		uint32_t t0 = micros();
+		if (decodeFrame(frame->header, frame->data + FRAME_HEADER_SIZE)) {
+			decodedAt = micros();
+			decodeTimer.add(decodedAt - t0);
+			shown = *frame;
+			decoded++;
+		}
+		pool.recycle(frame);
+	}
+
+	if (decoded) {
+		while ((int32_t)(target - micros()) > 0) {
+			// Wait for the exact moment
+		}
+		now = micros();
+		if (shown.timed) paceTimer.add(now - target);
+		jitter.presented(&shown, now, drain);
+		framesMerged += decoded - 1;
+		uint32_t swappedAt = swapFrame(shown.receivedAt);
+		if (TIMING_REPLIES) {
+			FrameTiming timing = {shown.header.id, shown.receivedAt - shown.receiveUs, shown.receivedAt, decodedAt, swappedAt};
+			timings.push(timing); // Dropped when full: nobody sent anything for a while
+		}
+	}
+	return jitter.untilDue(micros());
+}
+
+// Prints averages (max) per stage in µs, the presented frame rate, the
+// reassembly counters and the jitter buffer state, e.g.
+// "rx 2100 (5300) cpu 95 (160) dec 180 (230) swap 3105 (16020) lat 38420 (51400) us | 59.8 fps, 0 dropped, 1 merged |
+//  3 lost, 2 torn, 5 reordered, 1 late, 0 dup, 0 bad, 0 corrupt, 12 recovered, 0 deltas rejected |
+//  jitter 2 queued, pace 12 (40) us, 0 late, 0 early, 0 clock resets"
+// In WebSocket mode the reassembly counters give way to
+// "ws 1 connections, 3600 messages, 0 too large, 0 bad, 0 protocol errors".
+uint32_t framesInvalid = 0; // WebSocket messages that were not a valid frame
+
+void reportStats() {
+	static uint32_t lastReport = 0;
+	uint32_t now = millis();
+	if (STATS_INTERVAL == 0 || now - lastReport < STATS_INTERVAL) return;
+
+	Serial.printf("rx %lu (%lu) cpu %lu (%lu) dec %lu (%lu) swap %lu (%lu) lat %lu (%lu) us | %.1f fps, %lu dropped, %lu merged | ",
+		(unsigned long)receiveTimer.averageUs(), (unsigned long)receiveTimer.maxUs,
+		(unsigned long)cpuTimer.averageUs(), (unsigned long)cpuTimer.maxUs,
+		(unsigned long)decodeTimer.averageUs(), (unsigned long)decodeTimer.maxUs,
+		(unsigned long)presentTimer.averageUs(), (unsigned long)presentTimer.maxUs,
+		(unsigned long)latencyTimer.averageUs(), (unsigned long)latencyTimer.maxUs,
+		presentTimer.count * 1000.0f / (now - lastReport),
+		(unsigned long)pool.dropped, (unsigned long)framesMerged);
+	if (RECEIVER == RECEIVER_WEBSOCKET) {
+		Serial.printf("ws %lu connections, %lu messages, %lu too large, %lu bad, %lu protocol errors, %lu deltas rejected\n",
+			(unsigned long)ws.connections, (unsigned long)ws.messages, (unsigned long)ws.messagesTooLarge,
+			(unsigned long)framesInvalid, (unsigned long)ws.protocolErrors, (unsigned long)deltasRejected);
+	} else {
+		Serial.printf("%lu lost, %lu torn, %lu reordered, %lu late, %lu dup, %lu bad, %lu corrupt, %lu recovered, %lu restarts, %lu deltas rejected | "
+			"jitter %u queued, pace %lu (%lu) us, %lu late, %lu early, %lu clock resets",
+			(unsigned long)reassembler.framesLost, (unsigned long)reassembler.framesTorn,
+			(unsigned long)reassembler.chunksReordered, (unsigned long)reassembler.chunksLate,
+			(unsigned long)reassembler.chunksDuplicate, (unsigned long)reassembler.chunksMalformed,
+			(unsigned long)reassembler.framesCorrupt, (unsigned long)reassembler.framesRecovered,
+			(unsigned long)reassembler.senderRestarts,
+			(unsigned long)deltasRejected,
+			(unsigned)jitter.size(), (unsigned long)paceTimer.averageUs(), (unsigned long)paceTimer.maxUs,
+			(unsigned long)jitter.framesLate, (unsigned long)jitter.framesEarly, (unsigned long)jitter.clock.resets);
+		if (WALL_TILE) {
+			Serial.printf(" | wall %lu committed, %lu missed, %lu uncommitted, %lu restarts",
+				(unsigned long)wall.framesCommitted, (unsigned long)wall.framesMissed,
+				(unsigned long)wall.framesUncommitted, (unsigned long)wall.senderRestarts);
+		}
+		Serial.printf("\n");
+	}
+
+	receiveTimer.reset();
+	cpuTimer.reset();
+	decodeTimer.reset();
+	presentTimer.reset();
+	latencyTimer.reset();
+	paceTimer.reset();
+	lastReport = now;
 }
 
-// Helper function for RGB conversion
-inline void convert16to24bit(const uint8_t high, const uint8_t low, rgb24* col) {
-	uint16_t rgb16 = ((uint16_t)high << 8) | low;
-	col->red   = ((rgb16 >> 11) & 0x1F) << 3;
-	col->green = ((rgb16 >> 5)  & 0x3F) << 2;
-	col->blue  = (rgb16 & 0x1F) << 3;
+// True for a datagram holding a FRAME_FORMAT_QUERY frame
+bool isQuery(const uint8_t *data, size_t size) {
+	FrameHeader header;
+	return size == QUERY_FRAME_SIZE && parseFrame(data, size, 0, header) && header.format == FRAME_FORMAT_QUERY;
+}
+
+// Writes the FRAME_FORMAT_CAPS answer to a query into out (CAPS_FRAME_SIZE bytes)
+size_t writeCapsFrame(uint8_t *out) {
+	static uint16_t id = 0;
+
+	DeviceCaps caps;
+	caps.width       = TOTAL_WIDTH;
+	caps.height      = TOTAL_HEIGHT;
+	caps.maxPayload  = MAX_PAYLOAD;
+	caps.frameSlots  = FRAME_SLOTS;
+	caps.baud        = 0; // Not a serial link
+	caps.maxBaud     = 0;
+	caps.formats     = FORMATS;
+	caps.formatCount = sizeof(FORMATS);
+	size_t len = writeCaps(&out[FRAME_HEADER_SIZE], caps);
+	return encodeFrame(out, FRAME_FORMAT_CAPS, id++, len);
+}
+
+// Writes a FRAME_FORMAT_TIMING frame into out (TIMING_FRAME_SIZE bytes)
+size_t writeTimingFrame(uint8_t *out, const FrameTiming &timing) {
+	static uint16_t id = 0;
+	writeFrameTiming(&out[FRAME_HEADER_SIZE], timing);
+	return encodeFrame(out, FRAME_FORMAT_TIMING, id++, FRAME_TIMING_SIZE);
+}
+
+// Sends the queued timings to where the datagram just read came from
+void sendTimings() {
+	FrameTiming timing;
+	uint8_t out[TIMING_FRAME_SIZE];
+	while (timings.pop(timing)) {
+		udp.beginPacket(udp.remoteIP(), udp.remotePort());
+		udp.write(out, writeTimingFrame(out, timing));
+		udp.endPacket();
+	}
+}
+
+/**
+ * Reads one datagram straight into the frame buffer it belongs to.
+ * Returns true when it completed (and published) a frame.
+ */
+bool receiveChunk(int packetSize) {
+	if (packetSize == QUERY_FRAME_SIZE && udp.peek() == FRAME_SYNC_0) {
+		uint8_t query[QUERY_FRAME_SIZE], caps[CAPS_FRAME_SIZE];
+		if (udp.read(query, sizeof(query)) == sizeof(query) && isQuery(query, sizeof(query))) {
+			udp.beginPacket(udp.remoteIP(), udp.remotePort());
+			udp.write(caps, writeCapsFrame(caps));
+			udp.endPacket();
+		}
+		return false;
+	}
+
+	uint8_t head[CHUNK_MAX_HEADER_SIZE];
+	ChunkHeader chunk;
+	if (packetSize <= CHUNK_HEADER_SIZE || udp.read(head, CHUNK_HEADER_SIZE) != CHUNK_HEADER_SIZE ||
+	    !parseChunkHeader(head, chunk)) {
+		udp.flush(); // Not ours
+		return false;
+	}
+
+	// Optional fields behind the fixed header
+	size_t headerSize = chunkHeaderSize(chunk);
+	if ((size_t)packetSize <= headerSize ||
+	    udp.read(head + CHUNK_HEADER_SIZE, headerSize - CHUNK_HEADER_SIZE) != (int)(headerSize - CHUNK_HEADER_SIZE)) {
+		udp.flush();
+		return false;
+	}
+	parseChunkExtension(head, chunk);
+
+	size_t dataSize = packetSize - headerSize;
+	uint8_t *target = reassembler.begin(chunk, dataSize, micros());
+	if (target == NULL) {
+		udp.flush(); // Late, duplicate, malformed or no free buffer
+		return false;
+	}
+	udp.read(target, dataSize);
+
+	PipelineFrame *frame = reassembler.end(micros());
+	if (frame == NULL) return false;
+	receiveTimer.add(frame->receiveUs);
+	pool.publish(frame);
+	return true;
+}
+
+/**
+ * Same for a datagram that is already in memory (the lwIP pbuf): the
+ * header is parsed in place and the payload copied once, into the frame
+ * buffer. Returns true when it completed (and published) a frame.
+ *
+ * As a wall tile, only chunks of this tile are taken and complete frames
+ * are published when their commit beacon arrives.
+ */
+bool receiveDatagram(const uint8_t *data, size_t size) {
+	WallBeacon beacon;
+	if (WALL_TILE && parseWallBeacon(data, size, beacon)) {
+		PipelineFrame *frame = wall.commit(beacon, micros());
+		if (frame == NULL) return false;
+		pool.publish(frame);
+		return true;
+	}
+
+	ChunkHeader chunk;
+	if (size <= CHUNK_HEADER_SIZE || !parseChunkHeader(data, chunk)) return false; // Not ours
+
+	size_t headerSize = chunkHeaderSize(chunk);
+	if (size <= headerSize) return false;
+	parseChunkExtension(data, chunk);
+	if (WALL_TILE && !chunkIsTile(chunk, WALL_TILE_X, WALL_TILE_Y)) return false; // Another tile's
+
+	size_t dataSize = size - headerSize;
+	uint8_t *target = reassembler.begin(chunk, dataSize, micros());
+	if (target == NULL) return false; // Late, duplicate, malformed or no free buffer
+	memcpy(target, data + headerSize, dataSize);
+
+	PipelineFrame *frame = reassembler.end(micros());
+	if (frame == NULL) return false;
+	receiveTimer.add(frame->receiveUs);
+	if (WALL_TILE) {
+		wall.hold(frame);
+		return false;
+	}
+	pool.publish(frame);
+	return true;
+}
+
+// Adds the time spent on one datagram; a completed frame takes the sum
+void addReceiveCpu(uint32_t us, bool completed) {
+	receiveCpuUs += us;
+	if (!completed) return;
+	cpuTimer.add(receiveCpuUs);
+	receiveCpuUs = 0;
+}
+
+// AsyncUDP task: pbuf → reassembler → frame pool
+void onDatagram(AsyncUDPPacket &packet) {
+	if (isQuery(packet.data(), packet.length())) {
+		uint8_t caps[CAPS_FRAME_SIZE];
+		packet.write(caps, writeCapsFrame(caps)); // Back to the sender
+		return;
+	}
+
+	uint32_t t0 = micros();
+	pool.reclaim();
+	bool completed = receiveDatagram(packet.data(), packet.length());
+	addReceiveCpu(micros() - t0, completed);
+	if (completed && renderTask) xTaskNotifyGive(renderTask);
+
+	FrameTiming timing;
+	uint8_t out[TIMING_FRAME_SIZE];
+	while (timings.pop(timing)) packet.write(out, writeTimingFrame(out, timing));
+}
+
+// Core 0: UDP → reassembler → frame pool
+void receiveTask(void *) {
+	for (;;) {
+		uint32_t t0 = micros();
+		int packetSize = udp.parsePacket();
+		if (!packetSize) {
+			vTaskDelay(1); // Let the Wi-Fi stack run
+			continue;
+		}
+
+		pool.reclaim();
+		bool completed = receiveChunk(packetSize);
+		addReceiveCpu(micros() - t0, completed);
+		if (completed) xTaskNotifyGive(renderTask);
+		sendTimings();
+	}
+}
+
+// Core 0: WebSocket messages → frame pool. Every frame the renderer hands
+// back returns one credit to the browser.
+void webSocketTask(void *) {
+	PipelineFrame *incoming = NULL;
+	for (;;) {
+		ws.grant(pool.reclaim());
+		if (incoming == NULL && (incoming = pool.acquire()) == NULL) {
+			vTaskDelay(1); // All buffers busy, cannot happen within the credit window
+			continue;
+		}
+
+		size_t length = ws.poll(incoming->data, MAX_FRAME, micros(), 5);
+		if (!length) continue;
+		if (!parseFrame(incoming->data, length, MAX_PAYLOAD, incoming->header)) {
+			framesInvalid++;
+			ws.grant(1); // Not shown, the buffer is reused right away
+			continue;
+		}
+
+		uint32_t now = micros();
+		incoming->receivedAt = now;
+		incoming->receiveUs = now - ws.messageStartedAt();
+		incoming->timed = false;
+		receiveTimer.add(incoming->receiveUs);
+		pool.publish(incoming);
+		incoming = NULL;
+		xTaskNotifyGive(renderTask);
+	}
+}
+
+// Core 1: frame pool → jitter buffer → back buffer → swap
+void renderLoop(void *) {
+	for (;;) {
+		int32_t wait = presentFrames();
+		reportStats();
+
+		// Sleep until a new frame arrives or the next one is almost due;
+		// presentFrames() spins through the last JITTER_SPIN_US, so a frame
+		// that is due by then needs no sleep at all
+		TickType_t ticks = wait < 0 ? pdMS_TO_TICKS(100)
+		                 : wait <= JITTER_SPIN_US ? 0
+		                 : pdMS_TO_TICKS((wait - JITTER_SPIN_US) / 1000) + 1;
+		ulTaskNotifyTake(pdTRUE, ticks);
+	}
+}
+
+// Where the DMX receiver writes and how it shows a frame
+struct MatrixTarget {
+	uint8_t *backBuffer() { return (uint8_t *)bg.backBuffer(); }
+
+	void present() {
+		uint32_t t0 = micros();
+		bg.swapBuffers(true); // Universes that do not change keep their pixels
+		presentTimer.add(micros() - t0);
+		reportBoot();
+	}
+};
+
+// Prints the swap time and the DMX counters, e.g.
+// "swap 3105 (16020) us | 40.0 fps, 1960 packets, 0 partial, 80 syncs, 0 ignored, 0 out of order"
+void reportDmxStats() {
+	static uint32_t lastReport = 0;
+	uint32_t now = millis();
+	if (STATS_INTERVAL == 0 || now - lastReport < STATS_INTERVAL) return;
+
+	Serial.printf("swap %lu (%lu) us | %.1f fps, %lu packets, %lu partial, %lu syncs, %lu ignored, %lu out of order\n",
+		(unsigned long)presentTimer.averageUs(), (unsigned long)presentTimer.maxUs,
+		presentTimer.count * 1000.0f / (now - lastReport),
+		(unsigned long)dmx.packets, (unsigned long)dmx.framesPartial, (unsigned long)dmx.syncs,
+		(unsigned long)dmx.ignored, (unsigned long)dmx.outOfOrder);
+
+	presentTimer.reset();
+	lastReport = now;
+}
+
+// Core 0: Art-Net / sACN sockets → back buffer → swap
+void dmxTask(void *) {
+	MatrixTarget target;
+	for (;;) {
+		dmx.poll(target, millis(), 100);
+		reportDmxStats();
+	}
 }
 
 void loop() {
-	static uint32_t lastLEDBlink = 0;
-	int packetSize = udp.parsePacket();
-	
-	if (packetSize) {
-		uint8_t chunkIndex, totalChunks;
-		
-		// Read header
-		udp.read(&chunkIndex, 1);
-		udp.read(&totalChunks, 1);
-
-		// Read chunk data
-		int dataSize = packetSize - HEADER_SIZE; // Subtract header size
-		if (dataSize > 0) {
-			// Use memcpy for faster data copy
-			udp.read(&buf[chunkIndex * CHUNK_SIZE], dataSize);
-			receivedChunks[chunkIndex] = 1;
-
-			bool complete = true;
-			for (int i = 0; i < totalChunks && complete; i++) {
-				complete = receivedChunks[i];
-			}
-
-			if (complete) {
-				memset(receivedChunks, 0, sizeof(receivedChunks));
-				
-				rgb24 *buffer = bg.backBuffer();
-				
-				if (INCOMING_COLOR_DEPTH == 24) {
-					// Use memcpy for 24-bit color
-					memcpy(buffer, buf, BUFFER_SIZE);
-				} else if (INCOMING_COLOR_DEPTH == 16) {
-					uint16_t idx = 0;
-					for (uint16_t i = 0; i < NUM_LEDS; i++, idx += 2) {
-						convert16to24bit(buf[idx], buf[idx + 1], &buffer[i]);
-					}
-				}
-
-				
-
-				// Update debug information
-				char debugStr[16];
-				sprintf(debugStr, "F:%lu", frameCount);
-				bg.drawString(0, 0, {255,0,0}, debugStr);
-				// sprintf(debugStr, "FPS:%.1f", currentFPS);
-				// bg.drawString(0, 14, {255,0,0}, debugStr);
-
-				bg.swapBuffers();
-
-			
-
-			}
+	static bool started = false;
+
+	if (!started) {
+		WifiConnector::State state = wifi.poll(millis());
+		if (state == WifiConnector::FAILED) ESP.restart(); // Restart if cannot connect
+		showStatus(millis());
+		if (state != WifiConnector::CONNECTED) {
+			delay(STATUS_FRAME_MS);
+			return;
+		}
+		startReceiver();
+		started = true;
+	}
+
+	if (PIPELINED || RECEIVER != RECEIVER_UDP) {
+		// The tasks do the work
+		delay(LED_BLINK_INTERVAL);
+		return;
+	}
+
+	if (!UDP_ASYNC) {
+		uint32_t t0 = micros();
+		int packetSize = udp.parsePacket();
+		if (packetSize) {
+			pool.reclaim();
+			addReceiveCpu(micros() - t0, receiveChunk(packetSize));
+			sendTimings();
 		}
 	}
-	// // Update FPS calculation
-	// frameCount++;
-	// uint32_t now = millis();
-	// if (now - lastFPSUpdate >= FPS_UPDATE_INTERVAL) {
-	// 	currentFPS = frameCount * 1000.0f / (now - lastFPSUpdate);
-	// 	frameCount = 0;
-	// 	lastFPSUpdate = now;
-	// }
+	presentFrames();
+	reportStats();
 }
\ No newline at end of file